@@ -0,0 +1,44 @@
+#include "async_camera.hpp"
+
+/**
+ * @brief 构造函数
+ */
+async_camera::async_camera(io_executor& executor, v4l2_camera_device& camera)
+    : _executor(executor),
+      _camera(camera)
+{
+}
+
+/**
+ * @brief 等待下一帧
+ */
+task<std::shared_ptr<buffer>> async_camera::next_frame(clock::duration timeout)
+{
+    const bool unlimited = timeout < clock::duration(0);
+    const auto deadline = clock::now() + (unlimited ? clock::duration(0) : timeout);
+
+    while (true) {
+        auto frame = _camera.try_get_frame();
+        if (frame) {
+            co_return frame;
+        }
+
+        // 每次等待前重新获取描述符，设备恢复后会重新打开；等待时长不超过重试间隔，
+        // 描述符在等待期间被关闭时不会一直挂起
+        clock::duration wait = retry_interval;
+        if (!unlimited) {
+            auto remaining = deadline - clock::now();
+            if (remaining <= clock::duration(0)) {
+                co_return nullptr;
+            }
+            wait = std::min<clock::duration>(wait, remaining);
+        }
+
+        int fd = _camera.get_fd();
+        if (fd < 0) {
+            co_await _executor.sleep_for(wait);
+        } else {
+            co_await _executor.readable(fd, wait);
+        }
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+// 需要C++20协程，仅在编译器支持时由CMake编译（v4l2_camera_async）
+
+#include <chrono>
+#include <memory>
+
+#include "io_executor.hpp"
+#include "v4l2_camera_device.hpp"
+
+/**
+ * @brief v4l2_camera_device的协程取帧接口
+ *
+ * co_await camera.next_frame()在设备文件描述符的epoll可读事件上挂起，不占用线程，
+ * 就绪后在执行器线程中不等待地读取一帧。设备降级恢复或暂停采集期间按固定间隔重试。
+ * 协程需在执行器线程中运行；设备不能同时注册帧回调
+ */
+class async_camera {
+public:
+    using clock = io_executor::clock;
+
+    /**
+     * @brief 构造函数
+     *
+     * @param executor 执行器
+     * @param camera 已初始化的摄像头，需比本对象存活更久
+     */
+    async_camera(io_executor& executor, v4l2_camera_device& camera);
+
+    /**
+     * @brief 等待下一帧
+     *
+     * @param timeout 超时，为负时一直等待
+     * @return task<std::shared_ptr<buffer>> 帧，超时返回nullptr
+     */
+    task<std::shared_ptr<buffer>> next_frame(clock::duration timeout = clock::duration(-1));
+
+    /**
+     * @brief 获取摄像头
+     */
+    v4l2_camera_device& camera() { return _camera; }
+
+private:
+    static constexpr std::chrono::milliseconds retry_interval{100}; // 设备不可用时的重试间隔
+
+    io_executor& _executor;         // 执行器
+    v4l2_camera_device& _camera;    // 摄像头
+};
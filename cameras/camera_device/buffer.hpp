@@ -1,16 +1,84 @@
 #pragma once
 
 #include <vector>
+#include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <new>
+
+class preview_pyramid;
+
+/**
+ * @brief 时间戳所属的时钟
+ */
+enum class clock_domain : uint8_t {
+    unknown = 0,    // 未知
+    realtime,       // CLOCK_REALTIME（std::chrono::system_clock）
+    monotonic       // CLOCK_MONOTONIC（V4L2驱动时间戳、std::chrono::steady_clock）
+};
+
+/**
+ * @brief 按固定边界对齐的分配器
+ * 
+ * @tparam T 元素类型
+ * @tparam Alignment 对齐字节数
+ */
+template <typename T, size_t Alignment>
+struct aligned_allocator {
+    using value_type = T;
+
+    template <typename U>
+    struct rebind { using other = aligned_allocator<U, Alignment>; };
+
+    aligned_allocator() = default;
+
+    template <typename U>
+    aligned_allocator(const aligned_allocator<U, Alignment>&) {}
+
+    T* allocate(size_t n)
+    {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+    }
+
+    void deallocate(T* p, size_t)
+    {
+        ::operator delete(p, std::align_val_t(Alignment));
+    }
+
+    template <typename U>
+    bool operator==(const aligned_allocator<U, Alignment>&) const { return true; }
+
+    template <typename U>
+    bool operator!=(const aligned_allocator<U, Alignment>&) const { return false; }
+};
 
 /**
  * @brief 通用缓冲区类
  * 
- * 用于存储摄像头捕获的图像数据，并附带时间戳和序列号信息
+ * 用于存储摄像头捕获的图像数据，并附带时间戳、序列号和图像格式信息。
+ * 数据起始地址按alignment字节对齐，行跨度也是alignment的整数倍时每一行
+ * 都满足对齐要求，可以直接使用向量化内核
  */
 class buffer {
 public:
+    /**
+     * @brief 平面描述
+     * 
+     * 多平面格式（如NV12M）的各平面按驱动的平面布局依次存放在同一块数据中，
+     * 通过偏移直接访问，不做打包转换
+     */
+    struct plane {
+        size_t offset = 0;          // 平面在数据中的偏移（字节）
+        size_t size = 0;            // 平面大小（字节）
+        uint32_t bytesperline = 0;  // 行跨度（字节）
+    };
+
+    // 常用的多平面格式最多3个平面（YUV420M等），多留一个余量；超出的平面被忽略
+    static constexpr size_t max_planes = 4;
+
+    // 数据起始地址的对齐字节数，与缓存行一致
+    static constexpr size_t alignment = 64;
+
     /**
      * @brief 默认构造函数
      */
@@ -99,10 +167,148 @@ public:
      */
     void set_sequence(uint64_t sequence) { _sequence = sequence; }
 
+    /**
+     * @brief 设置图像格式
+     * 
+     * @param width 图像宽度
+     * @param height 图像高度
+     * @param fourcc 像素格式（V4L2 fourcc）
+     */
+    void set_format(uint32_t width, uint32_t height, uint32_t fourcc)
+    {
+        _width = width;
+        _height = height;
+        _fourcc = fourcc;
+    }
+
+    uint32_t width() const { return _width; }
+    uint32_t height() const { return _height; }
+    uint32_t fourcc() const { return _fourcc; }
+
+    /**
+     * @brief 设置/获取来源摄像头ID，未设置时为-1
+     */
+    void set_camera_id(int camera_id) { _camera_id = camera_id; }
+    int camera_id() const { return _camera_id; }
+
+    /**
+     * @brief 设置/获取产生该帧的触发编号，自由运行时为0
+     */
+    void set_trigger_id(uint64_t trigger_id) { _trigger_id = trigger_id; }
+    uint64_t trigger_id() const { return _trigger_id; }
+
+    /**
+     * @brief 设置/获取时间戳所属的时钟
+     */
+    void set_clock(clock_domain clock) { _clock = clock; }
+    clock_domain clock() const { return _clock; }
+
+    /**
+     * @brief 设置/获取附加的预览金字塔
+     * 
+     * 金字塔引用本buffer的数据，随缓冲池中的buffer一起复用，附加后不应再移动本buffer
+     */
+    void set_pyramid(std::shared_ptr<preview_pyramid> pyramid) { _pyramid = std::move(pyramid); }
+    const std::shared_ptr<preview_pyramid>& pyramid() const { return _pyramid; }
+
+    /**
+     * @brief 清除格式、来源和平面布局，用于缓冲池复用
+     */
+    void clear_metadata()
+    {
+        _width = 0;
+        _height = 0;
+        _fourcc = 0;
+        _camera_id = -1;
+        _trigger_id = 0;
+        _clock = clock_domain::unknown;
+        _plane_count = 0;
+    }
+
+    /**
+     * @brief 设置平面布局
+     * 
+     * @param planes 平面描述数组
+     * @param count 平面数量，超过max_planes的部分被忽略
+     */
+    void set_planes(const plane* planes, size_t count)
+    {
+        _plane_count = (count < max_planes) ? count : max_planes;
+        for (size_t i = 0; i < _plane_count; ++i) {
+            _planes[i] = planes[i];
+        }
+    }
+
+    /**
+     * @brief 清除平面布局
+     */
+    void clear_planes() { _plane_count = 0; }
+
+    /**
+     * @brief 获取平面数量
+     * 
+     * @return size_t 平面数量，未设置布局时为0
+     */
+    size_t plane_count() const { return _plane_count; }
+
+    /**
+     * @brief 获取平面描述
+     * 
+     * @param index 平面下标，需小于plane_count()
+     */
+    const plane& plane_info(size_t index) const { return _planes[index]; }
+
+    /**
+     * @brief 获取平面数据指针
+     * 
+     * @param index 平面下标，需小于plane_count()
+     */
+    uint8_t* plane_data(size_t index) { return _data.data() + _planes[index].offset; }
+    const uint8_t* plane_data(size_t index) const { return _data.data() + _planes[index].offset; }
+
+    /**
+     * @brief 获取某一平面第row行的起始地址
+     */
+    uint8_t* row(size_t plane_index, size_t row_index)
+    {
+        return plane_data(plane_index) + row_index * _planes[plane_index].bytesperline;
+    }
+    const uint8_t* row(size_t plane_index, size_t row_index) const
+    {
+        return plane_data(plane_index) + row_index * _planes[plane_index].bytesperline;
+    }
+
+    /**
+     * @brief 每个平面的每一行是否都按alignment对齐
+     * 
+     * @return true 数据起始地址、平面偏移和行跨度都是alignment的整数倍
+     */
+    bool rows_aligned() const
+    {
+        if (_plane_count == 0 || reinterpret_cast<uintptr_t>(_data.data()) % alignment != 0) {
+            return false;
+        }
+        for (size_t i = 0; i < _plane_count; ++i) {
+            if (_planes[i].offset % alignment != 0 || _planes[i].bytesperline % alignment != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
 protected:
     int64_t _timestamp;           // 时间戳（微秒）
     uint64_t _sequence;           // 序列号
+    plane _planes[max_planes];    // 平面布局
+    size_t _plane_count = 0;      // 平面数量
+    uint32_t _width = 0;          // 图像宽度
+    uint32_t _height = 0;         // 图像高度
+    uint32_t _fourcc = 0;         // 像素格式
+    int _camera_id = -1;          // 来源摄像头ID
+    uint64_t _trigger_id = 0;     // 触发编号
+    clock_domain _clock = clock_domain::unknown;  // 时间戳所属的时钟
+    std::shared_ptr<preview_pyramid> _pyramid;    // 预览金字塔
 
 private:
-    std::vector<uint8_t> _data;   // 内部数据存储
+    std::vector<uint8_t, aligned_allocator<uint8_t, alignment>> _data;   // 内部数据存储
 };
\ No newline at end of file
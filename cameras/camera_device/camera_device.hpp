@@ -2,10 +2,30 @@
 #pragma once
 #include <memory>
 #include <cstdint>
+#include <functional>
+#include <vector>
 #include "buffer.hpp"
 
 // 前向声明
 class buffer;
+class frame_dispatcher;
+
+// 推送方式的帧回调，frames按时间顺序；空批次表示在idle_interval_us内没有新帧，
+// 用于让使用者在设备降级或无数据时检查状态。回调可以取走frames中的帧
+using frame_sink = std::function<void(std::vector<std::shared_ptr<buffer>>& frames)>;
+
+// 帧回调选项
+struct frame_sink_options {
+    size_t max_batch = 1;                           // 每次回调最多交付的帧数，大于1时一次取走已就绪的帧
+    int64_t idle_interval_us = 100000;              // 没有新帧时以空批次回调的间隔（微秒），0表示不回调
+    std::shared_ptr<frame_dispatcher> dispatcher;   // 为空时在设备的采集线程中直接回调，否则交给分发线程
+};
+
+// 摄像头运行状态
+enum class camera_health {
+    ok,         // 正常采集
+    degraded    // 设备丢失或持续出错，正在后台恢复
+};
 
 class icamera_device {
 public:
@@ -26,4 +46,19 @@ public:
     
     // 获取摄像头ID
     virtual int get_camera_id() const = 0;
+    
+    // 获取运行状态，不支持故障恢复的设备始终为正常
+    virtual camera_health get_health() const { return camera_health::ok; }
+
+    // 注册推送方式的帧回调，替换已有的回调；返回false表示设备只支持get_frame拉取。
+    // 回调期间get_frame返回空；同一设备的回调不会并发执行，回调中不能注销回调或销毁设备
+    virtual bool set_frame_sink(frame_sink sink, const frame_sink_options& options = frame_sink_options())
+    {
+        (void)sink;
+        (void)options;
+        return false;
+    }
+
+    // 注销帧回调，返回后不会再有回调
+    virtual void clear_frame_sink() {}
 };
\ No newline at end of file
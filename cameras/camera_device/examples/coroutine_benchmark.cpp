@@ -0,0 +1,220 @@
+// 协程取帧与每摄像头一个线程取帧的对比
+//
+// 用V4l2Emulator模拟N个摄像头，分别以每摄像头一个阻塞取帧线程和单线程io_executor上的
+// N个协程取帧，比较帧率、进程CPU占用和线程数；另外挂起若干个空闲等待，观察其内存开销
+//
+// 用法: coroutine_benchmark [摄像头数=16] [每种方式的秒数=5] [帧率=30] [空闲等待数=10000]
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <linux/videodev2.h>
+
+#include "../async_camera.hpp"
+#include "../io_executor.hpp"
+#include "../v4l2_camera_device.hpp"
+#include "V4l2Emulator.h"
+
+namespace {
+
+// 读取/proc/self/status中的一项（Threads、VmRSS）
+long read_status(const char* key)
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    size_t length = std::char_traits<char>::length(key);
+    while (std::getline(status, line)) {
+        if (line.compare(0, length, key) == 0 && line.size() > length && line[length] == ':') {
+            return std::atol(line.c_str() + length + 1);
+        }
+    }
+    return -1;
+}
+
+double cpu_seconds()
+{
+    timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+struct result {
+    double fps = 0;
+    double cpu_percent = 0;
+    long threads = 0;
+};
+
+void print(const char* name, const result& r, size_t cameras)
+{
+    std::cout << std::left << std::setw(24) << name
+              << std::right << std::setw(10) << std::fixed << std::setprecision(1) << r.fps
+              << std::setw(12) << r.fps / cameras
+              << std::setw(9) << r.cpu_percent << "%"
+              << std::setw(9) << r.threads << std::endl;
+}
+
+// 每个摄像头一个线程，阻塞在get_frame中
+result run_threads(std::vector<std::unique_ptr<v4l2_camera_device>>& cameras, int seconds)
+{
+    std::atomic<bool> running(true);
+    std::atomic<uint64_t> frames(0);
+    std::vector<std::thread> threads;
+    for (auto& camera : cameras) {
+        threads.emplace_back([&, device = camera.get()]() {
+            while (running) {
+                if (device->get_frame()) {
+                    ++frames;
+                }
+            }
+        });
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    result r;
+    r.threads = read_status("Threads");
+    uint64_t start_frames = frames;
+    double start_cpu = cpu_seconds();
+    auto start = std::chrono::steady_clock::now();
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    r.fps = (frames - start_frames) / elapsed;
+    r.cpu_percent = 100.0 * (cpu_seconds() - start_cpu) / elapsed;
+
+    running = false;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return r;
+}
+
+task<void> consume(async_camera& camera, std::atomic<uint64_t>& frames, const bool& running)
+{
+    while (running) {
+        auto frame = co_await camera.next_frame(std::chrono::milliseconds(200));
+        if (frame) {
+            ++frames;
+        }
+    }
+}
+
+task<void> idle_wait(io_executor& executor, int fd)
+{
+    co_await executor.readable(fd);
+}
+
+task<void> stop_after(io_executor& executor, bool& running, std::chrono::milliseconds delay)
+{
+    co_await executor.sleep_for(delay);
+    running = false;
+    // 等正在等待的协程超时退出
+    co_await executor.sleep_for(std::chrono::milliseconds(300));
+    executor.stop();
+}
+
+// 单线程执行器上每个摄像头一个协程
+result run_coroutines(std::vector<std::unique_ptr<v4l2_camera_device>>& cameras, int seconds)
+{
+    io_executor executor;
+    std::vector<std::unique_ptr<async_camera>> async_cameras;
+    for (auto& camera : cameras) {
+        async_cameras.emplace_back(new async_camera(executor, *camera));
+    }
+
+    bool running = true;
+    std::atomic<uint64_t> frames(0);
+    for (auto& camera : async_cameras) {
+        executor.spawn(consume(*camera, frames, running));
+    }
+    executor.spawn(stop_after(executor, running, std::chrono::milliseconds(500 + seconds * 1000)));
+
+    result r;
+    uint64_t start_frames = 0;
+    double start_cpu = 0;
+    auto start = std::chrono::steady_clock::now();
+    std::thread sampler([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        r.threads = read_status("Threads");
+        start_frames = frames;
+        start_cpu = cpu_seconds();
+        start = std::chrono::steady_clock::now();
+        std::this_thread::sleep_for(std::chrono::seconds(seconds));
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        r.fps = (frames - start_frames) / elapsed;
+        r.cpu_percent = 100.0 * (cpu_seconds() - start_cpu) / elapsed;
+    });
+    executor.run();
+    sampler.join();
+    // 采样线程本身不计入
+    r.threads -= 1;
+    return r;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    size_t count = (argc > 1) ? std::atoi(argv[1]) : 16;
+    int seconds = (argc > 2) ? std::atoi(argv[2]) : 5;
+    int fps = (argc > 3) ? std::atoi(argv[3]) : 30;
+    size_t idle_waiters = (argc > 4) ? std::atoi(argv[4]) : 10000;
+
+    V4l2Emulator emulator;
+    std::vector<std::unique_ptr<v4l2_camera_device>> cameras;
+    for (size_t i = 0; i < count; ++i) {
+        std::string path = "/dev/v4l2emu" + std::to_string(i);
+        V4l2EmulatedDeviceConfig config;
+        config.m_fps = fps;
+        config.m_phaseUs = static_cast<long>(i * 1000000 / fps / count);
+        emulator.addDevice(path, config);
+
+        std::unique_ptr<v4l2_camera_device> camera(
+            new v4l2_camera_device(path, 640, 480, V4L2_PIX_FMT_YUYV, static_cast<int>(i)));
+        camera->set_syscalls(&emulator);
+        if (!camera->initialize() || !camera->start_capture()) {
+            std::cerr << "Cannot start " << path << std::endl;
+            return 1;
+        }
+        cameras.push_back(std::move(camera));
+    }
+
+    std::cout << std::left << std::setw(24) << "model"
+              << std::right << std::setw(10) << "fps"
+              << std::setw(12) << "per camera"
+              << std::setw(10) << "cpu"
+              << std::setw(9) << "threads" << std::endl;
+    print("thread per camera", run_threads(cameras, seconds), count);
+    print("coroutines", run_coroutines(cameras, seconds), count);
+
+    // 挂起的等待只占用协程帧，不占用线程
+    io_executor executor;
+    int idle_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    long rss_before = read_status("VmRSS");
+    for (size_t i = 0; i < idle_waiters; ++i) {
+        executor.spawn(idle_wait(executor, idle_fd));
+    }
+    long rss_after = read_status("VmRSS");
+    std::cout << executor.pending() << " pending awaits: "
+              << (rss_after - rss_before) << " kB RSS, "
+              << read_status("Threads") << " threads in process" << std::endl;
+    // 唤醒全部等待者使协程结束并释放
+    uint64_t one = 1;
+    ssize_t ret = write(idle_fd, &one, sizeof(one));
+    (void)ret;
+    executor.spawn([](io_executor& ex) -> task<void> {
+        co_await ex.sleep_for(std::chrono::milliseconds(10));
+        ex.stop();
+    }(executor));
+    executor.run();
+    close(idle_fd);
+    return 0;
+}
@@ -0,0 +1,129 @@
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include <linux/videodev2.h>
+
+#include "../buffer.hpp"
+#include "../pixel_pipeline.hpp"
+
+// 通用路径：每个像素在运行时判断输入格式、输出格式和处理阶段
+bool generic_convert(uint32_t fourcc, uint32_t out_fourcc, bool invert,
+                     const buffer& frame, size_t width, size_t height,
+                     uint8_t* dst, size_t dst_stride)
+{
+    const uint8_t* data = static_cast<const uint8_t*>(frame.data());
+    size_t stride = (fourcc == V4L2_PIX_FMT_YUYV) ? width * 2 : width;
+    size_t channels = (out_fourcc == V4L2_PIX_FMT_BGR24) ? 3 : 1;
+
+    for (size_t row = 0; row < height; ++row) {
+        uint8_t* d = dst + row * dst_stride;
+        for (size_t x = 0; x < width; ++x) {
+            int y = 0, u = 128, v = 128;
+            switch (fourcc) {
+                case V4L2_PIX_FMT_YUYV: {
+                    const uint8_t* s = data + row * stride + (x & ~size_t(1)) * 2;
+                    y = s[(x & 1) ? 2 : 0];
+                    u = s[1];
+                    v = s[3];
+                    break;
+                }
+                case V4L2_PIX_FMT_NV12: {
+                    const uint8_t* uv = data + stride * height + (row / 2) * stride;
+                    y = data[row * stride + x];
+                    u = uv[x & ~size_t(1)];
+                    v = uv[x | 1];
+                    break;
+                }
+                default:
+                    return false;
+            }
+            switch (out_fourcc) {
+                case V4L2_PIX_FMT_BGR24:
+                    pixel::bgr24::store_yuv(d, y, u, v);
+                    break;
+                case V4L2_PIX_FMT_GREY:
+                    pixel::gray8::store_yuv(d, y, u, v);
+                    break;
+                default:
+                    return false;
+            }
+            if (invert) {
+                for (size_t c = 0; c < channels; ++c) {
+                    d[c] = static_cast<uint8_t>(255 - d[c]);
+                }
+            }
+            d += channels;
+        }
+    }
+    return true;
+}
+
+// 生成测试图像
+std::shared_ptr<buffer> make_frame(size_t size)
+{
+    auto frame = std::make_shared<buffer>(size);
+    for (size_t i = 0; i < size; ++i) {
+        (*frame)[i] = static_cast<uint8_t>((i * 31) ^ (i >> 7));
+    }
+    return frame;
+}
+
+template <typename Fn>
+double time_per_frame_us(Fn&& fn, int iterations)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        fn();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::micro>(elapsed).count() / iterations;
+}
+
+template <typename Out, typename... Stages>
+void run_case(const char* name, uint32_t fourcc, size_t width, size_t height, int iterations, bool invert)
+{
+    size_t in_size = (fourcc == V4L2_PIX_FMT_YUYV) ? width * height * 2 : width * height * 3 / 2;
+    auto frame = make_frame(in_size);
+    size_t dst_stride = Out::min_stride(width);
+    std::vector<uint8_t> specialised(dst_stride * height);
+    std::vector<uint8_t> generic(dst_stride * height);
+
+    pixel::convert_fn fn = pixel::dispatcher<Out, Stages...>::select(fourcc);
+    if (!fn) {
+        std::cerr << name << ": no pipeline" << std::endl;
+        return;
+    }
+
+    double specialised_us = time_per_frame_us([&]() {
+        fn(*frame, width, height, specialised.data(), dst_stride);
+    }, iterations);
+    double generic_us = time_per_frame_us([&]() {
+        generic_convert(fourcc, Out::fourcc, invert, *frame, width, height, generic.data(), dst_stride);
+    }, iterations);
+
+    bool same = (specialised == generic);
+    std::cout << std::left << std::setw(28) << name
+              << std::right << std::setw(10) << std::fixed << std::setprecision(1) << generic_us << " us"
+              << std::setw(10) << specialised_us << " us"
+              << std::setw(8) << std::setprecision(2) << generic_us / specialised_us << "x"
+              << (same ? "" : "  OUTPUT MISMATCH") << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    int iterations = (argc > 1) ? std::atoi(argv[1]) : 50;
+
+    std::cout << std::left << std::setw(28) << "case"
+              << std::right << std::setw(13) << "generic"
+              << std::setw(13) << "specialised"
+              << std::setw(9) << "speedup" << std::endl;
+
+    run_case<pixel::bgr24>("YUYV->BGR 640x480", V4L2_PIX_FMT_YUYV, 640, 480, iterations, false);
+    run_case<pixel::bgr24>("YUYV->BGR 1920x1080", V4L2_PIX_FMT_YUYV, 1920, 1080, iterations, false);
+    run_case<pixel::gray8>("YUYV->GREY 1920x1080", V4L2_PIX_FMT_YUYV, 1920, 1080, iterations, false);
+    run_case<pixel::bgr24>("NV12->BGR 1920x1080", V4L2_PIX_FMT_NV12, 1920, 1080, iterations, false);
+    run_case<pixel::bgr24, pixel::stage::invert>("NV12->BGR+invert 1920x1080", V4L2_PIX_FMT_NV12, 1920, 1080, iterations, true);
+    return 0;
+}
@@ -11,6 +11,7 @@
 
 #include "../v4l2_camera_device.hpp"
 #include "../buffer.hpp"
+#include "../pixel_pipeline.hpp"
 
 // 确保目录存在，如果不存在则创建
 bool ensure_directory_exists(const std::string& path) {
@@ -31,7 +32,7 @@ void show_usage(const char* program_name) {
     std::cout << "选项:" << std::endl;
     std::cout << "  -w WIDTH     设置宽度 (默认: 640)" << std::endl;
     std::cout << "  -h HEIGHT    设置高度 (默认: 480)" << std::endl;
-    std::cout << "  -f FORMAT    设置格式 (MJPEG 或 YUYV, 默认: MJPEG)" << std::endl;
+    std::cout << "  -f FORMAT    设置格式 (MJPEG、YUYV、NV12 或 NV12M, 默认: MJPEG)" << std::endl;
     std::cout << "  -o DIR       指定输出目录 (默认: output)" << std::endl;
     std::cout << "  -i INTERVAL  保存图片的间隔(ms) (默认: 100)" << std::endl;
     std::cout << "  --help       显示此帮助信息" << std::endl;
@@ -40,19 +41,29 @@ void show_usage(const char* program_name) {
 }
 
 // 将二进制数据转换为OpenCV格式
-cv::Mat convertToMat(const std::shared_ptr<buffer>& frame, int width, int height, unsigned int format)
+cv::Mat convertToMat(const std::shared_ptr<buffer>& frame)
 {
     cv::Mat result;
     
-    // 根据不同格式进行转换
+    // 格式取自buffer自带的元数据，即采集时驱动实际协商的格式
+    int width = static_cast<int>(frame->width());
+    int height = static_cast<int>(frame->height());
+    unsigned int format = frame->fourcc();
+    
+    // 未压缩格式使用按fourcc预先实例化的转换管线，行跨度取自buffer的平面布局
+    pixel::convert_fn convert = pixel::dispatcher<pixel::bgr24>::select(format);
+    if (convert) {
+        result.create(height, width, CV_8UC3);
+        if (!convert(*frame, width, height, result.data, result.step)) {
+            std::cerr << "帧数据不完整" << std::endl;
+            result.release();
+        }
+        return result;
+    }
+    
+    // 压缩格式
     switch (format)
     {
-        case V4L2_PIX_FMT_YUYV:
-        {
-            cv::Mat yuyv(height, width, CV_8UC2, frame->data());
-            cv::cvtColor(yuyv, result, cv::COLOR_YUV2BGR_YUYV);
-            break;
-        }
         case V4L2_PIX_FMT_MJPEG:
         {
             try {
@@ -112,6 +123,8 @@ int main(int argc, char* argv[])
         } else if (strcmp(argv[i], "-f") == 0 && i+1 < argc) {
             std::string fmt = argv[++i];
             if (fmt == "YUYV") format = V4L2_PIX_FMT_YUYV;
+            if (fmt == "NV12") format = V4L2_PIX_FMT_NV12;
+            if (fmt == "NV12M") format = V4L2_PIX_FMT_NV12M;
         } else if (strcmp(argv[i], "-o") == 0 && i+1 < argc) {
             output_dir = argv[++i];
         } else if (strcmp(argv[i], "-i") == 0 && i+1 < argc) {
@@ -160,6 +173,11 @@ int main(int argc, char* argv[])
         // 捕获一帧
         auto frame = camera->get_frame();
         if (!frame) {
+            if (camera->get_health() == camera_health::degraded) {
+                // 设备丢失，等待后台恢复
+                std::this_thread::sleep_for(std::chrono::milliseconds(200));
+                continue;
+            }
             std::cerr << "无法获取帧!" << std::endl;
             std::this_thread::sleep_for(std::chrono::milliseconds(10));
             continue;
@@ -170,7 +188,7 @@ int main(int argc, char* argv[])
         frames_count++;
         
         // 转换图像
-        cv::Mat image = convertToMat(frame, actual_width, actual_height, format);
+        cv::Mat image = convertToMat(frame);
         if (image.empty()) {
             std::cerr << "无法解码图像" << std::endl;
             continue;
@@ -200,7 +218,9 @@ int main(int argc, char* argv[])
     // 停止捕获
     camera->stop_capture();
     
-    std::cout << "程序已退出，共捕获 " << frames_count << " 帧" << std::endl;
+    camera_recovery_stats recovery = camera->get_recovery_stats();
+    std::cout << "程序已退出，共捕获 " << frames_count << " 帧，恢复 " << recovery.recovered_count
+              << " 次，估计丢失 " << recovery.missed_frames << " 帧" << std::endl;
     
     return 0;
 }
@@ -0,0 +1,132 @@
+#include "frame_dispatcher.hpp"
+
+#include <algorithm>
+
+/**
+ * @brief 构造函数
+ */
+frame_dispatcher::frame_dispatcher(size_t max_queued)
+    : _max_queued(std::max<size_t>(max_queued, 1)),
+      _running_owner(nullptr),
+      _dropped_batches(0),
+      _stop(false)
+{
+    _thread = std::thread(&frame_dispatcher::run, this);
+}
+
+/**
+ * @brief 析构函数
+ */
+frame_dispatcher::~frame_dispatcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _cv.notify_all();
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+}
+
+/**
+ * @brief 登记帧来源的回调
+ */
+void frame_dispatcher::attach(const void* owner, frame_sink sink)
+{
+    auto shared_sink = std::make_shared<frame_sink>(std::move(sink));
+    std::lock_guard<std::mutex> lock(_mutex);
+    _sinks[owner] = std::move(shared_sink);
+}
+
+/**
+ * @brief 注销帧来源
+ */
+void frame_dispatcher::detach(const void* owner)
+{
+    // 丢弃的帧在锁外释放，归还帧缓冲池时不阻塞分发线程
+    std::deque<task> removed;
+    std::shared_ptr<frame_sink> sink;
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        for (auto it = _queue.begin(); it != _queue.end(); ) {
+            if (it->owner == owner) {
+                removed.push_back(std::move(*it));
+                it = _queue.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        auto it = _sinks.find(owner);
+        if (it != _sinks.end()) {
+            sink = std::move(it->second);
+            _sinks.erase(it);
+        }
+        if (std::this_thread::get_id() != _thread.get_id()) {
+            _idle_cv.wait(lock, [this, owner]() { return _running_owner != owner; });
+        }
+    }
+}
+
+/**
+ * @brief 提交一个帧批次
+ */
+void frame_dispatcher::post(const void* owner, std::vector<std::shared_ptr<buffer>> frames)
+{
+    task dropped;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_queue.size() >= _max_queued) {
+            dropped = std::move(_queue.front());
+            _queue.pop_front();
+            ++_dropped_batches;
+        }
+        _queue.push_back(task{owner, std::move(frames)});
+    }
+    _cv.notify_one();
+}
+
+/**
+ * @brief 获取丢弃的批次数
+ */
+uint64_t frame_dispatcher::get_dropped_batches() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _dropped_batches;
+}
+
+/**
+ * @brief 分发线程，按提交顺序执行回调
+ */
+void frame_dispatcher::run()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+        _cv.wait(lock, [this]() { return _stop || !_queue.empty(); });
+        if (_stop) {
+            break;
+        }
+
+        task item = std::move(_queue.front());
+        _queue.pop_front();
+        auto it = _sinks.find(item.owner);
+        if (it == _sinks.end()) {
+            continue;
+        }
+
+        // 回调期间不持锁，回调中注销自身时由这里的引用保持回调对象有效
+        std::shared_ptr<frame_sink> sink = it->second;
+        _running_owner = item.owner;
+        lock.unlock();
+        (*sink)(item.frames);
+        item.frames.clear();
+        sink.reset();
+        lock.lock();
+        _running_owner = nullptr;
+        _idle_cv.notify_all();
+    }
+
+    std::deque<task> remaining;
+    remaining.swap(_queue);
+    lock.unlock();
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "camera_device.hpp"
+
+/**
+ * @brief 帧回调分发线程
+ *
+ * 多个摄像头共用一个线程执行帧回调：采集线程只把帧批次入队，回调的耗时不影响取帧。
+ * 同一个分发器中的回调串行执行，因此同一设备的回调不会并发，不同设备的回调也不会并发。
+ * 队列满时丢弃最早的批次，其中的帧随之回到各自的帧缓冲池。
+ *
+ * 线程安全
+ */
+class frame_dispatcher {
+public:
+    /**
+     * @brief 构造函数，启动分发线程
+     *
+     * @param max_queued 最多排队的批次数
+     */
+    explicit frame_dispatcher(size_t max_queued = 64);
+
+    /**
+     * @brief 析构函数，丢弃未执行的批次并结束分发线程
+     */
+    ~frame_dispatcher();
+
+    // 禁止拷贝
+    frame_dispatcher(const frame_dispatcher&) = delete;
+    frame_dispatcher& operator=(const frame_dispatcher&) = delete;
+
+    /**
+     * @brief 登记一个帧来源的回调
+     *
+     * @param owner 帧来源，通常是设备对象
+     * @param sink 帧回调
+     */
+    void attach(const void* owner, frame_sink sink);
+
+    /**
+     * @brief 注销帧来源，丢弃其排队的批次并等待正在执行的回调返回
+     *
+     * 在分发线程中（即回调内）调用时不等待
+     *
+     * @param owner 帧来源
+     */
+    void detach(const void* owner);
+
+    /**
+     * @brief 提交一个帧批次
+     *
+     * @param owner 已登记的帧来源
+     * @param frames 帧批次，可以为空
+     */
+    void post(const void* owner, std::vector<std::shared_ptr<buffer>> frames);
+
+    /**
+     * @brief 获取因队列满而丢弃的批次数
+     */
+    uint64_t get_dropped_batches() const;
+
+private:
+    /**
+     * @brief 一个待执行的批次
+     */
+    struct task {
+        const void* owner;
+        std::vector<std::shared_ptr<buffer>> frames;
+    };
+
+    void run();
+
+    size_t _max_queued;                                 // 最多排队的批次数
+    mutable std::mutex _mutex;                          // 保护以下成员
+    std::condition_variable _cv;                        // 唤醒分发线程
+    std::condition_variable _idle_cv;                   // 通知回调已返回
+    std::deque<task> _queue;                            // 待执行的批次
+    std::map<const void*, std::shared_ptr<frame_sink>> _sinks; // 已登记的回调
+    const void* _running_owner;                         // 正在执行回调的帧来源
+    uint64_t _dropped_batches;                          // 丢弃的批次数
+    bool _stop;                                         // 通知分发线程退出
+    std::thread _thread;                                // 分发线程
+};
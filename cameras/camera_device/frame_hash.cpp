@@ -0,0 +1,153 @@
+#include "frame_hash.hpp"
+
+#include <chrono>
+#include <cstring>
+
+namespace {
+
+constexpr size_t block_size = 64;
+constexpr size_t lanes = block_size / sizeof(uint64_t);
+
+constexpr uint64_t prime64_1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t prime64_2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t prime32_1 = 0x9E3779B1U;
+
+// 取自xxh3默认密钥的前64字节
+constexpr uint64_t secret[lanes] = {
+    0xbe4ba423396cfeb8ULL, 0x1cad21f72c81017cULL, 0xdb979083e96dd4deULL, 0x1f67b3b7a4a44072ULL,
+    0x78e5c0cc4ee679cbULL, 0x2172ffcc7dd05a82ULL, 0x8e2443f7744608b8ULL, 0x4c263a81e69035e0ULL,
+};
+
+/**
+ * @brief 把一个64字节块累加到累加器
+ */
+inline void accumulate_block(uint64_t* acc, const uint8_t* block)
+{
+    uint64_t words[lanes];
+    memcpy(words, block, block_size);
+    for (size_t i = 0; i < lanes; ++i) {
+        uint64_t key = words[i] ^ secret[i];
+        acc[i ^ 1] += words[i];
+        acc[i] += (key & 0xFFFFFFFFULL) * (key >> 32);
+    }
+}
+
+/**
+ * @brief 打散累加器，避免长序列中高位信息丢失
+ */
+inline void scramble(uint64_t* acc)
+{
+    for (size_t i = 0; i < lanes; ++i) {
+        uint64_t a = acc[i];
+        a ^= a >> 47;
+        a ^= secret[i];
+        acc[i] = a * prime32_1;
+    }
+}
+
+inline uint64_t avalanche(uint64_t h)
+{
+    h ^= h >> 37;
+    h *= 0x165667919E3779F9ULL;
+    h ^= h >> 32;
+    return h;
+}
+
+} // namespace
+
+/**
+ * @brief 计算帧内容的采样哈希
+ */
+uint64_t frame_sample_hash(const void* data, size_t size, size_t sample_blocks)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint64_t acc[lanes] = {
+        prime32_1, prime64_1, prime64_2, prime64_1 ^ prime64_2,
+        prime64_2 + size, prime32_1 ^ size, prime64_1 + 1, prime64_2 - 1,
+    };
+
+    size_t total_blocks = size / block_size;
+    if (sample_blocks == 0 || sample_blocks > total_blocks) {
+        sample_blocks = total_blocks;
+    }
+
+    // 均匀选取采样块，块之间的间距固定，同一大小的帧总是采样相同的位置
+    for (size_t i = 0; i < sample_blocks; ++i) {
+        size_t index = (total_blocks == sample_blocks) ? i : (i * total_blocks) / sample_blocks;
+        accumulate_block(acc, bytes + index * block_size);
+        if ((i & 15) == 15) {
+            scramble(acc);
+        }
+    }
+
+    // 帧尾不足一个块的部分
+    size_t tail = size % block_size;
+    if (tail > 0) {
+        uint8_t last[block_size] = {0};
+        memcpy(last, bytes + size - tail, tail);
+        accumulate_block(acc, last);
+    }
+
+    uint64_t h = size * prime64_1;
+    for (size_t i = 0; i < lanes; i += 2) {
+        uint64_t lo = acc[i] ^ secret[i];
+        uint64_t hi = acc[i + 1] ^ secret[i + 1];
+        h += (lo ^ ((hi << 31) | (hi >> 33))) * prime64_1;
+        h ^= h >> 29;
+    }
+    return avalanche(h);
+}
+
+/**
+ * @brief 构造函数
+ */
+freeze_detector::freeze_detector(const freeze_config& config)
+    : _config(config),
+      _last_hash(0),
+      _last_size(0),
+      _has_last(false),
+      _repeat_count(0),
+      _frozen(false)
+{
+}
+
+/**
+ * @brief 检测一帧
+ */
+frame_verdict freeze_detector::check(const buffer& frame)
+{
+    auto start = std::chrono::steady_clock::now();
+    uint64_t hash = frame_sample_hash(frame.data(), frame.size(), _config.sample_blocks);
+    _stats.hash_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    ++_stats.frames;
+
+    bool same = _has_last && hash == _last_hash && frame.size() == _last_size;
+    _last_hash = hash;
+    _last_size = frame.size();
+    _has_last = true;
+
+    if (!same) {
+        _repeat_count = 0;
+        _frozen = false;
+        return frame_verdict::unique;
+    }
+
+    ++_stats.duplicates;
+    ++_repeat_count;
+    if (!_frozen && _config.freeze_threshold > 0 && _repeat_count >= _config.freeze_threshold) {
+        _frozen = true;
+        ++_stats.freeze_events;
+    }
+    return _frozen ? frame_verdict::frozen : frame_verdict::duplicate;
+}
+
+/**
+ * @brief 清除上一帧记录和冻结状态
+ */
+void freeze_detector::reset()
+{
+    _has_last = false;
+    _repeat_count = 0;
+    _frozen = false;
+}
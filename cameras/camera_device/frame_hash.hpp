@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "buffer.hpp"
+
+/**
+ * @brief 计算帧内容的采样哈希
+ *
+ * 在整帧上均匀选取sample_blocks个64字节块，按xxh3的累加方式（每个64位字与密钥
+ * 异或后高低32位相乘）混合到8个64位累加器中，循环可被编译器向量化。帧尾不足64字节
+ * 的部分和帧大小总是参与计算。采样只读取帧的一小部分，适合判断同一摄像头相邻两帧
+ * 是否为同一个缓冲区，不适合检测局部的细微变化
+ *
+ * @param data 帧数据
+ * @param size 帧大小（字节）
+ * @param sample_blocks 采样块数，为0或大于帧的块数时对整帧计算
+ * @return uint64_t 哈希值
+ */
+uint64_t frame_sample_hash(const void* data, size_t size, size_t sample_blocks);
+
+/**
+ * @brief 重复帧检测配置
+ */
+struct freeze_config {
+    size_t sample_blocks = 512;     // 每帧采样的64字节块数，1080p YUYV约读取帧的0.8%
+    uint32_t freeze_threshold = 3;  // 连续重复帧数达到该值时判定为画面冻结
+    bool drop_duplicates = true;    // 重复帧不参与组帧
+};
+
+/**
+ * @brief 单帧的检测结果
+ */
+enum class frame_verdict {
+    unique = 0,     // 与上一帧不同
+    duplicate,      // 与上一帧相同
+    frozen          // 与上一帧相同且连续重复次数已达到冻结阈值
+};
+
+/**
+ * @brief 重复帧检测统计
+ */
+struct freeze_stats {
+    uint64_t frames = 0;            // 检测的帧数
+    uint64_t duplicates = 0;        // 重复帧数
+    uint64_t freeze_events = 0;     // 进入冻结状态的次数
+    uint64_t hash_ns = 0;           // 哈希计算累计耗时（纳秒）
+};
+
+/**
+ * @brief 单个摄像头的重复帧和画面冻结检测
+ *
+ * 比较相邻两帧的采样哈希，画面冻结后收到第一帧不同的帧即恢复。
+ * 非线程安全，应只在该摄像头的采集线程中使用
+ */
+class freeze_detector {
+public:
+    /**
+     * @brief 构造函数
+     *
+     * @param config 检测配置
+     */
+    explicit freeze_detector(const freeze_config& config = freeze_config());
+
+    /**
+     * @brief 检测一帧
+     *
+     * @param frame 新到达的帧
+     * @return frame_verdict 检测结果
+     */
+    frame_verdict check(const buffer& frame);
+
+    /**
+     * @brief 是否处于画面冻结状态
+     */
+    bool frozen() const { return _frozen; }
+
+    /**
+     * @brief 当前连续重复的帧数
+     */
+    uint32_t repeat_count() const { return _repeat_count; }
+
+    /**
+     * @brief 获取检测配置
+     */
+    const freeze_config& config() const { return _config; }
+
+    /**
+     * @brief 获取统计信息
+     */
+    const freeze_stats& stats() const { return _stats; }
+
+    /**
+     * @brief 清除上一帧记录和冻结状态，用于摄像头重新打开后
+     */
+    void reset();
+
+private:
+    freeze_config _config;          // 检测配置
+    freeze_stats _stats;            // 统计信息
+    uint64_t _last_hash;            // 上一帧的哈希
+    size_t _last_size;              // 上一帧的大小
+    bool _has_last;                 // 是否已有上一帧
+    uint32_t _repeat_count;         // 连续重复帧数
+    bool _frozen;                   // 是否处于冻结状态
+};
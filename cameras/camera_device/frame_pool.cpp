@@ -0,0 +1,167 @@
+#include "frame_pool.hpp"
+
+#include <atomic>
+
+#include "preview_pyramid.hpp"
+
+/**
+ * @brief 构造函数
+ */
+frame_pool::frame_pool(size_t frame_size,
+                       size_t max_frames,
+                       std::shared_ptr<memory_budget> budget)
+    : _frame_size(frame_size),
+      _max_frames(max_frames),
+      _budget(std::move(budget)),
+      _next(0),
+      _exhausted(0)
+{
+    _frames.reserve(max_frames);
+}
+
+/**
+ * @brief 析构函数
+ */
+frame_pool::~frame_pool()
+{
+    if (_budget) {
+        _budget->release(_frames.size() * _frame_size, memory_consumer::frame_pool);
+    }
+}
+
+/**
+ * @brief 获取一个空闲buffer
+ */
+std::shared_ptr<buffer> frame_pool::acquire()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    std::shared_ptr<buffer> frame = find_free();
+    if (frame) {
+        return frame;
+    }
+
+    if (grow(lock)) {
+        return _frames.back();
+    }
+
+    // 申请预算时可能已触发削减动作并释放了部分buffer
+    frame = find_free();
+    if (!frame) {
+        ++_exhausted;
+    }
+    return frame;
+}
+
+/**
+ * @brief 预先分配buffer
+ */
+size_t frame_pool::reserve(size_t count)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    while (_frames.size() < count && grow(lock)) {
+    }
+    return _frames.size();
+}
+
+/**
+ * @brief 释放空闲的buffer
+ */
+size_t frame_pool::trim(size_t keep)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    size_t released = 0;
+    for (size_t i = _frames.size(); i > 0 && _frames.size() > keep; --i) {
+        if (_frames[i - 1].use_count() == 1) {
+            _frames.erase(_frames.begin() + (i - 1));
+            released += _frame_size;
+        }
+    }
+    _next = 0;
+
+    if (_budget && released > 0) {
+        _budget->release(released, memory_consumer::frame_pool);
+    }
+    return released;
+}
+
+/**
+ * @brief 已分配的buffer数量
+ */
+size_t frame_pool::allocated() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _frames.size();
+}
+
+/**
+ * @brief 获取失败的次数
+ */
+uint64_t frame_pool::exhausted_count() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _exhausted;
+}
+
+/**
+ * @brief 查找并复位一个只被池引用的buffer
+ *
+ * 调用者需持有互斥锁
+ */
+std::shared_ptr<buffer> frame_pool::find_free()
+{
+    for (size_t n = 0; n < _frames.size(); ++n) {
+        size_t index = (_next + n) % _frames.size();
+        std::shared_ptr<buffer>& frame = _frames[index];
+
+        // 只被池引用说明消费者已全部释放
+        if (frame.use_count() == 1) {
+            // 与消费者释放引用时的写入建立先后关系
+            std::atomic_thread_fence(std::memory_order_acquire);
+            frame->resize(_frame_size);
+            frame->set_timestamp(0);
+            frame->set_sequence(0);
+            frame->clear_metadata();
+            if (frame->pyramid()) {
+                // 保留金字塔对象，只归还上一帧的各级buffer
+                frame->pyramid()->reset();
+            }
+            _next = (index + 1) % _frames.size();
+            return frame;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * @brief 在数量上限和内存预算允许的情况下新增一个buffer
+ *
+ * 申请预算时会暂时释放互斥锁，削减回调可以安全地调用本池的trim
+ *
+ * @param lock 已持有的互斥锁
+ */
+bool frame_pool::grow(std::unique_lock<std::mutex>& lock)
+{
+    if (_frames.size() >= _max_frames) {
+        return false;
+    }
+
+    if (_budget) {
+        lock.unlock();
+        bool reserved = _budget->try_reserve(_frame_size, memory_consumer::frame_pool);
+        lock.lock();
+
+        if (!reserved) {
+            return false;
+        }
+        if (_frames.size() >= _max_frames) {
+            _budget->release(_frame_size, memory_consumer::frame_pool);
+            return false;
+        }
+    }
+
+    _frames.push_back(std::make_shared<buffer>(_frame_size));
+    return true;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "buffer.hpp"
+#include "memory_budget.hpp"
+
+/**
+ * @brief 帧缓冲池
+ *
+ * 为单个摄像头循环复用固定大小的buffer对象。当某个buffer只被池本身引用时即视为空闲；
+ * 没有空闲buffer时，在数量上限和内存预算允许的情况下扩容，否则获取失败，
+ * 由调用者丢弃该帧，从而限制在途帧的总内存。
+ */
+class frame_pool {
+public:
+    /**
+     * @brief 构造函数
+     *
+     * @param frame_size 单帧缓冲区大小（字节）
+     * @param max_frames 最多分配的buffer数量
+     * @param budget 共享的内存预算，为空时不做预算限制
+     */
+    frame_pool(size_t frame_size,
+               size_t max_frames,
+               std::shared_ptr<memory_budget> budget = nullptr);
+
+    /**
+     * @brief 析构函数，归还全部内存额度
+     */
+    ~frame_pool();
+
+    // 禁止拷贝
+    frame_pool(const frame_pool&) = delete;
+    frame_pool& operator=(const frame_pool&) = delete;
+
+    /**
+     * @brief 获取一个空闲buffer
+     *
+     * 返回的buffer大小为frame_size，时间戳和序列号已清零
+     *
+     * @return std::shared_ptr<buffer> 空闲buffer，池耗尽或超出预算时返回nullptr
+     */
+    std::shared_ptr<buffer> acquire();
+
+    /**
+     * @brief 预先分配buffer
+     *
+     * @param count 期望的buffer总数（不超过max_frames）
+     * @return size_t 实际分配后的buffer总数
+     */
+    size_t reserve(size_t count);
+
+    /**
+     * @brief 释放空闲的buffer并归还内存额度
+     *
+     * @param keep 至少保留的buffer数量
+     * @return size_t 释放的字节数
+     */
+    size_t trim(size_t keep = 0);
+
+    size_t frame_size() const { return _frame_size; }
+    size_t max_frames() const { return _max_frames; }
+
+    /**
+     * @brief 已分配的buffer数量
+     */
+    size_t allocated() const;
+
+    /**
+     * @brief 因池耗尽或超出预算而获取失败的次数
+     */
+    uint64_t exhausted_count() const;
+
+private:
+    std::shared_ptr<buffer> find_free();
+    bool grow(std::unique_lock<std::mutex>& lock);
+
+    size_t _frame_size;                                  // 单帧缓冲区大小
+    size_t _max_frames;                                  // buffer数量上限
+    std::shared_ptr<memory_budget> _budget;              // 共享的内存预算
+    mutable std::mutex _mutex;                           // 互斥锁
+    std::vector<std::shared_ptr<buffer>> _frames;        // 已分配的buffer
+    size_t _next;                                        // 下一次开始查找的位置
+    uint64_t _exhausted;                                 // 获取失败次数
+};
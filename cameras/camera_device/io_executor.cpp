@@ -0,0 +1,284 @@
+#include "io_executor.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace {
+
+/**
+ * @brief spawn使用的自释放协程
+ */
+struct detached_task {
+    struct promise_type {
+        detached_task get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() const noexcept { return {}; }
+        std::suspend_never final_suspend() const noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept {}
+    };
+};
+
+detached_task run_detached(task<void> work)
+{
+    try {
+        co_await work;
+    } catch (const std::exception& e) {
+        std::cerr << "Exception in spawned task: " << e.what() << std::endl;
+    } catch (...) {
+        std::cerr << "Unknown exception in spawned task" << std::endl;
+    }
+}
+
+} // namespace
+
+/**
+ * @brief 挂起并登记等待
+ */
+bool io_executor::readable_awaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    _handle = handle;
+    return _executor.add_waiter(this);
+}
+
+/**
+ * @brief 构造函数
+ */
+io_executor::io_executor()
+    : _epoll_fd(epoll_create1(EPOLL_CLOEXEC)),
+      _wake_fd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+      _stop(false),
+      _pending(0),
+      _stop_requested(false)
+{
+    if (_epoll_fd < 0 || _wake_fd < 0) {
+        throw std::runtime_error("io_executor: cannot create epoll or eventfd");
+    }
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = _wake_fd;
+    epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _wake_fd, &event);
+}
+
+/**
+ * @brief 析构函数
+ */
+io_executor::~io_executor()
+{
+    close(_wake_fd);
+    close(_epoll_fd);
+}
+
+/**
+ * @brief 执行协程直到stop
+ */
+void io_executor::run()
+{
+    _stop = false;
+    epoll_event events[64];
+    while (!_stop) {
+        int count = epoll_wait(_epoll_fd, events, 64, next_timeout_ms());
+        if (count < 0 && errno != EINTR) {
+            std::cerr << "io_executor: epoll_wait failed: " << strerror(errno) << std::endl;
+            break;
+        }
+        for (int i = 0; i < count; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == _wake_fd) {
+                uint64_t value;
+                while (read(_wake_fd, &value, sizeof(value)) > 0) {
+                }
+            } else {
+                resume_fd(fd);
+            }
+        }
+        expire_timers();
+
+        // 恢复期间可能登记新的等待，先取出本轮的等待者
+        std::vector<readable_awaiter*> ready;
+        ready.swap(_ready);
+        for (auto* waiter : ready) {
+            waiter->_handle.resume();
+        }
+        drain_posted();
+    }
+}
+
+/**
+ * @brief 通知run返回
+ */
+void io_executor::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(_post_mutex);
+        _stop_requested = true;
+    }
+    uint64_t one = 1;
+    ssize_t ret = write(_wake_fd, &one, sizeof(one));
+    (void)ret;
+}
+
+/**
+ * @brief 在执行器线程中恢复协程
+ */
+void io_executor::post(std::coroutine_handle<> handle)
+{
+    {
+        std::lock_guard<std::mutex> lock(_post_mutex);
+        _posted.push_back(handle);
+    }
+    uint64_t one = 1;
+    ssize_t ret = write(_wake_fd, &one, sizeof(one));
+    (void)ret;
+}
+
+/**
+ * @brief 启动独立运行的任务
+ */
+void io_executor::spawn(task<void> work)
+{
+    run_detached(std::move(work));
+}
+
+/**
+ * @brief 登记等待者，登记失败时返回false，协程不挂起
+ */
+bool io_executor::add_waiter(readable_awaiter* waiter)
+{
+    if (waiter->_fd != sleep_fd) {
+        // 每次登记都重新启用：描述符号可能已被关闭后重新分配给另一个设备
+        fd_state& state = _fds[waiter->_fd];
+        if (!arm(waiter->_fd)) {
+            if (state.waiters.empty()) {
+                _fds.erase(waiter->_fd);
+            }
+            waiter->_readable = false;
+            return false;
+        }
+        state.armed = true;
+        state.waiters.push_back(waiter);
+    }
+    if (waiter->_timeout >= clock::duration(0)) {
+        waiter->_timer = _timers.emplace(clock::now() + waiter->_timeout, waiter);
+        waiter->_has_timer = true;
+    }
+    ++_pending;
+    return true;
+}
+
+/**
+ * @brief 在epoll中登记一次可读事件
+ */
+bool io_executor::arm(int fd)
+{
+    epoll_event event = {};
+    event.events = EPOLLIN | EPOLLONESHOT;
+    event.data.fd = fd;
+    // 单次触发的描述符触发后仍在epoll中，重新启用即可；描述符关闭后epoll自动移除，需要重新加入
+    if (epoll_ctl(_epoll_fd, EPOLL_CTL_MOD, fd, &event) == 0) {
+        return true;
+    }
+    return (errno == ENOENT) && (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, fd, &event) == 0);
+}
+
+/**
+ * @brief 从文件描述符的等待列表中移除超时的等待者
+ */
+void io_executor::remove_waiter(readable_awaiter* waiter)
+{
+    auto it = _fds.find(waiter->_fd);
+    if (it == _fds.end()) {
+        return;
+    }
+    auto& waiters = it->second.waiters;
+    waiters.erase(std::remove(waiters.begin(), waiters.end(), waiter), waiters.end());
+    // 仍处于启用状态的登记保留在epoll中，触发时没有等待者即忽略
+    if (waiters.empty() && !it->second.armed) {
+        _fds.erase(it);
+    }
+}
+
+/**
+ * @brief 文件描述符可读，恢复其全部等待者
+ */
+void io_executor::resume_fd(int fd)
+{
+    auto it = _fds.find(fd);
+    if (it == _fds.end()) {
+        return;
+    }
+    std::vector<readable_awaiter*> waiters;
+    waiters.swap(it->second.waiters);
+    _fds.erase(it);
+
+    for (auto* waiter : waiters) {
+        if (waiter->_has_timer) {
+            _timers.erase(waiter->_timer);
+            waiter->_has_timer = false;
+        }
+        waiter->_readable = true;
+        --_pending;
+        _ready.push_back(waiter);
+    }
+}
+
+/**
+ * @brief 恢复到期的等待者
+ */
+void io_executor::expire_timers()
+{
+    auto now = clock::now();
+    while (!_timers.empty() && _timers.begin()->first <= now) {
+        readable_awaiter* waiter = _timers.begin()->second;
+        _timers.erase(_timers.begin());
+        waiter->_has_timer = false;
+        if (waiter->_fd != sleep_fd) {
+            remove_waiter(waiter);
+        }
+        waiter->_readable = false;
+        --_pending;
+        _ready.push_back(waiter);
+    }
+}
+
+/**
+ * @brief 恢复其他线程提交的协程
+ */
+void io_executor::drain_posted()
+{
+    {
+        std::lock_guard<std::mutex> lock(_post_mutex);
+        _running.swap(_posted);
+        if (_stop_requested) {
+            _stop_requested = false;
+            _stop = true;
+        }
+    }
+    for (auto handle : _running) {
+        handle.resume();
+    }
+    _running.clear();
+}
+
+/**
+ * @brief 计算epoll_wait的超时（毫秒），向上取整以免提前醒来
+ */
+int io_executor::next_timeout_ms() const
+{
+    if (!_ready.empty()) {
+        return 0;
+    }
+    if (_timers.empty()) {
+        return -1;
+    }
+    auto remaining = _timers.begin()->first - clock::now();
+    if (remaining <= clock::duration(0)) {
+        return 0;
+    }
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(remaining + std::chrono::milliseconds(1) - clock::duration(1));
+    return static_cast<int>(std::min<int64_t>(ms.count(), 1000000));
+}
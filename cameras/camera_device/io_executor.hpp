@@ -0,0 +1,293 @@
+#pragma once
+
+// 需要C++20协程，仅在编译器支持时由CMake编译（v4l2_camera_async）
+
+#include <algorithm>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief 惰性启动的协程任务
+ *
+ * 被co_await时才开始执行，结束后恢复等待它的协程。结果只能取一次
+ *
+ * @tparam T 返回值类型
+ */
+template <typename T>
+class task;
+
+namespace detail {
+
+/**
+ * @brief task的promise公共部分：保存等待者并在结束时转移执行
+ */
+struct task_promise_base {
+    struct final_awaiter {
+        bool await_ready() const noexcept { return false; }
+
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+        {
+            auto continuation = handle.promise().continuation;
+            return continuation ? continuation : std::noop_coroutine();
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    final_awaiter final_suspend() const noexcept { return {}; }
+    void unhandled_exception() { exception = std::current_exception(); }
+
+    std::coroutine_handle<> continuation;   // 等待本任务的协程
+    std::exception_ptr exception;           // 任务抛出的异常
+};
+
+template <typename T>
+struct task_promise : task_promise_base {
+    task<T> get_return_object() noexcept;
+
+    template <typename U>
+    void return_value(U&& value) { result.emplace(std::forward<U>(value)); }
+
+    T take()
+    {
+        if (exception) {
+            std::rethrow_exception(exception);
+        }
+        return std::move(*result);
+    }
+
+    std::optional<T> result;
+};
+
+template <>
+struct task_promise<void> : task_promise_base {
+    task<void> get_return_object() noexcept;
+
+    void return_void() noexcept {}
+
+    void take()
+    {
+        if (exception) {
+            std::rethrow_exception(exception);
+        }
+    }
+};
+
+} // namespace detail
+
+template <typename T = void>
+class task {
+public:
+    using promise_type = detail::task_promise<T>;
+
+    task() noexcept = default;
+    explicit task(std::coroutine_handle<promise_type> handle) noexcept : _handle(handle) {}
+    task(task&& other) noexcept : _handle(std::exchange(other._handle, nullptr)) {}
+    task& operator=(task&& other) noexcept
+    {
+        if (this != &other) {
+            if (_handle) {
+                _handle.destroy();
+            }
+            _handle = std::exchange(other._handle, nullptr);
+        }
+        return *this;
+    }
+    ~task()
+    {
+        if (_handle) {
+            _handle.destroy();
+        }
+    }
+
+    // 禁止拷贝
+    task(const task&) = delete;
+    task& operator=(const task&) = delete;
+
+    bool valid() const noexcept { return static_cast<bool>(_handle); }
+
+    bool await_ready() const noexcept { return !_handle || _handle.done(); }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+    {
+        _handle.promise().continuation = awaiting;
+        return _handle;
+    }
+
+    T await_resume() { return _handle.promise().take(); }
+
+private:
+    std::coroutine_handle<promise_type> _handle;
+};
+
+namespace detail {
+
+template <typename T>
+task<T> task_promise<T>::get_return_object() noexcept
+{
+    return task<T>(std::coroutine_handle<task_promise<T>>::from_promise(*this));
+}
+
+inline task<void> task_promise<void>::get_return_object() noexcept
+{
+    return task<void>(std::coroutine_handle<task_promise<void>>::from_promise(*this));
+}
+
+} // namespace detail
+
+/**
+ * @brief 基于epoll的单线程协程执行器
+ *
+ * 协程在run()所在的线程中执行，等待文件描述符可读或定时器时只占用一个等待记录，
+ * 不占用线程，数千个挂起的等待只消耗各自的协程帧。readable、sleep_for和spawn
+ * 只能在执行器线程中（或run之前）调用；post、stop可在任意线程调用。
+ *
+ * 同一文件描述符上可以有多个等待者，就绪时全部恢复，由各自重新检查数据
+ */
+class io_executor {
+public:
+    using clock = std::chrono::steady_clock;
+
+    /**
+     * @brief 构造函数，创建epoll和唤醒用的eventfd
+     */
+    io_executor();
+
+    /**
+     * @brief 析构函数，未完成的协程不会再被恢复
+     */
+    ~io_executor();
+
+    // 禁止拷贝
+    io_executor(const io_executor&) = delete;
+    io_executor& operator=(const io_executor&) = delete;
+
+    /**
+     * @brief 在当前线程中执行协程直到stop
+     */
+    void run();
+
+    /**
+     * @brief 通知run返回，可在任意线程调用
+     */
+    void stop();
+
+    /**
+     * @brief 在执行器线程中恢复一个协程，可在任意线程调用
+     */
+    void post(std::coroutine_handle<> handle);
+
+    /**
+     * @brief 启动一个独立运行的任务，任务结束后自动释放
+     *
+     * 任务立即在调用线程中开始执行直到第一次挂起
+     */
+    void spawn(task<void> work);
+
+    /**
+     * @brief 等待文件描述符的可读awaiter，co_await结果为true表示可读，false表示超时
+     */
+    class readable_awaiter {
+    public:
+        readable_awaiter(io_executor& executor, int fd, clock::duration timeout)
+            : _executor(executor), _fd(fd), _timeout(timeout) {}
+
+        bool await_ready() const noexcept { return (_fd < 0) && (_fd != sleep_fd); }
+        bool await_suspend(std::coroutine_handle<> handle);
+        bool await_resume() const noexcept { return _readable; }
+
+    private:
+        friend class io_executor;
+
+        io_executor& _executor;
+        int _fd;
+        clock::duration _timeout;
+        std::coroutine_handle<> _handle;
+        bool _readable = false;
+        bool _has_timer = false;
+        std::multimap<clock::time_point, readable_awaiter*>::iterator _timer;
+    };
+
+    /**
+     * @brief 等待文件描述符可读
+     *
+     * @param fd 文件描述符，为负时立即返回false
+     * @param timeout 超时，为负时不超时
+     */
+    readable_awaiter readable(int fd, clock::duration timeout = clock::duration(-1))
+    {
+        return readable_awaiter(*this, fd, timeout);
+    }
+
+    /**
+     * @brief 挂起一段时间，co_await结果为false
+     */
+    readable_awaiter sleep_for(clock::duration duration)
+    {
+        return readable_awaiter(*this, sleep_fd, std::max(duration, clock::duration(0)));
+    }
+
+    /**
+     * @brief 切换到执行器线程的awaiter
+     */
+    struct schedule_awaiter {
+        io_executor& executor;
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle) { executor.post(handle); }
+        void await_resume() const noexcept {}
+    };
+
+    /**
+     * @brief 把当前协程切换到执行器线程继续执行
+     */
+    schedule_awaiter schedule() { return schedule_awaiter{*this}; }
+
+    /**
+     * @brief 获取挂起中的等待数
+     */
+    size_t pending() const { return _pending; }
+
+private:
+    /**
+     * @brief 一个文件描述符上的等待者
+     */
+    struct fd_state {
+        std::vector<readable_awaiter*> waiters;   // 挂起的等待者
+        bool armed = false;                       // 是否已在epoll中登记（单次触发）
+    };
+
+    static constexpr int sleep_fd = -2;           // sleep_for使用的占位描述符
+
+    bool add_waiter(readable_awaiter* waiter);
+    bool arm(int fd);
+    void remove_waiter(readable_awaiter* waiter);
+    void resume_fd(int fd);
+    void expire_timers();
+    void drain_posted();
+    int next_timeout_ms() const;
+
+    int _epoll_fd;                                // epoll
+    int _wake_fd;                                 // 跨线程唤醒的eventfd
+    bool _stop;                                   // 执行器线程内的退出标志
+    size_t _pending;                              // 挂起的等待数
+    std::unordered_map<int, fd_state> _fds;       // 各文件描述符的等待者
+    std::multimap<clock::time_point, readable_awaiter*> _timers; // 按到期时间排序的等待者
+    std::vector<readable_awaiter*> _ready;        // 本轮待恢复的等待者
+
+    std::mutex _post_mutex;                       // 保护_posted和_stop_requested
+    std::vector<std::coroutine_handle<>> _posted; // 其他线程提交的协程
+    std::vector<std::coroutine_handle<>> _running;// 本轮执行的已提交协程
+    bool _stop_requested;                         // stop()的请求
+};
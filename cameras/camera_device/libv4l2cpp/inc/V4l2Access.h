@@ -25,6 +25,17 @@ class V4l2Access
 		unsigned int getFormat()     { return m_device->getFormat();     }
 		unsigned int getWidth()      { return m_device->getWidth();      }
 		unsigned int getHeight()     { return m_device->getHeight();     }
+		int getFps()                 { return m_device->getFps();        }
+		const std::string& getBusInfo()             { return m_device->getBusInfo();       }
+		const V4l2StartupTiming& getStartupTiming() { return m_device->getStartupTiming(); }
+		int getLastError()           { return m_device->getLastError();  }
+		unsigned long getLastTriggerId() { return m_device->getLastTriggerId(); }
+		unsigned long getDriverDrops()   { return m_device->getDriverDrops();   }
+		bool isMultiPlanar()         { return m_device->isMultiPlanar(); }
+		unsigned int getNumPlanes()  { return m_device->getNumPlanes();  }
+		unsigned int getBytesPerLine(unsigned int plane = 0) { return m_device->getBytesPerLine(plane); }
+		unsigned int getPlaneSize(unsigned int plane)        { return m_device->getPlaneSize(plane);    }
+		unsigned int getPlaneOffset(unsigned int plane)      { return m_device->getPlaneOffset(plane);  }
 		
 		void queryFormat()  { m_device->queryFormat();          }
 		int setFormat(unsigned int format, unsigned int width, unsigned int height)  { 
@@ -37,6 +48,11 @@ class V4l2Access
 		int isReady()       { return m_device->isReady();       }
 		int start()         { return m_device->start();         }
 		int stop()          { return m_device->stop();          }
+		int pause()         { return m_device->pause();         }
+		int resume()        { return m_device->resume();        }
+		int isStreaming()   { return m_device->isStreaming();   }
+		bool setTriggerMode(V4l2TriggerMode mode, unsigned int controlId = 0) { return m_device->setTriggerMode(mode, controlId); }
+		bool trigger(unsigned long id) { return m_device->trigger(id); }
 
 	private:
 		V4l2Access(const V4l2Access&);
@@ -27,6 +27,7 @@ class V4l2Capture : public V4l2Access
 		virtual ~V4l2Capture();
 	
 		size_t read(char* buffer, size_t bufferSize);
+		size_t readBatch(char** buffers, size_t bufferSize, V4l2FrameInfo* frames, size_t maxFrames);
 		bool   isReadable(timeval* tv);	
 };
 
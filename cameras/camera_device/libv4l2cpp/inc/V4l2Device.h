@@ -14,9 +14,12 @@
 
 #include <string>
 #include <list>
+#include <chrono>
 #include <linux/videodev2.h>
 #include <fcntl.h>
 
+#include "V4l2Syscalls.h"
+
 #ifndef V4L2_PIX_FMT_VP8
 #define V4L2_PIX_FMT_VP8  v4l2_fourcc('V', 'P', '8', '0')
 #endif
@@ -33,16 +36,26 @@ enum V4l2IoType
 	IOTYPE_MMAP
 };
 
+// ---------------------------------
+// V4L2 capture trigger mode
+// ---------------------------------
+enum V4l2TriggerMode
+{
+	TRIGGER_NONE,		// free running, every buffer is queued again after DQBUF
+	TRIGGER_QBUF,		// emulated trigger: dequeued buffers are kept, trigger() queues one buffer
+	TRIGGER_CONTROL		// trigger-driven exposure: trigger() sets a button control, buffers are queued as usual
+};
+
 // ---------------------------------
 // V4L2 Device parameters
 // ---------------------------------
 struct V4L2DeviceParameters 
 {
 	V4L2DeviceParameters(const char* devname, const std::list<unsigned int> & formatList, unsigned int width, unsigned int height, int fps, V4l2IoType ioType = IOTYPE_MMAP, int openFlags = O_RDWR | O_NONBLOCK) : 
-		m_devName(devname), m_formatList(formatList), m_width(width), m_height(height), m_fps(fps), m_iotype(ioType), m_openFlags(openFlags) {}
+		m_devName(devname), m_formatList(formatList), m_width(width), m_height(height), m_fps(fps), m_iotype(ioType), m_openFlags(openFlags), m_bytesPerLineAlign(0), m_bufferCount(0), m_syscalls(NULL) {}
 
 	V4L2DeviceParameters(const char* devname, unsigned int format, unsigned int width, unsigned int height, int fps, V4l2IoType ioType = IOTYPE_MMAP, int openFlags = O_RDWR | O_NONBLOCK) : 
-		m_devName(devname), m_width(width), m_height(height), m_fps(fps), m_iotype(ioType), m_openFlags(openFlags) {
+		m_devName(devname), m_width(width), m_height(height), m_fps(fps), m_iotype(ioType), m_openFlags(openFlags), m_bytesPerLineAlign(0), m_bufferCount(0), m_syscalls(NULL) {
 			if (format) {
 				m_formatList.push_back(format);
 			}
@@ -56,6 +69,56 @@ struct V4L2DeviceParameters
 	V4l2IoType m_iotype;
 	int m_verbose;
 	int m_openFlags;
+	unsigned int m_bytesPerLineAlign;	// request bytesperline rounded up to this multiple when the driver allows it (0: driver default)
+	unsigned int m_bufferCount;			// mmap buffers requested from the driver, at most V4L2MMAP_NBBUFFER (0: V4L2MMAP_NBBUFFER)
+	V4l2Syscalls* m_syscalls;			// system calls used to drive the device, not owned (NULL: V4l2Syscalls::system())
+};
+
+// ---------------------------------
+// V4L2 Device startup timing (microseconds)
+// ---------------------------------
+struct V4l2StartupTiming
+{
+	V4l2StartupTiming() : m_open(0), m_querycap(0), m_format(0), m_param(0), m_reqbufs(0), m_mmap(0), m_qbuf(0), m_streamon(0), m_formatCacheHit(false) {}
+
+	long m_open;            // open
+	long m_querycap;        // VIDIOC_QUERYCAP
+	long m_format;          // VIDIOC_G_FMT/VIDIOC_S_FMT
+	long m_param;           // VIDIOC_S_PARM
+	long m_reqbufs;         // VIDIOC_REQBUFS
+	long m_mmap;            // VIDIOC_QUERYBUF + mmap
+	long m_qbuf;            // VIDIOC_QBUF
+	long m_streamon;        // VIDIOC_STREAMON
+	bool m_formatCacheHit;  // format applied from V4l2FormatCache
+
+	long total() const { return m_open + m_querycap + m_format + m_param + m_reqbufs + m_mmap + m_qbuf + m_streamon; }
+};
+
+// ---------------------------------
+// V4L2 plane format
+// ---------------------------------
+struct V4l2PlaneFormat
+{
+	V4l2PlaneFormat() : m_bytesPerLine(0), m_sizeImage(0) {}
+
+	unsigned int m_bytesPerLine;
+	unsigned int m_sizeImage;
+};
+
+// ---------------------------------
+// V4L2 frame metadata returned by batch reads
+// ---------------------------------
+struct V4l2FrameInfo
+{
+	V4l2FrameInfo() : m_slot(0), m_size(0), m_sequence(0), m_timestampUs(0), m_flags(0), m_triggerId(0), m_dropped(0) {}
+
+	unsigned int  m_slot;        // index of the destination buffer holding the frame
+	size_t        m_size;        // bytes copied into the destination buffer
+	unsigned int  m_sequence;    // v4l2_buffer.sequence
+	long long     m_timestampUs; // v4l2_buffer.timestamp in microseconds, driver clock (0: not set)
+	unsigned int  m_flags;       // v4l2_buffer.flags
+	unsigned long m_triggerId;   // trigger id, 0 when not triggered
+	unsigned int  m_dropped;     // frames the driver skipped just before this one (gap in sequence)
 };
 
 // ---------------------------------
@@ -73,14 +136,25 @@ class V4l2Device
 		int checkCapabilities(int fd, unsigned int mandatoryCapabilities);
 		int configureFormat(int fd);
 		int configureFormat(int fd, unsigned int format, unsigned int width, unsigned int height);
+		int configureCachedFormat(int fd, const std::string& request);
 		int configureParam(int fd, int fps);
 
+		void setFormatRequest(struct v4l2_format& fmt, unsigned int format, unsigned int width, unsigned int height);
+		void storeFormat(const struct v4l2_format& fmt);
+		void alignBytesPerLine(int fd, struct v4l2_format& fmt);
+		static unsigned int formatPixelFormat(const struct v4l2_format& fmt);
+		static unsigned int formatWidth(const struct v4l2_format& fmt);
+		static unsigned int formatHeight(const struct v4l2_format& fmt);
+
 		virtual bool   init(unsigned int mandatoryCapabilities);		
 		virtual size_t writeInternal(char*, size_t)        { return -1;    }
 		virtual bool   startPartialWrite()                 { return false; }
 		virtual size_t writePartialInternal(char*, size_t) { return -1;    }
+		virtual char*  reservePartialWrite(size_t)         { return NULL;  }
 		virtual bool   endPartialWrite()                   { return false; }
 		virtual size_t readInternal(char*, size_t)         { return -1;    }
+		virtual size_t readBatchInternal(char** buffers, size_t bufferSize, V4l2FrameInfo* frames, size_t maxFrames);
+		unsigned int   countSequenceGap(unsigned int sequence);
 	
 	public:
 		V4l2Device(const V4L2DeviceParameters&  params, v4l2_buf_type deviceType);		
@@ -89,26 +163,44 @@ class V4l2Device
 		virtual bool isReady() { return (m_fd != -1); }
 		virtual bool start()   { return true; }
 		virtual bool stop()    { return true; }
+		virtual bool pause()   { return true; }
+		virtual bool resume()  { return true; }
+		virtual bool isStreaming() { return (m_fd != -1); }
+		virtual bool setTriggerMode(V4l2TriggerMode, unsigned int = 0) { return false; }
+		virtual bool trigger(unsigned long)                            { return false; }
 	
 		unsigned int getBufferSize() { return m_bufferSize; }
 		unsigned int getFormat()     { return m_format;     }
 		unsigned int getWidth()      { return m_width;      }
 		unsigned int getHeight()     { return m_height;     }
+		int          getFps()        { return m_fps;        }
 		int          getFd()         { return m_fd;         }
+		const std::string&       getBusInfo()       { return m_busInfo;       }
+		const V4l2StartupTiming& getStartupTiming() { return m_startupTiming; }
+		int          getLastError()  { return m_lastError;  }
+		unsigned long getLastTriggerId() { return m_lastTriggerId; }
+		unsigned long getDriverDrops()   { return m_driverDrops;   }
+		bool         isMultiPlanar() { return V4L2_TYPE_IS_MULTIPLANAR(m_deviceType); }
+		unsigned int getNumPlanes()  { return m_numPlanes;  }
+		unsigned int getBytesPerLine(unsigned int plane = 0) { return (plane < m_numPlanes) ? m_planes[plane].m_bytesPerLine : 0; }
+		unsigned int getPlaneSize(unsigned int plane)        { return (plane < m_numPlanes) ? m_planes[plane].m_sizeImage : 0;    }
+		unsigned int getPlaneOffset(unsigned int plane);
 		void         queryFormat();
 			
-		int setFormat(unsigned int format, unsigned int width, unsigned int height) {
+		virtual int setFormat(unsigned int format, unsigned int width, unsigned int height) {
 			return this->configureFormat(m_fd, format, width, height);
 		}
-		int setFps(int fps) {
+		virtual int setFps(int fps) {
 			return this->configureParam(m_fd, fps);
 		}		
 
 		static std::string fourcc(unsigned int format);
 		static unsigned int fourcc(const char* format);
+		static long elapsedUs(const std::chrono::steady_clock::time_point& start);
 		
 	protected:
 		V4L2DeviceParameters m_params;
+		V4l2Syscalls* m_sys;
 		int m_fd;
 		v4l2_buf_type m_deviceType;	
 	
@@ -116,6 +208,19 @@ class V4l2Device
 		unsigned int m_format;
 		unsigned int m_width;
 		unsigned int m_height;	
+		unsigned int m_bytesPerLine;
+		unsigned int m_numPlanes;
+		V4l2PlaneFormat m_planes[VIDEO_MAX_PLANES];
+
+		std::string m_busInfo;
+		std::string m_formatCacheKey; // V4l2FormatCache key, empty when the driver reports no bus_info
+		V4l2StartupTiming m_startupTiming;
+		int m_fps;          // frame rate accepted by the driver, 0 when S_PARM was not applied
+		int m_lastError;    // errno of the last failed read/write, 0 on success
+		unsigned long m_lastTriggerId; // trigger id of the last frame read, 0 when not triggered
+		unsigned long m_driverDrops;   // frames skipped by the driver, counted from gaps in buf.sequence
+		unsigned int  m_lastSequence;  // sequence of the last frame read
+		bool          m_sequenceValid; // m_lastSequence is set, cleared when the stream restarts
 
 		struct v4l2_buffer m_partialWriteBuf;
 		bool m_partialWriteInProgress;
@@ -0,0 +1,125 @@
+/* ---------------------------------------------------------------------------
+** This software is in the public domain, furnished "as is", without technical
+** support, and with no warranty, express or implied, as to its usefulness for
+** any purpose.
+**
+** V4l2Emulator.h
+**
+** User-space emulation of V4L2 devices
+**
+** -------------------------------------------------------------------------*/
+
+
+#pragma once
+
+#include <string>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <linux/videodev2.h>
+
+#include "V4l2Syscalls.h"
+
+// ---------------------------------
+// 模拟设备配置
+// ---------------------------------
+struct V4l2EmulatedDeviceConfig
+{
+	V4l2EmulatedDeviceConfig() : m_type(V4L2_BUF_TYPE_VIDEO_CAPTURE), m_format(V4L2_PIX_FMT_YUYV), m_width(640), m_height(480), m_fps(30),
+		m_maxBuffers(32), m_phaseUs(0), m_clockOffsetUs(0), m_driftPpm(0), m_jitterUs(0), m_dropEvery(0), m_card("V4L2 emulated device") {}
+
+	v4l2_buf_type m_type;       // V4L2_BUF_TYPE_VIDEO_CAPTURE或V4L2_BUF_TYPE_VIDEO_OUTPUT
+	unsigned int  m_format;     // 默认像素格式（YUYV、UYVY、NV12、GREY、RGB24、BGR24）
+	unsigned int  m_width;      // 默认宽度
+	unsigned int  m_height;     // 默认高度
+	int           m_fps;        // 默认帧率
+	unsigned int  m_maxBuffers; // VIDIOC_REQBUFS的缓冲区数量上限
+	long          m_phaseUs;    // VIDIOC_STREAMON后第一帧的延迟
+	long          m_clockOffsetUs; // 加到缓冲区时间戳上的偏移
+	double        m_driftPpm;   // 设备时钟的频率误差，正值表示比标称快
+	long          m_jitterUs;   // 每帧附加的随机延迟（0..m_jitterUs）
+	unsigned int  m_dropEvery;  // 每N帧跳过一帧，模拟驱动丢帧（0表示不丢）
+	std::string   m_card;       // VIDIOC_QUERYCAP返回的设备名
+};
+
+// ---------------------------------
+// 模拟设备计数
+// ---------------------------------
+struct V4l2EmulatedDeviceStats
+{
+	V4l2EmulatedDeviceStats() : m_produced(0), m_overruns(0), m_skipped(0), m_dequeued(0), m_consumed(0), m_ioctls(0) {}
+
+	unsigned long m_produced;   // 写入已入队缓冲区的采集帧数
+	unsigned long m_overruns;   // 没有入队缓冲区而丢失的采集帧数
+	unsigned long m_skipped;    // 按m_dropEvery跳过的采集帧数
+	unsigned long m_dequeued;   // VIDIOC_DQBUF返回的缓冲区数
+	unsigned long m_consumed;   // 通过VIDIOC_QBUF或write收到的输出帧数
+	unsigned long m_ioctls;     // ioctl调用次数
+};
+
+/**
+ * @brief V4L2设备的用户态模拟
+ *
+ * 作为V4l2Syscalls注入V4l2Device（V4L2DeviceParameters::m_syscalls），对注册过的设备路径
+ * 模拟QUERYCAP、ENUM_FMT、G/S/TRY_FMT、G/S_PARM、REQBUFS、QUERYBUF、mmap、QBUF/DQBUF、
+ * STREAMON/STREAMOFF和read/write，其余路径和文件描述符直接转给系统调用。
+ *
+ * 每个打开的模拟设备对应一个eventfd（信号量模式），有可出队的缓冲区时可读，
+ * 因此select/poll/epoll和真实设备一样工作；未开始流的采集设备始终可读，以便select后的
+ * read启动流。所有采集设备共用一个时钟线程，每个设备按自己的帧率、初始相位、时钟漂移
+ * 和抖动独立出帧；没有入队缓冲区时该帧丢失但序列号照常递增。输出设备在入队时立即消费缓冲区。
+ *
+ * 缓冲区放在memfd中，mmap映射的是真实的共享内存，munmap直接使用系统调用。
+ * 只模拟单平面格式。线程安全，对象需比使用它的设备存活更久
+ */
+class V4l2Emulator : public V4l2Syscalls
+{
+	public:
+		V4l2Emulator();
+		virtual ~V4l2Emulator();
+
+		/**
+		 * @brief 注册模拟设备
+		 *
+		 * @param path 设备路径，不需要在文件系统中存在
+		 * @param config 设备配置
+		 * @return true 注册成功
+		 * @return false 路径已注册
+		 */
+		bool addDevice(const std::string& path, const V4l2EmulatedDeviceConfig& config = V4l2EmulatedDeviceConfig());
+
+		/**
+		 * @brief 注销模拟设备，设备仍被打开时失败
+		 */
+		bool removeDevice(const std::string& path);
+
+		/**
+		 * @brief 获取模拟设备的计数
+		 */
+		V4l2EmulatedDeviceStats getStats(const std::string& path);
+
+		virtual int     open(const char* path, int flags, mode_t mode = 0);
+		virtual int     close(int fd);
+		virtual int     ioctl(int fd, unsigned long request, void* arg);
+		virtual void*   mmap(void* addr, size_t length, int prot, int flags, int fd, off_t offset);
+		virtual ssize_t read(int fd, void* buf, size_t count);
+		virtual ssize_t write(int fd, const void* buf, size_t count);
+		virtual bool    isCharDevice(const char* path);
+
+	private:
+		struct Device;
+
+		std::shared_ptr<Device> findByFd(int fd);
+		void clockLoop();
+		void wake();
+
+		std::mutex m_mutex;                                     // 保护设备表和m_stop
+		std::condition_variable m_cv;                           // 唤醒时钟线程
+		std::map<std::string, std::shared_ptr<Device> > m_devices; // 按路径登记的设备
+		std::map<int, std::shared_ptr<Device> > m_openFiles;   // 按eventfd索引的已打开设备
+		bool m_stop;
+		unsigned long m_generation;                             // 递增以唤醒时钟线程
+		std::thread m_clock;                                    // 产生采集帧
+};
@@ -0,0 +1,118 @@
+/* ---------------------------------------------------------------------------
+** This software is in the public domain, furnished "as is", without technical
+** support, and with no warranty, express or implied, as to its usefulness for
+** any purpose.
+**
+** V4l2FormatCache.h
+**
+** Cache of negotiated V4L2 formats keyed by device identity
+**
+** -------------------------------------------------------------------------*/
+
+
+#pragma once
+
+#include <string>
+#include <list>
+#include <map>
+#include <mutex>
+
+// ---------------------------------
+// 已协商的格式
+// ---------------------------------
+struct V4l2CachedFormat
+{
+	V4l2CachedFormat() : m_format(0), m_width(0), m_height(0), m_bufferSize(0), m_bytesPerLine(0) {}
+
+	unsigned int m_format;
+	unsigned int m_width;
+	unsigned int m_height;
+	unsigned int m_bufferSize;
+	unsigned int m_bytesPerLine;
+};
+
+/**
+ * @brief 已协商格式缓存
+ *
+ * 以设备标识为键保存上一次协商成功的格式。同一物理设备在重启后
+ * 即使设备节点编号改变，也可以直接设置缓存的格式，跳过逐个格式探测的过程。
+ * 同一bus_info下可能有多个节点（如UVC的采集节点和元数据节点、单平面和多平面节点），
+ * 标识由describeDevice生成，包含bus_info、驱动名、设备名、缓冲区类型和节点能力
+ */
+class V4l2FormatCache
+{
+	public:
+		/**
+		 * @brief 获取进程内共享的缓存实例
+		 */
+		static V4l2FormatCache& instance();
+
+		/**
+		 * @brief 查找缓存的格式
+		 *
+		 * @param device 设备标识，由describeDevice生成
+		 * @param request 请求参数（格式列表和分辨率）的描述
+		 * @param format 输出缓存的格式
+		 * @return true 命中缓存
+		 * @return false 未命中或请求参数已改变
+		 */
+		bool lookup(const std::string& device, const std::string& request, V4l2CachedFormat& format);
+
+		/**
+		 * @brief 保存协商成功的格式
+		 */
+		void store(const std::string& device, const std::string& request, const V4l2CachedFormat& format);
+
+		/**
+		 * @brief 删除设备的缓存项
+		 */
+		void invalidate(const std::string& device);
+
+		/**
+		 * @brief 清空缓存
+		 */
+		void clear();
+
+		/**
+		 * @brief 从文件加载缓存，用于进程重启后复用
+		 *
+		 * @param path 缓存文件路径
+		 * @return true 加载成功
+		 */
+		bool load(const std::string& path);
+
+		/**
+		 * @brief 将缓存保存到文件
+		 *
+		 * @param path 缓存文件路径
+		 * @return true 保存成功
+		 */
+		bool save(const std::string& path);
+
+		/**
+		 * @brief 生成设备标识，作为缓存项的键
+		 *
+		 * @param busInfo 设备的bus_info
+		 * @param driver 驱动名
+		 * @param card 设备名
+		 * @param bufferType 缓冲区类型
+		 * @param deviceCaps 节点的能力（device_caps）
+		 * @return 设备标识，bus_info为空时为空，空白字符替换为下划线以便保存到文件
+		 */
+		static std::string describeDevice(const std::string& busInfo, const std::string& driver, const std::string& card, unsigned int bufferType, unsigned int deviceCaps);
+
+		/**
+		 * @brief 生成请求参数的描述，作为缓存项的校验
+		 */
+		static std::string describeRequest(const std::list<unsigned int>& formatList, unsigned int width, unsigned int height);
+
+	private:
+		struct Entry
+		{
+			std::string      m_request;
+			V4l2CachedFormat m_format;
+		};
+
+		std::mutex m_mutex;
+		std::map<std::string, Entry> m_entries;
+};
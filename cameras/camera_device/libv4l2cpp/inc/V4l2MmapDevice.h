@@ -12,6 +12,9 @@
 
 #pragma once
  
+#include <deque>
+#include <mutex>
+
 #include "V4l2Device.h"
 
 // 内存映射缓冲区数量，影响视频流的平滑度和延迟
@@ -56,6 +59,17 @@ class V4l2MmapDevice : public V4l2Device
 		 */
 		size_t writePartialInternal(char*, size_t);
 		
+		/**
+		 * @brief 在已锁定的缓冲区末尾预留一段空间
+		 * 
+		 * 在startPartialWrite后调用，调用者在endPartialWrite之前直接填充返回的内存，
+		 * 例如把像素转换的结果直接写入设备缓冲区
+		 * 
+		 * @param size 预留的字节数，计入已写入的数据
+		 * @return char* 预留空间的起始地址，剩余空间不足时返回NULL
+		 */
+		char*  reservePartialWrite(size_t size);
+		
 		/**
 		 * @brief 结束部分写入操作
 		 * 
@@ -76,6 +90,20 @@ class V4l2MmapDevice : public V4l2Device
 		 * @return size_t 实际读取的字节数，失败返回-1
 		 */
 		size_t readInternal(char* buffer, size_t bufferSize);
+
+		/**
+		 * @brief 一次读取全部已就绪的帧的内部实现
+		 * 
+		 * 连续出队直到没有已填充的缓冲区，帧按序列号排序并带有元数据，
+		 * 序列号的间隔计为驱动丢弃的帧
+		 * 
+		 * @param buffers 目标缓冲区指针数组
+		 * @param bufferSize 每个目标缓冲区的大小
+		 * @param frames 输出各帧的元数据
+		 * @param maxFrames 最多读取的帧数
+		 * @return size_t 读取的帧数，0表示无数据，-1表示出错
+		 */
+		size_t readBatchInternal(char** buffers, size_t bufferSize, V4l2FrameInfo* frames, size_t maxFrames);
 			
 	public:
 		/**
@@ -133,19 +161,172 @@ class V4l2MmapDevice : public V4l2Device
 		 * @return false 停止失败
 		 */
 		virtual bool stop();
+
+		/**
+		 * @brief 暂停视频流
+		 * 
+		 * 只执行STREAMOFF，保留已分配和映射的缓冲区，之后可以用resume快速恢复
+		 * 
+		 * @return true 暂停成功或已暂停
+		 * @return false 暂停失败
+		 */
+		virtual bool pause();
+
+		/**
+		 * @brief 恢复视频流
+		 * 
+		 * 将全部已映射的缓冲区重新入队并执行STREAMON，不重新申请和映射缓冲区
+		 * 
+		 * @return true 恢复成功或已在采集
+		 * @return false 恢复失败
+		 */
+		virtual bool resume();
+
+		/**
+		 * @brief 视频流是否已启动
+		 */
+		virtual bool isStreaming() { return m_streaming; }
+
+		/**
+		 * @brief 运行时修改格式
+		 * 
+		 * 新格式的图像大小不超过已映射的缓冲区时直接复用缓冲区；
+		 * 缓冲区不够大或驱动拒绝（EBUSY）时才释放并重新分配缓冲区。
+		 * 调用前正在采集的设备在修改后自动恢复采集；修改失败时恢复原格式，
+		 * 原格式也无法恢复时设备不再有缓冲区（isReady()为false）
+		 * 
+		 * @return int 0表示成功，-1表示失败
+		 */
+		virtual int setFormat(unsigned int format, unsigned int width, unsigned int height);
+
+		/**
+		 * @brief 运行时修改帧率
+		 * 
+		 * 正在采集时先暂停视频流，修改后恢复，缓冲区保持不变；
+		 * 新帧率下无法恢复视频流时回到原帧率，仍失败时视频流保持停止
+		 * 
+		 * @return int 0表示成功，-1表示失败
+		 */
+		virtual int setFps(int fps);
+
+		/**
+		 * @brief 设置采集的触发方式
+		 * 
+		 * TRIGGER_QBUF模拟触发：取出的缓冲区不再立即入队，每次trigger只入队一个缓冲区，
+		 * 驱动在其后的第一帧填充它；TRIGGER_CONTROL用于支持触发曝光的摄像头，trigger
+		 * 把按钮类型的控制项置1，缓冲区照常循环入队。正在采集时先暂停视频流，修改后恢复
+		 * 
+		 * @param mode 触发方式
+		 * @param controlId TRIGGER_CONTROL使用的控制项ID
+		 * @return true 设置成功
+		 */
+		virtual bool setTriggerMode(V4l2TriggerMode mode, unsigned int controlId = 0);
+
+		/**
+		 * @brief 发出一次触发，可在其他线程调用
+		 * 
+		 * 之后读出的对应帧的getLastTriggerId()返回id
+		 * 
+		 * @param id 触发编号，非0
+		 * @return true 已触发
+		 * @return false 自由运行模式、没有空闲缓冲区（TRIGGER_QBUF）或驱动拒绝
+		 */
+		virtual bool trigger(unsigned long id);
 	
+	protected:
+		/**
+		 * @brief 申请并映射缓冲区（VIDIOC_REQBUFS + VIDIOC_QUERYBUF + mmap）
+		 */
+		bool allocateBuffers();
+
+		/**
+		 * @brief 解除映射并释放缓冲区（munmap + VIDIOC_REQBUFS(0)）
+		 */
+		bool releaseBuffers();
+
+		/**
+		 * @brief 将全部缓冲区入队并启动视频流（VIDIOC_QBUF + VIDIOC_STREAMON）
+		 */
+		bool streamOn();
+
+		/**
+		 * @brief 停止视频流（VIDIOC_STREAMOFF），驱动会归还全部缓冲区
+		 */
+		bool streamOff();
+
+		/**
+		 * @brief 新格式的图像大小是否能放入已映射的缓冲区
+		 */
+		bool fitsBuffers(unsigned int format, unsigned int width, unsigned int height);
+
+		/**
+		 * @brief 修改格式失败后恢复原格式并重新分配缓冲区
+		 * 
+		 * @param resume 恢复后是否重新启动视频流
+		 * @return true 已恢复
+		 * @return false 仍然失败，设备没有缓冲区，isReady()返回false
+		 */
+		bool restoreFormat(unsigned int format, unsigned int width, unsigned int height, bool resume);
+
+		/**
+		 * @brief 初始化v4l2_buffer，多平面设备同时设置平面数组
+		 * 
+		 * @param buf 待初始化的缓冲区描述
+		 * @param planes 平面数组，至少VIDEO_MAX_PLANES个元素
+		 */
+		void prepareBuffer(struct v4l2_buffer& buf, struct v4l2_plane* planes);
+
+		/**
+		 * @brief 归还读完的采集缓冲区并记录其触发编号
+		 * 
+		 * TRIGGER_QBUF模式下缓冲区留待下一次触发，否则重新入队
+		 * 
+		 * @return true 成功
+		 * @return false 重新入队失败，m_lastError为errno
+		 */
+		bool releaseBuffer(struct v4l2_buffer& buf);
+
+		/**
+		 * @brief 把出队的缓冲区内容复制到目标缓冲区
+		 * 
+		 * @return size_t 复制的字节数，超出bufferSize的部分被截断
+		 */
+		size_t copyBuffer(const struct v4l2_buffer& buf, const struct v4l2_plane* planes, char* buffer, size_t bufferSize);
+
+		/**
+		 * @brief 序列号的间隔是否计为驱动丢帧，TRIGGER_QBUF模式下不计
+		 */
+		bool tracksSequence();
+
 	protected:
 		unsigned int  n_buffers;  // 已分配的缓冲区数量
+		bool          m_streaming; // 视频流是否已启动
 	
 		/**
-		 * @brief 缓冲区结构，保存映射内存的信息
+		 * @brief 平面结构，保存一个平面映射内存的信息
 		 */
-		struct buffer 
+		struct plane
 		{
 			void *                  start;  // 映射内存的起始地址
 			size_t                  length; // 映射内存的长度
 		};
+
+		/**
+		 * @brief 缓冲区结构，单平面设备只使用planes[0]
+		 */
+		struct buffer 
+		{
+			plane                   planes[VIDEO_MAX_PLANES]; // 各平面的映射
+			unsigned int            nplanes;                  // 平面数量
+		};
 		buffer m_buffer[V4L2MMAP_NBBUFFER]; // 缓冲区数组
+
+		std::mutex                m_triggerMutex;    // 保护触发状态，trigger()在其他线程调用
+		V4l2TriggerMode           m_triggerMode;     // 触发方式
+		unsigned int              m_triggerControl;  // TRIGGER_CONTROL方式下trigger()设置的控制项
+		std::deque<unsigned int>  m_freeBuffers;     // TRIGGER_QBUF：已取出、等待触发的缓冲区
+		unsigned long             m_bufferTrigger[V4L2MMAP_NBBUFFER]; // TRIGGER_QBUF：各排队缓冲区对应的触发ID
+		std::deque<unsigned long> m_pendingTriggers; // TRIGGER_CONTROL：尚未匹配到帧的触发
 };
 
 
@@ -30,6 +30,7 @@ class V4l2Output : public V4l2Access
 		bool   isWritable(timeval* tv);
 		bool   startPartialWrite();
 		size_t writePartial(char* buffer, size_t bufferSize);
+		char*  reservePartialWrite(size_t size);
 		bool   endPartialWrite();
 };
 
@@ -0,0 +1,46 @@
+/* ---------------------------------------------------------------------------
+** This software is in the public domain, furnished "as is", without technical
+** support, and with no warranty, express or implied, as to its usefulness for
+** any purpose.
+**
+** V4l2Syscalls.h
+**
+** System calls used to drive a V4L2 device
+**
+** -------------------------------------------------------------------------*/
+
+
+#pragma once
+
+#include <sys/types.h>
+
+/**
+ * @brief V4L2设备使用的系统调用
+ *
+ * V4l2Device及其子类通过该接口访问设备，默认实现直接调用系统函数。
+ * 替换为其他实现（例如V4l2Emulator）即可在没有内核驱动的情况下运行完整的采集路径。
+ * 就绪通知仍通过真实的文件描述符完成，select/poll/epoll无需经过该接口
+ */
+class V4l2Syscalls
+{
+	public:
+		virtual ~V4l2Syscalls() {}
+
+		virtual int     open(const char* path, int flags, mode_t mode = 0);
+		virtual int     close(int fd);
+		virtual int     ioctl(int fd, unsigned long request, void* arg);
+		virtual void*   mmap(void* addr, size_t length, int prot, int flags, int fd, off_t offset);
+		virtual int     munmap(void* addr, size_t length);
+		virtual ssize_t read(int fd, void* buf, size_t count);
+		virtual ssize_t write(int fd, const void* buf, size_t count);
+
+		/**
+		 * @brief 路径是否为字符设备，不是时V4l2Device把它当作普通文件打开
+		 */
+		virtual bool    isCharDevice(const char* path);
+
+		/**
+		 * @brief 获取直接调用系统函数的进程内共享实例
+		 */
+		static V4l2Syscalls* system();
+};
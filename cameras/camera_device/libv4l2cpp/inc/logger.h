@@ -4,23 +4,102 @@
 ** any purpose.
 **
 ** logger.h
-** 
+**
 ** -------------------------------------------------------------------------*/
 
 #pragma once
 
 #include <unistd.h>
+#include <errno.h>
 #include <cstring>
+#include <string>
+#include <atomic>
+#include <ostream>
 
 #define __FILENAME__ (strrchr(__FILE__, '/') ? strrchr(__FILE__, '/') + 1 : __FILE__)
 
+// ---------------------------------
+// rate limiting of repeated messages
+// ---------------------------------
+#ifndef LOG_RATELIMIT_INTERVAL_MS
+#define LOG_RATELIMIT_INTERVAL_MS 1000
+#endif
+#ifndef LOG_RATELIMIT_BURST
+#define LOG_RATELIMIT_BURST 5
+#endif
+
+// limiter of one call site: lets LOG_RATELIMIT_BURST messages through every LOG_RATELIMIT_INTERVAL_MS,
+// counts the others and reports the count with the next message let through. Lock-free, shared by threads
+class LogRateLimiter
+{
+	public:
+		constexpr LogRateLimiter() : m_windowStart(0), m_count(0), m_suppressed(0) {}
+
+		// returns -1 when the message is suppressed, else the number of messages suppressed before it
+		long acquire();
+
+	private:
+		std::atomic<long long> m_windowStart;   // start of the current window (ms, monotonic)
+		std::atomic<unsigned int> m_count;      // messages in the current window
+		std::atomic<long> m_suppressed;         // messages suppressed since the last one let through
+};
+
+// one limiter per call site: every lambda expression has its own type and so its own static
+#define LOG_RATELIMITER() ([]() -> LogRateLimiter& { static LogRateLimiter limiter; return limiter; }())
+
+// ---------------------------------
+// structured fields
+// ---------------------------------
+
+// per-thread context: tags every message of the thread with a device and camera id while in scope,
+// the previous context is restored on exit. device must stay valid for the whole scope
+class LogContext
+{
+	public:
+		LogContext(const char* device, int cameraId = -1);
+		~LogContext();
+
+		static const char* device();
+		static int cameraId();
+
+	private:
+		LogContext(const LogContext&);
+		LogContext& operator=(const LogContext&);
+
+		const char* m_previousDevice;
+		int m_previousCameraId;
+};
+
+// field of a single message, streamed in: LOG(ERROR) << logDevice(m_params.m_devName) << "VIDIOC_DQBUF";
+// the asynchronous backend stores it (overriding the thread context), other backends print "dev=... "
+struct LogField
+{
+	enum Kind { DEVICE, CAMERA };
+
+	Kind m_kind;
+	const char* m_text;
+	int m_value;
+};
+
+inline LogField logDevice(const char* device)        { LogField field = { LogField::DEVICE, device, 0 }; return field; }
+inline LogField logDevice(const std::string& device) { return logDevice(device.c_str()); }
+inline LogField logCamera(int cameraId)              { LogField field = { LogField::CAMERA, NULL, cameraId }; return field; }
+
+std::ostream& operator<<(std::ostream& os, const LogField& field);
+
 #ifdef HAVE_LOG4CPP
 #include "log4cpp/Category.hh"
 #include "log4cpp/FileAppender.hh"
 #include "log4cpp/PatternLayout.hh"
 
-#define LOG(__level)  log4cpp::Category::getRoot() << log4cpp::Priority::__level << __FILENAME__ << ":" << __LINE__ << "\n\t" 
+#define LOG(__level)  log4cpp::Category::getRoot() << log4cpp::Priority::__level << __FILENAME__ << ":" << __LINE__ << "\n\t"
+#define LOG_ERRNO(__level)  LOG(__level) << "errno=" << errno << "(" << strerror(errno) << ") "
+#define LOG_RATELIMIT(__level) \
+	for (long __suppressed = LOG_RATELIMITER().acquire(); __suppressed >= 0; __suppressed = -1) LOG(__level) << "suppressed=" << __suppressed << " "
+#define LOG_ERRNO_RATELIMIT(__level) \
+	for (long __suppressed = LOG_RATELIMITER().acquire(); __suppressed >= 0; __suppressed = -1) LOG_ERRNO(__level) << "suppressed=" << __suppressed << " "
 
+inline void flushLogger() {}
 
 inline int getLogLevel() {
 	log4cpp::Category &log = log4cpp::Category::getRoot();
@@ -55,7 +134,7 @@ inline void initLogger(int verbose)
 
 	setLogLevel(verbose);
 
-	LOG(INFO) << "level:" << log4cpp::Priority::getPriorityName(log.getPriority()); 
+	LOG(INFO) << "level:" << log4cpp::Priority::getPriorityName(log.getPriority());
 }
 #else
 
@@ -71,6 +150,11 @@ typedef enum {EMERG  = 0,
                       NOTSET = 800
 } PriorityLevel;
 
+// messages above this level are removed at compile time (e.g. -DLOG_MIN_LEVEL=NOTICE)
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL DEBUG
+#endif
+
 #include <iostream>
 #include <iomanip>
 #include <sstream>
@@ -85,8 +169,58 @@ inline std::string getFilename(const char* filename, int line) {
 	ss << "(" << filename << ":" << line << ")";
 	return ss.str();
 }
-#define LOG(__level) if (__level<=LogLevel) std::cout << "\n" <<  std::setw(8) << std::left << getLevel(#__level) << " " << std::setw(30) << std::left << getFilename(__FILENAME__, __LINE__) << "\t" 
 
+struct LogRecord;
+
+// ---------------------------------
+// stream writing in place into a log record
+// ---------------------------------
+class LogStreamBuf : public std::streambuf
+{
+	public:
+		LogStreamBuf() : m_record(NULL) {}
+
+		void setBuffer(char* begin, size_t size) { this->setp(begin, begin + size); }
+		size_t length() const                    { return this->pptr() - this->pbase(); }
+
+		LogRecord* m_record;    // record being written, NULL when the message is dropped
+};
+
+// one asynchronous message: reserves a record in the ring of the calling thread, is formatted in place
+// and committed on destruction, a background thread writes it out. A full ring drops and counts the
+// message rather than blocking the caller
+class LogMessage
+{
+	public:
+		LogMessage(int level, const char* file, int line, int error = -1, long suppressed = 0);
+		~LogMessage();
+
+		std::ostream& stream() { return m_stream; }
+
+	private:
+		LogMessage(const LogMessage&);
+		LogMessage& operator=(const LogMessage&);
+
+		LogStreamBuf m_buf;
+		std::ostream m_stream;
+};
+
+inline bool logEnabled(int level) {
+	return (level <= LOG_MIN_LEVEL) && (level <= LogLevel);
+}
+
+// each macro is a single for statement, so an unbraced if/else around it binds as written
+#define LOG(__level) \
+	for (bool __once = logEnabled(__level); __once; __once = false) LogMessage(__level, __FILENAME__, __LINE__).stream()
+#define LOG_ERRNO(__level) \
+	for (bool __once = logEnabled(__level); __once; __once = false) LogMessage(__level, __FILENAME__, __LINE__, errno).stream()
+#define LOG_RATELIMIT(__level) \
+	for (long __suppressed = logEnabled(__level) ? LOG_RATELIMITER().acquire() : -1; __suppressed >= 0; __suppressed = -1) LogMessage(__level, __FILENAME__, __LINE__, -1, __suppressed).stream()
+#define LOG_ERRNO_RATELIMIT(__level) \
+	for (long __suppressed = logEnabled(__level) ? LOG_RATELIMITER().acquire() : -1; __suppressed >= 0; __suppressed = -1) LogMessage(__level, __FILENAME__, __LINE__, errno, __suppressed).stream()
+
+// wait until every committed message has been written out
+void flushLogger();
 
 inline int getLogLevel() {
 	return LogLevel;
@@ -108,5 +242,4 @@ inline void initLogger(int verbose)
 }
 
 #endif
-	
 
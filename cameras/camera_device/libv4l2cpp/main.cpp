@@ -13,9 +13,14 @@
 #include <string.h>
 #include <errno.h>
 #include <signal.h>
+#include <time.h>
+#include <sys/select.h>
+
+#include <vector>
 
 #include "logger.h"
 #include "V4l2Capture.h"
+#include "V4l2Emulator.h"
 
 int stop=0;
 
@@ -28,6 +33,94 @@ void sighandler(int)
        stop =1;
 }
 
+/* ---------------------------------------------------------------------------
+**  capture from <count> emulated devices and report frame rate and CPU usage
+** -------------------------------------------------------------------------*/
+int runEmulated(int count, V4l2IoType ioType, int format, int width, int height, int fps)
+{
+	V4l2Emulator emulator;
+	std::vector<V4l2Capture*> captures;
+	for (int i = 0; i < count; ++i)
+	{
+		std::string path = "/dev/v4l2emu" + std::to_string(i);
+		V4l2EmulatedDeviceConfig config;
+		config.m_phaseUs  = (i * 1000) % 33000;
+		config.m_driftPpm = (i % 5) * 20.0 - 40.0;
+		emulator.addDevice(path, config);
+
+		V4L2DeviceParameters param(path.c_str(), format, width, height, fps, ioType);
+		param.m_syscalls = &emulator;
+		V4l2Capture* capture = V4l2Capture::create(param);
+		if (capture == NULL)
+		{
+			LOG(WARN) << "Cannot create emulated capture " << path;
+			continue;
+		}
+		captures.push_back(capture);
+	}
+
+	LOG(NOTICE) << "Start reading from " << captures.size() << " emulated devices";
+	signal(SIGINT,sighandler);
+	std::vector<unsigned long> frames(captures.size(), 0);
+	std::vector<char> buffer(captures.empty() ? 0 : captures[0]->getBufferSize());
+	unsigned long total = 0;
+	struct timespec wall, cpu;
+	clock_gettime(CLOCK_MONOTONIC, &wall);
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu);
+	while (!stop && !captures.empty())
+	{
+		fd_set fdset;
+		FD_ZERO(&fdset);
+		int maxfd = -1;
+		for (size_t i = 0; i < captures.size(); ++i)
+		{
+			FD_SET(captures[i]->getFd(), &fdset);
+			maxfd = std::max(maxfd, captures[i]->getFd());
+		}
+		timeval tv = {1, 0};
+		if (select(maxfd + 1, &fdset, NULL, NULL, &tv) < 0)
+		{
+			break;
+		}
+		for (size_t i = 0; i < captures.size(); ++i)
+		{
+			if (FD_ISSET(captures[i]->getFd(), &fdset))
+			{
+				buffer.resize(std::max<size_t>(buffer.size(), captures[i]->getBufferSize()));
+				if (captures[i]->read(buffer.data(), buffer.size()) > 0)
+				{
+					frames[i]++;
+					total++;
+				}
+			}
+		}
+
+		struct timespec now, used;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		double elapsed = (now.tv_sec - wall.tv_sec) + (now.tv_nsec - wall.tv_nsec) * 1e-9;
+		if (elapsed >= 1.0)
+		{
+			clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &used);
+			double busy = (used.tv_sec - cpu.tv_sec) + (used.tv_nsec - cpu.tv_nsec) * 1e-9;
+			LOG(NOTICE) << "devices:" << captures.size() << " fps:" << total / elapsed << " per device:" << total / elapsed / captures.size() << " cpu:" << 100.0 * busy / elapsed << "%";
+			for (size_t i = 0; i < captures.size(); ++i)
+			{
+				V4l2EmulatedDeviceStats stats = emulator.getStats("/dev/v4l2emu" + std::to_string(i));
+				LOG(INFO) << "/dev/v4l2emu" << i << " frames:" << frames[i] << " overruns:" << stats.m_overruns;
+			}
+			total = 0;
+			wall = now;
+			cpu = used;
+		}
+	}
+
+	for (size_t i = 0; i < captures.size(); ++i)
+	{
+		delete captures[i];
+	}
+	return 0;
+}
+
 /* ---------------------------------------------------------------------------
 **  main
 ** -------------------------------------------------------------------------*/
@@ -41,8 +134,9 @@ int main(int argc, char* argv[])
 	int height = 0;
 	int fps = 0;
 	int framecount = 0;
+	int emulated = 0;
 	int c = 0;
-	while ((c = getopt (argc, argv, "x:hv:" "G:f:r")) != -1)
+	while ((c = getopt (argc, argv, "x:hv:" "G:f:re:")) != -1)
 	{
 		switch (c)
 		{
@@ -51,6 +145,7 @@ int main(int argc, char* argv[])
             case 'G':   sscanf(optarg,"%dx%dx%d", &width, &height, &fps)    ; break;
 			case 'f':	format    = V4l2Device::fourcc(optarg)              ; break;
 			case 'x':   sscanf(optarg,"%d", &framecount) 					; break;
+			case 'e':   sscanf(optarg,"%d", &emulated)  					; break;
 			case 'h':
 			{
 				std::cout << argv[0] << " [-v[v]] [-G <width>x<height>x<fps>] [-f format] [device] [-r]" << std::endl;
@@ -59,6 +154,7 @@ int main(int argc, char* argv[])
 				std::cout << "\t -vv           : very verbose " << std::endl;
 				std::cout << "\t -r            : V4L2 capture using read interface (default use memory mapped buffers)" << std::endl;
 				std::cout << "\t -x <count>    : read <count> frames and save them in current dir." << std::endl;
+				std::cout << "\t -e <count>    : capture from <count> user-space emulated devices instead of [device]" << std::endl;
 				std::cout << "\t device        : V4L2 capture device (default "<< in_devname << ")" << std::endl;
 				exit(0);
 			}
@@ -73,6 +169,11 @@ int main(int argc, char* argv[])
 	// initialize log4cpp
 	initLogger(verbose);
 
+	if (emulated > 0)
+	{
+		return runEmulated(emulated, ioTypeIn, format, width, height, fps);
+	}
+
 	// init V4L2 capture interface
 	V4L2DeviceParameters param(in_devname, format, width, height, fps, ioTypeIn);
 	V4l2Capture* videoCapture = V4l2Capture::create(param);
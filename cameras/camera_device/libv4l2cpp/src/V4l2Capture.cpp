@@ -116,4 +116,20 @@ size_t V4l2Capture::read(char* buffer, size_t bufferSize)
 	return m_device->readInternal(buffer, bufferSize);
 }
 
-
+/**
+ * @brief 一次取出设备中全部已就绪的帧
+ * 
+ * 非阻塞地连续出队直到没有已填充的缓冲区或取满maxFrames帧，
+ * 帧按驱动序列号排序，frames[i].m_slot指出第i帧所在的目标缓冲区。
+ * 读写方式的设备每次只读一帧
+ * 
+ * @param buffers 目标缓冲区指针数组，至少maxFrames个
+ * @param bufferSize 每个目标缓冲区的大小
+ * @param frames 输出各帧的元数据，至少maxFrames个
+ * @param maxFrames 最多读取的帧数
+ * @return size_t 读取的帧数，没有就绪的帧时返回0，出错且未读到帧时返回-1
+ */
+size_t V4l2Capture::readBatch(char** buffers, size_t bufferSize, V4l2FrameInfo* frames, size_t maxFrames)
+{
+	return m_device->readBatchInternal(buffers, bufferSize, frames, maxFrames);
+}
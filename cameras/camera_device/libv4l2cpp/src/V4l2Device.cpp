@@ -19,12 +19,17 @@
 #include "logger.h"
 
 #include "V4l2Device.h"
+#include "V4l2FormatCache.h"
 
 std::string V4l2Device::fourcc(unsigned int format) {
 	char formatArray[] = { (char)(format&0xff), (char)((format>>8)&0xff), (char)((format>>16)&0xff), (char)((format>>24)&0xff), 0 };
 	return std::string(formatArray, strlen(formatArray));
 }
 
+long V4l2Device::elapsedUs(const std::chrono::steady_clock::time_point& start) {
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
 unsigned int V4l2Device::fourcc(const char* format) {
 	char fourcc[4];
 	memset(&fourcc, 0, sizeof(fourcc));
@@ -38,7 +43,7 @@ unsigned int V4l2Device::fourcc(const char* format) {
 // -----------------------------------------
 //    V4L2Device
 // -----------------------------------------
-V4l2Device::V4l2Device(const V4L2DeviceParameters&  params, v4l2_buf_type deviceType) : m_params(params), m_fd(-1), m_deviceType(deviceType), m_bufferSize(0), m_format(0)
+V4l2Device::V4l2Device(const V4L2DeviceParameters&  params, v4l2_buf_type deviceType) : m_params(params), m_sys(params.m_syscalls ? params.m_syscalls : V4l2Syscalls::system()), m_fd(-1), m_deviceType(deviceType), m_bufferSize(0), m_format(0), m_width(0), m_height(0), m_bytesPerLine(0), m_numPlanes(0), m_fps(0), m_lastError(0), m_lastTriggerId(0), m_driverDrops(0), m_lastSequence(0), m_sequenceValid(false), m_partialWriteInProgress(false)
 {
 }
 
@@ -47,10 +52,46 @@ V4l2Device::~V4l2Device()
 	this->close();
 }
 
+// devices without buffer queues read a single frame
+size_t V4l2Device::readBatchInternal(char** buffers, size_t bufferSize, V4l2FrameInfo* frames, size_t maxFrames)
+{
+	if (maxFrames == 0)
+	{
+		return 0;
+	}
+	size_t size = this->readInternal(buffers[0], bufferSize);
+	if ((size == 0) || (size == (size_t)-1))
+	{
+		return size;
+	}
+	frames[0] = V4l2FrameInfo();
+	frames[0].m_size = size;
+	frames[0].m_triggerId = m_lastTriggerId;
+	return 1;
+}
+
+// count the frames skipped by the driver before the given sequence number
+unsigned int V4l2Device::countSequenceGap(unsigned int sequence)
+{
+	unsigned int gap = 0;
+	// sequence wraps at 2^32, a frame older than the last one (reordered) is not a gap
+	if (m_sequenceValid && ((int)(sequence - m_lastSequence) > 1))
+	{
+		gap = sequence - m_lastSequence - 1;
+		m_driverDrops += gap;
+	}
+	if (!m_sequenceValid || ((int)(sequence - m_lastSequence) > 0))
+	{
+		m_lastSequence = sequence;
+		m_sequenceValid = true;
+	}
+	return gap;
+}
+
 void V4l2Device::close() 
 {
 	if (m_fd != -1) 		
-		::close(m_fd);
+		m_sys->close(m_fd);
 	
 	m_fd = -1;
 }
@@ -61,12 +102,9 @@ void V4l2Device::queryFormat()
 	struct v4l2_format     fmt;
 	memset(&fmt,0,sizeof(fmt));
 	fmt.type  = m_deviceType;
-	if (0 == ioctl(m_fd,VIDIOC_G_FMT,&fmt)) 
+	if (0 == m_sys->ioctl(m_fd,VIDIOC_G_FMT,&fmt)) 
 	{
-		m_format     = fmt.fmt.pix.pixelformat;
-		m_width      = fmt.fmt.pix.width;
-		m_height     = fmt.fmt.pix.height;
-		m_bufferSize = fmt.fmt.pix.sizeimage;
+		this->storeFormat(fmt);
 
 		LOG(DEBUG) << m_params.m_devName << ":" << fourcc(m_format) << " size:" << m_width << "x" << m_height << " bufferSize:" << m_bufferSize;
 	}
@@ -75,8 +113,7 @@ void V4l2Device::queryFormat()
 // intialize the V4L2 connection
 bool V4l2Device::init(unsigned int mandatoryCapabilities)
 {
-	struct stat sb;
-	if ( (stat(m_params.m_devName.c_str(), &sb)==0) && ((sb.st_mode & S_IFMT) == S_IFCHR) )
+	if (m_sys->isCharDevice(m_params.m_devName.c_str()))
 	{
 		if (initdevice(m_params.m_devName.c_str(), mandatoryCapabilities) == -1)
 		{
@@ -86,7 +123,7 @@ bool V4l2Device::init(unsigned int mandatoryCapabilities)
 	else
 	{
 		// open a normal file
-		m_fd = open(m_params.m_devName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRWXU);
+		m_fd = m_sys->open(m_params.m_devName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRWXU);
 	}
 	return (m_fd!=-1);
 }
@@ -94,28 +131,40 @@ bool V4l2Device::init(unsigned int mandatoryCapabilities)
 // intialize the V4L2 device
 int V4l2Device::initdevice(const char *dev_name, unsigned int mandatoryCapabilities)
 {
-	m_fd = open(dev_name,  m_params.m_openFlags);
+	m_startupTiming = V4l2StartupTiming();
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	m_fd = m_sys->open(dev_name,  m_params.m_openFlags);
+	m_startupTiming.m_open = elapsedUs(start);
 	if (m_fd < 0) 
 	{
-		LOG(ERROR) << "Cannot open device:" << m_params.m_devName << " " << strerror(errno);
+		LOG_ERRNO(ERROR) << "Cannot open device:" << m_params.m_devName;
 		this->close();
 		return -1;
 	}
-	if (checkCapabilities(m_fd,mandatoryCapabilities) !=0)
+
+	start = std::chrono::steady_clock::now();
+	int ret = checkCapabilities(m_fd,mandatoryCapabilities);
+	m_startupTiming.m_querycap = elapsedUs(start);
+	if (ret !=0)
 	{
 		this->close();
 		return -1;
 	}	
-	if (configureFormat(m_fd) !=0) 
-	{
-		this->close();
-		return -1;
-	}
-	if (configureParam(m_fd, m_params.m_fps) !=0)
+
+	start = std::chrono::steady_clock::now();
+	ret = configureFormat(m_fd);
+	m_startupTiming.m_format = elapsedUs(start);
+	if (ret !=0) 
 	{
 		this->close();
 		return -1;
 	}
+
+	// many drivers (outputs, fixed rate sensors) reject S_PARM, the device keeps its default rate
+	start = std::chrono::steady_clock::now();
+	configureParam(m_fd, m_params.m_fps);
+	m_startupTiming.m_param = elapsedUs(start);
 	
 	return m_fd;
 }
@@ -125,12 +174,13 @@ int V4l2Device::checkCapabilities(int fd, unsigned int mandatoryCapabilities)
 {
 	struct v4l2_capability cap;
 	memset(&(cap), 0, sizeof(cap));
-	if (-1 == ioctl(fd, VIDIOC_QUERYCAP, &cap)) 
+	if (-1 == m_sys->ioctl(fd, VIDIOC_QUERYCAP, &cap)) 
 	{
-		LOG(ERROR) << "Cannot get capabilities for device:" << m_params.m_devName << " " << strerror(errno);
+		LOG_ERRNO(ERROR) << "Cannot get capabilities for device:" << m_params.m_devName;
 		return -1;
 	}
-	LOG(INFO) << "driver:" << cap.driver << " capabilities:" << std::hex << cap.capabilities <<  " mandatory:" << mandatoryCapabilities << std::dec;
+	m_busInfo = std::string((const char*)cap.bus_info, strnlen((const char*)cap.bus_info, sizeof(cap.bus_info)));
+	LOG(INFO) << "driver:" << cap.driver << " bus:" << m_busInfo << " capabilities:" << std::hex << cap.capabilities <<  " mandatory:" << mandatoryCapabilities << std::dec;
 		
 	if ((cap.capabilities & V4L2_CAP_VIDEO_OUTPUT))  LOG(DEBUG) << m_params.m_devName << " support output";
 	if ((cap.capabilities & V4L2_CAP_VIDEO_CAPTURE)) LOG(DEBUG) << m_params.m_devName << " support capture";
@@ -139,6 +189,27 @@ int V4l2Device::checkCapabilities(int fd, unsigned int mandatoryCapabilities)
 	if ((cap.capabilities & V4L2_CAP_STREAMING))     LOG(DEBUG) << m_params.m_devName << " support streaming";
 
 	if ((cap.capabilities & V4L2_CAP_TIMEPERFRAME))  LOG(DEBUG) << m_params.m_devName << " support timeperframe"; 
+
+	// multi-planar only devices (MIPI sensors, ISPs) : switch to the MPLANE buffer type
+	if ( (m_deviceType == V4L2_BUF_TYPE_VIDEO_CAPTURE) && !(cap.capabilities & V4L2_CAP_VIDEO_CAPTURE) && (cap.capabilities & V4L2_CAP_VIDEO_CAPTURE_MPLANE) )
+	{
+		LOG(INFO) << m_params.m_devName << " using multi-planar capture";
+		m_deviceType = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+		mandatoryCapabilities = (mandatoryCapabilities & ~V4L2_CAP_VIDEO_CAPTURE) | V4L2_CAP_VIDEO_CAPTURE_MPLANE;
+	}
+	else if ( (m_deviceType == V4L2_BUF_TYPE_VIDEO_OUTPUT) && !(cap.capabilities & V4L2_CAP_VIDEO_OUTPUT) && (cap.capabilities & V4L2_CAP_VIDEO_OUTPUT_MPLANE) )
+	{
+		LOG(INFO) << m_params.m_devName << " using multi-planar output";
+		m_deviceType = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+		mandatoryCapabilities = (mandatoryCapabilities & ~V4L2_CAP_VIDEO_OUTPUT) | V4L2_CAP_VIDEO_OUTPUT_MPLANE;
+	}
+
+	// key of the negotiated format cache, built once the buffer type is known
+	unsigned int deviceCaps = (cap.capabilities & V4L2_CAP_DEVICE_CAPS) ? cap.device_caps : cap.capabilities;
+	m_formatCacheKey = V4l2FormatCache::describeDevice(m_busInfo,
+		std::string((const char*)cap.driver, strnlen((const char*)cap.driver, sizeof(cap.driver))),
+		std::string((const char*)cap.card, strnlen((const char*)cap.card, sizeof(cap.card))),
+		m_deviceType, deviceCaps);
 	
 	if ( (cap.capabilities & mandatoryCapabilities) != mandatoryCapabilities )
 	{
@@ -152,6 +223,14 @@ int V4l2Device::checkCapabilities(int fd, unsigned int mandatoryCapabilities)
 // configure capture format 
 int V4l2Device::configureFormat(int fd)
 {
+	// format already negotiated for this device with the same request : apply it without probing
+	std::string request = V4l2FormatCache::describeRequest(m_params.m_formatList, m_params.m_width, m_params.m_height);
+	if (!m_formatCacheKey.empty() && (this->configureCachedFormat(fd, request) == 0))
+	{
+		m_startupTiming.m_formatCacheHit = true;
+		return 0;
+	}
+
 	// get current configuration
 	this->queryFormat();		
 
@@ -175,58 +254,227 @@ int V4l2Device::configureFormat(int fd)
 			// format has been set
 			// get the format again because calling SET-FMT return a bad buffersize using v4l2loopback
 			this->queryFormat();		
+
+			if (!m_formatCacheKey.empty()) {
+				V4l2CachedFormat cached;
+				cached.m_format       = m_format;
+				cached.m_width        = m_width;
+				cached.m_height       = m_height;
+				cached.m_bufferSize   = m_bufferSize;
+				cached.m_bytesPerLine = m_bytesPerLine;
+				V4l2FormatCache::instance().store(m_formatCacheKey, request, cached);
+			}
 			return 0;
 		}
 	}
 	return -1;
 }
 
+// configure capture format from V4l2FormatCache using a single VIDIOC_S_FMT
+int V4l2Device::configureCachedFormat(int fd, const std::string& request)
+{
+	V4l2CachedFormat cached;
+	if (!V4l2FormatCache::instance().lookup(m_formatCacheKey, request, cached))
+	{
+		return -1;
+	}
+
+	struct v4l2_format   fmt;			
+	memset(&(fmt), 0, sizeof(fmt));
+	fmt.type                 = m_deviceType;
+	this->setFormatRequest(fmt, cached.m_format, cached.m_width, cached.m_height);
+	if (this->isMultiPlanar())
+	{
+		fmt.fmt.pix_mp.field = V4L2_FIELD_ANY;
+	}
+	else
+	{
+		fmt.fmt.pix.bytesperline = cached.m_bytesPerLine;
+		fmt.fmt.pix.field        = V4L2_FIELD_ANY;
+	}
+
+	if ( (m_sys->ioctl(fd, VIDIOC_S_FMT, &fmt) == -1)
+	  || (formatPixelFormat(fmt) != cached.m_format)
+	  || (formatWidth(fmt) != cached.m_width)
+	  || (formatHeight(fmt) != cached.m_height) )
+	{
+		LOG(NOTICE) << m_params.m_devName << ": cached format for " << m_busInfo << " rejected, probing again";
+		V4l2FormatCache::instance().invalidate(m_formatCacheKey);
+		return -1;
+	}
+
+	this->storeFormat(fmt);
+	if (!this->isMultiPlanar())
+	{
+		// keep the cached size, SET-FMT return a bad buffersize using v4l2loopback
+		m_bytesPerLine = cached.m_bytesPerLine;
+		m_bufferSize   = cached.m_bufferSize;
+		m_planes[0].m_bytesPerLine = m_bytesPerLine;
+		m_planes[0].m_sizeImage    = m_bufferSize;
+	}
+
+	LOG(INFO) << m_params.m_devName << ":" << fourcc(m_format) << " size:" << m_width << "x" << m_height << " bufferSize:" << m_bufferSize << " (cached)";
+	return 0;
+}
+
 // configure capture format 
 int V4l2Device::configureFormat(int fd, unsigned int format, unsigned int width, unsigned int height)
 {
 	struct v4l2_format   fmt;			
 	memset(&(fmt), 0, sizeof(fmt));
 	fmt.type                = m_deviceType;
-	if (ioctl(m_fd,VIDIOC_G_FMT,&fmt) == -1)
+	if (m_sys->ioctl(m_fd,VIDIOC_G_FMT,&fmt) == -1)
 	{
-		LOG(ERROR) << m_params.m_devName << ": Cannot get format " << strerror(errno);
+		LOG_ERRNO(ERROR) << m_params.m_devName << ": Cannot get format";
 		return -1;
 	}
-	if (width != 0) {
-		fmt.fmt.pix.width       = width;
-	}
-	if (height != 0) {
-		fmt.fmt.pix.height      = height;
-	}
-	if (format != 0) {
-		fmt.fmt.pix.pixelformat = format;
-	}
+	this->setFormatRequest(fmt, format, width, height);
 	
-	if (ioctl(fd, VIDIOC_S_FMT, &fmt) == -1)
+	if (m_sys->ioctl(fd, VIDIOC_S_FMT, &fmt) == -1)
 	{
-		LOG(ERROR) << m_params.m_devName << ": Cannot set format:" << fourcc(format) << " " << strerror(errno);
+		LOG_ERRNO(ERROR) << m_params.m_devName << ": Cannot set format:" << fourcc(format);
 		return -1;
 	}			
-	if (fmt.fmt.pix.pixelformat != format) 
+	if (formatPixelFormat(fmt) != format) 
 	{
-		LOG(ERROR) << m_params.m_devName << ": Cannot set pixelformat to:" << fourcc(format) << " format is:" << fourcc(fmt.fmt.pix.pixelformat);
+		LOG(ERROR) << m_params.m_devName << ": Cannot set pixelformat to:" << fourcc(format) << " format is:" << fourcc(formatPixelFormat(fmt));
 		return -1;
 	}
-	if ((fmt.fmt.pix.width != width) || (fmt.fmt.pix.height != height))
+	if ((formatWidth(fmt) != width) || (formatHeight(fmt) != height))
 	{
-		LOG(WARN) << m_params.m_devName << ": Cannot set size to:" << width << "x" << height << " size is:"  << fmt.fmt.pix.width << "x" << fmt.fmt.pix.height;
+		LOG(WARN) << m_params.m_devName << ": Cannot set size to:" << width << "x" << height << " size is:"  << formatWidth(fmt) << "x" << formatHeight(fmt);
 	}
+	this->alignBytesPerLine(fd, fmt);
 	
-	m_format     = fmt.fmt.pix.pixelformat;
-	m_width      = fmt.fmt.pix.width;
-	m_height     = fmt.fmt.pix.height;		
-	m_bufferSize = fmt.fmt.pix.sizeimage;
+	this->storeFormat(fmt);
 	
 	LOG(INFO) << m_params.m_devName << ":" << fourcc(m_format) << " size:" << m_width << "x" << m_height << " bufferSize:" << m_bufferSize;
 	
 	return 0;
 }
 
+// fill the non-zero fields of a format request, single or multi-planar
+void V4l2Device::setFormatRequest(struct v4l2_format& fmt, unsigned int format, unsigned int width, unsigned int height)
+{
+	if (V4L2_TYPE_IS_MULTIPLANAR(fmt.type))
+	{
+		if (width != 0)  fmt.fmt.pix_mp.width       = width;
+		if (height != 0) fmt.fmt.pix_mp.height      = height;
+		if (format != 0) fmt.fmt.pix_mp.pixelformat = format;
+	}
+	else
+	{
+		if (width != 0)  fmt.fmt.pix.width       = width;
+		if (height != 0) fmt.fmt.pix.height      = height;
+		if (format != 0) fmt.fmt.pix.pixelformat = format;
+	}
+}
+
+// ask the driver for bytesperline rounded up to m_bytesPerLineAlign, keep fmt unchanged if it refuses
+void V4l2Device::alignBytesPerLine(int fd, struct v4l2_format& fmt)
+{
+	unsigned int align = m_params.m_bytesPerLineAlign;
+	if (align == 0)
+	{
+		return;
+	}
+
+	struct v4l2_format aligned = fmt;
+	bool needed = false;
+	if (V4L2_TYPE_IS_MULTIPLANAR(fmt.type))
+	{
+		for (unsigned int i = 0; (i < fmt.fmt.pix_mp.num_planes) && (i < VIDEO_MAX_PLANES); ++i)
+		{
+			unsigned int bpl = fmt.fmt.pix_mp.plane_fmt[i].bytesperline;
+			if ((bpl != 0) && (bpl % align != 0))
+			{
+				aligned.fmt.pix_mp.plane_fmt[i].bytesperline = (bpl + align - 1) / align * align;
+				needed = true;
+			}
+		}
+	}
+	else
+	{
+		// compressed formats report bytesperline 0
+		unsigned int bpl = fmt.fmt.pix.bytesperline;
+		if ((bpl != 0) && (bpl % align != 0))
+		{
+			aligned.fmt.pix.bytesperline = (bpl + align - 1) / align * align;
+			needed = true;
+		}
+	}
+	if (!needed)
+	{
+		return;
+	}
+
+	if ( (m_sys->ioctl(fd, VIDIOC_S_FMT, &aligned) == -1)
+	  || (formatPixelFormat(aligned) != formatPixelFormat(fmt))
+	  || (formatWidth(aligned) != formatWidth(fmt))
+	  || (formatHeight(aligned) != formatHeight(fmt)) )
+	{
+		// restore the negotiated format, the driver may have changed it
+		LOG(NOTICE) << m_params.m_devName << ": bytesperline alignment to " << align << " refused";
+		m_sys->ioctl(fd, VIDIOC_S_FMT, &fmt);
+		return;
+	}
+	fmt = aligned;
+}
+
+// keep the negotiated format, m_bufferSize is the size of all the planes
+void V4l2Device::storeFormat(const struct v4l2_format& fmt)
+{
+	memset(&m_planes, 0, sizeof(m_planes));
+	m_format = formatPixelFormat(fmt);
+	m_width  = formatWidth(fmt);
+	m_height = formatHeight(fmt);
+	if (V4L2_TYPE_IS_MULTIPLANAR(fmt.type))
+	{
+		m_numPlanes  = (fmt.fmt.pix_mp.num_planes < VIDEO_MAX_PLANES) ? fmt.fmt.pix_mp.num_planes : VIDEO_MAX_PLANES;
+		m_bufferSize = 0;
+		for (unsigned int i = 0; i < m_numPlanes; ++i)
+		{
+			m_planes[i].m_bytesPerLine = fmt.fmt.pix_mp.plane_fmt[i].bytesperline;
+			m_planes[i].m_sizeImage    = fmt.fmt.pix_mp.plane_fmt[i].sizeimage;
+			m_bufferSize += m_planes[i].m_sizeImage;
+		}
+	}
+	else
+	{
+		m_numPlanes  = 1;
+		m_bufferSize = fmt.fmt.pix.sizeimage;
+		m_planes[0].m_bytesPerLine = fmt.fmt.pix.bytesperline;
+		m_planes[0].m_sizeImage    = fmt.fmt.pix.sizeimage;
+	}
+	m_bytesPerLine = m_planes[0].m_bytesPerLine;
+}
+
+unsigned int V4l2Device::formatPixelFormat(const struct v4l2_format& fmt)
+{
+	return V4L2_TYPE_IS_MULTIPLANAR(fmt.type) ? fmt.fmt.pix_mp.pixelformat : fmt.fmt.pix.pixelformat;
+}
+
+unsigned int V4l2Device::formatWidth(const struct v4l2_format& fmt)
+{
+	return V4L2_TYPE_IS_MULTIPLANAR(fmt.type) ? fmt.fmt.pix_mp.width : fmt.fmt.pix.width;
+}
+
+unsigned int V4l2Device::formatHeight(const struct v4l2_format& fmt)
+{
+	return V4L2_TYPE_IS_MULTIPLANAR(fmt.type) ? fmt.fmt.pix_mp.height : fmt.fmt.pix.height;
+}
+
+// offset of a plane when the planes of a frame are stored back to back
+unsigned int V4l2Device::getPlaneOffset(unsigned int plane)
+{
+	unsigned int offset = 0;
+	for (unsigned int i = 0; (i < plane) && (i < m_numPlanes); ++i)
+	{
+		offset += m_planes[i].m_sizeImage;
+	}
+	return offset;
+}
+
 // configure capture FPS 
 int V4l2Device::configureParam(int fd, int fps)
 {
@@ -238,13 +486,25 @@ int V4l2Device::configureParam(int fd, int fps)
 		param.parm.capture.timeperframe.numerator = 1;
 		param.parm.capture.timeperframe.denominator = fps;
 
-		if (ioctl(fd, VIDIOC_S_PARM, &param) == -1)
+		if (m_sys->ioctl(fd, VIDIOC_S_PARM, &param) == -1)
 		{
-			LOG(WARN) << "Cannot set param for device:" << m_params.m_devName << " " << strerror(errno);
+			LOG_ERRNO(WARN) << "Cannot set param for device:" << m_params.m_devName;
+			return -1;
 		}
 	
 		LOG(INFO) << "fps:" << param.parm.capture.timeperframe.numerator << "/" << param.parm.capture.timeperframe.denominator;
 		LOG(INFO) << "nbBuffer:" << param.parm.capture.readbuffers;
+
+		// the driver writes back the interval it chose, possibly rounded to a supported rate
+		const struct v4l2_fract& interval = param.parm.capture.timeperframe;
+		if ((interval.numerator != 0) && (interval.denominator != 0))
+		{
+			m_fps = (interval.denominator + interval.numerator / 2) / interval.numerator;
+		}
+		else
+		{
+			m_fps = fps;
+		}
 	}
 	
 	return 0;
@@ -0,0 +1,890 @@
+/* ---------------------------------------------------------------------------
+** This software is in the public domain, furnished "as is", without technical
+** support, and with no warranty, express or implied, as to its usefulness for
+** any purpose.
+**
+** V4l2Emulator.cpp
+**
+** -------------------------------------------------------------------------*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <random>
+#include <vector>
+
+#include "V4l2Emulator.h"
+
+namespace
+{
+	typedef std::chrono::steady_clock emu_clock;
+
+	const unsigned int supportedFormats[] = {
+		V4L2_PIX_FMT_YUYV, V4L2_PIX_FMT_UYVY, V4L2_PIX_FMT_NV12,
+		V4L2_PIX_FMT_GREY, V4L2_PIX_FMT_RGB24, V4L2_PIX_FMT_BGR24,
+	};
+	const unsigned int stripeWidth = 16;
+
+	bool isSupported(unsigned int format)
+	{
+		return std::find(std::begin(supportedFormats), std::end(supportedFormats), format) != std::end(supportedFormats);
+	}
+
+	// bytes per pixel of the first plane
+	unsigned int bytesPerPixel(unsigned int format)
+	{
+		switch (format)
+		{
+			case V4L2_PIX_FMT_YUYV:
+			case V4L2_PIX_FMT_UYVY:  return 2;
+			case V4L2_PIX_FMT_RGB24:
+			case V4L2_PIX_FMT_BGR24: return 3;
+			default:                 return 1;
+		}
+	}
+
+	// adjust a format request the way a driver would
+	void adjustFormat(struct v4l2_pix_format& pix, unsigned int defaultFormat)
+	{
+		if (!isSupported(pix.pixelformat))
+		{
+			pix.pixelformat = defaultFormat;
+		}
+		pix.width  = std::min(std::max(pix.width,  16u), 8192u) & ~1u;
+		pix.height = std::min(std::max(pix.height, 16u), 8192u) & ~1u;
+		pix.field  = V4L2_FIELD_NONE;
+
+		unsigned int minBpl = pix.width * bytesPerPixel(pix.pixelformat);
+		if (pix.bytesperline < minBpl || pix.bytesperline > minBpl * 2)
+		{
+			pix.bytesperline = minBpl;
+		}
+		pix.sizeimage = pix.bytesperline * pix.height;
+		if (pix.pixelformat == V4L2_PIX_FMT_NV12)
+		{
+			pix.sizeimage += pix.bytesperline * (pix.height / 2);
+		}
+		pix.colorspace = (pix.pixelformat == V4L2_PIX_FMT_RGB24 || pix.pixelformat == V4L2_PIX_FMT_BGR24) ? V4L2_COLORSPACE_SRGB : V4L2_COLORSPACE_REC709;
+	}
+
+	int fail(int error)
+	{
+		errno = error;
+		return -1;
+	}
+}
+
+// ---------------------------------
+// State of one emulated device
+// ---------------------------------
+struct V4l2Emulator::Device
+{
+	enum BufferState { DEQUEUED, QUEUED, DONE };
+
+	struct Buffer
+	{
+		BufferState state;
+		struct v4l2_buffer info;
+		int stripe;             // byte offset of the stripe drawn in this buffer, -1 if none
+	};
+
+	Device(const std::string& path, const V4l2EmulatedDeviceConfig& config)
+		: m_path(path), m_config(config), m_fd(-1), m_nonBlocking(false), m_memfd(-1), m_memory(NULL), m_memorySize(0), m_bufferSpan(0),
+		  m_streaming(false), m_readMode(false), m_frameIndex(0), m_sequence(0), m_rng(std::hash<std::string>()(path))
+	{
+		memset(&m_pix, 0, sizeof(m_pix));
+		m_pix.pixelformat = config.m_format;
+		m_pix.width       = config.m_width;
+		m_pix.height      = config.m_height;
+		adjustFormat(m_pix, isSupported(config.m_format) ? config.m_format : V4L2_PIX_FMT_YUYV);
+		m_timePerFrame.numerator   = 1;
+		m_timePerFrame.denominator = (config.m_fps > 0) ? config.m_fps : 30;
+	}
+
+	~Device()
+	{
+		freeBuffers();
+	}
+
+	bool isCapture() const { return m_config.m_type == V4L2_BUF_TYPE_VIDEO_CAPTURE; }
+
+	// frame period in host time, the device clock runs m_driftPpm faster than nominal
+	emu_clock::duration period() const
+	{
+		double us = 1e6 * m_timePerFrame.numerator / m_timePerFrame.denominator;
+		return std::chrono::microseconds(static_cast<long>(us / (1.0 + m_config.m_driftPpm * 1e-6)));
+	}
+
+	int allocateBuffers(unsigned int count)
+	{
+		freeBuffers();
+		if (count == 0)
+		{
+			return 0;
+		}
+
+		long page = sysconf(_SC_PAGESIZE);
+		m_bufferSpan = (m_pix.sizeimage + page - 1) / page * page;
+		m_memorySize = m_bufferSpan * count;
+		m_memfd = memfd_create(m_path.c_str(), MFD_CLOEXEC);
+		if (m_memfd < 0 || ftruncate(m_memfd, m_memorySize) != 0)
+		{
+			int error = errno;
+			freeBuffers();
+			return fail(error);
+		}
+		void* memory = ::mmap(NULL, m_memorySize, PROT_READ | PROT_WRITE, MAP_SHARED, m_memfd, 0);
+		if (memory == MAP_FAILED)
+		{
+			int error = errno;
+			freeBuffers();
+			return fail(error);
+		}
+		m_memory = static_cast<unsigned char*>(memory);
+
+		fillBackground();
+		m_buffers.resize(count);
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			Buffer& buffer = m_buffers[i];
+			memset(&buffer.info, 0, sizeof(buffer.info));
+			buffer.info.index    = i;
+			buffer.info.type     = m_config.m_type;
+			buffer.info.memory   = V4L2_MEMORY_MMAP;
+			buffer.info.length   = m_pix.sizeimage;
+			buffer.info.m.offset = i * m_bufferSpan;
+			buffer.state  = DEQUEUED;
+			buffer.stripe = -1;
+			if (isCapture())
+			{
+				memcpy(m_memory + i * m_bufferSpan, m_background.data(), m_pix.sizeimage);
+			}
+		}
+		return 0;
+	}
+
+	void freeBuffers()
+	{
+		m_buffers.clear();
+		m_queued.clear();
+		m_done.clear();
+		if (m_memory)
+		{
+			::munmap(m_memory, m_memorySize);
+			m_memory = NULL;
+		}
+		if (m_memfd >= 0)
+		{
+			::close(m_memfd);
+			m_memfd = -1;
+		}
+		m_memorySize = 0;
+	}
+
+	// horizontal luma ramp, neutral chroma
+	void fillBackground()
+	{
+		m_background.assign(m_pix.sizeimage, 128);
+		unsigned int bpp = bytesPerPixel(m_pix.pixelformat);
+		for (unsigned int y = 0; y < m_pix.height; ++y)
+		{
+			unsigned char* row = m_background.data() + y * m_pix.bytesperline;
+			for (unsigned int x = 0; x < m_pix.width; ++x)
+			{
+				unsigned char luma = static_cast<unsigned char>(16 + (x * 219) / m_pix.width);
+				switch (m_pix.pixelformat)
+				{
+					case V4L2_PIX_FMT_YUYV:  row[x * 2] = luma; break;
+					case V4L2_PIX_FMT_UYVY:  row[x * 2 + 1] = luma; break;
+					case V4L2_PIX_FMT_RGB24:
+					case V4L2_PIX_FMT_BGR24: memset(row + x * bpp, luma, bpp); break;
+					default:                 row[x] = luma; break;
+				}
+			}
+		}
+	}
+
+	// move a bright stripe so that consecutive frames differ, touching only the stripe columns
+	void drawFrame(Buffer& buffer, unsigned int sequence)
+	{
+		unsigned int bpp = bytesPerPixel(m_pix.pixelformat);
+		unsigned int span = stripeWidth * bpp;
+		unsigned int columns = (m_pix.width > stripeWidth) ? (m_pix.width - stripeWidth) : 1;
+		int stripe = static_cast<int>((((sequence * 4) % columns) & ~1u) * bpp);
+		unsigned char* frame = m_memory + buffer.info.index * m_bufferSpan;
+		for (unsigned int y = 0; y < m_pix.height; ++y)
+		{
+			size_t row = y * m_pix.bytesperline;
+			if (buffer.stripe >= 0)
+			{
+				memcpy(frame + row + buffer.stripe, m_background.data() + row + buffer.stripe, span);
+			}
+			memset(frame + row + stripe, 235, span);
+		}
+		buffer.stripe = stripe;
+	}
+
+	// produce the frame due now, returns true when a buffer became ready
+	bool produce()
+	{
+		unsigned int sequence = m_sequence++;
+		bool skip = (m_config.m_dropEvery > 0) && (m_frameIndex % m_config.m_dropEvery == m_config.m_dropEvery - 1);
+		scheduleNext();
+		if (skip)
+		{
+			m_stats.m_skipped++;
+			return false;
+		}
+		if (m_queued.empty())
+		{
+			m_stats.m_overruns++;
+			return false;
+		}
+
+		Buffer& buffer = m_buffers[m_queued.front()];
+		m_queued.pop_front();
+		drawFrame(buffer, sequence);
+
+		long long us = std::chrono::duration_cast<std::chrono::microseconds>(emu_clock::now().time_since_epoch()).count() + m_config.m_clockOffsetUs;
+		buffer.info.bytesused = m_pix.sizeimage;
+		buffer.info.sequence  = sequence;
+		buffer.info.field     = V4L2_FIELD_NONE;
+		buffer.info.timestamp.tv_sec  = us / 1000000;
+		buffer.info.timestamp.tv_usec = us % 1000000;
+		markDone(buffer);
+		m_stats.m_produced++;
+		return true;
+	}
+
+	void markDone(Buffer& buffer)
+	{
+		buffer.state = DONE;
+		m_done.push_back(buffer.info.index);
+		uint64_t one = 1;
+		ssize_t ret = ::write(m_fd, &one, sizeof(one));
+		(void)ret;
+		m_cv.notify_all();
+	}
+
+	void scheduleNext()
+	{
+		++m_frameIndex;
+		long jitter = 0;
+		if (m_config.m_jitterUs > 0)
+		{
+			jitter = std::uniform_int_distribution<long>(0, m_config.m_jitterUs)(m_rng);
+		}
+		m_nextDue = m_start + std::chrono::microseconds(m_config.m_phaseUs) + period() * m_frameIndex + std::chrono::microseconds(jitter);
+	}
+
+	// a capture device that is not streaming polls readable, as a driver does to let
+	// select start the read() streaming (and to report an error to a DQBUF waiter)
+	void signalIdle()
+	{
+		if (isCapture())
+		{
+			uint64_t one = 1;
+			ssize_t ret = ::write(m_fd, &one, sizeof(one));
+			(void)ret;
+		}
+	}
+
+	void drainEvents()
+	{
+		uint64_t value;
+		while (::read(m_fd, &value, sizeof(value)) > 0) {}
+	}
+
+	void streamOn()
+	{
+		drainEvents();
+		m_streaming  = true;
+		m_start      = emu_clock::now();
+		m_frameIndex = 0;
+		m_sequence   = 0;
+		m_nextDue    = m_start + std::chrono::microseconds(m_config.m_phaseUs);
+		if (!isCapture())
+		{
+			// the output consumes whatever was queued before STREAMON
+			while (!m_queued.empty())
+			{
+				consume(m_buffers[m_queued.front()]);
+				m_queued.pop_front();
+			}
+		}
+	}
+
+	void streamOff()
+	{
+		m_streaming = false;
+		m_readMode  = false;
+		m_queued.clear();
+		m_done.clear();
+		for (size_t i = 0; i < m_buffers.size(); ++i)
+		{
+			m_buffers[i].state = DEQUEUED;
+		}
+		drainEvents();
+		signalIdle();
+		m_cv.notify_all();
+	}
+
+	void consume(Buffer& buffer)
+	{
+		m_stats.m_consumed++;
+		markDone(buffer);
+	}
+
+	// wait for a filled buffer, the caller holds m_mutex through lock
+	int waitDone(std::unique_lock<std::mutex>& lock)
+	{
+		if (m_done.empty() && !m_nonBlocking)
+		{
+			m_cv.wait(lock, [this]() { return !m_done.empty() || !m_streaming; });
+		}
+		if (!m_streaming)
+		{
+			return fail(EINVAL);
+		}
+		if (m_done.empty())
+		{
+			return fail(EAGAIN);
+		}
+		int index = m_done.front();
+		m_done.pop_front();
+		uint64_t value;
+		ssize_t ret = ::read(m_fd, &value, sizeof(value));
+		(void)ret;
+		m_buffers[index].state = DEQUEUED;
+		m_stats.m_dequeued++;
+		return index;
+	}
+
+	std::mutex m_mutex;
+	std::condition_variable m_cv;       // wakes a blocking DQBUF or read
+	std::string m_path;
+	V4l2EmulatedDeviceConfig m_config;
+	V4l2EmulatedDeviceStats m_stats;
+	int m_fd;                           // eventfd, -1 when closed
+	bool m_nonBlocking;
+	struct v4l2_pix_format m_pix;
+	struct v4l2_fract m_timePerFrame;
+
+	int m_memfd;
+	unsigned char* m_memory;
+	size_t m_memorySize;
+	size_t m_bufferSpan;                // page aligned size of one buffer in m_memory
+	std::vector<Buffer> m_buffers;
+	std::deque<unsigned int> m_queued;
+	std::deque<unsigned int> m_done;
+	std::vector<unsigned char> m_background;
+
+	bool m_streaming;
+	bool m_readMode;                    // streaming started implicitly by read
+	emu_clock::time_point m_start;
+	emu_clock::time_point m_nextDue;
+	unsigned long m_frameIndex;
+	unsigned int m_sequence;
+	std::minstd_rand m_rng;
+};
+
+// -----------------------------------------
+//    V4l2Emulator
+// -----------------------------------------
+V4l2Emulator::V4l2Emulator() : m_stop(false), m_generation(0)
+{
+	m_clock = std::thread(&V4l2Emulator::clockLoop, this);
+}
+
+V4l2Emulator::~V4l2Emulator()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+		++m_generation;
+	}
+	m_cv.notify_all();
+	m_clock.join();
+
+	std::map<int, std::shared_ptr<Device> > files;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		files.swap(m_openFiles);
+	}
+	for (std::map<int, std::shared_ptr<Device> >::iterator it = files.begin(); it != files.end(); ++it)
+	{
+		::close(it->first);
+	}
+}
+
+bool V4l2Emulator::addDevice(const std::string& path, const V4l2EmulatedDeviceConfig& config)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_devices.count(path))
+	{
+		return false;
+	}
+	m_devices[path] = std::make_shared<Device>(path, config);
+	return true;
+}
+
+bool V4l2Emulator::removeDevice(const std::string& path)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::map<std::string, std::shared_ptr<Device> >::iterator it = m_devices.find(path);
+	if (it == m_devices.end())
+	{
+		return false;
+	}
+	std::lock_guard<std::mutex> deviceLock(it->second->m_mutex);
+	if (it->second->m_fd != -1)
+	{
+		return false;
+	}
+	m_devices.erase(it);
+	return true;
+}
+
+V4l2EmulatedDeviceStats V4l2Emulator::getStats(const std::string& path)
+{
+	std::shared_ptr<Device> device;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		std::map<std::string, std::shared_ptr<Device> >::iterator it = m_devices.find(path);
+		if (it == m_devices.end())
+		{
+			return V4l2EmulatedDeviceStats();
+		}
+		device = it->second;
+	}
+	std::lock_guard<std::mutex> lock(device->m_mutex);
+	return device->m_stats;
+}
+
+int V4l2Emulator::open(const char* path, int flags, mode_t mode)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::map<std::string, std::shared_ptr<Device> >::iterator it = m_devices.find(path);
+	if (it == m_devices.end())
+	{
+		return V4l2Syscalls::open(path, flags, mode);
+	}
+
+	std::shared_ptr<Device> device = it->second;
+	std::lock_guard<std::mutex> deviceLock(device->m_mutex);
+	if (device->m_fd != -1)
+	{
+		return fail(EBUSY);
+	}
+	int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC | EFD_SEMAPHORE);
+	if (fd < 0)
+	{
+		return -1;
+	}
+	device->m_fd = fd;
+	device->m_nonBlocking = (flags & O_NONBLOCK) != 0;
+	device->signalIdle();
+	m_openFiles[fd] = device;
+	return fd;
+}
+
+int V4l2Emulator::close(int fd)
+{
+	std::shared_ptr<Device> device;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		std::map<int, std::shared_ptr<Device> >::iterator it = m_openFiles.find(fd);
+		if (it == m_openFiles.end())
+		{
+			return V4l2Syscalls::close(fd);
+		}
+		device = it->second;
+		m_openFiles.erase(it);
+	}
+
+	std::lock_guard<std::mutex> lock(device->m_mutex);
+	device->streamOff();
+	device->freeBuffers();
+	device->m_fd = -1;
+	return ::close(fd);
+}
+
+int V4l2Emulator::ioctl(int fd, unsigned long request, void* arg)
+{
+	std::shared_ptr<Device> device = findByFd(fd);
+	if (!device)
+	{
+		return V4l2Syscalls::ioctl(fd, request, arg);
+	}
+	if (arg == NULL)
+	{
+		return fail(EFAULT);
+	}
+
+	bool started = false;
+	int ret = 0;
+	{
+		std::unique_lock<std::mutex> lock(device->m_mutex);
+		Device& dev = *device;
+		dev.m_stats.m_ioctls++;
+
+		switch (request)
+		{
+			case VIDIOC_QUERYCAP:
+			{
+				struct v4l2_capability* cap = static_cast<struct v4l2_capability*>(arg);
+				memset(cap, 0, sizeof(*cap));
+				strncpy(reinterpret_cast<char*>(cap->driver), "v4l2emu", sizeof(cap->driver) - 1);
+				strncpy(reinterpret_cast<char*>(cap->card), dev.m_config.m_card.c_str(), sizeof(cap->card) - 1);
+				snprintf(reinterpret_cast<char*>(cap->bus_info), sizeof(cap->bus_info), "emulated:%s", dev.m_path.c_str());
+				cap->version      = 0x050f00;
+				cap->device_caps  = (dev.isCapture() ? V4L2_CAP_VIDEO_CAPTURE : V4L2_CAP_VIDEO_OUTPUT) | V4L2_CAP_STREAMING | V4L2_CAP_READWRITE;
+				cap->capabilities = cap->device_caps | V4L2_CAP_DEVICE_CAPS;
+				break;
+			}
+			case VIDIOC_ENUM_FMT:
+			{
+				struct v4l2_fmtdesc* desc = static_cast<struct v4l2_fmtdesc*>(arg);
+				unsigned int count = sizeof(supportedFormats) / sizeof(supportedFormats[0]);
+				if (desc->type != dev.m_config.m_type || desc->index >= count)
+				{
+					ret = fail(EINVAL);
+					break;
+				}
+				unsigned int index = desc->index;
+				memset(desc, 0, sizeof(*desc));
+				desc->index       = index;
+				desc->type        = dev.m_config.m_type;
+				desc->pixelformat = supportedFormats[index];
+				break;
+			}
+			case VIDIOC_G_FMT:
+			case VIDIOC_S_FMT:
+			case VIDIOC_TRY_FMT:
+			{
+				struct v4l2_format* fmt = static_cast<struct v4l2_format*>(arg);
+				if (fmt->type != dev.m_config.m_type)
+				{
+					ret = fail(EINVAL);
+					break;
+				}
+				if (request == VIDIOC_G_FMT)
+				{
+					fmt->fmt.pix = dev.m_pix;
+					break;
+				}
+				struct v4l2_pix_format pix = fmt->fmt.pix;
+				adjustFormat(pix, dev.m_pix.pixelformat);
+				if (request == VIDIOC_S_FMT)
+				{
+					if (!dev.m_buffers.empty())
+					{
+						ret = fail(EBUSY);
+						break;
+					}
+					dev.m_pix = pix;
+				}
+				fmt->fmt.pix = pix;
+				break;
+			}
+			case VIDIOC_G_PARM:
+			case VIDIOC_S_PARM:
+			{
+				struct v4l2_streamparm* param = static_cast<struct v4l2_streamparm*>(arg);
+				if (param->type != dev.m_config.m_type)
+				{
+					ret = fail(EINVAL);
+					break;
+				}
+				struct v4l2_fract& requested = dev.isCapture() ? param->parm.capture.timeperframe : param->parm.output.timeperframe;
+				if (request == VIDIOC_S_PARM && requested.numerator > 0 && requested.denominator > 0)
+				{
+					dev.m_timePerFrame = requested;
+				}
+				memset(&param->parm, 0, sizeof(param->parm));
+				if (dev.isCapture())
+				{
+					param->parm.capture.capability   = V4L2_CAP_TIMEPERFRAME;
+					param->parm.capture.timeperframe = dev.m_timePerFrame;
+				}
+				else
+				{
+					param->parm.output.capability   = V4L2_CAP_TIMEPERFRAME;
+					param->parm.output.timeperframe = dev.m_timePerFrame;
+				}
+				break;
+			}
+			case VIDIOC_REQBUFS:
+			{
+				struct v4l2_requestbuffers* req = static_cast<struct v4l2_requestbuffers*>(arg);
+				if (req->type != dev.m_config.m_type || req->memory != V4L2_MEMORY_MMAP)
+				{
+					ret = fail(EINVAL);
+					break;
+				}
+				if (dev.m_streaming)
+				{
+					ret = fail(EBUSY);
+					break;
+				}
+				unsigned int count = (req->count == 0) ? 0 : std::min(std::max(req->count, 2u), std::max(dev.m_config.m_maxBuffers, 2u));
+				ret = dev.allocateBuffers(count);
+				req->count = (ret == 0) ? count : 0;
+				break;
+			}
+			case VIDIOC_QUERYBUF:
+			case VIDIOC_QBUF:
+			{
+				struct v4l2_buffer* buf = static_cast<struct v4l2_buffer*>(arg);
+				if (buf->type != dev.m_config.m_type || buf->index >= dev.m_buffers.size())
+				{
+					ret = fail(EINVAL);
+					break;
+				}
+				Device::Buffer& buffer = dev.m_buffers[buf->index];
+				if (request == VIDIOC_QBUF)
+				{
+					if (buffer.state != Device::DEQUEUED)
+					{
+						ret = fail(EINVAL);
+						break;
+					}
+					buffer.state = Device::QUEUED;
+					if (!dev.isCapture())
+					{
+						buffer.info.bytesused = std::min(buf->bytesused, buffer.info.length);
+						if (dev.m_streaming)
+						{
+							dev.consume(buffer);
+							break;
+						}
+					}
+					dev.m_queued.push_back(buf->index);
+					break;
+				}
+				*buf = buffer.info;
+				buf->flags = V4L2_BUF_FLAG_MAPPED | V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC | V4L2_BUF_FLAG_TSTAMP_SRC_EOF;
+				if (buffer.state == Device::QUEUED) buf->flags |= V4L2_BUF_FLAG_QUEUED;
+				if (buffer.state == Device::DONE)   buf->flags |= V4L2_BUF_FLAG_DONE;
+				break;
+			}
+			case VIDIOC_DQBUF:
+			{
+				struct v4l2_buffer* buf = static_cast<struct v4l2_buffer*>(arg);
+				if (buf->type != dev.m_config.m_type)
+				{
+					ret = fail(EINVAL);
+					break;
+				}
+				int index = dev.waitDone(lock);
+				if (index < 0)
+				{
+					ret = -1;
+					break;
+				}
+				*buf = dev.m_buffers[index].info;
+				buf->flags = V4L2_BUF_FLAG_MAPPED | V4L2_BUF_FLAG_DONE | V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC | V4L2_BUF_FLAG_TSTAMP_SRC_EOF;
+				break;
+			}
+			case VIDIOC_STREAMON:
+			case VIDIOC_STREAMOFF:
+			{
+				int type = *static_cast<int*>(arg);
+				if (type != dev.m_config.m_type || (request == VIDIOC_STREAMON && dev.m_buffers.empty()))
+				{
+					ret = fail(EINVAL);
+					break;
+				}
+				if (request == VIDIOC_STREAMOFF)
+				{
+					dev.streamOff();
+				}
+				else if (!dev.m_streaming)
+				{
+					dev.streamOn();
+					started = dev.isCapture();
+				}
+				break;
+			}
+			default:
+				ret = fail(ENOTTY);
+				break;
+		}
+	}
+
+	if (started)
+	{
+		wake();
+	}
+	return ret;
+}
+
+void* V4l2Emulator::mmap(void* addr, size_t length, int prot, int flags, int fd, off_t offset)
+{
+	std::shared_ptr<Device> device = findByFd(fd);
+	if (!device)
+	{
+		return V4l2Syscalls::mmap(addr, length, prot, flags, fd, offset);
+	}
+
+	std::lock_guard<std::mutex> lock(device->m_mutex);
+	if (device->m_memfd < 0 || offset < 0 || static_cast<size_t>(offset) + length > device->m_memorySize)
+	{
+		errno = EINVAL;
+		return MAP_FAILED;
+	}
+	// map the same pages as the emulator, munmap is an ordinary system call
+	return ::mmap(addr, length, prot, flags, device->m_memfd, offset);
+}
+
+ssize_t V4l2Emulator::read(int fd, void* buf, size_t count)
+{
+	std::shared_ptr<Device> device = findByFd(fd);
+	if (!device)
+	{
+		return V4l2Syscalls::read(fd, buf, count);
+	}
+
+	bool started = false;
+	ssize_t size = 0;
+	{
+		std::unique_lock<std::mutex> lock(device->m_mutex);
+		Device& dev = *device;
+		if (!dev.isCapture() || (dev.m_streaming && !dev.m_readMode))
+		{
+			return dev.isCapture() ? fail(EBUSY) : fail(EINVAL);
+		}
+		if (!dev.m_streaming)
+		{
+			// the first read starts streaming with internal buffers
+			if (dev.allocateBuffers(4) != 0)
+			{
+				return -1;
+			}
+			for (unsigned int i = 0; i < dev.m_buffers.size(); ++i)
+			{
+				dev.m_buffers[i].state = Device::QUEUED;
+				dev.m_queued.push_back(i);
+			}
+			dev.streamOn();
+			dev.m_readMode = true;
+			started = true;
+		}
+		if (!started || !dev.m_nonBlocking)
+		{
+			int index = dev.waitDone(lock);
+			if (index < 0)
+			{
+				size = -1;
+			}
+			else
+			{
+				Device::Buffer& buffer = dev.m_buffers[index];
+				size = std::min<size_t>(count, buffer.info.bytesused);
+				memcpy(buf, dev.m_memory + index * dev.m_bufferSpan, size);
+				buffer.state = Device::QUEUED;
+				dev.m_queued.push_back(index);
+			}
+		}
+		else
+		{
+			size = fail(EAGAIN);
+		}
+	}
+
+	if (started)
+	{
+		wake();
+	}
+	return size;
+}
+
+ssize_t V4l2Emulator::write(int fd, const void* buf, size_t count)
+{
+	std::shared_ptr<Device> device = findByFd(fd);
+	if (!device)
+	{
+		return V4l2Syscalls::write(fd, buf, count);
+	}
+
+	std::lock_guard<std::mutex> lock(device->m_mutex);
+	if (device->isCapture())
+	{
+		return fail(EINVAL);
+	}
+	device->m_stats.m_consumed++;
+	return count;
+}
+
+bool V4l2Emulator::isCharDevice(const char* path)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_devices.count(path))
+		{
+			return true;
+		}
+	}
+	return V4l2Syscalls::isCharDevice(path);
+}
+
+std::shared_ptr<V4l2Emulator::Device> V4l2Emulator::findByFd(int fd)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::map<int, std::shared_ptr<Device> >::iterator it = m_openFiles.find(fd);
+	return (it != m_openFiles.end()) ? it->second : std::shared_ptr<Device>();
+}
+
+void V4l2Emulator::wake()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		++m_generation;
+	}
+	m_cv.notify_all();
+}
+
+// produce the frames of every streaming capture device when they are due
+void V4l2Emulator::clockLoop()
+{
+	std::vector<std::shared_ptr<Device> > devices;
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (!m_stop)
+	{
+		unsigned long generation = m_generation;
+		devices.clear();
+		for (std::map<int, std::shared_ptr<Device> >::iterator it = m_openFiles.begin(); it != m_openFiles.end(); ++it)
+		{
+			devices.push_back(it->second);
+		}
+		lock.unlock();
+
+		emu_clock::time_point now = emu_clock::now();
+		emu_clock::time_point wakeup = now + std::chrono::seconds(1);
+		for (size_t i = 0; i < devices.size(); ++i)
+		{
+			Device& dev = *devices[i];
+			std::lock_guard<std::mutex> deviceLock(dev.m_mutex);
+			if (!dev.m_streaming || !dev.isCapture())
+			{
+				continue;
+			}
+			while (dev.m_nextDue <= now)
+			{
+				dev.produce();
+			}
+			wakeup = std::min(wakeup, dev.m_nextDue);
+		}
+
+		lock.lock();
+		m_cv.wait_until(lock, wakeup, [this, generation]() { return m_stop || m_generation != generation; });
+	}
+}
@@ -0,0 +1,129 @@
+/* ---------------------------------------------------------------------------
+** This software is in the public domain, furnished "as is", without technical
+** support, and with no warranty, express or implied, as to its usefulness for
+** any purpose.
+**
+** V4l2FormatCache.cpp
+**
+** Cache of negotiated V4L2 formats keyed by device identity
+**
+** -------------------------------------------------------------------------*/
+
+#include <cctype>
+#include <fstream>
+#include <sstream>
+
+#include "V4l2FormatCache.h"
+
+V4l2FormatCache& V4l2FormatCache::instance()
+{
+	static V4l2FormatCache cache;
+	return cache;
+}
+
+bool V4l2FormatCache::lookup(const std::string& device, const std::string& request, V4l2CachedFormat& format)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::map<std::string, Entry>::iterator it = m_entries.find(device);
+	if ( (it == m_entries.end()) || (it->second.m_request != request) )
+	{
+		return false;
+	}
+	format = it->second.m_format;
+	return true;
+}
+
+void V4l2FormatCache::store(const std::string& device, const std::string& request, const V4l2CachedFormat& format)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Entry& entry = m_entries[device];
+	entry.m_request = request;
+	entry.m_format  = format;
+}
+
+void V4l2FormatCache::invalidate(const std::string& device)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_entries.erase(device);
+}
+
+void V4l2FormatCache::clear()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_entries.clear();
+}
+
+// one entry per line: <device> <request> <format> <width> <height> <bufferSize> <bytesPerLine>
+bool V4l2FormatCache::load(const std::string& path)
+{
+	std::ifstream file(path.c_str());
+	if (!file)
+	{
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::string line;
+	while (std::getline(file, line))
+	{
+		std::istringstream is(line);
+		std::string device;
+		Entry entry;
+		if (is >> device >> entry.m_request >> entry.m_format.m_format >> entry.m_format.m_width >> entry.m_format.m_height >> entry.m_format.m_bufferSize >> entry.m_format.m_bytesPerLine)
+		{
+			m_entries[device] = entry;
+		}
+	}
+	return true;
+}
+
+bool V4l2FormatCache::save(const std::string& path)
+{
+	std::ofstream file(path.c_str(), std::ios::trunc);
+	if (!file)
+	{
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::map<std::string, Entry>::const_iterator it;
+	for (it = m_entries.begin(); it != m_entries.end(); ++it)
+	{
+		const V4l2CachedFormat& format = it->second.m_format;
+		file << it->first << " " << it->second.m_request << " " << format.m_format << " " << format.m_width << " " << format.m_height << " " << format.m_bufferSize << " " << format.m_bytesPerLine << "\n";
+	}
+	return file.good();
+}
+
+std::string V4l2FormatCache::describeDevice(const std::string& busInfo, const std::string& driver, const std::string& card, unsigned int bufferType, unsigned int deviceCaps)
+{
+	if (busInfo.empty())
+	{
+		return std::string();
+	}
+
+	// nodes sharing a bus_info (UVC capture and metadata nodes, single and multi-planar nodes) get distinct keys
+	std::ostringstream os;
+	os << busInfo << "|" << driver << "|" << card << "|" << bufferType << "|" << std::hex << deviceCaps;
+	std::string device = os.str();
+	for (std::string::iterator it = device.begin(); it != device.end(); ++it)
+	{
+		if (isspace(static_cast<unsigned char>(*it)))
+		{
+			*it = '_';
+		}
+	}
+	return device;
+}
+
+std::string V4l2FormatCache::describeRequest(const std::list<unsigned int>& formatList, unsigned int width, unsigned int height)
+{
+	std::ostringstream os;
+	std::list<unsigned int>::const_iterator it;
+	for (it = formatList.begin(); it != formatList.end(); ++it)
+	{
+		os << std::hex << *it << std::dec << ",";
+	}
+	os << "@" << width << "x" << height;
+	return os.str();
+}
@@ -31,10 +31,11 @@
  * @param params 设备参数，包含设备路径等信息
  * @param deviceType 设备类型，如视频捕获、输出等
  */
-V4l2MmapDevice::V4l2MmapDevice(const V4L2DeviceParameters & params, v4l2_buf_type deviceType) : V4l2Device(params, deviceType), n_buffers(0) 
+V4l2MmapDevice::V4l2MmapDevice(const V4L2DeviceParameters & params, v4l2_buf_type deviceType) : V4l2Device(params, deviceType), n_buffers(0), m_streaming(false), m_triggerMode(TRIGGER_NONE), m_triggerControl(0) 
 {
 	// 初始化缓冲区数组为全0
 	memset(&m_buffer, 0, sizeof(m_buffer));
+	memset(&m_bufferTrigger, 0, sizeof(m_bufferTrigger));
 }
 
 /**
@@ -81,17 +82,297 @@ bool V4l2MmapDevice::start()
 {
 	LOG(INFO) << "Device " << m_params.m_devName;
 
+	bool success = this->allocateBuffers();
+	if (n_buffers > 0)
+	{
+		success = this->streamOn() && success;
+	}
+	return success; 
+}
+
+/**
+ * @brief 停止视频流
+ * 
+ * 停止设备流，解除内存映射，释放缓冲区
+ * 
+ * @return true 停止成功
+ * @return false 停止失败
+ */
+bool V4l2MmapDevice::stop() 
+{
+	LOG(INFO) << "Device " << m_params.m_devName;
+
+	bool success = this->streamOff();
+	success = this->releaseBuffers() && success;
+	return success; 
+}
+
+/**
+ * @brief 暂停视频流
+ * 
+ * 只停止视频流，缓冲区的分配和映射保持不变
+ * 
+ * @return true 暂停成功
+ * @return false 暂停失败
+ */
+bool V4l2MmapDevice::pause()
+{
+	if (!m_streaming)
+	{
+		return true;
+	}
+	LOG(INFO) << "Device " << m_params.m_devName;
+	return this->streamOff();
+}
+
+/**
+ * @brief 恢复视频流
+ * 
+ * 复用已映射的缓冲区重新入队并启动视频流
+ * 
+ * @return true 恢复成功
+ * @return false 恢复失败
+ */
+bool V4l2MmapDevice::resume()
+{
+	if (m_streaming)
+	{
+		return true;
+	}
+	if (n_buffers == 0)
+	{
+		LOG(ERROR) << "Device " << m_params.m_devName << " has no buffers to resume";
+		return false;
+	}
+	LOG(INFO) << "Device " << m_params.m_devName;
+	return this->streamOn();
+}
+
+/**
+ * @brief 运行时修改格式
+ * 
+ * 优先复用已映射的缓冲区，失败时释放并重新分配缓冲区
+ * 
+ * @param format 像素格式
+ * @param width 图像宽度
+ * @param height 图像高度
+ * @return int 0表示成功，-1表示失败
+ */
+int V4l2MmapDevice::setFormat(unsigned int format, unsigned int width, unsigned int height)
+{
+	if (n_buffers == 0)
+	{
+		return V4l2Device::setFormat(format, width, height);
+	}
+
+	bool wasStreaming = m_streaming;
+	unsigned int oldFormat = m_format;
+	unsigned int oldWidth = m_width;
+	unsigned int oldHeight = m_height;
+	if (!this->pause())
+	{
+		return -1;
+	}
+
+	int ret = -1;
+	if (this->fitsBuffers(format, width, height))
+	{
+		// 驱动允许在缓冲区已分配时修改格式，直接复用缓冲区
+		ret = this->configureFormat(m_fd, format, width, height);
+	}
+	if (ret != 0)
+	{
+		// 缓冲区不够大或驱动拒绝（通常为EBUSY），重新分配缓冲区
+		LOG(INFO) << "Device " << m_params.m_devName << " reallocating buffers for format change";
+		this->releaseBuffers();
+		ret = this->configureFormat(m_fd, format, width, height);
+		if (!this->allocateBuffers())
+		{
+			ret = -1;
+		}
+	}
+	if ((ret == 0) && wasStreaming && !this->resume())
+	{
+		ret = -1;
+	}
+
+	// 修改失败时回到原格式，设备照常采集
+	if ((ret != 0) && !this->restoreFormat(oldFormat, oldWidth, oldHeight, wasStreaming))
+	{
+		return -1;
+	}
+	return ret;
+}
+
+/**
+ * @brief 运行时修改帧率
+ * 
+ * @param fps 帧率
+ * @return int 0表示成功，-1表示失败
+ */
+int V4l2MmapDevice::setFps(int fps)
+{
+	bool wasStreaming = m_streaming;
+	int oldFps = m_fps;
+	if (!this->pause())
+	{
+		return -1;
+	}
+
+	int ret = this->configureParam(m_fd, fps);
+
+	if (wasStreaming && !this->resume())
+	{
+		// 驱动不接受新帧率下的视频流时回到原帧率再启动一次
+		LOG(WARN) << "Device " << m_params.m_devName << " cannot stream at " << fps << " fps";
+		if (oldFps > 0)
+		{
+			this->configureParam(m_fd, oldFps);
+		}
+		if (!this->resume())
+		{
+			LOG(ERROR) << "Device " << m_params.m_devName << " cannot resume streaming";
+			m_lastError = EIO;
+		}
+		return -1;
+	}
+	return ret;
+}
+
+/**
+ * @brief 恢复原格式并重新分配缓冲区
+ * 
+ * @return true 已恢复
+ * @return false 仍然失败，设备没有缓冲区（isReady()为false），m_lastError为EIO
+ */
+bool V4l2MmapDevice::restoreFormat(unsigned int format, unsigned int width, unsigned int height, bool resume)
+{
+	LOG(WARN) << "Device " << m_params.m_devName << " restoring format " << fourcc(format) << " " << width << "x" << height;
+	this->pause();
+	this->releaseBuffers();
+	if ((this->configureFormat(m_fd, format, width, height) != 0) || !this->allocateBuffers() || (resume && !this->resume()))
+	{
+		LOG(ERROR) << "Device " << m_params.m_devName << " cannot restore its buffers";
+		this->pause();
+		this->releaseBuffers();
+		m_lastError = EIO;
+		return false;
+	}
+	return true;
+}
+
+/**
+ * @brief 设置采集的触发方式
+ * 
+ * @param mode 触发方式
+ * @param controlId TRIGGER_CONTROL使用的控制项ID
+ * @return true 设置成功
+ */
+bool V4l2MmapDevice::setTriggerMode(V4l2TriggerMode mode, unsigned int controlId)
+{
+	if (m_deviceType != V4L2_BUF_TYPE_VIDEO_CAPTURE && m_deviceType != V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE)
+	{
+		return false;
+	}
+
+	// 排队方式只在STREAMOFF和STREAMON之间切换
+	bool wasStreaming = m_streaming;
+	if (!this->pause())
+	{
+		return false;
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_triggerMutex);
+		m_triggerMode = mode;
+		m_triggerControl = controlId;
+	}
+	LOG(INFO) << "Device " << m_params.m_devName << " trigger mode:" << mode;
+
+	if (wasStreaming && !this->resume())
+	{
+		return false;
+	}
+	return true;
+}
+
+/**
+ * @brief 发出一次触发
+ * 
+ * @param id 触发编号
+ * @return true 已触发
+ */
+bool V4l2MmapDevice::trigger(unsigned long id)
+{
+	std::lock_guard<std::mutex> lock(m_triggerMutex);
+
+	if (m_triggerMode == TRIGGER_QBUF)
+	{
+		// 每次触发只排队一个缓冲区，驱动用下一帧填充
+		if (m_freeBuffers.empty())
+		{
+			return false;
+		}
+		struct v4l2_buffer buf;
+		struct v4l2_plane planes[VIDEO_MAX_PLANES];
+		this->prepareBuffer(buf, planes);
+		buf.index = m_freeBuffers.front();
+		if (this->isMultiPlanar()) {
+			buf.length = m_buffer[buf.index].nplanes;
+		}
+		if (-1 == m_sys->ioctl(m_fd, VIDIOC_QBUF, &buf))
+		{
+			LOG_ERRNO_RATELIMIT(ERROR) << logDevice(m_params.m_devName) << "VIDIOC_QBUF";
+			return false;
+		}
+		m_freeBuffers.pop_front();
+		m_bufferTrigger[buf.index] = id;
+		return true;
+	}
+
+	if (m_triggerMode == TRIGGER_CONTROL)
+	{
+		struct v4l2_control control;
+		memset(&control, 0, sizeof(control));
+		control.id = m_triggerControl;
+		control.value = 1;
+		if (-1 == m_sys->ioctl(m_fd, VIDIOC_S_CTRL, &control))
+		{
+			LOG_ERRNO_RATELIMIT(ERROR) << logDevice(m_params.m_devName) << "VIDIOC_S_CTRL trigger";
+			return false;
+		}
+		// 驱动丢弃了对应帧的触发在积满一个队列后丢弃
+		if (m_pendingTriggers.size() >= n_buffers)
+		{
+			m_pendingTriggers.pop_front();
+		}
+		m_pendingTriggers.push_back(id);
+		return true;
+	}
+	return false;
+}
+
+/**
+ * @brief 申请并映射缓冲区
+ * 
+ * @return true 全部缓冲区映射成功
+ * @return false 申请或映射失败
+ */
+bool V4l2MmapDevice::allocateBuffers()
+{
 	bool success = true;
 	struct v4l2_requestbuffers req;
 	memset (&req, 0, sizeof(req));
 	
 	// 请求分配内存映射缓冲区
-	req.count               = V4L2MMAP_NBBUFFER; // 请求的缓冲区数量
+	req.count               = (m_params.m_bufferCount > 0 && m_params.m_bufferCount < V4L2MMAP_NBBUFFER) ? m_params.m_bufferCount : V4L2MMAP_NBBUFFER; // 请求的缓冲区数量
 	req.type                = m_deviceType;      // 缓冲区类型（捕获或输出）
 	req.memory              = V4L2_MEMORY_MMAP;  // 使用内存映射方式
 
 	// 向驱动请求分配缓冲区
-	if (-1 == ioctl(m_fd, VIDIOC_REQBUFS, &req)) 
+	std::chrono::steady_clock::time_point phaseStart = std::chrono::steady_clock::now();
+	int ret = m_sys->ioctl(m_fd, VIDIOC_REQBUFS, &req);
+	m_startupTiming.m_reqbufs = elapsedUs(phaseStart);
+	if (-1 == ret) 
 	{
 		if (EINVAL == errno) 
 		{
@@ -101,7 +382,7 @@ bool V4l2MmapDevice::start()
 		} 
 		else 
 		{
-			perror("VIDIOC_REQBUFS");
+			LOG_ERRNO(ERROR) << logDevice(m_params.m_devName) << "VIDIOC_REQBUFS";
 			success = false;
 		}
 	}
@@ -110,125 +391,244 @@ bool V4l2MmapDevice::start()
 		LOG(INFO) << "Device " << m_params.m_devName << " nb buffer:" << req.count;
 		
 		 // 分配并映射缓冲区
+		phaseStart = std::chrono::steady_clock::now();
 		memset(&m_buffer,0, sizeof(m_buffer));
 		for (n_buffers = 0; n_buffers < req.count; ++n_buffers) 
 		{
 			struct v4l2_buffer buf;
-			memset (&buf, 0, sizeof(buf));
-			buf.type        = m_deviceType;
-			buf.memory      = V4L2_MEMORY_MMAP;
+			struct v4l2_plane planes[VIDEO_MAX_PLANES];
+			this->prepareBuffer(buf, planes);
 			buf.index       = n_buffers;
 
 			// 查询缓冲区信息（大小和偏移量）
-			if (-1 == ioctl(m_fd, VIDIOC_QUERYBUF, &buf))
+			if (-1 == m_sys->ioctl(m_fd, VIDIOC_QUERYBUF, &buf))
 			{
-				perror("VIDIOC_QUERYBUF");
+				LOG_ERRNO(ERROR) << logDevice(m_params.m_devName) << "VIDIOC_QUERYBUF";
 				success = false;
 			}
 			else
 			{
-				LOG(INFO) << "Device " << m_params.m_devName << " buffer idx:" << n_buffers << " size:" << buf.length << " offset:" << buf.m.offset;
+				// 多平面设备的每个平面单独映射
+				bool multiPlanar = this->isMultiPlanar();
+				m_buffer[n_buffers].nplanes = multiPlanar ? buf.length : 1;
+				for (unsigned int p = 0; p < m_buffer[n_buffers].nplanes; ++p)
+				{
+					size_t length = multiPlanar ? planes[p].length : buf.length;
+					if (!length) {
+						length = multiPlanar ? planes[p].bytesused : buf.bytesused;
+					}
+					off_t offset = multiPlanar ? planes[p].m.mem_offset : buf.m.offset;
+					LOG(INFO) << "Device " << m_params.m_devName << " buffer idx:" << n_buffers << " plane:" << p << " size:" << length << " offset:" << offset;
 				
-				// 保存缓冲区长度
-				m_buffer[n_buffers].length = buf.length;
-				if (!m_buffer[n_buffers].length) {
-					m_buffer[n_buffers].length = buf.bytesused;
-				}
+					// 保存缓冲区长度
+					m_buffer[n_buffers].planes[p].length = length;
 				
-				// 将内核空间的缓冲区映射到用户空间
-				m_buffer[n_buffers].start = mmap (   NULL /* start anywhere */, 
-											m_buffer[n_buffers].length, 
-											PROT_READ | PROT_WRITE /* required */, 
-											MAP_SHARED /* recommended */, 
-											m_fd, 
-											buf.m.offset);
-
-				// 检查映射是否成功
-				if (MAP_FAILED == m_buffer[n_buffers].start)
-				{
-					perror("mmap");
-					success = false;
+					// 将内核空间的缓冲区映射到用户空间
+					void* start = m_sys->mmap (   NULL /* start anywhere */, 
+										length, 
+										PROT_READ | PROT_WRITE /* required */, 
+										MAP_SHARED /* recommended */, 
+										m_fd, 
+										offset);
+
+					// 检查映射是否成功
+					if (MAP_FAILED == start)
+					{
+						LOG_ERRNO(ERROR) << logDevice(m_params.m_devName) << "mmap";
+						success = false;
+						start = NULL;
+					}
+					m_buffer[n_buffers].planes[p].start = start;
 				}
 			}
 		}
 
-		// 将所有缓冲区入队，准备接收/发送数据
-		for (unsigned int i = 0; i < n_buffers; ++i) 
-		{
-			struct v4l2_buffer buf;
-			memset (&buf, 0, sizeof(buf));
-			buf.type        = m_deviceType;
-			buf.memory      = V4L2_MEMORY_MMAP;
-			buf.index       = i;
+		m_startupTiming.m_mmap = elapsedUs(phaseStart);
+	}
+	return success;
+}
 
-			// 将缓冲区放入驱动队列
-			if (-1 == ioctl(m_fd, VIDIOC_QBUF, &buf))
+/**
+ * @brief 解除映射并释放缓冲区
+ * 
+ * @return true 释放成功
+ * @return false 释放失败
+ */
+bool V4l2MmapDevice::releaseBuffers()
+{
+	bool success = true;
+
+	// 解除所有缓冲区的内存映射
+	for (unsigned int i = 0; i < n_buffers; ++i)
+	{
+		for (unsigned int p = 0; p < m_buffer[i].nplanes; ++p)
+		{
+			if ( (m_buffer[i].planes[p].start != NULL) && (-1 == m_sys->munmap (m_buffer[i].planes[p].start, m_buffer[i].planes[p].length)) )
 			{
-				perror("VIDIOC_QBUF");
+				LOG_ERRNO(ERROR) << logDevice(m_params.m_devName) << "munmap";
 				success = false;
 			}
 		}
+	}
+	
+	// 释放所有缓冲区
+	struct v4l2_requestbuffers req;
+	memset (&req, 0, sizeof(req));
+	req.count               = 0; // 请求0个缓冲区表示释放所有缓冲区
+	req.type                = m_deviceType;
+	req.memory              = V4L2_MEMORY_MMAP;
+	
+	// 向驱动请求释放缓冲区
+	if (-1 == m_sys->ioctl(m_fd, VIDIOC_REQBUFS, &req)) 
+	{
+		LOG_ERRNO(ERROR) << logDevice(m_params.m_devName) << "VIDIOC_REQBUFS";
+		success = false;
+	}
+	
+	// 重置缓冲区计数
+	n_buffers = 0;
+	return success;
+}
+
+/**
+ * @brief 将全部缓冲区入队并启动视频流
+ * 
+ * @return true 启动成功
+ * @return false 入队或启动失败
+ */
+bool V4l2MmapDevice::streamOn()
+{
+	bool success = true;
+
+	// STREAMON后驱动的序列号从0重新开始
+	m_sequenceValid = false;
+
+	// 模拟触发时缓冲区留待触发入队
+	bool queueAll = true;
+	{
+		std::lock_guard<std::mutex> lock(m_triggerMutex);
+		m_freeBuffers.clear();
+		m_pendingTriggers.clear();
+		if (m_triggerMode == TRIGGER_QBUF)
+		{
+			for (unsigned int i = 0; i < n_buffers; ++i)
+			{
+				m_freeBuffers.push_back(i);
+			}
+			queueAll = false;
+		}
+	}
 
-		// 启动视频流
-		int type = m_deviceType;
-		if (-1 == ioctl(m_fd, VIDIOC_STREAMON, &type))
+	// 将所有缓冲区入队，准备接收/发送数据
+	std::chrono::steady_clock::time_point phaseStart = std::chrono::steady_clock::now();
+	for (unsigned int i = 0; queueAll && (i < n_buffers); ++i) 
+	{
+		struct v4l2_buffer buf;
+		struct v4l2_plane planes[VIDEO_MAX_PLANES];
+		this->prepareBuffer(buf, planes);
+		buf.index       = i;
+		if (this->isMultiPlanar()) {
+			buf.length  = m_buffer[i].nplanes;
+		}
+
+		// 将缓冲区放入驱动队列
+		if (-1 == m_sys->ioctl(m_fd, VIDIOC_QBUF, &buf))
 		{
-			perror("VIDIOC_STREAMON");
+			LOG_ERRNO(ERROR) << logDevice(m_params.m_devName) << "VIDIOC_QBUF";
 			success = false;
 		}
 	}
-	return success; 
+
+	m_startupTiming.m_qbuf = elapsedUs(phaseStart);
+
+	// 启动视频流
+	int type = m_deviceType;
+	phaseStart = std::chrono::steady_clock::now();
+	int ret = m_sys->ioctl(m_fd, VIDIOC_STREAMON, &type);
+	m_startupTiming.m_streamon = elapsedUs(phaseStart);
+	if (-1 == ret)
+	{
+		LOG_ERRNO(ERROR) << logDevice(m_params.m_devName) << "VIDIOC_STREAMON";
+		success = false;
+	}
+	else
+	{
+		m_streaming = true;
+	}
+	return success;
 }
 
 /**
  * @brief 停止视频流
  * 
- * 停止设备流，解除内存映射，释放缓冲区
+ * STREAMOFF后驱动队列中的缓冲区全部回到未入队状态，进行中的部分写入随之作废
  * 
  * @return true 停止成功
  * @return false 停止失败
  */
-bool V4l2MmapDevice::stop() 
+bool V4l2MmapDevice::streamOff()
 {
-	LOG(INFO) << "Device " << m_params.m_devName;
-
 	bool success = true;
-	
-	// 停止视频流
+
+	{
+		// STREAMOFF归还全部缓冲区，已发出的触发不会再有帧；
+		// 先清空，避免期间的触发排队缓冲区
+		std::lock_guard<std::mutex> lock(m_triggerMutex);
+		m_freeBuffers.clear();
+		m_pendingTriggers.clear();
+	}
 	int type = m_deviceType;
-	if (-1 == ioctl(m_fd, VIDIOC_STREAMOFF, &type))
+	if (-1 == m_sys->ioctl(m_fd, VIDIOC_STREAMOFF, &type))
 	{
-		perror("VIDIOC_STREAMOFF");      
+		LOG_ERRNO(ERROR) << logDevice(m_params.m_devName) << "VIDIOC_STREAMOFF";
 		success = false;
 	}
+	m_streaming = false;
+	m_partialWriteInProgress = false;
+	return success;
+}
 
-	// 解除所有缓冲区的内存映射
+/**
+ * @brief 新格式的图像大小是否能放入已映射的缓冲区
+ * 
+ * 使用VIDIOC_TRY_FMT查询新格式的sizeimage，不改变设备状态
+ * 
+ * @return true 已映射的每个缓冲区都足够大
+ * @return false 缓冲区不够大或无法查询
+ */
+bool V4l2MmapDevice::fitsBuffers(unsigned int format, unsigned int width, unsigned int height)
+{
+	struct v4l2_format fmt;
+	memset(&fmt, 0, sizeof(fmt));
+	fmt.type = m_deviceType;
+	if (-1 == m_sys->ioctl(m_fd, VIDIOC_G_FMT, &fmt))
+	{
+		return false;
+	}
+	this->setFormatRequest(fmt, format, width, height);
+	if (-1 == m_sys->ioctl(m_fd, VIDIOC_TRY_FMT, &fmt))
+	{
+		return false;
+	}
+
+	bool multiPlanar = this->isMultiPlanar();
+	unsigned int nplanes = multiPlanar ? fmt.fmt.pix_mp.num_planes : 1;
 	for (unsigned int i = 0; i < n_buffers; ++i)
 	{
-		if (-1 == munmap (m_buffer[i].start, m_buffer[i].length))
+		if (m_buffer[i].nplanes != nplanes)
 		{
-			perror("munmap");
-			success = false;
+			return false;
+		}
+		for (unsigned int p = 0; p < nplanes; ++p)
+		{
+			size_t needed = multiPlanar ? fmt.fmt.pix_mp.plane_fmt[p].sizeimage : fmt.fmt.pix.sizeimage;
+			if (m_buffer[i].planes[p].length < needed)
+			{
+				return false;
+			}
 		}
 	}
-	
-	// 释放所有缓冲区
-	struct v4l2_requestbuffers req;
-	memset (&req, 0, sizeof(req));
-	req.count               = 0; // 请求0个缓冲区表示释放所有缓冲区
-	req.type                = m_deviceType;
-	req.memory              = V4L2_MEMORY_MMAP;
-	
-	// 向驱动请求释放缓冲区
-	if (-1 == ioctl(m_fd, VIDIOC_REQBUFS, &req)) 
-	{
-		perror("VIDIOC_REQBUFS");
-		success = false;
-	}
-	
-	// 重置缓冲区计数
-	n_buffers = 0;
-	return success; 
+	return true;
 }
 
 /**
@@ -246,38 +646,33 @@ size_t V4l2MmapDevice::readInternal(char* buffer, size_t bufferSize)
 	if (n_buffers > 0)
 	{
 		struct v4l2_buffer buf;	
-		memset (&buf, 0, sizeof(buf));
-		buf.type = m_deviceType;
-		buf.memory = V4L2_MEMORY_MMAP;
+		struct v4l2_plane planes[VIDEO_MAX_PLANES];
+		this->prepareBuffer(buf, planes);
 
 		// 从队列中取出一个已填充的缓冲区
-		if (-1 == ioctl(m_fd, VIDIOC_DQBUF, &buf)) 
+		m_lastError = 0;
+		if (-1 == m_sys->ioctl(m_fd, VIDIOC_DQBUF, &buf)) 
 		{
+			m_lastError = errno;
 			if (errno == EAGAIN) {
 				// 非阻塞模式下没有数据可读
 				size = 0;
 			} else {
-				perror("VIDIOC_DQBUF");
+				LOG_ERRNO_RATELIMIT(ERROR) << logDevice(m_params.m_devName) << "VIDIOC_DQBUF";
 				size = -1;
 			}
 		}
 		else if (buf.index < n_buffers)
 		{
-			// 获取数据大小，并确保不超出目标缓冲区大小
-			size = buf.bytesused;
-			if (size > bufferSize)
+			size = this->copyBuffer(buf, planes, buffer, bufferSize);
+			if (this->tracksSequence())
 			{
-				size = bufferSize;
-				LOG(WARN) << "Device " << m_params.m_devName << " buffer truncated available:" << bufferSize << " needed:" << buf.bytesused;
+				this->countSequenceGap(buf.sequence);
 			}
-			
-			// 复制数据到目标缓冲区
-			memcpy(buffer, m_buffer[buf.index].start, size);
 
 			// 将处理完的缓冲区重新入队，以便重用
-			if (-1 == ioctl(m_fd, VIDIOC_QBUF, &buf))
+			if (!this->releaseBuffer(buf))
 			{
-				perror("VIDIOC_QBUF");
 				size = -1;
 			}
 		}
@@ -285,6 +680,172 @@ size_t V4l2MmapDevice::readInternal(char* buffer, size_t bufferSize)
 	return size;
 }
 
+/**
+ * @brief 一次取出全部已填充的缓冲区
+ * 
+ * 连续DQBUF直到EAGAIN或取满maxFrames帧，每个缓冲区复制后立即重新入队，
+ * 驱动的空闲缓冲区不会因批量读取而减少。读完后按序列号排序，
+ * 再按顺序由序列号的间隔统计驱动丢弃的帧
+ * 
+ * @return size_t 读取的帧数，0表示无数据，未读到帧就出错时返回-1
+ */
+size_t V4l2MmapDevice::readBatchInternal(char** buffers, size_t bufferSize, V4l2FrameInfo* frames, size_t maxFrames)
+{
+	size_t count = 0;
+	m_lastError = 0;
+	while ((n_buffers > 0) && (count < maxFrames))
+	{
+		struct v4l2_buffer buf;
+		struct v4l2_plane planes[VIDEO_MAX_PLANES];
+		this->prepareBuffer(buf, planes);
+
+		if (-1 == m_sys->ioctl(m_fd, VIDIOC_DQBUF, &buf))
+		{
+			if (errno != EAGAIN)
+			{
+				m_lastError = errno;
+				LOG_ERRNO_RATELIMIT(ERROR) << logDevice(m_params.m_devName) << "VIDIOC_DQBUF";
+			}
+			break;
+		}
+		if (buf.index >= n_buffers)
+		{
+			continue;
+		}
+
+		V4l2FrameInfo& info = frames[count];
+		info = V4l2FrameInfo();
+		info.m_slot        = count;
+		info.m_size        = this->copyBuffer(buf, planes, buffers[count], bufferSize);
+		info.m_sequence    = buf.sequence;
+		info.m_timestampUs = (long long)buf.timestamp.tv_sec * 1000000 + buf.timestamp.tv_usec;
+		info.m_flags       = buf.flags;
+		if (!this->releaseBuffer(buf))
+		{
+			break;
+		}
+		info.m_triggerId   = m_lastTriggerId;
+		++count;
+	}
+
+	// 驱动通常按顺序交付，插入排序在有序时只比较一遍
+	for (size_t i = 1; i < count; ++i)
+	{
+		V4l2FrameInfo info = frames[i];
+		size_t j = i;
+		while ((j > 0) && ((int)(info.m_sequence - frames[j - 1].m_sequence) < 0))
+		{
+			frames[j] = frames[j - 1];
+			--j;
+		}
+		frames[j] = info;
+	}
+	if (this->tracksSequence())
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			frames[i].m_dropped = this->countSequenceGap(frames[i].m_sequence);
+		}
+	}
+
+	if ((count == 0) && (m_lastError != 0))
+	{
+		return -1;
+	}
+	return count;
+}
+
+/**
+ * @brief 复制出队的缓冲区内容
+ * 
+ * 多平面设备的各平面按格式的平面布局（getPlaneOffset）依次存放，不做打包转换
+ * 
+ * @return size_t 复制的字节数
+ */
+size_t V4l2MmapDevice::copyBuffer(const struct v4l2_buffer& buf, const struct v4l2_plane* planes, char* buffer, size_t bufferSize)
+{
+	size_t size = 0;
+	if (this->isMultiPlanar())
+	{
+		for (unsigned int p = 0; (p < buf.length) && (p < m_buffer[buf.index].nplanes); ++p)
+		{
+			size_t offset = (p < m_numPlanes) ? this->getPlaneOffset(p) : size;
+			size_t dataOffset = (planes[p].data_offset < planes[p].bytesused) ? planes[p].data_offset : 0;
+			size_t used = planes[p].bytesused - dataOffset;
+			if (offset + used > bufferSize)
+			{
+				LOG_RATELIMIT(WARN) << "Device " << m_params.m_devName << " plane:" << p << " truncated available:" << bufferSize << " needed:" << offset + used;
+				used = (offset < bufferSize) ? (bufferSize - offset) : 0;
+			}
+			memcpy(buffer + offset, (char*)m_buffer[buf.index].planes[p].start + dataOffset, used);
+			size = offset + used;
+		}
+	}
+	else
+	{
+		// 获取数据大小，并确保不超出目标缓冲区大小
+		size = buf.bytesused;
+		if (size > bufferSize)
+		{
+			size = bufferSize;
+			LOG_RATELIMIT(WARN) << "Device " << m_params.m_devName << " buffer truncated available:" << bufferSize << " needed:" << buf.bytesused;
+		}
+		memcpy(buffer, m_buffer[buf.index].planes[0].start, size);
+	}
+	return size;
+}
+
+/**
+ * @brief 序列号的间隔是否表示丢帧
+ * 
+ * 模拟触发时驱动在没有入队缓冲区的帧周期里照常递增序列号，这些间隔不是丢帧
+ */
+bool V4l2MmapDevice::tracksSequence()
+{
+	std::lock_guard<std::mutex> lock(m_triggerMutex);
+	return (m_triggerMode != TRIGGER_QBUF);
+}
+
+/**
+ * @brief 归还读完的采集缓冲区并记录其触发编号
+ * 
+ * @param buf DQBUF取出的缓冲区
+ * @return true 成功
+ * @return false 重新入队失败
+ */
+bool V4l2MmapDevice::releaseBuffer(struct v4l2_buffer& buf)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_triggerMutex);
+		switch (m_triggerMode)
+		{
+			case TRIGGER_QBUF:
+				m_lastTriggerId = m_bufferTrigger[buf.index];
+				m_freeBuffers.push_back(buf.index);
+				return true;
+			case TRIGGER_CONTROL:
+				m_lastTriggerId = 0;
+				if (!m_pendingTriggers.empty())
+				{
+					m_lastTriggerId = m_pendingTriggers.front();
+					m_pendingTriggers.pop_front();
+				}
+				break;
+			default:
+				m_lastTriggerId = 0;
+				break;
+		}
+	}
+
+	if (-1 == m_sys->ioctl(m_fd, VIDIOC_QBUF, &buf))
+	{
+		m_lastError = errno;
+		LOG_ERRNO_RATELIMIT(ERROR) << logDevice(m_params.m_devName) << "VIDIOC_QBUF";
+		return false;
+	}
+	return true;
+}
+
 /**
  * @brief 向设备写入数据
  * 
@@ -300,34 +861,66 @@ size_t V4l2MmapDevice::writeInternal(char* buffer, size_t bufferSize)
 	if (n_buffers > 0)
 	{
 		struct v4l2_buffer buf;	
-		memset (&buf, 0, sizeof(buf));
-		buf.type = m_deviceType;
-		buf.memory = V4L2_MEMORY_MMAP;
+		struct v4l2_plane planes[VIDEO_MAX_PLANES];
+		this->prepareBuffer(buf, planes);
 
 		// 从队列中取出一个空缓冲区
-		if (-1 == ioctl(m_fd, VIDIOC_DQBUF, &buf)) 
+		m_lastError = 0;
+		if (-1 == m_sys->ioctl(m_fd, VIDIOC_DQBUF, &buf)) 
 		{
-			perror("VIDIOC_DQBUF");
+			m_lastError = errno;
+			LOG_ERRNO_RATELIMIT(ERROR) << logDevice(m_params.m_devName) << "VIDIOC_DQBUF";
 			size = -1;
 		}
+		else if ( (buf.index < n_buffers) && this->isMultiPlanar() )
+		{
+			// 源数据按格式的平面布局拆分到各平面
+			for (unsigned int p = 0; p < m_buffer[buf.index].nplanes; ++p)
+			{
+				size_t offset = (p < m_numPlanes) ? this->getPlaneOffset(p) : size;
+				size_t chunk = (offset < bufferSize) ? (bufferSize - offset) : 0;
+				if ( (p < m_numPlanes) && (p + 1 < m_buffer[buf.index].nplanes) && (chunk > m_planes[p].m_sizeImage) )
+				{
+					chunk = m_planes[p].m_sizeImage;
+				}
+				if (chunk > m_buffer[buf.index].planes[p].length)
+				{
+					LOG_RATELIMIT(WARN) << "Device " << m_params.m_devName << " plane:" << p << " truncated available:" << m_buffer[buf.index].planes[p].length << " needed:" << chunk;
+					chunk = m_buffer[buf.index].planes[p].length;
+				}
+				memcpy(m_buffer[buf.index].planes[p].start, buffer + offset, chunk);
+				planes[p].bytesused = chunk;
+				size += chunk;
+			}
+			buf.length = m_buffer[buf.index].nplanes;
+
+			// 将填充好的缓冲区重新入队，准备发送
+			if (-1 == m_sys->ioctl(m_fd, VIDIOC_QBUF, &buf))
+			{
+				m_lastError = errno;
+				LOG_ERRNO_RATELIMIT(ERROR) << logDevice(m_params.m_devName) << "VIDIOC_QBUF";
+				size = -1;
+			}
+		}
 		else if (buf.index < n_buffers)
 		{
 			// 确定写入大小，确保不超出缓冲区容量
 			size = bufferSize;
 			if (size > buf.length)
 			{
-				LOG(WARN) << "Device " << m_params.m_devName << " buffer truncated available:" << buf.length << " needed:" << size;
+				LOG_RATELIMIT(WARN) << "Device " << m_params.m_devName << " buffer truncated available:" << buf.length << " needed:" << size;
 				size = buf.length;
 			}
 			
 			// 将数据复制到缓冲区
-			memcpy(m_buffer[buf.index].start, buffer, size);
+			memcpy(m_buffer[buf.index].planes[0].start, buffer, size);
 			buf.bytesused = size; // 设置已使用的字节数
 
 			// 将填充好的缓冲区重新入队，准备发送
-			if (-1 == ioctl(m_fd, VIDIOC_QBUF, &buf))
+			if (-1 == m_sys->ioctl(m_fd, VIDIOC_QBUF, &buf))
 			{
-				perror("VIDIOC_QBUF");
+				m_lastError = errno;
+				LOG_ERRNO_RATELIMIT(ERROR) << logDevice(m_params.m_devName) << "VIDIOC_QBUF";
 				size = -1;
 			}
 		}
@@ -352,6 +945,13 @@ bool V4l2MmapDevice::startPartialWrite()
 	// 确保没有其他部分写入操作正在进行
 	if (m_partialWriteInProgress)
 		return false;
+
+	// 部分写入只支持单平面设备
+	if (this->isMultiPlanar())
+	{
+		LOG(WARN) << "Device " << m_params.m_devName << " partial write not supported on multi-planar device";
+		return false;
+	}
 	
 	// 清空部分写入缓冲区信息
 	memset(&m_partialWriteBuf, 0, sizeof(m_partialWriteBuf));
@@ -359,9 +959,15 @@ bool V4l2MmapDevice::startPartialWrite()
 	m_partialWriteBuf.memory = V4L2_MEMORY_MMAP;
 	
 	// 从队列中取出一个空缓冲区
-	if (-1 == ioctl(m_fd, VIDIOC_DQBUF, &m_partialWriteBuf))
+	m_lastError = 0;
+	if (-1 == m_sys->ioctl(m_fd, VIDIOC_DQBUF, &m_partialWriteBuf))
 	{
-		perror("VIDIOC_DQBUF");
+		m_lastError = errno;
+		// 非阻塞输出没有已消费的缓冲区属于背压，不是错误
+		if (m_lastError != EAGAIN)
+		{
+			LOG_ERRNO_RATELIMIT(ERROR) << logDevice(m_params.m_devName) << "VIDIOC_DQBUF";
+		}
 		return false;
 	}
 	
@@ -398,7 +1004,7 @@ size_t V4l2MmapDevice::writePartialInternal(char* buffer, size_t bufferSize)
 			// 确保不超出缓冲区容量
 			if (new_size > m_partialWriteBuf.length)
 			{
-				LOG(WARN) << "Device " << m_params.m_devName << " buffer truncated available:" << m_partialWriteBuf.length << " needed:" << new_size;
+				LOG_RATELIMIT(WARN) << "Device " << m_params.m_devName << " buffer truncated available:" << m_partialWriteBuf.length << " needed:" << new_size;
 				new_size = m_partialWriteBuf.length;
 			}
 			
@@ -406,7 +1012,7 @@ size_t V4l2MmapDevice::writePartialInternal(char* buffer, size_t bufferSize)
 			size = new_size - m_partialWriteBuf.bytesused;
 			
 			// 将数据追加到已有数据之后
-			memcpy(&((char *)m_buffer[m_partialWriteBuf.index].start)[m_partialWriteBuf.bytesused], buffer, size);
+			memcpy(&((char *)m_buffer[m_partialWriteBuf.index].planes[0].start)[m_partialWriteBuf.bytesused], buffer, size);
 
 			// 更新已使用字节计数
 			m_partialWriteBuf.bytesused += size;
@@ -415,6 +1021,28 @@ size_t V4l2MmapDevice::writePartialInternal(char* buffer, size_t bufferSize)
 	return size;
 }
 
+/**
+ * @brief 在已锁定的缓冲区末尾预留一段空间
+ * 
+ * @param size 预留的字节数
+ * @return char* 预留空间的起始地址，失败返回NULL
+ */
+char* V4l2MmapDevice::reservePartialWrite(size_t size)
+{
+	if ((n_buffers == 0) || !m_partialWriteInProgress || (m_partialWriteBuf.index >= n_buffers))
+	{
+		return NULL;
+	}
+	if (size > m_partialWriteBuf.length - m_partialWriteBuf.bytesused)
+	{
+		LOG_RATELIMIT(WARN) << "Device " << m_params.m_devName << " buffer too small available:" << (m_partialWriteBuf.length - m_partialWriteBuf.bytesused) << " needed:" << size;
+		return NULL;
+	}
+	char* start = &((char *)m_buffer[m_partialWriteBuf.index].planes[0].start)[m_partialWriteBuf.bytesused];
+	m_partialWriteBuf.bytesused += size;
+	return start;
+}
+
 /**
  * @brief 结束部分写入操作
  * 
@@ -438,9 +1066,9 @@ bool V4l2MmapDevice::endPartialWrite()
 	}
 	
 	// 将填充好的缓冲区重新入队，准备发送
-	if (-1 == ioctl(m_fd, VIDIOC_QBUF, &m_partialWriteBuf))
+	if (-1 == m_sys->ioctl(m_fd, VIDIOC_QBUF, &m_partialWriteBuf))
 	{
-		perror("VIDIOC_QBUF");
+		LOG_ERRNO_RATELIMIT(ERROR) << logDevice(m_params.m_devName) << "VIDIOC_QBUF";
 		// 强制结束部分写入状态，放弃当前操作
 		m_partialWriteInProgress = false;
 		return true;
@@ -450,3 +1078,22 @@ bool V4l2MmapDevice::endPartialWrite()
 	m_partialWriteInProgress = false;
 	return true;
 }
+
+/**
+ * @brief 初始化v4l2_buffer
+ * 
+ * @param buf 待初始化的缓冲区描述
+ * @param planes 平面数组，多平面设备由驱动填写各平面信息
+ */
+void V4l2MmapDevice::prepareBuffer(struct v4l2_buffer& buf, struct v4l2_plane* planes)
+{
+	memset (&buf, 0, sizeof(buf));
+	buf.type        = m_deviceType;
+	buf.memory      = V4L2_MEMORY_MMAP;
+	if (this->isMultiPlanar())
+	{
+		memset (planes, 0, VIDEO_MAX_PLANES * sizeof(struct v4l2_plane));
+		buf.m.planes = planes;
+		buf.length   = VIDEO_MAX_PLANES;
+	}
+}
@@ -149,6 +149,20 @@ size_t V4l2Output::writePartial(char* buffer, size_t bufferSize)
 	return m_device->writePartialInternal(buffer, bufferSize);
 }
 
+/**
+ * @brief 在已锁定的缓冲区中预留空间
+ * 
+ * 必须在startPartialWrite之后调用，返回的内存在endPartialWrite之前由调用者直接填充，
+ * 省去先在别处生成数据再复制的一步
+ * 
+ * @param size 预留的字节数
+ * @return char* 预留空间的起始地址，设备不支持或空间不足时返回NULL
+ */
+char* V4l2Output::reservePartialWrite(size_t size)
+{
+	return m_device->reservePartialWrite(size);
+}
+
 /**
  * @brief 结束部分写入操作
  * 
@@ -9,6 +9,7 @@
 **
 ** -------------------------------------------------------------------------*/
 
+#include <errno.h>
 #include <unistd.h>
 
 #include "V4l2ReadWriteDevice.h"
@@ -18,11 +19,15 @@ V4l2ReadWriteDevice::V4l2ReadWriteDevice(const V4L2DeviceParameters&  params, v4
 
 
 size_t V4l2ReadWriteDevice::writeInternal(char* buffer, size_t bufferSize) { 
-	return ::write(m_fd, buffer,  bufferSize); 
+	ssize_t size = m_sys->write(m_fd, buffer,  bufferSize);
+	m_lastError = (size == -1) ? errno : 0;
+	return size; 
 }
 
 size_t V4l2ReadWriteDevice::readInternal(char* buffer, size_t bufferSize)  { 
-	return ::read(m_fd, buffer,  bufferSize); 
+	ssize_t size = m_sys->read(m_fd, buffer,  bufferSize);
+	m_lastError = (size == -1) ? errno : 0;
+	return size; 
 }
 		
 	
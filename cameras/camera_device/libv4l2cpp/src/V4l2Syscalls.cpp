@@ -0,0 +1,63 @@
+/* ---------------------------------------------------------------------------
+** This software is in the public domain, furnished "as is", without technical
+** support, and with no warranty, express or implied, as to its usefulness for
+** any purpose.
+**
+** V4l2Syscalls.cpp
+**
+** -------------------------------------------------------------------------*/
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "V4l2Syscalls.h"
+
+int V4l2Syscalls::open(const char* path, int flags, mode_t mode)
+{
+	return ::open(path, flags, mode);
+}
+
+int V4l2Syscalls::close(int fd)
+{
+	return ::close(fd);
+}
+
+int V4l2Syscalls::ioctl(int fd, unsigned long request, void* arg)
+{
+	return ::ioctl(fd, request, arg);
+}
+
+void* V4l2Syscalls::mmap(void* addr, size_t length, int prot, int flags, int fd, off_t offset)
+{
+	return ::mmap(addr, length, prot, flags, fd, offset);
+}
+
+int V4l2Syscalls::munmap(void* addr, size_t length)
+{
+	return ::munmap(addr, length);
+}
+
+ssize_t V4l2Syscalls::read(int fd, void* buf, size_t count)
+{
+	return ::read(fd, buf, count);
+}
+
+ssize_t V4l2Syscalls::write(int fd, const void* buf, size_t count)
+{
+	return ::write(fd, buf, count);
+}
+
+bool V4l2Syscalls::isCharDevice(const char* path)
+{
+	struct stat sb;
+	return (stat(path, &sb) == 0) && ((sb.st_mode & S_IFMT) == S_IFCHR);
+}
+
+V4l2Syscalls* V4l2Syscalls::system()
+{
+	static V4l2Syscalls syscalls;
+	return &syscalls;
+}
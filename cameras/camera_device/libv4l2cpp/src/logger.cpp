@@ -4,11 +4,485 @@
 ** any purpose.
 **
 ** logger.cpp
-** 
+**
 ** -------------------------------------------------------------------------*/
 
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 #include "logger.h"
 
-#ifndef HAVE_LOG4CPP
+// ---------------------------------
+// rate limiter
+// ---------------------------------
+long LogRateLimiter::acquire()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	long long ms = now.tv_sec * 1000LL + now.tv_nsec / 1000000;
+
+	long long start = m_windowStart.load(std::memory_order_relaxed);
+	if ((start == 0) || (ms - start >= LOG_RATELIMIT_INTERVAL_MS))
+	{
+		// the thread that moves the window resets the count
+		if (m_windowStart.compare_exchange_strong(start, ms, std::memory_order_relaxed))
+		{
+			m_count.store(0, std::memory_order_relaxed);
+		}
+	}
+	if (m_count.fetch_add(1, std::memory_order_relaxed) >= LOG_RATELIMIT_BURST)
+	{
+		m_suppressed.fetch_add(1, std::memory_order_relaxed);
+		return -1;
+	}
+	return m_suppressed.exchange(0, std::memory_order_relaxed);
+}
+
+// ---------------------------------
+// thread context
+// ---------------------------------
+static thread_local const char* t_logDevice = NULL;
+static thread_local int t_logCameraId = -1;
+
+LogContext::LogContext(const char* device, int cameraId) : m_previousDevice(t_logDevice), m_previousCameraId(t_logCameraId)
+{
+	t_logDevice = device;
+	t_logCameraId = cameraId;
+}
+
+LogContext::~LogContext()
+{
+	t_logDevice = m_previousDevice;
+	t_logCameraId = m_previousCameraId;
+}
+
+const char* LogContext::device()
+{
+	return t_logDevice;
+}
+
+int LogContext::cameraId()
+{
+	return t_logCameraId;
+}
+
+#ifdef HAVE_LOG4CPP
+
+std::ostream& operator<<(std::ostream& os, const LogField& field)
+{
+	if (field.m_kind == LogField::DEVICE)
+	{
+		os << "dev=" << (field.m_text ? field.m_text : "") << " ";
+	}
+	else
+	{
+		os << "cam=" << field.m_value << " ";
+	}
+	return os;
+}
+
+#else
+
 int LogLevel=NOTICE;
+
+#ifndef LOG_RING_SIZE
+#define LOG_RING_SIZE 256
+#endif
+#ifndef LOG_FLUSH_INTERVAL_MS
+#define LOG_FLUSH_INTERVAL_MS 50
+#endif
+
+// ---------------------------------
+// log record, filled in place by LogMessage
+// ---------------------------------
+struct LogRecord
+{
+	struct timespec m_time;
+	const char* m_file;         // __FILENAME__, static storage
+	int m_line;
+	int m_level;
+	int m_errno;                // -1: no errno attached
+	long m_suppressed;          // messages suppressed by the rate limiter before this one
+	int m_cameraId;             // -1: unknown
+	char m_device[32];
+	unsigned int m_length;
+	char m_text[384];
+};
+
+// ---------------------------------
+// single producer / single consumer ring owned by one thread
+// ---------------------------------
+struct LogRing
+{
+	LogRing() : m_head(0), m_tail(0), m_dropped(0), m_closed(false), m_busy(false) {}
+
+	LogRecord m_records[LOG_RING_SIZE];
+	std::atomic<unsigned int> m_head;       // next record to write out, advanced by the flusher
+	std::atomic<unsigned int> m_tail;       // next free record, advanced by the owning thread
+	std::atomic<unsigned long> m_dropped;   // messages dropped because the ring was full
+	std::atomic<bool> m_closed;             // owning thread exited, freed by the flusher once empty
+	bool m_busy;                            // a message is being formatted (owning thread only)
+};
+
+// ---------------------------------
+// backend: registers the per-thread rings, a background thread writes them to stdout in time order
+// ---------------------------------
+class LogBackend
+{
+	public:
+		static LogBackend& instance();
+
+		LogRing* attach();
+		void notify();
+		void flush();
+		void shutdown();
+		bool isStopped() { return m_stopped.load(std::memory_order_acquire); }
+
+	private:
+		LogBackend();
+
+		void run();
+		void drain();
+		static size_t format(const LogRecord& record, char* line, size_t size);
+
+		std::mutex m_mutex;                     // protects m_rings and m_stop
+		std::condition_variable m_cv;
+		std::vector<LogRing*> m_rings;
+		std::atomic<bool> m_pending;            // a producer asked for an early flush
+		std::atomic<bool> m_stopped;
+		bool m_stop;
+		std::thread m_thread;
+		std::mutex m_writeMutex;                // serializes drain() between the flusher and flush()
+		std::string m_output;
+		std::vector<LogRecord*> m_batch;
+};
+
+static void shutdownLogger()
+{
+	LogBackend::instance().shutdown();
+}
+
+LogBackend& LogBackend::instance()
+{
+	// never destroyed: threads may still log while static objects are being destroyed
+	static LogBackend* backend = new LogBackend();
+	return *backend;
+}
+
+LogBackend::LogBackend() : m_pending(false), m_stopped(false), m_stop(false)
+{
+	m_thread = std::thread(&LogBackend::run, this);
+	atexit(shutdownLogger);
+}
+
+LogRing* LogBackend::attach()
+{
+	LogRing* ring = new LogRing();
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_rings.push_back(ring);
+	return ring;
+}
+
+void LogBackend::notify()
+{
+	if (!m_pending.exchange(true))
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_cv.notify_one();
+	}
+}
+
+void LogBackend::flush()
+{
+	this->drain();
+}
+
+void LogBackend::shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_stop)
+		{
+			return;
+		}
+		m_stop = true;
+		m_cv.notify_one();
+	}
+	if (m_thread.joinable())
+	{
+		m_thread.join();
+	}
+	// from now on messages are written synchronously
+	m_stopped.store(true, std::memory_order_release);
+	this->drain();
+}
+
+void LogBackend::run()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (!m_stop)
+	{
+		m_cv.wait_for(lock, std::chrono::milliseconds(LOG_FLUSH_INTERVAL_MS), [this]() { return m_stop || m_pending.load(); });
+		m_pending.store(false);
+		lock.unlock();
+		this->drain();
+		lock.lock();
+	}
+}
+
+// write out every committed record of every ring, oldest first
+void LogBackend::drain()
+{
+	std::lock_guard<std::mutex> writeLock(m_writeMutex);
+
+	std::vector<LogRing*> rings;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		rings = m_rings;
+	}
+
+	m_batch.clear();
+	std::vector<unsigned int> tails(rings.size());
+	unsigned long dropped = 0;
+	for (size_t i = 0; i < rings.size(); ++i)
+	{
+		LogRing* ring = rings[i];
+		unsigned int head = ring->m_head.load(std::memory_order_relaxed);
+		tails[i] = ring->m_tail.load(std::memory_order_acquire);
+		for (unsigned int index = head; index != tails[i]; ++index)
+		{
+			m_batch.push_back(&ring->m_records[index % LOG_RING_SIZE]);
+		}
+		dropped += ring->m_dropped.exchange(0, std::memory_order_relaxed);
+	}
+
+	std::stable_sort(m_batch.begin(), m_batch.end(), [](const LogRecord* a, const LogRecord* b) {
+		return (a->m_time.tv_sec != b->m_time.tv_sec) ? (a->m_time.tv_sec < b->m_time.tv_sec) : (a->m_time.tv_nsec < b->m_time.tv_nsec);
+	});
+
+	m_output.clear();
+	char line[640];
+	for (size_t i = 0; i < m_batch.size(); ++i)
+	{
+		m_output.append(line, format(*m_batch[i], line, sizeof(line)));
+	}
+	if (dropped > 0)
+	{
+		int length = snprintf(line, sizeof(line), "%-8s %-30s\t%lu log messages dropped\n", "[WARN]", "(logger.cpp)", dropped);
+		m_output.append(line, std::min<size_t>(length, sizeof(line) - 1));
+	}
+
+	// release the records only once they are formatted
+	for (size_t i = 0; i < rings.size(); ++i)
+	{
+		rings[i]->m_head.store(tails[i], std::memory_order_release);
+	}
+
+	if (!m_output.empty())
+	{
+		fwrite(m_output.data(), 1, m_output.size(), stdout);
+		fflush(stdout);
+	}
+
+	// free the rings of exited threads
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (std::vector<LogRing*>::iterator it = m_rings.begin(); it != m_rings.end(); )
+	{
+		LogRing* ring = *it;
+		if (ring->m_closed.load(std::memory_order_acquire) && (ring->m_head.load() == ring->m_tail.load(std::memory_order_acquire)))
+		{
+			delete ring;
+			it = m_rings.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
+
+static const char* levelName(int level)
+{
+	if (level <= FATAL)  return "[FATAL]";
+	if (level <= ALERT)  return "[ALERT]";
+	if (level <= CRIT)   return "[CRIT]";
+	if (level <= ERROR)  return "[ERROR]";
+	if (level <= WARN)   return "[WARN]";
+	if (level <= NOTICE) return "[NOTICE]";
+	if (level <= INFO)   return "[INFO]";
+	return "[DEBUG]";
+}
+
+size_t LogBackend::format(const LogRecord& record, char* line, size_t size)
+{
+	struct tm tm;
+	localtime_r(&record.m_time.tv_sec, &tm);
+	char location[64];
+	snprintf(location, sizeof(location), "(%s:%d)", record.m_file, record.m_line);
+
+	size_t length = 0;
+	int ret = snprintf(line, size, "%02d:%02d:%02d.%06ld %-8s %-30s\t%.*s",
+		tm.tm_hour, tm.tm_min, tm.tm_sec, record.m_time.tv_nsec / 1000,
+		levelName(record.m_level), location, (int)record.m_length, record.m_text);
+	length = std::min<size_t>(ret, size - 1);
+
+	if ((record.m_device[0] != 0) && (length < size))
+	{
+		ret = snprintf(line + length, size - length, " dev=%s", record.m_device);
+		length = std::min<size_t>(length + ret, size - 1);
+	}
+	if ((record.m_cameraId >= 0) && (length < size))
+	{
+		ret = snprintf(line + length, size - length, " cam=%d", record.m_cameraId);
+		length = std::min<size_t>(length + ret, size - 1);
+	}
+	if ((record.m_errno >= 0) && (length < size))
+	{
+		ret = snprintf(line + length, size - length, " errno=%d(%s)", record.m_errno, strerror(record.m_errno));
+		length = std::min<size_t>(length + ret, size - 1);
+	}
+	if ((record.m_suppressed > 0) && (length < size))
+	{
+		ret = snprintf(line + length, size - length, " suppressed=%ld", record.m_suppressed);
+		length = std::min<size_t>(length + ret, size - 1);
+	}
+	if (length >= size - 1)
+	{
+		length = size - 2;
+	}
+	line[length++] = '\n';
+	return length;
+}
+
+// ---------------------------------
+// ring of the calling thread, closed when the thread exits
+// ---------------------------------
+struct LogRingOwner
+{
+	LogRingOwner() : m_ring(NULL) {}
+	~LogRingOwner()
+	{
+		if (m_ring)
+		{
+			m_ring->m_closed.store(true, std::memory_order_release);
+			LogBackend::instance().notify();
+		}
+	}
+
+	LogRing* get()
+	{
+		if (m_ring == NULL)
+		{
+			m_ring = LogBackend::instance().attach();
+		}
+		return m_ring;
+	}
+
+	LogRing* m_ring;
+};
+
+static thread_local LogRingOwner t_logRing;
+
+// ---------------------------------
+// log message
+// ---------------------------------
+LogMessage::LogMessage(int level, const char* file, int line, int error, long suppressed) : m_stream(&m_buf)
+{
+	LogRing* ring = t_logRing.get();
+	unsigned int tail = ring->m_tail.load(std::memory_order_relaxed);
+	unsigned int head = ring->m_head.load(std::memory_order_acquire);
+	if (ring->m_busy || (tail - head >= LOG_RING_SIZE))
+	{
+		// full (or a message logged while formatting another): drop rather than block
+		ring->m_dropped.fetch_add(1, std::memory_order_relaxed);
+		LogBackend::instance().notify();
+		m_stream.setstate(std::ios::badbit);
+		return;
+	}
+	ring->m_busy = true;
+
+	LogRecord* record = &ring->m_records[tail % LOG_RING_SIZE];
+	clock_gettime(CLOCK_REALTIME, &record->m_time);
+	record->m_file = file;
+	record->m_line = line;
+	record->m_level = level;
+	record->m_errno = error;
+	record->m_suppressed = suppressed;
+	record->m_cameraId = LogContext::cameraId();
+	const char* device = LogContext::device();
+	strncpy(record->m_device, device ? device : "", sizeof(record->m_device) - 1);
+	record->m_device[sizeof(record->m_device) - 1] = 0;
+	m_buf.m_record = record;
+	m_buf.setBuffer(record->m_text, sizeof(record->m_text));
+}
+
+LogMessage::~LogMessage()
+{
+	LogRecord* record = m_buf.m_record;
+	if (record == NULL)
+	{
+		return;
+	}
+	record->m_length = m_buf.length();
+
+	LogRing* ring = t_logRing.get();
+	ring->m_busy = false;
+	unsigned int tail = ring->m_tail.load(std::memory_order_relaxed) + 1;
+	ring->m_tail.store(tail, std::memory_order_release);
+
+	LogBackend& backend = LogBackend::instance();
+	if (backend.isStopped())
+	{
+		backend.flush();
+	}
+	else if (tail - ring->m_head.load(std::memory_order_relaxed) >= LOG_RING_SIZE / 2)
+	{
+		backend.notify();
+	}
+}
+
+std::ostream& operator<<(std::ostream& os, const LogField& field)
+{
+	LogStreamBuf* buf = dynamic_cast<LogStreamBuf*>(os.rdbuf());
+	LogRecord* record = buf ? buf->m_record : NULL;
+	if (record == NULL)
+	{
+		if (buf == NULL)
+		{
+			if (field.m_kind == LogField::DEVICE)
+			{
+				os << "dev=" << (field.m_text ? field.m_text : "") << " ";
+			}
+			else
+			{
+				os << "cam=" << field.m_value << " ";
+			}
+		}
+		return os;
+	}
+
+	if (field.m_kind == LogField::DEVICE)
+	{
+		strncpy(record->m_device, field.m_text ? field.m_text : "", sizeof(record->m_device) - 1);
+		record->m_device[sizeof(record->m_device) - 1] = 0;
+	}
+	else
+	{
+		record->m_cameraId = field.m_value;
+	}
+	return os;
+}
+
+void flushLogger()
+{
+	LogBackend::instance().flush();
+}
+
 #endif
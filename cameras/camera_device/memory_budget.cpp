@@ -0,0 +1,304 @@
+#include "memory_budget.hpp"
+
+#include <algorithm>
+
+namespace {
+
+// 一次性动作每次越过高水位执行一次，其余动作持续到回落至低水位
+bool is_one_shot(shed_action action)
+{
+    return action == shed_action::drop_oldest_incomplete_groups;
+}
+
+size_t index_of(memory_consumer consumer)
+{
+    return static_cast<size_t>(consumer);
+}
+
+size_t index_of(shed_action action)
+{
+    return static_cast<size_t>(action);
+}
+
+} // namespace
+
+/**
+ * @brief 构造函数
+ */
+memory_budget::memory_budget(const memory_budget_config& config)
+    : _config(config),
+      _high_bytes(static_cast<size_t>(config.limit_bytes * config.high_watermark)),
+      _low_bytes(static_cast<size_t>(config.limit_bytes * config.low_watermark)),
+      _used(0),
+      _peak(0),
+      _shedding(false),
+      _above_high(false),
+      _high_events(0),
+      _low_events(0),
+      _rejected(0),
+      _recheck(false),
+      _next_handler_id(0)
+{
+    if (_low_bytes > _high_bytes) {
+        _low_bytes = _high_bytes;
+    }
+    for (auto& used : _used_by) {
+        used.store(0, std::memory_order_relaxed);
+    }
+    for (auto& engaged : _engaged) {
+        engaged.store(false, std::memory_order_relaxed);
+    }
+    for (auto& events : _shed_events) {
+        events.store(0, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief 申请内存额度
+ */
+bool memory_budget::try_reserve(size_t bytes, memory_consumer consumer)
+{
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        size_t used = _used.load(std::memory_order_relaxed);
+        bool reserved = false;
+        while (used + bytes <= _config.limit_bytes) {
+            if (_used.compare_exchange_weak(used, used + bytes, std::memory_order_relaxed)) {
+                reserved = true;
+                break;
+            }
+        }
+
+        if (reserved) {
+            _used_by[index_of(consumer)].fetch_add(bytes, std::memory_order_relaxed);
+
+            size_t peak = _peak.load(std::memory_order_relaxed);
+            while (used + bytes > peak &&
+                   !_peak.compare_exchange_weak(peak, used + bytes, std::memory_order_relaxed)) {
+            }
+
+            if (used + bytes >= _high_bytes) {
+                check_watermarks();
+            }
+            return true;
+        }
+
+        // 超出上限，先执行削减动作再重试
+        if (attempt == 0) {
+            check_watermarks(true);
+        }
+    }
+
+    _rejected.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+/**
+ * @brief 归还内存额度
+ */
+void memory_budget::release(size_t bytes, memory_consumer consumer)
+{
+    _used_by[index_of(consumer)].fetch_sub(bytes, std::memory_order_relaxed);
+    size_t used = _used.fetch_sub(bytes, std::memory_order_relaxed) - bytes;
+
+    if ((_shedding.load(std::memory_order_relaxed) && used <= _low_bytes) ||
+        (_above_high.load(std::memory_order_relaxed) && used < _high_bytes)) {
+        check_watermarks();
+    }
+}
+
+/**
+ * @brief 注册削减动作回调
+ */
+int memory_budget::add_shed_handler(shed_action action, shed_handler handler)
+{
+    std::lock_guard<std::mutex> lock(_handler_mutex);
+    int id = _next_handler_id++;
+    auto entry = std::make_shared<handler_entry>();
+    entry->id = id;
+    entry->action = action;
+    entry->handler = std::move(handler);
+    _handlers.push_back(std::move(entry));
+    return id;
+}
+
+/**
+ * @brief 注销削减动作回调
+ */
+void memory_budget::remove_shed_handler(int handler_id)
+{
+    std::unique_lock<std::mutex> lock(_handler_mutex);
+    auto it = std::find_if(_handlers.begin(), _handlers.end(),
+                           [handler_id](const std::shared_ptr<handler_entry>& entry) {
+                               return entry->id == handler_id;
+                           });
+    if (it == _handlers.end()) {
+        return;
+    }
+
+    std::shared_ptr<handler_entry> entry = *it;
+    entry->removed = true;
+    _handlers.erase(it);
+
+    // 回调可能捕获了持有者的this，等其他线程上的调用结束后再返回
+    std::thread::id self = std::this_thread::get_id();
+    _handler_cv.wait(lock, [&entry, self]() {
+        return std::all_of(entry->callers.begin(), entry->callers.end(),
+                           [self](std::thread::id caller) { return caller == self; });
+    });
+}
+
+/**
+ * @brief 持续性削减动作当前是否生效
+ */
+bool memory_budget::is_engaged(shed_action action) const
+{
+    return _engaged[index_of(action)].load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief 获取统计信息快照
+ */
+memory_budget_stats memory_budget::stats() const
+{
+    memory_budget_stats stats;
+    stats.used_bytes = _used.load(std::memory_order_relaxed);
+    stats.peak_bytes = _peak.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < index_of(memory_consumer::count); ++i) {
+        stats.used_by[i] = _used_by[i].load(std::memory_order_relaxed);
+    }
+    stats.high_watermark_events = _high_events.load(std::memory_order_relaxed);
+    stats.low_watermark_events = _low_events.load(std::memory_order_relaxed);
+    stats.rejected_reservations = _rejected.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < index_of(shed_action::count); ++i) {
+        stats.shed_events[i] = _shed_events[i].load(std::memory_order_relaxed);
+    }
+    return stats;
+}
+
+/**
+ * @brief 检查水位并执行或解除削减动作
+ *
+ * 削减回调中释放内存会再次进入此函数，其他线程也可能同时检查。拿不到锁时只置位_recheck，
+ * 由持有者释放锁后重新检查，保证回落到低水位时的解除不会被跳过
+ *
+ * @param pressure true表示申请因超出上限失败，无论当前水位都执行削减动作
+ */
+void memory_budget::check_watermarks(bool pressure)
+{
+    _recheck.store(true);
+    while (_recheck.load()) {
+        std::unique_lock<std::mutex> lock(_watermark_mutex, std::try_to_lock);
+        if (!lock.owns_lock()) {
+            return;
+        }
+        _recheck.store(false);
+        update_watermarks(pressure);
+        pressure = false;
+    }
+}
+
+/**
+ * @brief 按当前使用量切换削减状态，调用方持有_watermark_mutex
+ *
+ * @param pressure true表示申请因超出上限失败
+ */
+void memory_budget::update_watermarks(bool pressure)
+{
+    size_t used = _used.load(std::memory_order_relaxed);
+    if (used >= _high_bytes || pressure) {
+        if (!_shedding.exchange(true, std::memory_order_relaxed)) {
+            _high_events.fetch_add(1, std::memory_order_relaxed);
+        }
+        // 一次性动作只在越过高水位时执行一次，使用量仍在高水位之上时不再重复执行
+        bool crossed = !_above_high.exchange(true, std::memory_order_relaxed);
+        run_shed_actions(true, crossed);
+    }
+
+    used = _used.load(std::memory_order_relaxed);
+    if (used < _high_bytes) {
+        _above_high.store(false, std::memory_order_relaxed);
+    }
+
+    if (!pressure && _shedding.load(std::memory_order_relaxed) && used <= _low_bytes) {
+        _shedding.store(false, std::memory_order_relaxed);
+        _low_events.fetch_add(1, std::memory_order_relaxed);
+        run_shed_actions(false, false);
+    }
+}
+
+/**
+ * @brief 按配置顺序执行或解除削减动作
+ *
+ * @param engaged true表示执行，false表示解除持续性动作
+ * @param crossed true表示本次刚越过高水位，一次性动作只在此时执行
+ */
+void memory_budget::run_shed_actions(bool engaged, bool crossed)
+{
+    std::vector<std::shared_ptr<handler_entry>> handlers;
+    {
+        std::lock_guard<std::mutex> lock(_handler_mutex);
+        handlers = _handlers;
+    }
+
+    for (shed_action action : _config.shed_actions) {
+        size_t index = index_of(action);
+
+        if (engaged) {
+            if (is_one_shot(action) && !crossed) {
+                continue;
+            }
+            // 一次性动作释放内存后若已回落到高水位以下，不再继续执行后续动作
+            if (!is_one_shot(action) &&
+                (_engaged[index].load(std::memory_order_relaxed) ||
+                 _used.load(std::memory_order_relaxed) < _high_bytes)) {
+                continue;
+            }
+            if (!is_one_shot(action)) {
+                _engaged[index].store(true, std::memory_order_relaxed);
+            }
+        } else {
+            if (is_one_shot(action) || !_engaged[index].exchange(false, std::memory_order_relaxed)) {
+                continue;
+            }
+        }
+
+        bool handled = false;
+        for (auto& entry : handlers) {
+            if (entry->action == action && call_handler(*entry, action, engaged)) {
+                handled = true;
+            }
+        }
+        if (engaged && handled) {
+            _shed_events[index].fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+/**
+ * @brief 调用单个削减动作回调
+ *
+ * 调用期间登记当前线程，remove_shed_handler据此等待调用结束
+ *
+ * @return true 已调用
+ * @return false 回调已注销
+ */
+bool memory_budget::call_handler(handler_entry& entry, shed_action action, bool engaged)
+{
+    std::thread::id self = std::this_thread::get_id();
+    {
+        std::lock_guard<std::mutex> lock(_handler_mutex);
+        if (entry.removed) {
+            return false;
+        }
+        entry.callers.push_back(self);
+    }
+
+    entry.handler(action, engaged);
+
+    {
+        std::lock_guard<std::mutex> lock(_handler_mutex);
+        entry.callers.erase(std::find(entry.callers.begin(), entry.callers.end(), self));
+    }
+    _handler_cv.notify_all();
+    return true;
+}
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief 内存使用方类别
+ *
+ * 采集管线中占用预算的各类队列和缓冲池
+ */
+enum class memory_consumer {
+    frame_pool = 0,      // 摄像头帧缓冲池
+    sync_queue,          // 同步帧组队列
+    recorder_queue,      // 录制队列（运动触发的预录队列）
+    count
+};
+
+/**
+ * @brief 超过高水位时可执行的削减动作
+ */
+enum class shed_action {
+    drop_oldest_incomplete_groups = 0,   // 丢弃最早的未完成帧组（一次性释放），由sync_capture_manager处理
+    reduce_preview_resolution,           // 降低预览分辨率（持续到回落至低水位），由preview_pyramid_pool处理
+    pause_recorders,                     // 暂停录制（持续到回落至低水位），由motion_trigger和帧组历史处理
+    count
+};
+
+/**
+ * @brief 内存预算配置
+ */
+struct memory_budget_config {
+    size_t limit_bytes = 256u * 1024u * 1024u;   // 预算上限（字节）
+    double high_watermark = 0.85;                // 高水位（占上限的比例）
+    double low_watermark = 0.65;                 // 低水位（占上限的比例）
+
+    // 超过高水位时依次执行的动作
+    std::vector<shed_action> shed_actions = {
+        shed_action::drop_oldest_incomplete_groups,
+        shed_action::reduce_preview_resolution,
+        shed_action::pause_recorders,
+    };
+};
+
+/**
+ * @brief 内存预算统计
+ */
+struct memory_budget_stats {
+    size_t used_bytes = 0;                       // 当前使用量
+    size_t peak_bytes = 0;                       // 峰值使用量
+    size_t used_by[static_cast<size_t>(memory_consumer::count)] = {};  // 各类别使用量
+    uint64_t high_watermark_events = 0;          // 越过高水位次数
+    uint64_t low_watermark_events = 0;           // 回落至低水位次数
+    uint64_t rejected_reservations = 0;          // 被拒绝的申请次数
+    uint64_t shed_events[static_cast<size_t>(shed_action::count)] = {};  // 各削减动作执行次数
+};
+
+/**
+ * @brief 全局内存预算
+ *
+ * 由帧缓冲池、同步队列和录制队列共享。所有使用方在分配内存前申请额度，
+ * 超过上限的申请被拒绝；使用量越过高水位时按配置顺序执行削减动作，
+ * 回落到低水位以下时解除持续性的削减动作。
+ */
+class memory_budget {
+public:
+    /**
+     * @brief 削减动作回调
+     *
+     * @param action 削减动作
+     * @param engaged true表示开始执行，false表示解除（仅对持续性动作）
+     */
+    using shed_handler = std::function<void(shed_action action, bool engaged)>;
+
+    /**
+     * @brief 构造函数
+     *
+     * @param config 预算配置
+     */
+    explicit memory_budget(const memory_budget_config& config = memory_budget_config());
+
+    // 预算被多个模块共享，禁止拷贝
+    memory_budget(const memory_budget&) = delete;
+    memory_budget& operator=(const memory_budget&) = delete;
+
+    /**
+     * @brief 申请内存额度
+     *
+     * 超过上限时先执行削减动作再重试一次
+     *
+     * @param bytes 申请的字节数
+     * @param consumer 使用方类别
+     * @return true 申请成功
+     * @return false 超出预算
+     */
+    bool try_reserve(size_t bytes, memory_consumer consumer);
+
+    /**
+     * @brief 归还内存额度
+     *
+     * @param bytes 归还的字节数
+     * @param consumer 使用方类别
+     */
+    void release(size_t bytes, memory_consumer consumer);
+
+    /**
+     * @brief 注册削减动作回调
+     *
+     * @param action 处理的削减动作
+     * @param handler 回调函数
+     * @return int 回调ID，用于注销
+     */
+    int add_shed_handler(shed_action action, shed_handler handler);
+
+    /**
+     * @brief 注销削减动作回调
+     *
+     * 等待其他线程上正在执行的该回调返回，返回后回调不会再被调用，
+     * 持有者可以安全析构。在回调内部注销自身时不等待本次调用
+     *
+     * @param handler_id add_shed_handler返回的回调ID
+     */
+    void remove_shed_handler(int handler_id);
+
+    /**
+     * @brief 持续性削减动作当前是否生效
+     */
+    bool is_engaged(shed_action action) const;
+
+    /**
+     * @brief 是否处于高水位之上的削减状态
+     */
+    bool is_shedding() const { return _shedding.load(std::memory_order_relaxed); }
+
+    size_t limit() const { return _config.limit_bytes; }
+    size_t used() const { return _used.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 获取统计信息快照
+     */
+    memory_budget_stats stats() const;
+
+private:
+    void check_watermarks(bool pressure = false);
+    void update_watermarks(bool pressure);
+    void run_shed_actions(bool engaged, bool crossed);
+
+    memory_budget_config _config;                 // 预算配置
+    size_t _high_bytes;                           // 高水位（字节）
+    size_t _low_bytes;                            // 低水位（字节）
+
+    std::atomic<size_t> _used;                    // 当前使用量
+    std::atomic<size_t> _peak;                    // 峰值使用量
+    std::atomic<size_t> _used_by[static_cast<size_t>(memory_consumer::count)];
+    std::atomic<bool> _shedding;                  // 是否处于削减状态
+    std::atomic<bool> _above_high;                // 使用量是否在高水位之上，回落后才允许再次执行一次性动作
+    std::atomic<bool> _engaged[static_cast<size_t>(shed_action::count)];
+
+    std::atomic<uint64_t> _high_events;           // 越过高水位次数
+    std::atomic<uint64_t> _low_events;            // 回落至低水位次数
+    std::atomic<uint64_t> _rejected;              // 被拒绝的申请次数
+    std::atomic<uint64_t> _shed_events[static_cast<size_t>(shed_action::count)];
+
+    std::mutex _watermark_mutex;                  // 水位检查互斥锁
+    std::atomic<bool> _recheck;                   // 水位检查被占用时置位，由持有者释放锁后重新检查
+    /**
+     * @brief 已注册的削减动作回调
+     */
+    struct handler_entry {
+        int id;
+        shed_action action;
+        shed_handler handler;
+        bool removed = false;                     // 已注销，不再调用
+        std::vector<std::thread::id> callers;     // 正在执行该回调的线程
+    };
+
+    bool call_handler(handler_entry& entry, shed_action action, bool engaged);
+
+    mutable std::mutex _handler_mutex;            // 回调列表互斥锁
+    std::condition_variable _handler_cv;          // 回调执行结束通知
+    std::vector<std::shared_ptr<handler_entry>> _handlers;  // 削减动作回调
+    int _next_handler_id;                         // 下一个回调ID
+};
@@ -0,0 +1,448 @@
+#include "motion_detector.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <linux/videodev2.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "pixel_pipeline.hpp"
+#include "preview_pyramid.hpp"
+
+namespace {
+
+template <uint32_t FourCC>
+bool locate(const buffer& frame, const uint8_t** planes, size_t* strides)
+{
+    return pixel::locate_planes<pixel::format_traits<FourCC>>(frame, frame.width(), frame.height(), planes, strides);
+}
+
+/**
+ * @brief 降采样倍数对应的预览金字塔级别，不是2的1~3次幂时返回0
+ */
+size_t pyramid_level(uint32_t downsample)
+{
+    for (size_t level = 1; level <= preview_pyramid::max_levels; ++level) {
+        if (downsample == (1u << level)) {
+            return level;
+        }
+    }
+    return 0;
+}
+
+// 预录队列每个元素计入预算的字节数：帧数据已由帧缓冲池计入，这里只计队列自身保存的引用
+constexpr size_t ring_entry_bytes = sizeof(std::shared_ptr<buffer>);
+
+} // namespace
+
+/**
+ * @brief 计算两块图像的绝对差之和（SAD）
+ */
+uint32_t block_sad(const uint8_t* a, const uint8_t* b, size_t stride, size_t width, size_t height)
+{
+#if defined(__SSE2__)
+    __m128i acc = _mm_setzero_si128();
+    for (size_t y = 0; y < height; ++y) {
+        const uint8_t* ra = a + y * stride;
+        const uint8_t* rb = b + y * stride;
+        for (size_t x = 0; x < width; x += 16) {
+            __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ra + x));
+            __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rb + x));
+            acc = _mm_add_epi64(acc, _mm_sad_epu8(va, vb));
+        }
+    }
+    return static_cast<uint32_t>(_mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_srli_si128(acc, 8)));
+#elif defined(__ARM_NEON)
+    uint32x4_t acc = vdupq_n_u32(0);
+    for (size_t y = 0; y < height; ++y) {
+        const uint8_t* ra = a + y * stride;
+        const uint8_t* rb = b + y * stride;
+        for (size_t x = 0; x < width; x += 16) {
+            uint8x16_t diff = vabdq_u8(vld1q_u8(ra + x), vld1q_u8(rb + x));
+            acc = vpadalq_u16(acc, vpaddlq_u8(diff));
+        }
+    }
+    uint64x2_t sum = vpaddlq_u32(acc);
+    return static_cast<uint32_t>(vgetq_lane_u64(sum, 0) + vgetq_lane_u64(sum, 1));
+#else
+    uint32_t sum = 0;
+    for (size_t y = 0; y < height; ++y) {
+        const uint8_t* ra = a + y * stride;
+        const uint8_t* rb = b + y * stride;
+        for (size_t x = 0; x < width; ++x) {
+            int d = static_cast<int>(ra[x]) - static_cast<int>(rb[x]);
+            sum += static_cast<uint32_t>(d < 0 ? -d : d);
+        }
+    }
+    return sum;
+#endif
+}
+
+/**
+ * @brief 构造函数
+ */
+motion_detector::motion_detector(const motion_config& config)
+    : _config(config),
+      _width(0),
+      _height(0),
+      _stride(0),
+      _rows(0),
+      _has_reference(false),
+      _active(false),
+      _motion_count(0),
+      _still_count(0)
+{
+    _config.downsample = std::max<uint32_t>(_config.downsample, 1);
+    _config.block_size = std::max<uint32_t>((_config.block_size + 15) / 16 * 16, 16);
+}
+
+/**
+ * @brief 检测一帧
+ */
+motion_result motion_detector::update(const buffer& frame)
+{
+    motion_result result;
+    auto start = std::chrono::steady_clock::now();
+
+    if (!extract_luma(frame)) {
+        result.active = _active;
+        return result;
+    }
+
+    // 尺寸变化时extract_luma已丢弃参考帧
+    if (_has_reference) {
+        // 逐块比较，块内平均每像素差超过阈值时记为变化块
+        size_t block = _config.block_size;
+        uint32_t limit = _config.block_threshold * static_cast<uint32_t>(block * block);
+        size_t columns = _stride / block;
+        size_t rows = _rows / block;
+        for (size_t by = 0; by < rows; ++by) {
+            size_t offset = by * block * _stride;
+            for (size_t bx = 0; bx < columns; ++bx, offset += block) {
+                if (block_sad(_current.data() + offset, _reference.data() + offset, _stride, block, block) > limit) {
+                    ++result.changed_blocks;
+                }
+            }
+        }
+        result.changed_ratio = static_cast<double>(result.changed_blocks) / (columns * rows);
+        result.valid = true;
+    }
+    _current.swap(_reference);
+    _has_reference = true;
+
+    ++_stats.frames;
+    if (result.valid) {
+        // 双阈值加连续帧数的滞回
+        if (result.changed_ratio >= _config.trigger_ratio) {
+            ++_motion_count;
+            _still_count = 0;
+        } else if (result.changed_ratio < _config.release_ratio) {
+            ++_still_count;
+            _motion_count = 0;
+        }
+
+        if (!_active && _motion_count >= std::max<uint32_t>(_config.trigger_frames, 1)) {
+            _active = true;
+            result.started = true;
+            ++_stats.events;
+        } else if (_active && _still_count >= std::max<uint32_t>(_config.release_frames, 1)) {
+            _active = false;
+            result.ended = true;
+        }
+    }
+    if (_active) {
+        ++_stats.motion_frames;
+    }
+    result.active = _active;
+
+    _stats.analyse_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+/**
+ * @brief 清除参考帧和运动状态
+ */
+void motion_detector::reset()
+{
+    _has_reference = false;
+    _active = false;
+    _motion_count = 0;
+    _still_count = 0;
+}
+
+/**
+ * @brief 是否支持该输入格式
+ */
+bool motion_detector::supports(uint32_t fourcc)
+{
+    switch (fourcc) {
+    case V4L2_PIX_FMT_YUYV:
+    case V4L2_PIX_FMT_UYVY:
+    case V4L2_PIX_FMT_NV12:
+    case V4L2_PIX_FMT_NV12M:
+    case V4L2_PIX_FMT_GREY:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/**
+ * @brief 把帧的亮度降采样到_current，尺寸变化时丢弃参考帧
+ *
+ * @return false 格式不支持或数据不完整
+ */
+bool motion_detector::extract_luma(const buffer& frame)
+{
+    const uint8_t* planes[2] = {nullptr, nullptr};
+    size_t strides[2] = {0, 0};
+    const uint8_t* luma = nullptr;
+    size_t step = 1;
+    size_t sample = _config.downsample;
+    size_t width = frame.width();
+    size_t height = frame.height();
+
+    // 预览金字塔已按2x2取平均，直接取对应级别的亮度平面，与预览共用一次降采样；
+    // 金字塔因内存压力只保留了更小的级别时自行降采样，保持检测尺度不变
+    std::shared_ptr<buffer> scaled;
+    size_t level = pyramid_level(_config.downsample);
+    if (level > 0 && frame.pyramid()) {
+        scaled = frame.pyramid()->level(level);
+        uint32_t level_width = 0;
+        uint32_t level_height = 0;
+        preview_pyramid_pool::level_size(frame.width(), frame.height(), level, level_width, level_height);
+        if (scaled && (scaled->width() != level_width || scaled->height() != level_height)) {
+            scaled.reset();
+        }
+    }
+    if (scaled && locate<V4L2_PIX_FMT_NV12>(*scaled, planes, strides)) {
+        luma = planes[0];
+        sample = 1;
+        width = scaled->width();
+        height = scaled->height();
+    } else {
+        bool located = false;
+        switch (frame.fourcc()) {
+        case V4L2_PIX_FMT_YUYV:
+            located = locate<V4L2_PIX_FMT_YUYV>(frame, planes, strides);
+            step = 2;
+            break;
+        case V4L2_PIX_FMT_UYVY:
+            located = locate<V4L2_PIX_FMT_UYVY>(frame, planes, strides);
+            step = 2;
+            break;
+        case V4L2_PIX_FMT_NV12:
+            located = locate<V4L2_PIX_FMT_NV12>(frame, planes, strides);
+            break;
+        case V4L2_PIX_FMT_NV12M:
+            located = locate<V4L2_PIX_FMT_NV12M>(frame, planes, strides);
+            break;
+        case V4L2_PIX_FMT_GREY:
+            located = locate<V4L2_PIX_FMT_GREY>(frame, planes, strides);
+            break;
+        default:
+            break;
+        }
+        if (!located) {
+            return false;
+        }
+        luma = planes[0] + (frame.fourcc() == V4L2_PIX_FMT_UYVY ? 1 : 0);
+    }
+
+    size_t out_width = width / sample;
+    size_t out_height = height / sample;
+    if (out_width == 0 || out_height == 0) {
+        return false;
+    }
+
+    size_t block = _config.block_size;
+    size_t stride = (out_width + block - 1) / block * block;
+    size_t rows = (out_height + block - 1) / block * block;
+    if (out_width != _width || out_height != _height) {
+        _width = out_width;
+        _height = out_height;
+        _stride = stride;
+        _rows = rows;
+        _current.assign(stride * rows, 0);
+        _reference.assign(stride * rows, 0);
+        _has_reference = false;
+    }
+
+    // 按点取样，右侧和下方补齐的部分重复边缘像素
+    size_t pitch = sample * step;
+    for (size_t y = 0; y < out_height; ++y) {
+        const uint8_t* src = luma + y * sample * strides[0];
+        uint8_t* dst = _current.data() + y * stride;
+        if (pitch == 1) {
+            memcpy(dst, src, out_width);
+        } else {
+            for (size_t x = 0; x < out_width; ++x) {
+                dst[x] = src[x * pitch];
+            }
+        }
+        memset(dst + out_width, dst[out_width - 1], stride - out_width);
+    }
+    for (size_t y = out_height; y < rows; ++y) {
+        memcpy(_current.data() + y * stride, _current.data() + (out_height - 1) * stride, stride);
+    }
+    return true;
+}
+
+/**
+ * @brief 构造函数
+ */
+motion_trigger::motion_trigger(const motion_config& detection, const motion_trigger_config& config,
+                               std::shared_ptr<memory_budget> budget)
+    : _detector(detection),
+      _config(config),
+      _state(motion_trigger_state::idle),
+      _last_motion_time(0),
+      _budget(std::move(budget)),
+      _shed_handler_id(-1),
+      _paused(false),
+      _ring_bytes(0)
+{
+    if (_budget) {
+        // 回调可能在其他线程执行，只设置标志，由采集线程在下一帧清空预录队列
+        _paused = _budget->is_engaged(shed_action::pause_recorders);
+        _shed_handler_id = _budget->add_shed_handler(
+            shed_action::pause_recorders,
+            [this](shed_action, bool engaged) {
+                _paused = engaged;
+            });
+    }
+}
+
+/**
+ * @brief 析构函数
+ */
+motion_trigger::~motion_trigger()
+{
+    if (_budget) {
+        _budget->remove_shed_handler(_shed_handler_id);
+    }
+    clear_ring();
+}
+
+/**
+ * @brief 处理一帧
+ */
+motion_trigger_state motion_trigger::process(std::shared_ptr<buffer> frame,
+                                             std::vector<std::shared_ptr<buffer>>& output)
+{
+    if (!frame) {
+        return _state;
+    }
+
+    ++_stats.frames_in;
+    _stats.bytes_in += frame->size();
+    _last_result = _detector.update(*frame);
+    int64_t now = frame->timestamp();
+
+    // 暂停期间只做检测，恢复后仍在运动时作为新的一段重新开始
+    if (_paused.load(std::memory_order_relaxed)) {
+        clear_ring();
+        ++_stats.paused_frames;
+        _state = motion_trigger_state::idle;
+        return _state;
+    }
+
+    if (_last_result.active) {
+        if (_state == motion_trigger_state::idle) {
+            // 运动开始，先输出预录队列中仍在时间窗口内的帧
+            ++_stats.events;
+            trim_ring(now);
+            for (auto& retained : _ring) {
+                ++_stats.frames_out;
+                _stats.bytes_out += retained->size();
+                output.push_back(retained);
+            }
+            clear_ring();
+        }
+        _state = motion_trigger_state::recording;
+        _last_motion_time = now;
+    } else if (_state != motion_trigger_state::idle) {
+        _state = (now - _last_motion_time <= _config.post_roll_us) ? motion_trigger_state::post_roll
+                                                                  : motion_trigger_state::idle;
+    }
+
+    if (_state == motion_trigger_state::idle) {
+        push_ring(std::move(frame));
+        trim_ring(now);
+    } else {
+        ++_stats.frames_out;
+        _stats.bytes_out += frame->size();
+        output.push_back(std::move(frame));
+    }
+    return _state;
+}
+
+/**
+ * @brief 清空预录队列并回到空闲状态
+ */
+void motion_trigger::reset()
+{
+    clear_ring();
+    _detector.reset();
+    _state = motion_trigger_state::idle;
+    _last_motion_time = 0;
+}
+
+/**
+ * @brief 丢弃超出时间窗口或帧数上限的预录帧
+ */
+void motion_trigger::trim_ring(int64_t now)
+{
+    while (!_ring.empty() && now - _ring.front()->timestamp() > _config.pre_roll_us) {
+        pop_ring();
+    }
+    while (_ring.size() > _config.max_ring_frames) {
+        pop_ring();
+        ++_stats.ring_evictions;
+    }
+}
+
+/**
+ * @brief 帧加入预录队列，超出内存预算时丢弃
+ *
+ * 帧数据已计入帧缓冲池，不再重复计入，这里只计入队列自身的开销
+ */
+void motion_trigger::push_ring(std::shared_ptr<buffer> frame)
+{
+    if (_budget && !_budget->try_reserve(ring_entry_bytes, memory_consumer::recorder_queue)) {
+        ++_stats.ring_rejections;
+        return;
+    }
+    _ring_bytes += ring_entry_bytes;
+    _ring.push_back(std::move(frame));
+}
+
+/**
+ * @brief 丢弃最早的预录帧并归还额度
+ */
+void motion_trigger::pop_ring()
+{
+    _ring.pop_front();
+    _ring_bytes -= ring_entry_bytes;
+    if (_budget) {
+        _budget->release(ring_entry_bytes, memory_consumer::recorder_queue);
+    }
+}
+
+/**
+ * @brief 清空预录队列并归还全部额度
+ */
+void motion_trigger::clear_ring()
+{
+    _ring.clear();
+    if (_budget && _ring_bytes > 0) {
+        _budget->release(_ring_bytes, memory_consumer::recorder_queue);
+    }
+    _ring_bytes = 0;
+}
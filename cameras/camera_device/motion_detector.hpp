@@ -0,0 +1,258 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "buffer.hpp"
+#include "memory_budget.hpp"
+
+/**
+ * @brief 计算两块图像的绝对差之和（SAD）
+ *
+ * 每行按16字节一组比较，x86上使用SSE2的psadbw，ARM上使用NEON，其余平台逐字节计算
+ *
+ * @param a 第一块的起始地址
+ * @param b 第二块的起始地址
+ * @param stride 行跨度（两块相同）
+ * @param width 块宽度（字节），需为16的整数倍
+ * @param height 块高度（行）
+ * @return uint32_t 绝对差之和
+ */
+uint32_t block_sad(const uint8_t* a, const uint8_t* b, size_t stride, size_t width, size_t height);
+
+/**
+ * @brief 运动检测配置
+ */
+struct motion_config {
+    uint32_t downsample = 4;        // 亮度降采样倍数（每个方向），帧附加了预览金字塔且为2、4、8时直接取对应级别
+    uint32_t block_size = 16;       // 降采样图上的块边长（像素），需为16的整数倍
+    uint32_t block_threshold = 10;  // 块内平均每像素的亮度差超过该值时记为变化块
+    double trigger_ratio = 0.01;    // 变化块比例达到该值的帧记为运动帧
+    double release_ratio = 0.003;   // 变化块比例低于该值的帧记为静止帧，两个比例之间的帧不改变计数
+    uint32_t trigger_frames = 2;    // 连续运动帧数达到该值时进入运动状态
+    uint32_t release_frames = 10;   // 连续静止帧数达到该值时退出运动状态
+};
+
+/**
+ * @brief 单帧的运动检测结果
+ */
+struct motion_result {
+    bool valid = false;             // 是否完成了比较（格式不支持或第一帧时为false）
+    bool active = false;            // 是否处于运动状态
+    bool started = false;           // 本帧进入运动状态
+    bool ended = false;             // 本帧退出运动状态
+    uint32_t changed_blocks = 0;    // 变化块数量
+    double changed_ratio = 0.0;     // 变化块比例
+};
+
+/**
+ * @brief 运动检测统计
+ */
+struct motion_stats {
+    uint64_t frames = 0;            // 检测的帧数
+    uint64_t motion_frames = 0;     // 处于运动状态的帧数
+    uint64_t events = 0;            // 进入运动状态的次数
+    uint64_t analyse_ns = 0;        // 降采样和比较的累计耗时（纳秒）
+};
+
+/**
+ * @brief 单个摄像头的运动检测
+ *
+ * 把每帧的亮度降采样后与上一帧逐块计算SAD，变化块比例经过双阈值和连续帧数两级
+ * 滞回，避免噪声和闪烁造成状态抖动。降采样后1080p只需比较约13万个像素。
+ *
+ * 输入支持YUYV、UYVY、NV12、NV12M和GREY。非线程安全，应只在该摄像头的采集线程中使用
+ */
+class motion_detector {
+public:
+    /**
+     * @brief 构造函数
+     *
+     * @param config 检测配置
+     */
+    explicit motion_detector(const motion_config& config = motion_config());
+
+    /**
+     * @brief 检测一帧
+     *
+     * @param frame 新到达的帧，需已设置格式元数据
+     * @return motion_result 检测结果
+     */
+    motion_result update(const buffer& frame);
+
+    /**
+     * @brief 是否处于运动状态
+     */
+    bool active() const { return _active; }
+
+    /**
+     * @brief 获取检测配置
+     */
+    const motion_config& config() const { return _config; }
+
+    /**
+     * @brief 获取统计信息
+     */
+    const motion_stats& stats() const { return _stats; }
+
+    /**
+     * @brief 清除参考帧和运动状态，用于摄像头重新打开或格式变化后
+     */
+    void reset();
+
+    /**
+     * @brief 是否支持该输入格式
+     */
+    static bool supports(uint32_t fourcc);
+
+private:
+    bool extract_luma(const buffer& frame);
+
+    motion_config _config;              // 检测配置
+    motion_stats _stats;                // 统计信息
+    std::vector<uint8_t> _current;      // 当前帧的降采样亮度，宽高补齐到块的整数倍
+    std::vector<uint8_t> _reference;    // 上一帧的降采样亮度
+    size_t _width;                      // 降采样图的有效宽度
+    size_t _height;                     // 降采样图的有效高度
+    size_t _stride;                     // 补齐后的宽度
+    size_t _rows;                       // 补齐后的高度
+    bool _has_reference;                // 是否已有参考帧
+    bool _active;                       // 是否处于运动状态
+    uint32_t _motion_count;             // 连续运动帧数
+    uint32_t _still_count;              // 连续静止帧数
+};
+
+/**
+ * @brief 运动触发录制配置
+ */
+struct motion_trigger_config {
+    int64_t pre_roll_us = 2000000;      // 运动开始前保留的时长（微秒）
+    int64_t post_roll_us = 3000000;     // 运动结束后继续录制的时长（微秒）
+    size_t max_ring_frames = 90;        // 预录环形队列最多保留的帧数
+};
+
+/**
+ * @brief 运动触发录制的状态
+ */
+enum class motion_trigger_state {
+    idle = 0,       // 无运动，帧只进入预录队列
+    recording,      // 运动中，帧直接输出
+    post_roll       // 运动已结束，在延时内继续输出
+};
+
+/**
+ * @brief 运动触发录制统计
+ */
+struct motion_trigger_stats {
+    uint64_t frames_in = 0;             // 输入帧数
+    uint64_t frames_out = 0;            // 输出给录制的帧数
+    uint64_t bytes_in = 0;              // 输入字节数
+    uint64_t bytes_out = 0;             // 输出字节数
+    uint64_t events = 0;                // 触发的录制段数
+    uint64_t ring_evictions = 0;        // 因超出帧数上限而提前丢弃的预录帧数
+    uint64_t ring_rejections = 0;       // 因超出内存预算而未进入预录队列的帧数
+    uint64_t paused_frames = 0;         // 内存预算暂停录制期间未录制的帧数
+};
+
+/**
+ * @brief 按运动检测结果决定哪些帧需要录制
+ *
+ * 空闲时帧保存在内存中的预录环形队列，只保留最近pre_roll_us内的帧；检测到运动时
+ * 先按时间顺序输出预录队列，之后直接输出新帧，运动结束后再持续post_roll_us。
+ * 队列保存的是帧缓冲池中buffer的引用，不复制数据，摄像头的帧缓冲池容量需大于
+ * max_ring_frames加上其他在途帧数，否则池耗尽时采集会丢帧。
+ *
+ * 指定内存预算时，帧数据已由帧缓冲池计入，预录队列只把自身保存的引用计入recorder_queue，
+ * 超出预算的帧不进入队列；
+ * 预算执行pause_recorders时清空预录队列、停止输出，只继续运动检测，回落到低水位后恢复。
+ *
+ * 除暂停状态外非线程安全，应只在该摄像头的采集线程中使用
+ */
+class motion_trigger {
+public:
+    /**
+     * @brief 构造函数
+     *
+     * @param detection 运动检测配置
+     * @param config 录制配置
+     * @param budget 共享的内存预算，为空时不限制
+     */
+    motion_trigger(const motion_config& detection = motion_config(),
+                   const motion_trigger_config& config = motion_trigger_config(),
+                   std::shared_ptr<memory_budget> budget = nullptr);
+
+    /**
+     * @brief 析构函数，归还预录队列的内存额度并注销削减动作回调
+     */
+    ~motion_trigger();
+
+    // 削减动作回调引用该对象，禁止拷贝
+    motion_trigger(const motion_trigger&) = delete;
+    motion_trigger& operator=(const motion_trigger&) = delete;
+
+    /**
+     * @brief 处理一帧
+     *
+     * @param frame 新到达的帧
+     * @param output 追加需要录制的帧，按时间顺序
+     * @return motion_trigger_state 处理后的状态
+     */
+    motion_trigger_state process(std::shared_ptr<buffer> frame, std::vector<std::shared_ptr<buffer>>& output);
+
+    /**
+     * @brief 当前状态
+     */
+    motion_trigger_state state() const { return _state; }
+
+    /**
+     * @brief 是否因内存压力暂停录制
+     */
+    bool paused() const { return _paused.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 最近一帧的检测结果
+     */
+    const motion_result& last_result() const { return _last_result; }
+
+    /**
+     * @brief 获取运动检测器
+     */
+    const motion_detector& detector() const { return _detector; }
+
+    /**
+     * @brief 获取统计信息
+     */
+    const motion_trigger_stats& stats() const { return _stats; }
+
+    /**
+     * @brief 预录队列中的帧数
+     */
+    size_t ring_size() const { return _ring.size(); }
+
+    /**
+     * @brief 清空预录队列并回到空闲状态，归还队列持有的buffer
+     */
+    void reset();
+
+private:
+    void trim_ring(int64_t now);
+    void push_ring(std::shared_ptr<buffer> frame);
+    void pop_ring();
+    void clear_ring();
+
+    motion_detector _detector;                      // 运动检测器
+    motion_trigger_config _config;                  // 录制配置
+    motion_trigger_stats _stats;                    // 统计信息
+    motion_result _last_result;                     // 最近一帧的检测结果
+    std::deque<std::shared_ptr<buffer>> _ring;      // 预录环形队列
+    motion_trigger_state _state;                    // 当前状态
+    int64_t _last_motion_time;                      // 最近一个运动帧的时间戳（微秒）
+    std::shared_ptr<memory_budget> _budget;         // 共享的内存预算
+    int _shed_handler_id;                           // 削减动作回调ID
+    std::atomic<bool> _paused;                      // 是否暂停录制，由削减动作回调设置
+    size_t _ring_bytes;                             // 预录队列计入预算的字节数
+};
@@ -0,0 +1,409 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <linux/videodev2.h>
+
+#include "buffer.hpp"
+
+/**
+ * @brief 编译期特化的像素转换管线
+ *
+ * 输入像素格式、输出格式和处理阶段都是模板参数，行跨度、帧大小和转换内核
+ * 在编译期确定并内联进逐像素循环；运行时由dispatcher按协商得到的fourcc
+ * 选择预先实例化的管线
+ */
+namespace pixel {
+
+/**
+ * @brief 饱和到0~255
+ */
+inline uint8_t clamp_u8(int value)
+{
+    return static_cast<uint8_t>(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+// ---------------------------------------------------------------------------
+// 输出格式
+// ---------------------------------------------------------------------------
+
+/**
+ * @brief BGR24输出（OpenCV默认的通道顺序）
+ */
+struct bgr24 {
+    static constexpr uint32_t fourcc = V4L2_PIX_FMT_BGR24;
+    static constexpr size_t channels = 3;
+
+    static constexpr size_t min_stride(size_t width) { return width * channels; }
+
+    // BT.601有限范围，8位定点系数
+    static void store_yuv(uint8_t* dst, int y, int u, int v)
+    {
+        int c = 298 * (y - 16) + 128;
+        int d = u - 128;
+        int e = v - 128;
+        dst[0] = clamp_u8((c + 516 * d) >> 8);
+        dst[1] = clamp_u8((c - 100 * d - 208 * e) >> 8);
+        dst[2] = clamp_u8((c + 409 * e) >> 8);
+    }
+
+    static void store_rgb(uint8_t* dst, int r, int g, int b)
+    {
+        dst[0] = static_cast<uint8_t>(b);
+        dst[1] = static_cast<uint8_t>(g);
+        dst[2] = static_cast<uint8_t>(r);
+    }
+};
+
+/**
+ * @brief 8位灰度输出，YUV输入只取亮度，色度计算被编译器消除
+ */
+struct gray8 {
+    static constexpr uint32_t fourcc = V4L2_PIX_FMT_GREY;
+    static constexpr size_t channels = 1;
+
+    static constexpr size_t min_stride(size_t width) { return width; }
+
+    static void store_yuv(uint8_t* dst, int y, int, int) { dst[0] = static_cast<uint8_t>(y); }
+
+    static void store_rgb(uint8_t* dst, int r, int g, int b)
+    {
+        dst[0] = static_cast<uint8_t>((77 * r + 150 * g + 29 * b) >> 8);
+    }
+};
+
+// ---------------------------------------------------------------------------
+// 处理阶段，作用于每个输出像素
+// ---------------------------------------------------------------------------
+
+namespace stage {
+
+/**
+ * @brief 反色
+ */
+struct invert {
+    template <typename Out>
+    static void apply(uint8_t* px)
+    {
+        for (size_t c = 0; c < Out::channels; ++c) {
+            px[c] = static_cast<uint8_t>(255 - px[c]);
+        }
+    }
+};
+
+/**
+ * @brief 亮度偏移
+ */
+template <int Delta>
+struct brightness {
+    template <typename Out>
+    static void apply(uint8_t* px)
+    {
+        for (size_t c = 0; c < Out::channels; ++c) {
+            px[c] = clamp_u8(px[c] + Delta);
+        }
+    }
+};
+
+} // namespace stage
+
+/**
+ * @brief 依次执行全部处理阶段
+ */
+template <typename Out, typename... Stages>
+inline void apply_stages(uint8_t* px)
+{
+    (void)px;
+    (Stages::template apply<Out>(px), ...);
+}
+
+// ---------------------------------------------------------------------------
+// 输入格式
+// ---------------------------------------------------------------------------
+
+/**
+ * @brief 输入像素格式的编译期描述
+ *
+ * planes：平面数量；min_stride：无填充时的行跨度；chroma_rows：第二平面的行数；
+ * convert：把一帧转换为输出格式
+ */
+template <uint32_t FourCC>
+struct format_traits;
+
+/**
+ * @brief 打包YUV 4:2:2格式的公共实现
+ *
+ * @tparam Y0 第一个Y分量的字节位置
+ * @tparam U U分量的字节位置
+ * @tparam V V分量的字节位置
+ */
+template <int Y0, int U, int V>
+struct packed_yuv422_traits {
+    static constexpr size_t planes = 1;
+
+    static constexpr size_t min_stride(size_t width) { return width * 2; }
+    static constexpr size_t chroma_rows(size_t) { return 0; }
+
+    template <typename Out, typename... Stages>
+    static void convert(const uint8_t* const* src, const size_t* stride,
+                        size_t width, size_t height, uint8_t* dst, size_t dst_stride)
+    {
+        for (size_t row = 0; row < height; ++row) {
+            const uint8_t* s = src[0] + row * stride[0];
+            uint8_t* d = dst + row * dst_stride;
+            for (size_t x = 0; x + 1 < width; x += 2, s += 4) {
+                Out::store_yuv(d, s[Y0], s[U], s[V]);
+                apply_stages<Out, Stages...>(d);
+                d += Out::channels;
+                Out::store_yuv(d, s[Y0 + 2], s[U], s[V]);
+                apply_stages<Out, Stages...>(d);
+                d += Out::channels;
+            }
+        }
+    }
+};
+
+template <>
+struct format_traits<V4L2_PIX_FMT_YUYV> : packed_yuv422_traits<0, 1, 3> {};
+
+template <>
+struct format_traits<V4L2_PIX_FMT_UYVY> : packed_yuv422_traits<1, 0, 2> {};
+
+/**
+ * @brief NV12：Y平面加交错的UV平面，4:2:0
+ */
+template <>
+struct format_traits<V4L2_PIX_FMT_NV12> {
+    static constexpr size_t planes = 2;
+
+    static constexpr size_t min_stride(size_t width) { return width; }
+    static constexpr size_t chroma_rows(size_t height) { return (height + 1) / 2; }
+
+    template <typename Out, typename... Stages>
+    static void convert(const uint8_t* const* src, const size_t* stride,
+                        size_t width, size_t height, uint8_t* dst, size_t dst_stride)
+    {
+        for (size_t row = 0; row < height; ++row) {
+            const uint8_t* y = src[0] + row * stride[0];
+            const uint8_t* uv = src[1] + (row / 2) * stride[1];
+            uint8_t* d = dst + row * dst_stride;
+            for (size_t x = 0; x < width; ++x) {
+                Out::store_yuv(d, y[x], uv[x & ~size_t(1)], uv[x | 1]);
+                apply_stages<Out, Stages...>(d);
+                d += Out::channels;
+            }
+        }
+    }
+};
+
+/**
+ * @brief NV12M：与NV12相同，只是两个平面位于不同的V4L2平面
+ */
+template <>
+struct format_traits<V4L2_PIX_FMT_NV12M> : format_traits<V4L2_PIX_FMT_NV12> {};
+
+/**
+ * @brief 8位灰度
+ */
+template <>
+struct format_traits<V4L2_PIX_FMT_GREY> {
+    static constexpr size_t planes = 1;
+
+    static constexpr size_t min_stride(size_t width) { return width; }
+    static constexpr size_t chroma_rows(size_t) { return 0; }
+
+    template <typename Out, typename... Stages>
+    static void convert(const uint8_t* const* src, const size_t* stride,
+                        size_t width, size_t height, uint8_t* dst, size_t dst_stride)
+    {
+        for (size_t row = 0; row < height; ++row) {
+            const uint8_t* s = src[0] + row * stride[0];
+            uint8_t* d = dst + row * dst_stride;
+            for (size_t x = 0; x < width; ++x) {
+                Out::store_yuv(d, s[x], 128, 128);
+                apply_stages<Out, Stages...>(d);
+                d += Out::channels;
+            }
+        }
+    }
+};
+
+/**
+ * @brief 打包24位RGB格式的公共实现
+ *
+ * @tparam R R分量的字节位置
+ * @tparam B B分量的字节位置
+ */
+template <int R, int B>
+struct packed_rgb24_traits {
+    static constexpr size_t planes = 1;
+
+    static constexpr size_t min_stride(size_t width) { return width * 3; }
+    static constexpr size_t chroma_rows(size_t) { return 0; }
+
+    template <typename Out, typename... Stages>
+    static void convert(const uint8_t* const* src, const size_t* stride,
+                        size_t width, size_t height, uint8_t* dst, size_t dst_stride)
+    {
+        for (size_t row = 0; row < height; ++row) {
+            const uint8_t* s = src[0] + row * stride[0];
+            uint8_t* d = dst + row * dst_stride;
+            for (size_t x = 0; x < width; ++x, s += 3) {
+                Out::store_rgb(d, s[R], s[1], s[B]);
+                apply_stages<Out, Stages...>(d);
+                d += Out::channels;
+            }
+        }
+    }
+};
+
+template <>
+struct format_traits<V4L2_PIX_FMT_RGB24> : packed_rgb24_traits<0, 2> {};
+
+template <>
+struct format_traits<V4L2_PIX_FMT_BGR24> : packed_rgb24_traits<2, 0> {};
+
+// ---------------------------------------------------------------------------
+// 管线
+// ---------------------------------------------------------------------------
+
+/**
+ * @brief 按buffer的平面布局定位各平面，未设置布局时按无填充的紧凑布局
+ *
+ * @return true 数据足够容纳整帧
+ */
+template <typename Traits>
+inline bool locate_planes(const buffer& frame, size_t width, size_t height,
+                          const uint8_t** planes, size_t* strides)
+{
+    const uint8_t* data = static_cast<const uint8_t*>(frame.data());
+    size_t stride0 = Traits::min_stride(width);
+    if (frame.plane_count() > 0 && frame.plane_info(0).bytesperline >= stride0) {
+        stride0 = frame.plane_info(0).bytesperline;
+    }
+    planes[0] = data;
+    strides[0] = stride0;
+    size_t end = stride0 * height;
+
+    if (Traits::planes > 1) {
+        if (frame.plane_count() > 1) {
+            planes[1] = frame.plane_data(1);
+            strides[1] = frame.plane_info(1).bytesperline ? frame.plane_info(1).bytesperline : stride0;
+        } else {
+            planes[1] = data + stride0 * height;
+            strides[1] = stride0;
+        }
+        end = static_cast<size_t>(planes[1] - data) + strides[1] * Traits::chroma_rows(height);
+    }
+    return frame.size() >= end;
+}
+
+/**
+ * @brief 编译期特化的转换管线
+ *
+ * @tparam FourCC 输入像素格式
+ * @tparam Out 输出格式（bgr24、gray8）
+ * @tparam Stages 依次作用于每个输出像素的处理阶段
+ */
+template <uint32_t FourCC, typename Out, typename... Stages>
+struct pipeline {
+    using input = format_traits<FourCC>;
+    using output = Out;
+
+    static constexpr uint32_t fourcc = FourCC;
+
+    /**
+     * @brief 无填充时输入帧的大小
+     */
+    static constexpr size_t input_size(size_t width, size_t height)
+    {
+        return input::min_stride(width) * height + input::min_stride(width) * input::chroma_rows(height);
+    }
+
+    /**
+     * @brief 无填充时输出帧的大小
+     */
+    static constexpr size_t output_size(size_t width, size_t height)
+    {
+        return Out::min_stride(width) * height;
+    }
+
+    /**
+     * @brief 转换一帧
+     *
+     * @param frame 输入帧，按其平面布局读取行跨度
+     * @param width 图像宽度
+     * @param height 图像高度
+     * @param dst 输出图像
+     * @param dst_stride 输出行跨度，不小于Out::min_stride(width)
+     * @return true 转换成功
+     * @return false 输入数据不足一帧
+     */
+    static bool run(const buffer& frame, uint32_t width, uint32_t height, uint8_t* dst, size_t dst_stride)
+    {
+        const uint8_t* planes[2] = {nullptr, nullptr};
+        size_t strides[2] = {0, 0};
+        if (!locate_planes<input>(frame, width, height, planes, strides)) {
+            return false;
+        }
+        input::template convert<Out, Stages...>(planes, strides, width, height, dst, dst_stride);
+        return true;
+    }
+};
+
+// ---------------------------------------------------------------------------
+// 运行时分发
+// ---------------------------------------------------------------------------
+
+/**
+ * @brief 转换函数，对应某个预先实例化的管线
+ */
+using convert_fn = bool (*)(const buffer& frame, uint32_t width, uint32_t height, uint8_t* dst, size_t dst_stride);
+
+/**
+ * @brief 输入格式列表
+ */
+template <uint32_t... FourCCs>
+struct format_list {};
+
+/**
+ * @brief 预先实例化的输入格式
+ */
+using supported_formats = format_list<V4L2_PIX_FMT_YUYV,
+                                      V4L2_PIX_FMT_UYVY,
+                                      V4L2_PIX_FMT_NV12,
+                                      V4L2_PIX_FMT_NV12M,
+                                      V4L2_PIX_FMT_GREY,
+                                      V4L2_PIX_FMT_RGB24,
+                                      V4L2_PIX_FMT_BGR24>;
+
+/**
+ * @brief 按fourcc选择管线
+ *
+ * 对supported_formats中的每个格式实例化pipeline<FourCC, Out, Stages...>，
+ * 运行时只在选择时比较一次fourcc，逐像素循环中没有格式分支
+ *
+ * @tparam Out 输出格式
+ * @tparam Stages 处理阶段
+ */
+template <typename Out, typename... Stages>
+struct dispatcher {
+    /**
+     * @brief 选择管线
+     *
+     * @param fourcc 协商得到的像素格式
+     * @return convert_fn 转换函数，格式不支持时返回nullptr
+     */
+    static convert_fn select(uint32_t fourcc) { return select_from(fourcc, supported_formats()); }
+
+private:
+    template <uint32_t... FourCCs>
+    static convert_fn select_from(uint32_t fourcc, format_list<FourCCs...>)
+    {
+        convert_fn fn = nullptr;
+        (void)((fourcc == FourCCs ? (fn = &pipeline<FourCCs, Out, Stages...>::run, true) : false) || ...);
+        return fn;
+    }
+};
+
+} // namespace pixel
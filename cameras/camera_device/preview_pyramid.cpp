@@ -0,0 +1,400 @@
+#include "preview_pyramid.hpp"
+
+#include <algorithm>
+
+#include <linux/videodev2.h>
+
+#include "pixel_pipeline.hpp"
+
+namespace {
+
+/**
+ * @brief 只读的亮度/色度平面
+ */
+struct nv12_source {
+    const uint8_t* y;       // 亮度平面
+    const uint8_t* uv;      // 交错的UV平面
+    size_t y_stride;        // 亮度行跨度
+    size_t uv_stride;       // 色度行跨度
+};
+
+/**
+ * @brief 金字塔某一级的NV12图像，行跨度等于宽度
+ */
+struct nv12_level {
+    uint8_t* y;             // 亮度平面
+    uint8_t* uv;            // 交错的UV平面
+    size_t width;           // 宽度（偶数）
+    size_t height;          // 高度（偶数）
+
+    size_t units() const { return height / 2; }
+    nv12_source as_source() const { return {y, uv, width, width}; }
+};
+
+/**
+ * @brief 两行亮度按2x2取平均得到一行
+ */
+inline void halve_luma(const uint8_t* r0, const uint8_t* r1, uint8_t* dst, size_t width)
+{
+    for (size_t x = 0; x < width; ++x) {
+        dst[x] = static_cast<uint8_t>((r0[2 * x] + r0[2 * x + 1] + r1[2 * x] + r1[2 * x + 1] + 2) >> 2);
+    }
+}
+
+/**
+ * @brief 两行交错UV按2x2取平均得到一行
+ */
+inline void halve_chroma(const uint8_t* r0, const uint8_t* r1, uint8_t* dst, size_t pairs)
+{
+    for (size_t x = 0; x < 2 * pairs; ++x) {
+        size_t s = 2 * x - (x & 1);
+        dst[x] = static_cast<uint8_t>((r0[s] + r0[s + 2] + r1[s] + r1[s + 2] + 2) >> 2);
+    }
+}
+
+/**
+ * @brief 生成NV12图像的一个单元：两行亮度和一行色度
+ */
+inline void downscale_nv12_unit(const nv12_source& src, const nv12_level& dst, size_t unit)
+{
+    for (size_t row = 2 * unit; row < 2 * unit + 2; ++row) {
+        halve_luma(src.y + 2 * row * src.y_stride, src.y + (2 * row + 1) * src.y_stride,
+                   dst.y + row * dst.width, dst.width);
+    }
+    halve_chroma(src.uv + 2 * unit * src.uv_stride, src.uv + (2 * unit + 1) * src.uv_stride,
+                 dst.uv + unit * dst.width, dst.width / 2);
+}
+
+/**
+ * @brief 从打包YUV 4:2:2生成第1级的一个单元
+ *
+ * 一个单元对应原图的4行：亮度按2x2取平均，色度取4行中每2个宏像素的8个样本的平均
+ *
+ * @tparam Y0 第一个Y分量的字节位置
+ * @tparam U U分量的字节位置
+ * @tparam V V分量的字节位置
+ */
+template <int Y0, int U, int V>
+void packed_yuv422_unit(const uint8_t* src, size_t stride, const nv12_level& dst, size_t unit)
+{
+    for (size_t row = 2 * unit; row < 2 * unit + 2; ++row) {
+        const uint8_t* s0 = src + 2 * row * stride;
+        const uint8_t* s1 = s0 + stride;
+        uint8_t* d = dst.y + row * dst.width;
+        for (size_t x = 0; x < dst.width; ++x) {
+            d[x] = static_cast<uint8_t>((s0[4 * x + Y0] + s0[4 * x + Y0 + 2] +
+                                         s1[4 * x + Y0] + s1[4 * x + Y0 + 2] + 2) >> 2);
+        }
+    }
+
+    const uint8_t* r0 = src + 4 * unit * stride;
+    const uint8_t* r1 = r0 + stride;
+    const uint8_t* r2 = r1 + stride;
+    const uint8_t* r3 = r2 + stride;
+    uint8_t* d = dst.uv + unit * dst.width;
+    for (size_t x = 0; x < dst.width / 2; ++x) {
+        size_t u = 8 * x + U;
+        size_t v = 8 * x + V;
+        d[2 * x] = static_cast<uint8_t>((r0[u] + r0[u + 4] + r1[u] + r1[u + 4] +
+                                         r2[u] + r2[u + 4] + r3[u] + r3[u + 4] + 4) >> 3);
+        d[2 * x + 1] = static_cast<uint8_t>((r0[v] + r0[v + 4] + r1[v] + r1[v + 4] +
+                                             r2[v] + r2[v + 4] + r3[v] + r3[v + 4] + 4) >> 3);
+    }
+}
+
+/**
+ * @brief 一次遍历生成全部级别
+ *
+ * 第1级每生成两个单元，第2级即可生成一个单元，依此类推，因此各级的输入行在生成时
+ * 仍在缓存中，原图只被读取一次
+ *
+ * @param first_unit 生成第1级某个单元的函数
+ * @param levels 各级图像
+ * @param count 级数
+ */
+template <typename FirstUnit>
+void build_levels(FirstUnit&& first_unit, const nv12_level* levels, size_t count)
+{
+    for (size_t i = 0; i < levels[0].units(); ++i) {
+        first_unit(levels[0], i);
+        size_t unit = i;
+        for (size_t k = 1; k < count; ++k) {
+            // 上一级的第2j、2j+1个单元都已生成时生成本级的第j个单元
+            if ((unit & 1) == 0) {
+                break;
+            }
+            unit /= 2;
+            if (unit >= levels[k].units()) {
+                break;
+            }
+            downscale_nv12_unit(levels[k - 1].as_source(), levels[k], unit);
+        }
+    }
+}
+
+template <uint32_t FourCC>
+bool locate_source(const buffer& source, const uint8_t** planes, size_t* strides)
+{
+    return pixel::locate_planes<pixel::format_traits<FourCC>>(
+        source, source.width(), source.height(), planes, strides);
+}
+
+} // namespace
+
+/**
+ * @brief 构造函数
+ */
+preview_pyramid_pool::preview_pyramid_pool(uint32_t width, uint32_t height, size_t max_frames,
+                                           std::shared_ptr<memory_budget> budget)
+    : _width(width),
+      _height(height),
+      _budget(std::move(budget)),
+      _shed_handler_id(-1),
+      _reduced(false)
+{
+    for (size_t i = 0; i < max_levels; ++i) {
+        uint32_t level_width = 0;
+        uint32_t level_height = 0;
+        level_size(width, height, i + 1, level_width, level_height);
+        if (level_width > 0 && level_height > 0) {
+            size_t frame_size = static_cast<size_t>(level_width) * level_height * 3 / 2;
+            _pools[i].reset(new frame_pool(frame_size, max_frames, _budget));
+        }
+    }
+
+    if (_budget) {
+        // 削减状态中重建的缓冲池直接从降低后的分辨率开始
+        _reduced = _budget->is_engaged(shed_action::reduce_preview_resolution);
+        _shed_handler_id = _budget->add_shed_handler(
+            shed_action::reduce_preview_resolution,
+            [this](shed_action, bool engaged) {
+                set_reduced(engaged);
+            });
+    }
+}
+
+/**
+ * @brief 析构函数
+ */
+preview_pyramid_pool::~preview_pyramid_pool()
+{
+    if (_budget) {
+        _budget->remove_shed_handler(_shed_handler_id);
+    }
+}
+
+/**
+ * @brief 设置是否降低预览分辨率
+ */
+void preview_pyramid_pool::set_reduced(bool reduced)
+{
+    _reduced = reduced;
+    if (!reduced) {
+        return;
+    }
+    // 在途帧持有的buffer随帧回收，这里只释放空闲的
+    for (size_t i = 0; i + 1 < max_levels; ++i) {
+        if (_pools[i]) {
+            _pools[i]->trim();
+        }
+    }
+}
+
+/**
+ * @brief 获取某一级的空闲buffer
+ */
+std::shared_ptr<buffer> preview_pyramid_pool::acquire(size_t level)
+{
+    if (level < 1 || level > max_levels || !_pools[level - 1]) {
+        return nullptr;
+    }
+    return _pools[level - 1]->acquire();
+}
+
+/**
+ * @brief 计算某一级的尺寸
+ */
+void preview_pyramid_pool::level_size(uint32_t width, uint32_t height, size_t level,
+                                      uint32_t& level_width, uint32_t& level_height)
+{
+    level_width = (width >> level) & ~1u;
+    level_height = (height >> level) & ~1u;
+}
+
+/**
+ * @brief 构造函数
+ */
+preview_pyramid::preview_pyramid(const buffer& source)
+    : _source(source),
+      _computed(false),
+      _first_level(1)
+{
+}
+
+/**
+ * @brief 为帧附加金字塔
+ */
+void preview_pyramid::attach(buffer& frame, std::shared_ptr<preview_pyramid_pool> pool)
+{
+    if (!frame.pyramid()) {
+        frame.set_pyramid(std::make_shared<preview_pyramid>(frame));
+    }
+    preview_pyramid& pyramid = *frame.pyramid();
+    std::lock_guard<std::mutex> lock(pyramid._mutex);
+    pyramid._pool = std::move(pool);
+}
+
+/**
+ * @brief 获取某一级缩小图像
+ */
+std::shared_ptr<buffer> preview_pyramid::level(size_t level)
+{
+    if (level < 1 || level > max_levels) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_computed) {
+        build();
+        _computed = true;
+    }
+    return _levels[std::max(level, _first_level) - 1];
+}
+
+/**
+ * @brief 是否只保留了最小的一级
+ */
+bool preview_pyramid::reduced() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _first_level > 1;
+}
+
+/**
+ * @brief 是否已生成
+ */
+bool preview_pyramid::computed() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _computed;
+}
+
+/**
+ * @brief 释放各级buffer并清除缓存
+ */
+void preview_pyramid::reset()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto& level : _levels) {
+        level.reset();
+    }
+    _pool.reset();
+    _computed = false;
+    _first_level = 1;
+}
+
+/**
+ * @brief 是否支持该输入格式
+ */
+bool preview_pyramid::supports(uint32_t fourcc)
+{
+    switch (fourcc) {
+    case V4L2_PIX_FMT_YUYV:
+    case V4L2_PIX_FMT_UYVY:
+    case V4L2_PIX_FMT_NV12:
+    case V4L2_PIX_FMT_NV12M:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/**
+ * @brief 生成全部级别，调用者需持有_mutex
+ */
+void preview_pyramid::build()
+{
+    uint32_t fourcc = _source.fourcc();
+    if (!_pool || !supports(fourcc) ||
+        _pool->width() != _source.width() || _pool->height() != _source.height()) {
+        return;
+    }
+
+    const uint8_t* planes[2] = {nullptr, nullptr};
+    size_t strides[2] = {0, 0};
+    bool located = false;
+    switch (fourcc) {
+    case V4L2_PIX_FMT_YUYV:  located = locate_source<V4L2_PIX_FMT_YUYV>(_source, planes, strides); break;
+    case V4L2_PIX_FMT_UYVY:  located = locate_source<V4L2_PIX_FMT_UYVY>(_source, planes, strides); break;
+    case V4L2_PIX_FMT_NV12:  located = locate_source<V4L2_PIX_FMT_NV12>(_source, planes, strides); break;
+    case V4L2_PIX_FMT_NV12M: located = locate_source<V4L2_PIX_FMT_NV12M>(_source, planes, strides); break;
+    default: break;
+    }
+    if (!located) {
+        return;
+    }
+
+    // 获取各级buffer，某一级无法获取时更小的级别也不再生成
+    nv12_level levels[max_levels];
+    size_t count = 0;
+    for (; count < max_levels; ++count) {
+        std::shared_ptr<buffer> frame = _pool->acquire(count + 1);
+        if (!frame) {
+            break;
+        }
+
+        uint32_t width = 0;
+        uint32_t height = 0;
+        preview_pyramid_pool::level_size(_source.width(), _source.height(), count + 1, width, height);
+        size_t luma_size = static_cast<size_t>(width) * height;
+        buffer::plane layout[2];
+        layout[0].offset = 0;
+        layout[0].size = luma_size;
+        layout[0].bytesperline = width;
+        layout[1].offset = luma_size;
+        layout[1].size = luma_size / 2;
+        layout[1].bytesperline = width;
+        frame->resize(luma_size * 3 / 2);
+        frame->set_planes(layout, 2);
+        frame->set_format(width, height, V4L2_PIX_FMT_NV12);
+        frame->set_timestamp(_source.timestamp());
+        frame->set_sequence(_source.sequence());
+        frame->set_camera_id(_source.camera_id());
+        frame->set_clock(_source.clock());
+
+        levels[count].y = frame->plane_data(0);
+        levels[count].uv = frame->plane_data(1);
+        levels[count].width = width;
+        levels[count].height = height;
+        _levels[count] = std::move(frame);
+    }
+    if (count == 0) {
+        return;
+    }
+
+    switch (fourcc) {
+    case V4L2_PIX_FMT_YUYV:
+        build_levels([&](const nv12_level& dst, size_t unit) {
+            packed_yuv422_unit<0, 1, 3>(planes[0], strides[0], dst, unit);
+        }, levels, count);
+        break;
+    case V4L2_PIX_FMT_UYVY:
+        build_levels([&](const nv12_level& dst, size_t unit) {
+            packed_yuv422_unit<1, 0, 2>(planes[0], strides[0], dst, unit);
+        }, levels, count);
+        break;
+    default: {
+        nv12_source source = {planes[0], planes[1], strides[0], strides[1]};
+        build_levels([&](const nv12_level& dst, size_t unit) {
+            downscale_nv12_unit(source, dst, unit);
+        }, levels, count);
+        break;
+    }
+    }
+
+    // 降低预览分辨率时更大的级别只作为生成的中间结果，生成后立即归还缓冲池
+    _first_level = std::min(_pool->first_level(), count);
+    for (size_t i = 0; i + 1 < _first_level; ++i) {
+        _levels[i].reset();
+    }
+}
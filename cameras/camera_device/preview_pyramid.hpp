@@ -0,0 +1,156 @@
+#pragma once
+
+#include <cstddef>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+#include "buffer.hpp"
+#include "frame_pool.hpp"
+#include "memory_budget.hpp"
+
+/**
+ * @brief 预览金字塔各级buffer的缓冲池
+ *
+ * 每一级使用一个独立的帧缓冲池，buffer大小按该级的NV12图像计算。
+ * 内存预算执行reduce_preview_resolution时只保留最小的一级，更大级别的空闲buffer归还预算，
+ * 回落到低水位后恢复
+ */
+class preview_pyramid_pool {
+public:
+    // 第1/2/3级分别为原图的1/2、1/4、1/8
+    static constexpr size_t max_levels = 3;
+
+    /**
+     * @brief 构造函数
+     *
+     * @param width 原图宽度
+     * @param height 原图高度
+     * @param max_frames 每一级最多分配的buffer数量，一般与原图的帧缓冲池一致
+     * @param budget 共享的内存预算，为空时不限制
+     */
+    preview_pyramid_pool(uint32_t width, uint32_t height, size_t max_frames,
+                         std::shared_ptr<memory_budget> budget = nullptr);
+
+    /**
+     * @brief 析构函数，注销削减动作回调
+     */
+    ~preview_pyramid_pool();
+
+    // 削减动作回调引用该对象，禁止拷贝
+    preview_pyramid_pool(const preview_pyramid_pool&) = delete;
+    preview_pyramid_pool& operator=(const preview_pyramid_pool&) = delete;
+
+    /**
+     * @brief 获取某一级的空闲buffer
+     *
+     * @param level 级别（1~max_levels）
+     * @return std::shared_ptr<buffer> 空闲buffer，该级尺寸为0或池耗尽时返回nullptr
+     */
+    std::shared_ptr<buffer> acquire(size_t level);
+
+    uint32_t width() const { return _width; }
+    uint32_t height() const { return _height; }
+
+    /**
+     * @brief 设置是否降低预览分辨率，降低时释放更大级别的空闲buffer
+     *
+     * @param reduced true表示只保留最小的一级
+     */
+    void set_reduced(bool reduced);
+
+    /**
+     * @brief 保留的最大级别，正常时为1，降低预览分辨率时为max_levels
+     */
+    size_t first_level() const { return _reduced.load(std::memory_order_relaxed) ? max_levels : 1; }
+
+    /**
+     * @brief 计算某一级的尺寸，宽高向下取偶数
+     */
+    static void level_size(uint32_t width, uint32_t height, size_t level,
+                           uint32_t& level_width, uint32_t& level_height);
+
+private:
+    uint32_t _width;                                     // 原图宽度
+    uint32_t _height;                                    // 原图高度
+    std::unique_ptr<frame_pool> _pools[max_levels];      // 各级缓冲池
+    std::shared_ptr<memory_budget> _budget;              // 共享的内存预算
+    int _shed_handler_id;                                // 削减动作回调ID
+    std::atomic<bool> _reduced;                          // 是否降低预览分辨率
+};
+
+/**
+ * @brief 附加在帧上的缩小预览图
+ *
+ * 预览、运动检测和网络缩略图共用同一组缩小图像。第一次访问任一级时对原图做
+ * 一次遍历，同时生成全部级别并缓存，之后的访问直接返回缓存的buffer。
+ * 输入支持YUYV、UYVY、NV12和NV12M，各级输出均为NV12（亮度和色度都按2x2取平均）。
+ *
+ * 对象随帧缓冲池中的buffer复用，帧被回收时由帧缓冲池调用reset释放各级buffer。
+ * 使用者需在持有原图的期间访问金字塔
+ */
+class preview_pyramid {
+public:
+    static constexpr size_t max_levels = preview_pyramid_pool::max_levels;
+
+    /**
+     * @brief 构造函数
+     *
+     * @param source 所属的原图
+     */
+    explicit preview_pyramid(const buffer& source);
+
+    // 禁止拷贝
+    preview_pyramid(const preview_pyramid&) = delete;
+    preview_pyramid& operator=(const preview_pyramid&) = delete;
+
+    /**
+     * @brief 为帧附加金字塔，buffer已有金字塔时复用该对象
+     *
+     * @param frame 原图，格式元数据需已设置
+     * @param pool 各级buffer的缓冲池
+     */
+    static void attach(buffer& frame, std::shared_ptr<preview_pyramid_pool> pool);
+
+    /**
+     * @brief 获取某一级缩小图像，首次访问时生成全部级别
+     *
+     * 生成时缓冲池处于降低预览分辨率状态的，只保留最小的一级，请求更大的级别时返回该级，
+     * 使用者需按返回图像的宽高处理
+     *
+     * @param level 级别（1~max_levels）
+     * @return std::shared_ptr<buffer> NV12图像，格式不支持、尺寸过小或池耗尽时返回nullptr
+     */
+    std::shared_ptr<buffer> level(size_t level);
+
+    /**
+     * @brief 是否因内存压力只保留了最小的一级，首次访问前为false
+     */
+    bool reduced() const;
+
+    /**
+     * @brief 是否已生成
+     */
+    bool computed() const;
+
+    /**
+     * @brief 释放各级buffer并清除缓存
+     */
+    void reset();
+
+    /**
+     * @brief 是否支持该输入格式
+     */
+    static bool supports(uint32_t fourcc);
+
+private:
+    void build();
+
+    const buffer& _source;                               // 所属的原图
+    mutable std::mutex _mutex;                           // 保护生成状态
+    std::shared_ptr<preview_pyramid_pool> _pool;         // 各级buffer的缓冲池
+    bool _computed;                                      // 是否已生成
+    size_t _first_level;                                 // 保留的最大级别
+    std::shared_ptr<buffer> _levels[max_levels];         // 各级图像
+};
@@ -0,0 +1,263 @@
+#include "thread_policy.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+namespace {
+
+// 节点掩码位数，一个unsigned long覆盖64个NUMA节点
+constexpr int max_numa_nodes = 8 * sizeof(unsigned long);
+
+/**
+ * @brief 设置当前线程的内存优先节点
+ */
+bool set_preferred_node(int node)
+{
+    unsigned long mask = 1UL << node;
+    return syscall(SYS_set_mempolicy, MPOL_PREFERRED, &mask, max_numa_nodes + 1) == 0;
+}
+
+/**
+ * @brief 读取当前线程的内存优先节点
+ *
+ * @return 节点编号，非MPOL_PREFERRED策略时返回-1
+ */
+int get_preferred_node()
+{
+    int mode = 0;
+    unsigned long mask = 0;
+    if (syscall(SYS_get_mempolicy, &mode, &mask, max_numa_nodes + 1, nullptr, 0) != 0) {
+        return -1;
+    }
+    if (mode != MPOL_PREFERRED || mask == 0) {
+        return -1;
+    }
+    return __builtin_ctzl(mask);
+}
+
+/**
+ * @brief NUMA节点是否存在
+ */
+bool numa_node_exists(int node)
+{
+    struct stat st;
+    std::string path = "/sys/devices/system/node/node" + std::to_string(node);
+    return stat(path.c_str(), &st) == 0;
+}
+
+} // namespace
+
+/**
+ * @brief 设置角色的线程策略
+ */
+void thread_policy_set::set(thread_role role, const thread_policy& policy)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _policies[static_cast<size_t>(role)] = policy;
+}
+
+/**
+ * @brief 获取角色的线程策略
+ */
+thread_policy thread_policy_set::get(thread_role role) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _policies[static_cast<size_t>(role)];
+}
+
+/**
+ * @brief 启动前检查配置
+ */
+bool thread_policy_set::validate(std::vector<std::string>& errors) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    bool have_allowed = (sched_getaffinity(0, sizeof(allowed), &allowed) == 0);
+
+    int min_priority = sched_get_priority_min(SCHED_FIFO);
+    int max_priority = sched_get_priority_max(SCHED_FIFO);
+
+    size_t error_count = errors.size();
+    for (size_t r = 0; r < static_cast<size_t>(thread_role::count); ++r) {
+        const thread_policy& policy = _policies[r];
+        std::string name = role_name(static_cast<thread_role>(r));
+
+        for (int cpu : policy.cpus) {
+            if (cpu < 0 || cpu >= CPU_SETSIZE || (have_allowed && !CPU_ISSET(cpu, &allowed))) {
+                errors.push_back(name + ": CPU " + std::to_string(cpu) + " is not available to this process");
+            }
+        }
+        if (policy.realtime && (policy.priority < min_priority || policy.priority > max_priority)) {
+            errors.push_back(name + ": SCHED_FIFO priority " + std::to_string(policy.priority) +
+                             " out of range [" + std::to_string(min_priority) + ", " +
+                             std::to_string(max_priority) + "]");
+        }
+        if (policy.numa_node >= max_numa_nodes ||
+            (policy.numa_node >= 0 && !numa_node_exists(policy.numa_node))) {
+            errors.push_back(name + ": NUMA node " + std::to_string(policy.numa_node) + " does not exist");
+        }
+    }
+
+    // 采集线程与编码、存储线程共用CPU会带来DQBUF唤醒抖动
+    const thread_policy& capture = _policies[static_cast<size_t>(thread_role::capture)];
+    for (thread_role other : {thread_role::decode, thread_role::storage}) {
+        const thread_policy& policy = _policies[static_cast<size_t>(other)];
+        for (int cpu : capture.cpus) {
+            if (std::find(policy.cpus.begin(), policy.cpus.end(), cpu) != policy.cpus.end()) {
+                errors.push_back(std::string("capture shares CPU ") + std::to_string(cpu) +
+                                 " with " + role_name(other));
+            }
+        }
+    }
+
+    return errors.size() == error_count;
+}
+
+/**
+ * @brief 把策略应用到当前线程并校验
+ */
+thread_policy_status thread_policy_set::apply(thread_role role, int index) const
+{
+    thread_policy policy = get(role);
+
+    thread_policy_status status;
+    status.role = role;
+    status.index = index;
+
+    pthread_t self = pthread_self();
+
+    // 绑定CPU
+    std::vector<int> target;
+    if (!policy.cpus.empty()) {
+        if (policy.spread) {
+            target.push_back(policy.cpus[static_cast<size_t>(index) % policy.cpus.size()]);
+        } else {
+            target = policy.cpus;
+        }
+
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : target) {
+            if (cpu >= 0 && cpu < CPU_SETSIZE) {
+                CPU_SET(cpu, &set);
+            }
+        }
+        int ret = pthread_setaffinity_np(self, sizeof(set), &set);
+        if (ret != 0) {
+            status.ok = false;
+            status.error += std::string("affinity: ") + strerror(ret) + "; ";
+        }
+    }
+
+    // 实时调度，需要CAP_SYS_NICE或足够的RLIMIT_RTPRIO
+    if (policy.realtime) {
+        struct sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = policy.priority;
+        int ret = pthread_setschedparam(self, SCHED_FIFO, &param);
+        if (ret != 0) {
+            status.ok = false;
+            status.error += std::string("SCHED_FIFO: ") + strerror(ret) + "; ";
+        }
+    }
+
+    // 内存优先分配到绑定CPU所在的节点
+    int node = policy.numa_node;
+    if (node < 0 && !target.empty()) {
+        node = cpu_numa_node(target.front());
+        for (int cpu : target) {
+            if (cpu_numa_node(cpu) != node) {
+                node = -1;
+                break;
+            }
+        }
+    }
+    if (node >= 0 && node < max_numa_nodes && !set_preferred_node(node)) {
+        status.ok = false;
+        status.error += std::string("set_mempolicy: ") + strerror(errno) + "; ";
+    }
+
+    // 回读实际状态
+    cpu_set_t actual;
+    CPU_ZERO(&actual);
+    if (pthread_getaffinity_np(self, sizeof(actual), &actual) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &actual)) {
+                status.cpus.push_back(cpu);
+            }
+        }
+    }
+    int sched_policy = SCHED_OTHER;
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    if (pthread_getschedparam(self, &sched_policy, &param) == 0) {
+        status.realtime = (sched_policy == SCHED_FIFO);
+        status.priority = param.sched_priority;
+    }
+    status.numa_node = get_preferred_node();
+
+    // 校验
+    if (!target.empty()) {
+        std::vector<int> expected(target);
+        std::sort(expected.begin(), expected.end());
+        expected.erase(std::unique(expected.begin(), expected.end()), expected.end());
+        if (status.cpus != expected) {
+            status.ok = false;
+        }
+    }
+    if (policy.realtime && (!status.realtime || status.priority != policy.priority)) {
+        status.ok = false;
+    }
+    if (node >= 0 && status.numa_node != node) {
+        status.ok = false;
+    }
+    return status;
+}
+
+/**
+ * @brief 查询CPU所在的NUMA节点
+ */
+int thread_policy_set::cpu_numa_node(int cpu)
+{
+    std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+    DIR* dir = opendir(path.c_str());
+    if (!dir) {
+        return -1;
+    }
+
+    int node = -1;
+    while (struct dirent* entry = readdir(dir)) {
+        if (strncmp(entry->d_name, "node", 4) == 0 && entry->d_name[4] >= '0' && entry->d_name[4] <= '9') {
+            node = atoi(entry->d_name + 4);
+            break;
+        }
+    }
+    closedir(dir);
+    return node;
+}
+
+/**
+ * @brief 角色名称
+ */
+const char* thread_policy_set::role_name(thread_role role)
+{
+    switch (role) {
+    case thread_role::capture: return "capture";
+    case thread_role::sync:    return "sync";
+    case thread_role::decode:  return "decode";
+    case thread_role::storage: return "storage";
+    case thread_role::trigger: return "trigger";
+    default:                   return "unknown";
+    }
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief 线程角色
+ *
+ * 不同角色的线程对延迟的敏感程度不同，分别配置CPU、调度和内存节点
+ */
+enum class thread_role {
+    capture = 0,     // 摄像头采集（DQBUF）线程
+    sync,            // 同步组帧线程
+    decode,          // 解码/编码线程
+    storage,         // 存储线程
+    trigger,         // 触发调度线程
+    count
+};
+
+/**
+ * @brief 单个角色的线程策略
+ */
+struct thread_policy {
+    std::vector<int> cpus;       // 可运行的CPU，为空时不限制
+    bool spread = true;          // 同角色多个线程时按下标各绑定一个CPU，否则共享全部CPU
+    bool realtime = false;       // 是否使用SCHED_FIFO
+    int priority = 0;            // SCHED_FIFO优先级（1~99）
+    int numa_node = -1;          // 内存优先分配的NUMA节点，-1表示按绑定CPU所在节点推断
+};
+
+/**
+ * @brief 线程策略应用后的实际状态
+ */
+struct thread_policy_status {
+    thread_role role = thread_role::capture;    // 线程角色
+    int index = 0;                              // 同角色线程的下标
+    std::vector<int> cpus;                      // 实际可运行的CPU
+    bool realtime = false;                      // 实际是否为SCHED_FIFO
+    int priority = 0;                           // 实际优先级
+    int numa_node = -1;                         // 实际内存优先节点，-1表示默认策略
+    bool ok = true;                             // 实际状态是否与策略一致
+    std::string error;                          // 失败原因
+};
+
+/**
+ * @brief 按角色管理线程策略
+ *
+ * 线程启动后在自身线程内调用apply，绑定CPU、设置调度策略并把内存优先分配到
+ * 所在CPU的NUMA节点，随后回读实际状态进行校验。采集线程中帧缓冲池的buffer
+ * 按需分配并在分配时清零，因此会落在该线程所在的节点上
+ */
+class thread_policy_set {
+public:
+    /**
+     * @brief 设置角色的线程策略
+     */
+    void set(thread_role role, const thread_policy& policy);
+
+    /**
+     * @brief 获取角色的线程策略
+     */
+    thread_policy get(thread_role role) const;
+
+    /**
+     * @brief 启动前检查配置
+     *
+     * 检查CPU是否在进程允许的范围内、优先级是否有效、NUMA节点是否存在，
+     * 以及采集线程是否与解码、存储线程共用CPU
+     *
+     * @param errors 输出发现的问题
+     * @return true 没有发现问题
+     */
+    bool validate(std::vector<std::string>& errors) const;
+
+    /**
+     * @brief 把策略应用到当前线程并校验
+     *
+     * @param role 线程角色
+     * @param index 同角色线程的下标，用于spread模式选择CPU
+     * @return thread_policy_status 应用后的实际状态
+     */
+    thread_policy_status apply(thread_role role, int index = 0) const;
+
+    /**
+     * @brief 查询CPU所在的NUMA节点
+     *
+     * @return 节点编号，无法确定时返回-1
+     */
+    static int cpu_numa_node(int cpu);
+
+    /**
+     * @brief 角色名称
+     */
+    static const char* role_name(thread_role role);
+
+private:
+    mutable std::mutex _mutex;                                          // 互斥锁
+    thread_policy _policies[static_cast<size_t>(thread_role::count)];  // 各角色策略
+};
@@ -0,0 +1,198 @@
+#include "trigger_scheduler.hpp"
+
+#include <algorithm>
+#include <ctime>
+#include <iostream>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+#include "v4l2_camera_device.hpp"
+
+namespace {
+
+int64_t monotonic_ns()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+} // namespace
+
+/**
+ * @brief 构造函数
+ */
+trigger_scheduler::trigger_scheduler(const trigger_config& config)
+    : _config(config),
+      _timer_fd(timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC)),
+      _stop_fd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+      _running(false),
+      _late_sum_us(0)
+{
+    _config.fps = std::max(_config.fps, 1);
+    _config.spin_us = std::max<int64_t>(_config.spin_us, 0);
+}
+
+/**
+ * @brief 析构函数
+ */
+trigger_scheduler::~trigger_scheduler()
+{
+    stop();
+    if (_timer_fd >= 0) {
+        close(_timer_fd);
+    }
+    if (_stop_fd >= 0) {
+        close(_stop_fd);
+    }
+}
+
+/**
+ * @brief 添加被触发的摄像头
+ */
+void trigger_scheduler::add_camera(v4l2_camera_device* camera)
+{
+    if (camera && !_running && std::find(_cameras.begin(), _cameras.end(), camera) == _cameras.end()) {
+        _cameras.push_back(camera);
+    }
+}
+
+/**
+ * @brief 启动触发线程
+ */
+bool trigger_scheduler::start(std::shared_ptr<thread_policy_set> policies)
+{
+    if (_timer_fd < 0 || _stop_fd < 0) {
+        std::cerr << "Cannot start trigger scheduler: timerfd or eventfd unavailable" << std::endl;
+        return false;
+    }
+    if (_running.exchange(true)) {
+        return false;
+    }
+
+    // 清除上一次stop留下的通知
+    uint64_t value;
+    ssize_t ret = read(_stop_fd, &value, sizeof(value));
+    (void)ret;
+    _thread = std::thread(&trigger_scheduler::run, this, std::move(policies));
+    return true;
+}
+
+/**
+ * @brief 停止触发线程
+ */
+void trigger_scheduler::stop()
+{
+    if (!_running.exchange(false)) {
+        return;
+    }
+    uint64_t one = 1;
+    ssize_t ret = write(_stop_fd, &one, sizeof(one));
+    (void)ret;
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+}
+
+/**
+ * @brief 获取触发统计
+ */
+trigger_stats trigger_scheduler::get_stats() const
+{
+    std::lock_guard<std::mutex> lock(_stats_mutex);
+    return _stats;
+}
+
+/**
+ * @brief 触发线程
+ *
+ * 按绝对时间排定每个触发时刻，某一轮被延迟时跳过已经错过的周期，不累积漂移
+ */
+void trigger_scheduler::run(std::shared_ptr<thread_policy_set> policies)
+{
+    if (policies) {
+        thread_policy_status status = policies->apply(thread_role::trigger);
+        if (!status.ok) {
+            std::cerr << "Trigger thread policy not applied: " << status.error << std::endl;
+        }
+    }
+
+    const int64_t period_ns = 1000000000LL / _config.fps;
+    const int64_t spin_ns = std::min<int64_t>(_config.spin_us * 1000, period_ns / 2);
+    uint64_t next_id;
+    {
+        std::lock_guard<std::mutex> lock(_stats_mutex);
+        next_id = _stats.last_trigger_id + 1;
+    }
+
+    pollfd fds[2];
+    fds[0].fd = _timer_fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = _stop_fd;
+    fds[1].events = POLLIN;
+
+    int64_t deadline = monotonic_ns() + period_ns;
+    while (_running) {
+        int64_t wake = deadline - spin_ns;
+        itimerspec spec = {};
+        spec.it_value.tv_sec = wake / 1000000000;
+        spec.it_value.tv_nsec = wake % 1000000000;
+        if (timerfd_settime(_timer_fd, TFD_TIMER_ABSTIME, &spec, nullptr) != 0) {
+            std::cerr << "Trigger timer failed, stopping trigger scheduler" << std::endl;
+            break;
+        }
+
+        fds[0].revents = 0;
+        fds[1].revents = 0;
+        if (poll(fds, 2, -1) < 0 || (fds[1].revents & POLLIN)) {
+            continue;
+        }
+        uint64_t expirations;
+        ssize_t ret = read(_timer_fd, &expirations, sizeof(expirations));
+        (void)ret;
+
+        // 剩余时间忙等，定时器的唤醒延迟不进入触发时刻
+        int64_t now = monotonic_ns();
+        while (now < deadline) {
+            cpu_relax();
+            now = monotonic_ns();
+        }
+
+        uint64_t id = next_id++;
+        uint64_t rejected = 0;
+        for (auto* camera : _cameras) {
+            if (!camera->trigger(id)) {
+                ++rejected;
+            }
+        }
+
+        int64_t late_us = (now - deadline) / 1000;
+        deadline += period_ns;
+        uint64_t skipped = 0;
+        now = monotonic_ns();
+        if (now > deadline) {
+            skipped = static_cast<uint64_t>((now - deadline) / period_ns) + 1;
+            deadline += static_cast<int64_t>(skipped) * period_ns;
+        }
+
+        std::lock_guard<std::mutex> lock(_stats_mutex);
+        ++_stats.triggers;
+        _stats.rejected += rejected;
+        _stats.skipped_periods += skipped;
+        _stats.max_late_us = std::max(_stats.max_late_us, late_us);
+        _late_sum_us += late_us;
+        _stats.mean_late_us = _late_sum_us / _stats.triggers;
+        _stats.last_trigger_id = id;
+    }
+}
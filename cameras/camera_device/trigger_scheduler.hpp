@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "thread_policy.hpp"
+
+class v4l2_camera_device;
+
+/**
+ * @brief 软件触发配置
+ */
+struct trigger_config {
+    int fps = 30;                            // 触发频率，摄像头帧率应不低于该值
+    int64_t spin_us = 200;                   // 定时器提前唤醒、其后忙等到触发时刻的时长（微秒）
+    uint32_t control_id = 0;                 // 支持触发曝光的摄像头使用的按钮控制项ID
+    std::vector<int> hardware_cameras;       // 支持触发曝光的摄像头ID，其余摄像头以定时QBUF模拟触发
+};
+
+/**
+ * @brief 软件触发统计
+ */
+struct trigger_stats {
+    uint64_t triggers = 0;           // 发出的触发轮数
+    uint64_t rejected = 0;           // 摄像头未接受触发的次数（没有空闲缓冲区或驱动拒绝）
+    uint64_t skipped_periods = 0;    // 因线程被延迟而跳过的触发周期数
+    int64_t max_late_us = 0;         // 触发相对计划时刻的最大延迟（微秒）
+    double mean_late_us = 0;         // 触发相对计划时刻的平均延迟（微秒）
+    uint64_t last_trigger_id = 0;    // 最近一次触发的编号
+};
+
+/**
+ * @brief 多摄像头软件触发调度器
+ *
+ * 由一个线程按固定周期向所有摄像头发出同一编号的触发：CLOCK_MONOTONIC的timerfd在触发
+ * 时刻前spin_us唤醒，剩余时间忙等，避免定时器唤醒延迟带来的抖动。每个触发编号对应每个
+ * 摄像头的一帧，帧组可以按编号精确配对而不依赖时间戳窗口。
+ *
+ * 摄像头需先设置为触发模式（v4l2_camera_device::set_trigger_mode）
+ */
+class trigger_scheduler {
+public:
+    /**
+     * @brief 构造函数
+     *
+     * @param config 触发配置
+     */
+    explicit trigger_scheduler(const trigger_config& config = trigger_config());
+
+    /**
+     * @brief 析构函数，停止触发线程
+     */
+    ~trigger_scheduler();
+
+    // 禁止拷贝
+    trigger_scheduler(const trigger_scheduler&) = delete;
+    trigger_scheduler& operator=(const trigger_scheduler&) = delete;
+
+    /**
+     * @brief 添加被触发的摄像头，需在start之前调用，重复添加时忽略
+     */
+    void add_camera(v4l2_camera_device* camera);
+
+    /**
+     * @brief 启动触发线程
+     *
+     * @param policies 线程策略，触发线程按trigger角色应用，为空时不做设置
+     * @return true 启动成功
+     * @return false 已在运行或无法创建定时器
+     */
+    bool start(std::shared_ptr<thread_policy_set> policies = nullptr);
+
+    /**
+     * @brief 停止触发线程
+     */
+    void stop();
+
+    /**
+     * @brief 获取触发配置
+     */
+    const trigger_config& config() const { return _config; }
+
+    /**
+     * @brief 获取触发统计
+     */
+    trigger_stats get_stats() const;
+
+private:
+    void run(std::shared_ptr<thread_policy_set> policies);
+
+    trigger_config _config;                      // 触发配置
+    std::vector<v4l2_camera_device*> _cameras;   // 被触发的摄像头
+    int _timer_fd;                               // CLOCK_MONOTONIC定时器
+    int _stop_fd;                                // 通知触发线程退出的eventfd
+    std::thread _thread;                         // 触发线程
+    std::atomic<bool> _running;                  // 触发线程是否在运行
+
+    mutable std::mutex _stats_mutex;             // 保护_stats
+    trigger_stats _stats;                        // 触发统计
+    double _late_sum_us;                         // 延迟之和，用于平均延迟
+};
@@ -1,6 +1,66 @@
 #include "v4l2_camera_device.hpp"
+#include "frame_dispatcher.hpp"
+#include "libv4l2cpp/inc/V4l2MmapDevice.h"
+#include <algorithm>
 #include <iostream>
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
 #include <linux/videodev2.h>
+#include "libv4l2cpp/inc/logger.h"
+
+namespace {
+
+/**
+ * @brief 读取设备节点的总线信息，用于识别重新插入后编号改变的设备
+ *
+ * @param syscalls 访问设备使用的系统调用，与打开设备时相同
+ * @param device_path 设备节点
+ * @return 总线信息，节点不存在或不是V4L2设备时为空
+ */
+std::string query_bus_info(V4l2Syscalls* syscalls, const std::string& device_path)
+{
+    int fd = syscalls->open(device_path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        return std::string();
+    }
+
+    std::string bus_info;
+    struct v4l2_capability cap;
+    memset(&cap, 0, sizeof(cap));
+    if (syscalls->ioctl(fd, VIDIOC_QUERYCAP, &cap) == 0) {
+        const char* info = reinterpret_cast<const char*>(cap.bus_info);
+        bus_info.assign(info, strnlen(info, sizeof(cap.bus_info)));
+    }
+    syscalls->close(fd);
+    return bus_info;
+}
+
+/**
+ * @brief 列出/dev下的全部video节点
+ */
+std::vector<std::string> list_video_nodes()
+{
+    std::vector<std::string> nodes;
+    DIR* dir = opendir("/dev");
+    if (!dir) {
+        return nodes;
+    }
+    while (struct dirent* entry = readdir(dir)) {
+        if (strncmp(entry->d_name, "video", 5) == 0) {
+            nodes.push_back(std::string("/dev/") + entry->d_name);
+        }
+    }
+    closedir(dir);
+    return nodes;
+}
+
+} // namespace
 
 /**
  * @brief 构造函数
@@ -17,7 +77,25 @@ v4l2_camera_device::v4l2_camera_device(const std::string& device_path,
       _camera_id(camera_id),
       _is_capturing(false),
       _timestamp(0),
-      _capture(nullptr)
+      _capture(nullptr),
+      _trigger_mode(camera_trigger::free_running),
+      _trigger_control(0),
+      _pool_size(8),
+      _io_type(IOTYPE_MMAP),
+      _driver_buffers(0),
+      _preview_pyramid(false),
+      _dropped_frames(0),
+      _driver_drops(0),
+      _last_restart_us(0),
+      _restart_at_us(0),
+      _last_stream_on_us(0),
+      _fps(30),
+      _health(camera_health::ok),
+      _consecutive_errors(0),
+      _stop_recovery(false),
+      _sink_active(false),
+      _stop_delivery(false),
+      _syscalls(nullptr)
 {
 }
 
@@ -26,6 +104,13 @@ v4l2_camera_device::v4l2_camera_device(const std::string& device_path,
  */
 v4l2_camera_device::~v4l2_camera_device()
 {
+    // 先结束回调线程和后台恢复线程
+    clear_frame_sink();
+    _stop_recovery = true;
+    if (_recovery_thread.joinable()) {
+        _recovery_thread.join();
+    }
+
     // 如果还在捕获，先停止
     if (_is_capturing) {
         stop_capture();
@@ -41,16 +126,38 @@ bool v4l2_camera_device::initialize()
     
     try {
         // 创建V4L2设备参数，指定使用MMAP模式
-        V4L2DeviceParameters params(_device_path.c_str(), _format, _width, _height, 30);
-        params.m_iotype = IOTYPE_MMAP; // 使用MMAP模式，更高效
+        V4L2DeviceParameters params(_device_path.c_str(), _format, _width, _height, _fps);
+        params.m_iotype = _io_type;                 // 默认使用MMAP模式，更高效
+        params.m_bufferCount = _driver_buffers;     // 为0时使用默认数量
+        params.m_bytesPerLineAlign = buffer::alignment; // 驱动允许时行跨度按缓存行对齐
+        params.m_syscalls = _syscalls;              // 为空时使用系统调用
         
         // 创建V4L2捕获设备
-        _capture.reset(V4l2Capture::create(params));
+        std::unique_ptr<V4l2Capture> capture(V4l2Capture::create(params));
+        {
+            std::lock_guard<std::mutex> trigger_lock(_trigger_mutex);
+            _capture = std::move(capture);
+        }
         
         if (!_capture) {
             std::cerr << "Failed to create V4L2 capture for device: " << _device_path << std::endl;
             return false;
         }
+        // 新打开的设备为自由运行
+        if (_trigger_mode != camera_trigger::free_running) {
+            apply_trigger_mode();
+        }
+        
+        _bus_info = _capture->getBusInfo();
+        if (_capture->getFps() > 0) {
+            // 驱动实际采用的帧率
+            _fps = _capture->getFps();
+        }
+        
+        // 按协商后的缓冲区大小创建帧缓冲池
+        size_t buffer_size = _capture->getBufferSize();
+        _pool.reset(new frame_pool(buffer_size, _pool_size, _budget));
+        _discard.resize(buffer_size);
         
         std::cout << "Device " << _device_path << " initialized with format: " 
                   << _capture->getFormat() << " size: " << _capture->getWidth() 
@@ -71,6 +178,11 @@ bool v4l2_camera_device::start_capture()
     std::lock_guard<std::mutex> lock(_mutex);
     
     if (!_capture) {
+        if (_health == camera_health::degraded) {
+            // 设备恢复后自动开始采集
+            _is_capturing = true;
+            return true;
+        }
         std::cerr << "Cannot start capture: device not initialized" << std::endl;
         return false;
     }
@@ -80,7 +192,11 @@ bool v4l2_camera_device::start_capture()
         return true;
     }
     
-    // MMAP模式在初始化时已经启动了流，这里只需标记状态
+    // MMAP模式在初始化时已经启动了流，stop_capture暂停后复用已映射的缓冲区恢复
+    if (!_capture->resume()) {
+        std::cerr << "Failed to resume stream on device " << _device_path << std::endl;
+        return false;
+    }
     _is_capturing = true;
     return true;
 }
@@ -97,8 +213,13 @@ bool v4l2_camera_device::stop_capture()
         return true;
     }
     
-    // 标记状态为停止
+    // 只停止视频流，保留缓冲区映射和帧缓冲池，以便快速恢复
     _is_capturing = false;
+    _restart_at_us = 0;
+    if (_capture && !_capture->pause()) {
+        std::cerr << "Failed to pause stream on device " << _device_path << std::endl;
+        return false;
+    }
     return true;
 }
 
@@ -109,52 +230,74 @@ std::shared_ptr<buffer> v4l2_camera_device::get_frame()
 {
     std::lock_guard<std::mutex> lock(_mutex);
     
+    if (_sink_active) {
+        // 帧由回调推送
+        return nullptr;
+    }
+
+    bool timed_out = false;
+    auto frame = read_frame(1000000, timed_out);  // 1秒超时
+    if (timed_out) {
+        std::cerr << "Timeout waiting for frame on device " << _device_path << std::endl;
+    }
+    return frame;
+}
+
+/**
+ * @brief 等待并读取一帧，调用者需持有_mutex
+ */
+std::shared_ptr<buffer> v4l2_camera_device::read_frame(long timeout_us, bool& timed_out)
+{
+    timed_out = false;
     if (!_capture || !_is_capturing) {
         return nullptr;
     }
+
+    // libv4l2cpp在本次采集中输出的日志带上设备和摄像头编号
+    LogContext log_context(_device_path.c_str(), _camera_id);
     
     try {
-        // 检查是否有数据可读
-        struct timeval tv;
-        tv.tv_sec = 1;  // 1秒超时
-        tv.tv_usec = 0;
-        
-        if (!_capture->isReadable(&tv)) {
-            std::cerr << "Timeout waiting for frame on device " << _device_path << std::endl;
+        if (!wait_readable(timeout_us, timed_out)) {
             return nullptr;
         }
         
-        // 获取当前时间戳（简单使用系统时钟）
-        auto now = std::chrono::high_resolution_clock::now();
+        // 获取当前时间戳（系统时钟，对应clock_domain::realtime）
+        auto now = std::chrono::system_clock::now();
         _timestamp = std::chrono::duration_cast<std::chrono::microseconds>(
             now.time_since_epoch()).count();
             
-        // 估计需要的缓冲区大小
-        size_t buffer_size = _capture->getBufferSize();
-        if (buffer_size == 0) {
+        if (!_pool || _pool->frame_size() == 0) {
             std::cerr << "Invalid buffer size for device " << _device_path << std::endl;
             return nullptr;
         }
         
-        // 创建buffer对象
-        auto frame = std::make_shared<buffer>(buffer_size);
+        // 从帧缓冲池获取buffer，超出预算时取走并丢弃该帧，避免驱动队列阻塞
+        auto frame = _pool->acquire();
         if (!frame) {
-            std::cerr << "Failed to allocate buffer for frame" << std::endl;
+            if (_capture->read(_discard.data(), _discard.size()) == static_cast<size_t>(-1)) {
+                handle_read_error(_capture->getLastError());
+            } else {
+                ++_dropped_frames;
+            }
             return nullptr;
         }
+        size_t buffer_size = frame->size();
         
         // 直接从设备读取数据到buffer
         size_t bytes_read = _capture->read(static_cast<char*>(frame->data()), buffer_size);
         
-        if (bytes_read <= 0) {
+        if (bytes_read == static_cast<size_t>(-1)) {
             std::cerr << "Failed to read frame from device " << _device_path << std::endl;
+            handle_read_error(_capture->getLastError());
             return nullptr;
         }
+        if (bytes_read == 0) {
+            // 非阻塞模式下暂无数据
+            return nullptr;
+        }
+        _consecutive_errors = 0;
         
-        // 调整buffer大小为实际读取的字节数
-        frame->resize(bytes_read);
-        frame->set_timestamp(_timestamp);
-        
+        finish_frame(*frame, bytes_read, _timestamp, _capture->getLastTriggerId());
         return frame;
     } catch (const std::exception& e) {
         std::cerr << "Exception during frame capture: " << e.what() << std::endl;
@@ -162,6 +305,294 @@ std::shared_ptr<buffer> v4l2_camera_device::get_frame()
     }
 }
 
+/**
+ * @brief 等待并一次读取全部已就绪的帧，调用者需持有_mutex
+ */
+size_t v4l2_camera_device::read_frames(long timeout_us, bool& timed_out,
+                                       std::vector<std::shared_ptr<buffer>>& frames, size_t max_frames)
+{
+    timed_out = false;
+    if (!_capture || !_is_capturing || max_frames == 0) {
+        return 0;
+    }
+
+    LogContext log_context(_device_path.c_str(), _camera_id);
+
+    try {
+        if (!wait_readable(timeout_us, timed_out)) {
+            return 0;
+        }
+        if (!_pool || _pool->frame_size() == 0) {
+            std::cerr << "Invalid buffer size for device " << _device_path << std::endl;
+            return 0;
+        }
+
+        // 按驱动缓冲区数量准备目标buffer，本次没有用到的随即回到池中
+        size_t capacity = std::min<size_t>(max_frames, V4L2MMAP_NBBUFFER);
+        std::shared_ptr<buffer> targets[V4L2MMAP_NBBUFFER];
+        char* data[V4L2MMAP_NBBUFFER];
+        V4l2FrameInfo infos[V4L2MMAP_NBBUFFER];
+        size_t acquired = 0;
+        while (acquired < capacity && (targets[acquired] = _pool->acquire())) {
+            data[acquired] = static_cast<char*>(targets[acquired]->data());
+            ++acquired;
+        }
+        if (acquired == 0) {
+            // 缓冲池耗尽时与read_frame一样取走并丢弃一帧
+            auto frame = read_frame(0, timed_out);
+            if (frame) {
+                frames.push_back(std::move(frame));
+                return 1;
+            }
+            return 0;
+        }
+
+        size_t count = _capture->readBatch(data, _pool->frame_size(), infos, acquired);
+        if (count == static_cast<size_t>(-1)) {
+            std::cerr << "Failed to read frame from device " << _device_path << std::endl;
+            handle_read_error(_capture->getLastError());
+            return 0;
+        }
+        if (count == 0) {
+            return 0;
+        }
+        _consecutive_errors = 0;
+
+        // 同一批的帧在同一时刻取出，按驱动时间戳的间隔向前推算各帧的系统时钟时间戳
+        _timestamp = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        const long long newest_us = infos[count - 1].m_timestampUs;
+        for (size_t i = 0; i < count; ++i) {
+            const V4l2FrameInfo& info = infos[i];
+            int64_t age_us = 0;
+            if (info.m_timestampUs > 0 && newest_us >= info.m_timestampUs) {
+                age_us = newest_us - info.m_timestampUs;
+            }
+            buffer& frame = *targets[info.m_slot];
+            finish_frame(frame, info.m_size, _timestamp - age_us, info.m_triggerId);
+            frames.push_back(std::move(targets[info.m_slot]));
+        }
+        return count;
+    } catch (const std::exception& e) {
+        std::cerr << "Exception during frame capture: " << e.what() << std::endl;
+        return 0;
+    }
+}
+
+/**
+ * @brief 等待设备可读，等待期间到了计划的重启时间时先重启视频流
+ *
+ * @return true 设备可读
+ * @return false 超时，timed_out为true
+ */
+bool v4l2_camera_device::wait_readable(long timeout_us, bool& timed_out)
+{
+    while (true) {
+        long wait_us = timeout_us;
+        bool restart_due = false;
+        int64_t restart_at = _restart_at_us;
+        if (restart_at > 0) {
+            int64_t remaining = restart_at - std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+            if (remaining <= 0) {
+                _restart_at_us.compare_exchange_strong(restart_at, 0);
+                restart_stream_locked();
+                _last_stream_on_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::system_clock::now().time_since_epoch()).count();
+                continue;
+            }
+            if (remaining < wait_us) {
+                wait_us = static_cast<long>(remaining);
+                restart_due = true;
+            }
+        }
+
+        struct timeval tv;
+        tv.tv_sec = wait_us / 1000000;
+        tv.tv_usec = wait_us % 1000000;
+        if (_capture->isReadable(&tv)) {
+            return true;
+        }
+        if (!restart_due) {
+            timed_out = true;
+            return false;
+        }
+        timeout_us -= wait_us;
+    }
+}
+
+/**
+ * @brief 填写读出帧的大小、时间戳、平面布局和格式
+ */
+void v4l2_camera_device::finish_frame(buffer& frame, size_t bytes_read, int64_t timestamp, uint64_t trigger_id)
+{
+    // 调整buffer大小为实际读取的字节数
+    frame.resize(bytes_read);
+    frame.set_timestamp(timestamp);
+    frame.set_trigger_id(trigger_id);
+    
+    // 记录平面布局，多平面格式的各平面依次存放在buffer中
+    buffer::plane planes[buffer::max_planes];
+    size_t plane_count = std::min<size_t>(_capture->getNumPlanes(), buffer::max_planes);
+    for (size_t i = 0; i < plane_count; ++i) {
+        planes[i].offset = _capture->getPlaneOffset(i);
+        planes[i].size = _capture->getPlaneSize(i);
+        planes[i].bytesperline = _capture->getBytesPerLine(i);
+        if (planes[i].offset >= bytes_read) {
+            plane_count = i;
+            break;
+        }
+        planes[i].size = std::min(planes[i].size, bytes_read - planes[i].offset);
+    }
+    frame.set_planes(planes, plane_count);
+    
+    // 记录驱动实际协商的格式和来源，下游无需再查询设备
+    frame.set_format(_capture->getWidth(), _capture->getHeight(), _capture->getFormat());
+    frame.set_camera_id(_camera_id);
+    frame.set_clock(clock_domain::realtime);
+    
+    if (_preview_pyramid) {
+        // 分辨率变化后按新尺寸重建各级缓冲池，旧的buffer随使用者释放
+        if (!_pyramid_pool || _pyramid_pool->width() != frame.width() ||
+            _pyramid_pool->height() != frame.height()) {
+            _pyramid_pool = std::make_shared<preview_pyramid_pool>(
+                frame.width(), frame.height(), _pool_size, _budget);
+        }
+        preview_pyramid::attach(frame, _pyramid_pool);
+    }
+}
+
+/**
+ * @brief 不等待地读取一帧
+ */
+std::shared_ptr<buffer> v4l2_camera_device::try_get_frame()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (_sink_active) {
+        return nullptr;
+    }
+    bool timed_out = false;
+    return read_frame(0, timed_out);
+}
+
+/**
+ * @brief 获取可等待可读事件的文件描述符
+ */
+int v4l2_camera_device::get_fd() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (!_capture || !_is_capturing || _sink_active) {
+        return -1;
+    }
+    return _capture->getFd();
+}
+
+/**
+ * @brief 设置驱动设备使用的系统调用
+ */
+void v4l2_camera_device::set_syscalls(V4l2Syscalls* syscalls)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _syscalls = syscalls;
+}
+
+/**
+ * @brief 注册推送方式的帧回调
+ */
+bool v4l2_camera_device::set_frame_sink(frame_sink sink, const frame_sink_options& options)
+{
+    if (!sink) {
+        return false;
+    }
+    clear_frame_sink();
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _sink = std::move(sink);
+        _sink_options = options;
+        _sink_options.max_batch = std::max<size_t>(_sink_options.max_batch, 1);
+        _sink_active = true;
+    }
+    if (_sink_options.dispatcher) {
+        _sink_options.dispatcher->attach(this, _sink);
+    }
+    _stop_delivery = false;
+    _delivery_thread = std::thread(&v4l2_camera_device::delivery_loop, this);
+    return true;
+}
+
+/**
+ * @brief 注销帧回调
+ */
+void v4l2_camera_device::clear_frame_sink()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_sink_active) {
+            return;
+        }
+        _sink_active = false;
+    }
+
+    _stop_delivery = true;
+    if (_delivery_thread.joinable()) {
+        _delivery_thread.join();
+    }
+    if (_sink_options.dispatcher) {
+        _sink_options.dispatcher->detach(this);
+    }
+    _sink = nullptr;
+    _sink_options = frame_sink_options();
+}
+
+/**
+ * @brief 回调线程，取帧后直接回调或交给分发线程
+ *
+ * 已就绪的帧在一次回调中交付，最多max_batch帧；没有新帧时按idle_interval_us以空批次回调
+ */
+void v4l2_camera_device::delivery_loop()
+{
+    const int64_t idle_us = _sink_options.idle_interval_us;
+    // 等待新帧的超时不超过100ms，以便及时响应注销
+    const long wait_us = static_cast<long>(idle_us > 0 ? std::min<int64_t>(idle_us, 100000) : 100000);
+    auto last_delivery = std::chrono::steady_clock::now();
+
+    std::vector<std::shared_ptr<buffer>> frames;
+    while (!_stop_delivery) {
+        frames.clear();
+        frames.reserve(_sink_options.max_batch);
+
+        bool ready = false;
+        bool timed_out = false;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            ready = _capture && _is_capturing;
+            // 一次取走驱动中全部已就绪的帧，积压后不必逐帧select
+            read_frames(wait_us, timed_out, frames, _sink_options.max_batch);
+        }
+
+        if (frames.empty() && !timed_out) {
+            // 未开始采集、降级恢复中或读帧失败，稍后重试
+            std::this_thread::sleep_for(std::chrono::microseconds(ready ? 5000 : wait_us));
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (frames.empty() &&
+            (idle_us <= 0 || now - last_delivery < std::chrono::microseconds(idle_us))) {
+            continue;
+        }
+        last_delivery = now;
+
+        if (_sink_options.dispatcher) {
+            _sink_options.dispatcher->post(this, std::move(frames));
+        } else {
+            _sink(frames);
+        }
+    }
+}
+
 /**
  * @brief 获取时间戳
  */
@@ -178,11 +609,20 @@ int v4l2_camera_device::get_camera_id() const
     return _camera_id;
 }
 
+/**
+ * @brief 获取运行状态
+ */
+camera_health v4l2_camera_device::get_health() const
+{
+    return _health;
+}
+
 /**
  * @brief 获取实际宽度
  */
 unsigned int v4l2_camera_device::get_width() const
 {
+    std::lock_guard<std::mutex> lock(_mutex);
     if (_capture) {
         return _capture->getWidth();
     }
@@ -194,6 +634,7 @@ unsigned int v4l2_camera_device::get_width() const
  */
 unsigned int v4l2_camera_device::get_height() const
 {
+    std::lock_guard<std::mutex> lock(_mutex);
     if (_capture) {
         return _capture->getHeight();
     }
@@ -205,8 +646,472 @@ unsigned int v4l2_camera_device::get_height() const
  */
 unsigned int v4l2_camera_device::get_format() const
 {
+    std::lock_guard<std::mutex> lock(_mutex);
     if (_capture) {
         return _capture->getFormat();
     }
     return _format;
 }
+
+/**
+ * @brief 获取总线信息
+ */
+std::string v4l2_camera_device::get_bus_info() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _bus_info;
+}
+
+/**
+ * @brief 获取初始化各阶段耗时
+ */
+V4l2StartupTiming v4l2_camera_device::get_startup_timing() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_capture) {
+        return _capture->getStartupTiming();
+    }
+    return V4l2StartupTiming();
+}
+
+/**
+ * @brief 设置共享的内存预算
+ */
+void v4l2_camera_device::set_memory_budget(std::shared_ptr<memory_budget> budget, size_t pool_size)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _budget = std::move(budget);
+    _pool_size = pool_size;
+}
+
+/**
+ * @brief 获取帧缓冲池容量
+ */
+size_t v4l2_camera_device::get_pool_size() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _pool_size;
+}
+
+/**
+ * @brief 设置IO方式和驱动缓冲区数量
+ */
+void v4l2_camera_device::set_io_mode(V4l2IoType io_type, unsigned int driver_buffers)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _io_type = io_type;
+    _driver_buffers = driver_buffers;
+}
+
+/**
+ * @brief 启用或关闭预览金字塔
+ */
+void v4l2_camera_device::enable_preview_pyramid(bool enable)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _preview_pyramid = enable;
+    if (!enable) {
+        _pyramid_pool.reset();
+    }
+}
+
+/**
+ * @brief 获取丢弃的帧数
+ */
+uint64_t v4l2_camera_device::get_dropped_frames() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _dropped_frames;
+}
+
+/**
+ * @brief 获取驱动丢弃的帧数
+ */
+uint64_t v4l2_camera_device::get_driver_drops() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _driver_drops + (_capture ? _capture->getDriverDrops() : 0);
+}
+
+/**
+ * @brief 运行时修改格式和分辨率
+ */
+bool v4l2_camera_device::set_format(unsigned int format, unsigned int width, unsigned int height)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (!_capture) {
+        return false;
+    }
+    if (_capture->setFormat(format, width, height) != 0) {
+        std::cerr << "Failed to change format on device " << _device_path << std::endl;
+        check_device_after_failure();
+        return false;
+    }
+
+    // 记录当前格式，设备恢复时按该格式重新初始化
+    _format = _capture->getFormat();
+    _width = _capture->getWidth();
+    _height = _capture->getHeight();
+
+    // 新帧超过原有buffer时才重建帧缓冲池，已发出的buffer由持有者继续使用
+    size_t buffer_size = _capture->getBufferSize();
+    if (!_pool || buffer_size > _pool->frame_size()) {
+        _pool.reset(new frame_pool(buffer_size, _pool_size, _budget));
+        _discard.resize(buffer_size);
+    }
+    return true;
+}
+
+/**
+ * @brief 运行时修改帧率
+ */
+bool v4l2_camera_device::set_fps(int fps)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (fps <= 0) {
+        return false;
+    }
+    if (!_capture) {
+        // 尚未初始化，初始化时使用
+        _fps = fps;
+        return true;
+    }
+    // MMAP设备在采集中先停止视频流再设置，缓冲区保持不变
+    if (_capture->setFps(fps) != 0) {
+        std::cerr << "Device " << _device_path << " rejected " << fps << " fps" << std::endl;
+        check_device_after_failure();
+        return false;
+    }
+    // 驱动可能把帧率调整到支持的值
+    _fps = (_capture->getFps() > 0) ? _capture->getFps() : fps;
+    if (_fps != fps) {
+        std::cout << "Device " << _device_path << " runs at " << _fps << " fps instead of " << fps << std::endl;
+    }
+    return true;
+}
+
+/**
+ * @brief 修改参数失败后检查设备，已无法采集时交给降级和恢复流程
+ */
+void v4l2_camera_device::check_device_after_failure()
+{
+    // 设备恢复原设置失败时没有缓冲区或视频流保持停止
+    if (_capture->isReady() && (!_is_capturing || _capture->isStreaming())) {
+        return;
+    }
+    int error = _capture->getLastError();
+    std::cerr << "Device " << _device_path << " cannot capture after a failed change" << std::endl;
+    enter_degraded(error != 0 ? error : EIO);
+}
+
+/**
+ * @brief 获取帧率
+ */
+int v4l2_camera_device::get_fps() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _fps;
+}
+
+/**
+ * @brief 快速重启视频流
+ */
+bool v4l2_camera_device::restart_stream()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (!_capture) {
+        return false;
+    }
+    return restart_stream_locked();
+}
+
+/**
+ * @brief 执行STREAMOFF/STREAMON
+ */
+bool v4l2_camera_device::restart_stream_locked()
+{
+    auto start = std::chrono::steady_clock::now();
+    bool success = _capture->pause() && _capture->resume();
+    _last_restart_us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+
+    if (!success) {
+        std::cerr << "Failed to restart stream on device " << _device_path << std::endl;
+    }
+    return success;
+}
+
+/**
+ * @brief 设置采集的触发方式
+ */
+bool v4l2_camera_device::set_trigger_mode(camera_trigger mode, uint32_t control_id)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _trigger_mode = mode;
+    _trigger_control = control_id;
+    return !_capture || apply_trigger_mode();
+}
+
+/**
+ * @brief 把触发方式应用到当前设备，调用者需持有_mutex
+ */
+bool v4l2_camera_device::apply_trigger_mode()
+{
+    V4l2TriggerMode mode = TRIGGER_NONE;
+    switch (_trigger_mode) {
+    case camera_trigger::emulated: mode = TRIGGER_QBUF;    break;
+    case camera_trigger::hardware: mode = TRIGGER_CONTROL; break;
+    default:                       break;
+    }
+    if (!_capture->setTriggerMode(mode, _trigger_control)) {
+        std::cerr << "Failed to set trigger mode on device " << _device_path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief 发出一次触发
+ */
+bool v4l2_camera_device::trigger(uint64_t id)
+{
+    std::lock_guard<std::mutex> lock(_trigger_mutex);
+    return _capture && _capture->trigger(static_cast<unsigned long>(id));
+}
+
+/**
+ * @brief 安排在指定时间重启视频流
+ */
+void v4l2_camera_device::schedule_restart(int64_t at_us)
+{
+    _restart_at_us = std::max<int64_t>(at_us, 1);
+}
+
+/**
+ * @brief 获取最近一次按计划重启后STREAMON完成的时间
+ */
+int64_t v4l2_camera_device::get_last_stream_on_us() const
+{
+    return _last_stream_on_us;
+}
+
+/**
+ * @brief 获取最近一次重启视频流的耗时
+ */
+int64_t v4l2_camera_device::get_last_restart_us() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _last_restart_us;
+}
+
+/**
+ * @brief 获取故障恢复统计
+ */
+camera_recovery_stats v4l2_camera_device::get_recovery_stats() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _recovery_stats;
+}
+
+/**
+ * @brief 按errno分类处理读帧失败
+ */
+void v4l2_camera_device::handle_read_error(int error)
+{
+    switch (error) {
+    case 0:
+    case EAGAIN:
+    case EINTR:
+        // 暂无数据或被信号打断，下次重试
+        return;
+
+    case ENODEV:
+    case ENXIO:
+        // 设备已拔出，重启视频流无效，直接进入降级状态
+        std::cerr << "Device " << _device_path << " lost: " << strerror(error) << std::endl;
+        enter_degraded(error);
+        return;
+
+    default:
+        // EIO等错误可能只是USB传输的短暂抖动，连续出现时先尝试快速重启视频流
+        if (++_consecutive_errors < max_consecutive_errors) {
+            return;
+        }
+        _consecutive_errors = 0;
+        if (_capture->pause() && _capture->resume()) {
+            std::cerr << "Device " << _device_path << " stream restarted after: " << strerror(error) << std::endl;
+            return;
+        }
+        std::cerr << "Device " << _device_path << " failed to restart: " << strerror(error) << std::endl;
+        enter_degraded(error);
+        return;
+    }
+}
+
+/**
+ * @brief 进入降级状态并启动后台恢复
+ */
+void v4l2_camera_device::enter_degraded(int error)
+{
+    _health = camera_health::degraded;
+    _degraded_since = std::chrono::steady_clock::now();
+    _consecutive_errors = 0;
+    ++_recovery_stats.degraded_count;
+    _recovery_stats.last_error = error;
+
+    // 释放设备句柄和映射，已发出的帧由持有者继续使用
+    {
+        std::lock_guard<std::mutex> trigger_lock(_trigger_mutex);
+        if (_capture) {
+            _driver_drops += _capture->getDriverDrops();
+        }
+        _capture.reset();
+    }
+
+    // 上一次恢复线程在恢复成功后即退出，这里只需回收
+    if (_recovery_thread.joinable()) {
+        _recovery_thread.join();
+    }
+    _stop_recovery = false;
+    _recovery_thread = std::thread(&v4l2_camera_device::recovery_loop, this);
+}
+
+/**
+ * @brief 后台恢复线程
+ */
+void v4l2_camera_device::recovery_loop()
+{
+    // 监视/dev下节点的创建和权限变更，udev先创建节点再设置权限
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd >= 0 && inotify_add_watch(fd, "/dev", IN_CREATE | IN_ATTRIB) < 0) {
+        ::close(fd);
+        fd = -1;
+    }
+
+    bool recovered = false;
+    while (!_stop_recovery && !recovered) {
+        // 有事件或超时后都重新扫描一次，避免错过事件
+        if (fd >= 0) {
+            struct pollfd pfd;
+            pfd.fd = fd;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            if (poll(&pfd, 1, 500) > 0) {
+                char events[4096];
+                while (::read(fd, events, sizeof(events)) > 0) {
+                }
+            }
+        } else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        }
+        if (_stop_recovery) {
+            break;
+        }
+
+        // 设备参数可能被其他线程修改，每轮扫描前在锁内取一份
+        std::string device_path;
+        std::string expected_bus_info;
+        V4l2Syscalls* syscalls = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            device_path = _device_path;
+            expected_bus_info = _bus_info;
+            syscalls = _syscalls ? _syscalls : V4l2Syscalls::system();
+        }
+
+        // 优先尝试原节点，再按bus_info匹配编号改变的节点，探测与打开设备使用同一组系统调用
+        std::vector<std::string> candidates = list_video_nodes();
+        candidates.erase(std::remove(candidates.begin(), candidates.end(), device_path), candidates.end());
+        candidates.insert(candidates.begin(), device_path);
+        for (const auto& candidate : candidates) {
+            std::string bus_info = query_bus_info(syscalls, candidate);
+            if (bus_info.empty()) {
+                continue;
+            }
+            if (expected_bus_info.empty() ? (candidate != device_path) : (bus_info != expected_bus_info)) {
+                continue;
+            }
+            if (try_reopen(candidate)) {
+                recovered = true;
+                break;
+            }
+        }
+    }
+
+    if (fd >= 0) {
+        ::close(fd);
+    }
+}
+
+/**
+ * @brief 在指定节点上重新初始化设备
+ */
+bool v4l2_camera_device::try_reopen(const std::string& device_path)
+{
+    // 设备参数可能同时被修改，先在锁内取一份；打开和协商格式较慢，不持有锁
+    unsigned int format, width, height;
+    int fps;
+    V4l2IoType io_type;
+    unsigned int driver_buffers;
+    V4l2Syscalls* syscalls;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        format = _format;
+        width = _width;
+        height = _height;
+        fps = _fps;
+        io_type = _io_type;
+        driver_buffers = _driver_buffers;
+        syscalls = _syscalls;
+    }
+    V4L2DeviceParameters params(device_path.c_str(), format, width, height, fps);
+    params.m_iotype = io_type;
+    params.m_bufferCount = driver_buffers;
+    params.m_bytesPerLineAlign = buffer::alignment;
+    params.m_syscalls = syscalls;
+    std::unique_ptr<V4l2Capture> capture(V4l2Capture::create(params));
+    if (!capture) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (!_is_capturing) {
+        capture->pause();
+    }
+
+    size_t buffer_size = capture->getBufferSize();
+    if (!_pool || buffer_size > _pool->frame_size()) {
+        _pool.reset(new frame_pool(buffer_size, _pool_size, _budget));
+        _discard.resize(buffer_size);
+    }
+
+    {
+        std::lock_guard<std::mutex> trigger_lock(_trigger_mutex);
+        _capture = std::move(capture);
+    }
+    _device_path = device_path;
+    _bus_info = _capture->getBusInfo();
+    if (_capture->getFps() > 0) {
+        _fps = _capture->getFps();
+    }
+    if (_trigger_mode != camera_trigger::free_running) {
+        apply_trigger_mode();
+    }
+
+    int64_t recovery_us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - _degraded_since).count();
+    uint64_t missed = static_cast<uint64_t>(recovery_us * _fps / 1000000);
+    ++_recovery_stats.recovered_count;
+    _recovery_stats.last_recovery_us = recovery_us;
+    _recovery_stats.missed_frames += missed;
+    _health = camera_health::ok;
+
+    std::cout << "Device " << _device_path << " recovered in " << recovery_us
+              << " us, about " << missed << " frames missed" << std::endl;
+    return true;
+}
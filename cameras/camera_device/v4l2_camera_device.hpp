@@ -2,12 +2,38 @@
 
 #include <string>
 #include <memory>
+#include <atomic>
 #include <chrono>
 #include <mutex>
+#include <thread>
+#include <vector>
 
 #include "camera_device.hpp"
+#include "frame_pool.hpp"
+#include "memory_budget.hpp"
+#include "preview_pyramid.hpp"
 #include "libv4l2cpp/inc/V4l2Capture.h"
 
+/**
+ * @brief 摄像头故障恢复统计
+ */
+struct camera_recovery_stats {
+    uint64_t degraded_count = 0;    // 进入降级状态的次数
+    uint64_t recovered_count = 0;   // 恢复成功的次数
+    int last_error = 0;             // 最近一次导致降级的errno
+    int64_t last_recovery_us = 0;   // 最近一次从降级到恢复的耗时（微秒）
+    uint64_t missed_frames = 0;     // 降级期间按帧率估算的累计丢失帧数
+};
+
+/**
+ * @brief 采集的触发方式
+ */
+enum class camera_trigger {
+    free_running = 0,   // 自由运行，按设定帧率连续出帧
+    emulated,           // 定时QBUF模拟触发：每次触发只入队一个缓冲区，驱动用其后的第一帧填充
+    hardware            // 摄像头支持触发曝光，每次触发设置一次按钮控制项
+};
+
 /**
  * @brief V4L2摄像头设备实现类
  * 
@@ -41,6 +67,42 @@ public:
     std::shared_ptr<buffer> get_frame() override;
     int64_t get_timestamp() const override;
     int get_camera_id() const override;
+    camera_health get_health() const override;
+
+    /**
+     * @brief 注册推送方式的帧回调
+     * 
+     * 启动本设备的回调线程：没有分发器时回调在该线程中执行，省去使用者自己的取帧线程；
+     * 指定分发器时帧批次交给分发线程执行。回调期间get_frame返回空，
+     * stop_capture后回调线程保留，只交付空批次
+     */
+    bool set_frame_sink(frame_sink sink, const frame_sink_options& options = frame_sink_options()) override;
+    void clear_frame_sink() override;
+
+    /**
+     * @brief 不等待地读取一帧，用于基于可读事件的异步等待
+     * 
+     * @return std::shared_ptr<buffer> 帧，暂无数据、未采集或已注册帧回调时为空
+     */
+    std::shared_ptr<buffer> try_get_frame();
+
+    /**
+     * @brief 获取可用于select/poll/epoll等待新帧的文件描述符
+     * 
+     * 设备重新打开后会变化，每次等待前重新获取
+     * 
+     * @return 文件描述符，未采集、降级恢复中或已注册帧回调时为-1
+     */
+    int get_fd() const;
+
+    /**
+     * @brief 设置驱动设备使用的系统调用，需在initialize之前调用
+     * 
+     * 用于以V4l2Emulator等模拟设备代替真实设备
+     * 
+     * @param syscalls 系统调用，不转移所有权，为空时使用真实的系统调用
+     */
+    void set_syscalls(V4l2Syscalls* syscalls);
 
     /**
      * @brief 获取实际分辨率的方法
@@ -63,7 +125,241 @@ public:
      */
     unsigned int get_format() const;
 
+    /**
+     * @brief 获取设备的总线信息(VIDIOC_QUERYCAP bus_info)
+     * 
+     * @return 总线信息，未初始化时为空
+     */
+    std::string get_bus_info() const;
+
+    /**
+     * @brief 获取初始化各阶段耗时
+     * 
+     * @return 各阶段耗时（微秒），未初始化时全部为0
+     */
+    V4l2StartupTiming get_startup_timing() const;
+
+    /**
+     * @brief 设置共享的内存预算，需在initialize之前调用
+     * 
+     * @param budget 内存预算，为空时不限制
+     * @param pool_size 帧缓冲池最多分配的buffer数量
+     */
+    void set_memory_budget(std::shared_ptr<memory_budget> budget, size_t pool_size = 8);
+
+    /**
+     * @brief 获取帧缓冲池容量
+     */
+    size_t get_pool_size() const;
+
+    /**
+     * @brief 设置IO方式和向驱动申请的缓冲区数量，需在initialize之前调用
+     * 
+     * @param io_type IOTYPE_MMAP（默认）或IOTYPE_READWRITE
+     * @param driver_buffers MMAP方式向驱动申请的缓冲区数量，0表示默认数量
+     */
+    void set_io_mode(V4l2IoType io_type, unsigned int driver_buffers = 0);
+
+    /**
+     * @brief 启用或关闭预览金字塔
+     * 
+     * 启用后每帧附加一个preview_pyramid，预览、运动检测等使用者通过
+     * frame->pyramid()->level(n)按需获取1/2、1/4、1/8的NV12图像，首次访问时生成
+     * 
+     * @param enable 是否启用
+     */
+    void enable_preview_pyramid(bool enable);
+
+    /**
+     * @brief 获取因帧缓冲池耗尽而丢弃的帧数
+     * 
+     * @return 丢弃的帧数
+     */
+    uint64_t get_dropped_frames() const;
+
+    /**
+     * @brief 获取驱动丢弃的帧数
+     * 
+     * 由驱动帧序列号的间隔统计，包括驱动没有空闲缓冲区时丢失的帧，设备重新打开后累计
+     * 
+     * @return 丢弃的帧数
+     */
+    uint64_t get_driver_drops() const;
+
+    /**
+     * @brief 运行时修改格式和分辨率
+     * 
+     * 新图像能放入已映射的缓冲区时复用缓冲区，否则重新分配；
+     * 帧缓冲池仅在新帧大小超过原有buffer时重建
+     * 
+     * @param format 像素格式，0表示保持不变
+     * @param width 图像宽度，0表示保持不变
+     * @param height 图像高度，0表示保持不变
+     * @return true 修改成功
+     * @return false 未初始化或驱动拒绝
+     */
+    bool set_format(unsigned int format, unsigned int width, unsigned int height);
+
+    /**
+     * @brief 修改帧率，缓冲区保持不变
+     * 
+     * 在initialize之前调用时只记录帧率，初始化时按该帧率打开设备；
+     * 采集中调用时只重启本摄像头的视频流（STREAMOFF/S_PARM/STREAMON）。
+     * 驱动可能把帧率调整到它支持的值，实际帧率由get_fps获取
+     * 
+     * @param fps 帧率
+     * @return true 修改成功
+     * @return false 帧率无效或驱动拒绝
+     */
+    bool set_fps(int fps);
+
+    /**
+     * @brief 获取帧率，设置成功后为驱动实际采用的值
+     */
+    int get_fps() const;
+
+    /**
+     * @brief 快速重启视频流
+     * 
+     * 执行STREAMOFF/STREAMON并重新入队已映射的缓冲区，用于从USB抖动等
+     * 短暂故障中恢复，不重新打开设备和分配缓冲区
+     * 
+     * @return true 重启成功
+     */
+    bool restart_stream();
+
+    /**
+     * @brief 设置采集的触发方式
+     * 
+     * 触发模式下读出的帧带有对应的触发编号（buffer::trigger_id），设备重新打开后保持该设置
+     * 
+     * @param mode 触发方式
+     * @param control_id hardware方式使用的按钮控制项ID
+     * @return true 设置成功
+     */
+    bool set_trigger_mode(camera_trigger mode, uint32_t control_id = 0);
+
+    /**
+     * @brief 发出一次触发，可在任意线程调用，不等待正在进行的取帧
+     * 
+     * @param id 触发编号，非0
+     * @return true 已触发
+     * @return false 未初始化、未处于触发模式或没有空闲缓冲区
+     */
+    bool trigger(uint64_t id);
+
+    /**
+     * @brief 在指定时间重启视频流，用于调整自由运行摄像头的采集相位
+     * 
+     * 由取帧所在的线程在到点时执行STREAMOFF/STREAMON，重启不会被阻塞中的取帧推迟。
+     * 重复调用时以最后一次为准
+     * 
+     * @param at_us 重启时间，与帧时间戳同一时钟（系统时钟，微秒）
+     */
+    void schedule_restart(int64_t at_us);
+
+    /**
+     * @brief 获取最近一次按计划重启后STREAMON完成的时间
+     * 
+     * @return 时间（与帧时间戳同一时钟，微秒），尚未按计划重启时为0
+     */
+    int64_t get_last_stream_on_us() const;
+
+    /**
+     * @brief 获取最近一次restart_stream的耗时
+     * 
+     * @return 耗时（微秒）
+     */
+    int64_t get_last_restart_us() const;
+
+    /**
+     * @brief 获取故障恢复统计
+     * 
+     * @return 降级次数、恢复耗时和估算的丢失帧数
+     */
+    camera_recovery_stats get_recovery_stats() const;
+
 private:
+    /**
+     * @brief 处理读帧失败，按errno分类决定忽略、重启视频流或进入降级状态
+     * 
+     * 调用者需持有_mutex
+     * 
+     * @param error 读帧失败时的errno
+     */
+    void handle_read_error(int error);
+
+    /**
+     * @brief 释放设备并启动后台恢复线程，调用者需持有_mutex
+     */
+    void enter_degraded(int error);
+
+    /**
+     * @brief 修改格式或帧率失败后检查设备，无法继续采集时进入降级状态，调用者需持有_mutex
+     */
+    void check_device_after_failure();
+
+    /**
+     * @brief 后台恢复线程，监视/dev等待设备重新出现后重新初始化
+     */
+    void recovery_loop();
+
+    /**
+     * @brief 尝试在指定设备节点上重新初始化
+     * 
+     * @param device_path 候选设备节点
+     * @return true 重新初始化成功
+     */
+    bool try_reopen(const std::string& device_path);
+
+    /**
+     * @brief 等待并读取一帧，调用者需持有_mutex
+     * 
+     * @param timeout_us 等待超时（微秒），0表示不等待
+     * @param timed_out 超时时置为true
+     * @return std::shared_ptr<buffer> 帧，未采集、超时或出错时为空
+     */
+    std::shared_ptr<buffer> read_frame(long timeout_us, bool& timed_out);
+
+    /**
+     * @brief 等待并一次读取驱动中全部已就绪的帧，调用者需持有_mutex
+     * 
+     * @param timeout_us 等待超时（微秒）
+     * @param timed_out 输出是否超时
+     * @param frames 读出的帧按驱动序列号顺序追加到末尾
+     * @param max_frames 最多读取的帧数
+     * @return size_t 读取的帧数
+     */
+    size_t read_frames(long timeout_us, bool& timed_out, std::vector<std::shared_ptr<buffer>>& frames,
+                       size_t max_frames);
+
+    /**
+     * @brief 等待设备可读，调用者需持有_mutex
+     */
+    bool wait_readable(long timeout_us, bool& timed_out);
+
+    /**
+     * @brief 填写读出帧的元数据，调用者需持有_mutex
+     */
+    void finish_frame(buffer& frame, size_t bytes_read, int64_t timestamp, uint64_t trigger_id);
+
+    /**
+     * @brief 把触发方式应用到当前设备，调用者需持有_mutex
+     */
+    bool apply_trigger_mode();
+
+    /**
+     * @brief 执行STREAMOFF/STREAMON并记录耗时，调用者需持有_mutex
+     */
+    bool restart_stream_locked();
+
+    /**
+     * @brief 帧回调线程
+     */
+    void delivery_loop();
+
+    static constexpr int max_consecutive_errors = 3;    // 连续I/O错误达到该次数后重启视频流
+
     std::string _device_path;       // 设备路径
     unsigned int _width;            // 图像宽度
     unsigned int _height;           // 图像高度
@@ -73,5 +369,39 @@ private:
     int64_t _timestamp;             // 最后一帧的时间戳
     
     std::unique_ptr<V4l2Capture> _capture; // V4L2捕获设备
-    std::mutex _mutex;                     // 互斥锁
+    mutable std::mutex _mutex;             // 互斥锁
+    std::mutex _trigger_mutex;             // 触发路径访问_capture时持有，替换_capture时同时持有
+    camera_trigger _trigger_mode;          // 触发方式
+    uint32_t _trigger_control;             // hardware触发方式的控制项ID
+
+    std::shared_ptr<memory_budget> _budget; // 共享的内存预算
+    size_t _pool_size;                      // 帧缓冲池容量
+    V4l2IoType _io_type;                    // IO方式
+    unsigned int _driver_buffers;           // MMAP方式向驱动申请的缓冲区数量，0表示默认数量
+    std::unique_ptr<frame_pool> _pool;      // 帧缓冲池
+    bool _preview_pyramid;                  // 是否附加预览金字塔
+    std::shared_ptr<preview_pyramid_pool> _pyramid_pool; // 预览金字塔各级buffer的缓冲池
+    std::vector<char> _discard;             // 缓冲池耗尽时用于取走并丢弃驱动中的帧
+    uint64_t _dropped_frames;               // 丢弃的帧数
+    uint64_t _driver_drops;                 // 已关闭的设备上驱动丢弃的帧数
+    int64_t _last_restart_us;               // 最近一次重启视频流的耗时
+    std::atomic<int64_t> _restart_at_us;    // 计划重启视频流的时间，0表示没有计划
+    std::atomic<int64_t> _last_stream_on_us; // 最近一次按计划重启后STREAMON完成的时间
+
+    int _fps;                                        // 帧率，用于估算丢失帧数
+    std::string _bus_info;                           // 总线信息，用于识别重新出现的设备
+    std::atomic<camera_health> _health;              // 运行状态
+    int _consecutive_errors;                         // 连续I/O错误次数
+    std::chrono::steady_clock::time_point _degraded_since; // 进入降级状态的时间
+    camera_recovery_stats _recovery_stats;           // 故障恢复统计
+    std::thread _recovery_thread;                    // 后台恢复线程
+    std::atomic<bool> _stop_recovery;                // 通知恢复线程退出
+
+    frame_sink _sink;                                // 帧回调
+    frame_sink_options _sink_options;                // 帧回调选项
+    bool _sink_active;                               // 是否已注册帧回调，受_mutex保护
+    std::thread _delivery_thread;                    // 帧回调线程
+    std::atomic<bool> _stop_delivery;                // 通知回调线程退出
+
+    V4l2Syscalls* _syscalls;                         // 驱动设备使用的系统调用，为空时使用真实的系统调用
 };
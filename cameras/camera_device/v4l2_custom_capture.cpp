@@ -82,13 +82,8 @@ std::shared_ptr<buffer> V4l2CustomCapture::captureFrame()
     }
     
     try {
-        // 获取一个足够大的buffer，大小基于图像尺寸
-        unsigned int width = getWidth();
-        unsigned int height = getHeight();
-        unsigned int format = getFormat();
-        
-        // 根据格式计算需要的缓冲区大小，这里用最大可能值
-        size_t buffer_size = width * height * 4;  // 保守估计，确保足够大
+        // 使用驱动协商得到的帧大小（VIDIOC_G_FMT sizeimage），已包含行填充和全部平面
+        size_t buffer_size = getBufferSize();
         
         // 创建帧缓冲区
         auto frame_buffer = std::make_shared<buffer>(buffer_size);
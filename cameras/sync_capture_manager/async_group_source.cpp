@@ -0,0 +1,36 @@
+#include "async_group_source.hpp"
+
+/**
+ * @brief 构造函数
+ */
+async_group_source::async_group_source(io_executor& executor, sync_capture_manager& manager)
+    : _executor(executor),
+      _manager(manager)
+{
+}
+
+/**
+ * @brief 等待下一个同步帧组
+ */
+task<std::shared_ptr<frame_group>> async_group_source::next_group(clock::duration timeout)
+{
+    const bool unlimited = timeout < clock::duration(0);
+    const auto deadline = clock::now() + (unlimited ? clock::duration(0) : timeout);
+
+    while (true) {
+        // 先取再等：事件描述符只表示"可能有新帧组"，被其他等待者取走时继续等待
+        auto group = _manager.get_sync_frame_group(0);
+        if (group) {
+            co_return group;
+        }
+
+        clock::duration wait = clock::duration(-1);
+        if (!unlimited) {
+            wait = deadline - clock::now();
+            if (wait <= clock::duration(0)) {
+                co_return nullptr;
+            }
+        }
+        co_await _executor.readable(_manager.get_group_fd(), wait);
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+// 需要C++20协程，仅在编译器支持时由CMake编译（sync_capture_manager_async）
+
+#include <memory>
+
+#include "io_executor.hpp"
+#include "sync_capture_manager.hpp"
+
+/**
+ * @brief sync_capture_manager的协程取帧组接口
+ *
+ * co_await groups.next_group()在管理器的帧组事件描述符上挂起，不占用线程。
+ * 多个协程可以同时等待，每个帧组只交给其中一个
+ */
+class async_group_source {
+public:
+    using clock = io_executor::clock;
+
+    /**
+     * @brief 构造函数
+     *
+     * @param executor 执行器
+     * @param manager 同步采集管理器，需比本对象存活更久
+     */
+    async_group_source(io_executor& executor, sync_capture_manager& manager);
+
+    /**
+     * @brief 等待下一个同步帧组
+     *
+     * @param timeout 超时，为负时一直等待
+     * @return task<std::shared_ptr<frame_group>> 帧组，超时返回nullptr
+     */
+    task<std::shared_ptr<frame_group>> next_group(clock::duration timeout = clock::duration(-1));
+
+private:
+    io_executor& _executor;             // 执行器
+    sync_capture_manager& _manager;     // 同步采集管理器
+};
@@ -0,0 +1,620 @@
+#include "capture_config.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sched.h>
+#include <set>
+#include <sstream>
+#include <type_traits>
+
+namespace {
+
+/**
+ * @brief JSON值，只覆盖配置文件用到的部分
+ */
+struct json_value {
+    enum kind_t { null_value, boolean, number, string, array, object };
+
+    kind_t kind = null_value;
+    bool flag = false;
+    double value = 0;
+    std::string text;
+    std::vector<json_value> items;                              // array的元素
+    std::vector<std::pair<std::string, json_value>> members;   // object的成员，保持文件中的顺序
+
+    const json_value* find(const char* key) const
+    {
+        for (const auto& member : members) {
+            if (member.first == key) {
+                return &member.second;
+            }
+        }
+        return nullptr;
+    }
+};
+
+/**
+ * @brief 递归下降的JSON解析器，出错时记录行号
+ */
+class json_parser {
+public:
+    explicit json_parser(const std::string& text) : _text(text), _pos(0) {}
+
+    bool parse(json_value& root, std::string& error)
+    {
+        if (!parse_value(root, 0) || (skip_space(), _pos != _text.size() && fail("unexpected trailing data"))) {
+            error = _error;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    static constexpr int max_depth = 32;
+
+    bool fail(const char* message)
+    {
+        if (_error.empty()) {
+            size_t line = 1 + std::count(_text.begin(), _text.begin() + std::min(_pos, _text.size()), '\n');
+            _error = std::string(message) + " at line " + std::to_string(line);
+        }
+        return false;
+    }
+
+    void skip_space()
+    {
+        while (_pos < _text.size()) {
+            if (std::isspace(static_cast<unsigned char>(_text[_pos]))) {
+                ++_pos;
+            } else if (_text.compare(_pos, 2, "//") == 0) {
+                // 允许行注释，便于在配置中说明
+                while (_pos < _text.size() && _text[_pos] != '\n') {
+                    ++_pos;
+                }
+            } else {
+                break;
+            }
+        }
+    }
+
+    bool consume(char c)
+    {
+        skip_space();
+        if (_pos < _text.size() && _text[_pos] == c) {
+            ++_pos;
+            return true;
+        }
+        return false;
+    }
+
+    bool parse_value(json_value& value, int depth)
+    {
+        if (depth > max_depth) {
+            return fail("nesting too deep");
+        }
+        skip_space();
+        if (_pos >= _text.size()) {
+            return fail("unexpected end of input");
+        }
+        char c = _text[_pos];
+        if (c == '{') {
+            return parse_object(value, depth);
+        }
+        if (c == '[') {
+            return parse_array(value, depth);
+        }
+        if (c == '"') {
+            value.kind = json_value::string;
+            return parse_string(value.text);
+        }
+        if (_text.compare(_pos, 4, "true") == 0 || _text.compare(_pos, 5, "false") == 0) {
+            value.kind = json_value::boolean;
+            value.flag = (c == 't');
+            _pos += value.flag ? 4 : 5;
+            return true;
+        }
+        if (_text.compare(_pos, 4, "null") == 0) {
+            value.kind = json_value::null_value;
+            _pos += 4;
+            return true;
+        }
+        const char* start = _text.c_str() + _pos;
+        char* end = nullptr;
+        value.value = std::strtod(start, &end);
+        if (end == start || !std::isfinite(value.value)) {
+            return fail("invalid value");
+        }
+        value.kind = json_value::number;
+        _pos += static_cast<size_t>(end - start);
+        return true;
+    }
+
+    bool parse_object(json_value& value, int depth)
+    {
+        value.kind = json_value::object;
+        ++_pos;
+        if (consume('}')) {
+            return true;
+        }
+        do {
+            skip_space();
+            std::string key;
+            if (_pos >= _text.size() || _text[_pos] != '"' || !parse_string(key)) {
+                return fail("expected a quoted key");
+            }
+            if (value.find(key.c_str())) {
+                return fail(("duplicate key \"" + key + "\"").c_str());
+            }
+            if (!consume(':')) {
+                return fail("expected ':'");
+            }
+            value.members.emplace_back(key, json_value());
+            if (!parse_value(value.members.back().second, depth + 1)) {
+                return false;
+            }
+        } while (consume(','));
+        return consume('}') || fail("expected ',' or '}'");
+    }
+
+    bool parse_array(json_value& value, int depth)
+    {
+        value.kind = json_value::array;
+        ++_pos;
+        if (consume(']')) {
+            return true;
+        }
+        do {
+            value.items.emplace_back();
+            if (!parse_value(value.items.back(), depth + 1)) {
+                return false;
+            }
+        } while (consume(','));
+        return consume(']') || fail("expected ',' or ']'");
+    }
+
+    bool parse_string(std::string& out)
+    {
+        ++_pos;
+        while (_pos < _text.size()) {
+            char c = _text[_pos++];
+            if (c == '"') {
+                return true;
+            }
+            if (c != '\\') {
+                out.push_back(c);
+                continue;
+            }
+            if (_pos >= _text.size()) {
+                break;
+            }
+            char escaped = _text[_pos++];
+            switch (escaped) {
+            case '"':  out.push_back('"');  break;
+            case '\\': out.push_back('\\'); break;
+            case '/':  out.push_back('/');  break;
+            case 'n':  out.push_back('\n'); break;
+            case 't':  out.push_back('\t'); break;
+            default:   return fail("unsupported escape in string");
+            }
+        }
+        return fail("unterminated string");
+    }
+
+    const std::string& _text;
+    size_t _pos;
+    std::string _error;
+};
+
+/**
+ * @brief 带路径的字段读取，出错时记录第一个错误
+ */
+class config_reader {
+public:
+    explicit config_reader(std::string& error) : _error(error) {}
+
+    bool ok() const { return _error.empty(); }
+
+    bool fail(const std::string& path, const std::string& message)
+    {
+        if (_error.empty()) {
+            _error = path + ": " + message;
+        }
+        return false;
+    }
+
+    /**
+     * @brief 检查对象只包含已知的键
+     */
+    bool expect_object(const json_value& value, const std::string& path, std::initializer_list<const char*> keys)
+    {
+        if (value.kind != json_value::object) {
+            return fail(path, "expected an object");
+        }
+        for (const auto& member : value.members) {
+            bool known = false;
+            for (const char* key : keys) {
+                known = known || member.first == key;
+            }
+            if (!known) {
+                return fail(path, "unknown key \"" + member.first + "\"");
+            }
+        }
+        return true;
+    }
+
+    template <typename T>
+    void read_number(const json_value& object, const char* key, const std::string& path, T& out,
+                     double min_value, double max_value)
+    {
+        const json_value* value = object.find(key);
+        if (!value) {
+            return;
+        }
+        if (value->kind != json_value::number) {
+            fail(path + "." + key, "expected a number");
+            return;
+        }
+        if (value->value < min_value || value->value > max_value) {
+            fail(path + "." + key, "out of range");
+            return;
+        }
+        if (std::is_integral<T>::value && value->value != std::floor(value->value)) {
+            fail(path + "." + key, "expected an integer");
+            return;
+        }
+        out = static_cast<T>(value->value);
+    }
+
+    void read_bool(const json_value& object, const char* key, const std::string& path, bool& out)
+    {
+        const json_value* value = object.find(key);
+        if (!value) {
+            return;
+        }
+        if (value->kind != json_value::boolean) {
+            fail(path + "." + key, "expected true or false");
+            return;
+        }
+        out = value->flag;
+    }
+
+    void read_string(const json_value& object, const char* key, const std::string& path, std::string& out)
+    {
+        const json_value* value = object.find(key);
+        if (!value) {
+            return;
+        }
+        if (value->kind != json_value::string) {
+            fail(path + "." + key, "expected a string");
+            return;
+        }
+        out = value->text;
+    }
+
+    void read_int_list(const json_value& object, const char* key, const std::string& path, std::vector<int>& out,
+                       double min_value, double max_value)
+    {
+        const json_value* value = object.find(key);
+        if (!value) {
+            return;
+        }
+        if (value->kind != json_value::array) {
+            fail(path + "." + key, "expected an array");
+            return;
+        }
+        out.clear();
+        for (const auto& item : value->items) {
+            if (item.kind != json_value::number || item.value != std::floor(item.value)) {
+                fail(path + "." + key, "expected integers");
+                return;
+            }
+            if (item.value < min_value || item.value > max_value) {
+                fail(path + "." + key, "out of range");
+                return;
+            }
+            out.push_back(static_cast<int>(item.value));
+        }
+    }
+
+    void read_format(const json_value& object, const char* key, const std::string& path, uint32_t& out)
+    {
+        std::string name;
+        read_string(object, key, path, name);
+        if (name.empty()) {
+            return;
+        }
+        static const std::pair<const char*, const char*> aliases[] = {
+            {"MJPEG", "MJPG"}, {"RGB24", "RGB3"}, {"BGR24", "BGR3"}, {"NV12M", "NM12"}, {"GRAY", "GREY"}};
+        for (const auto& alias : aliases) {
+            if (name == alias.first) {
+                name = alias.second;
+            }
+        }
+        if (name.size() != 4) {
+            fail(path + "." + key, "unknown pixel format \"" + name + "\"");
+            return;
+        }
+        out = v4l2_fourcc(name[0], name[1], name[2], name[3]);
+    }
+
+    void read_io(const json_value& object, const std::string& path, V4l2IoType& out)
+    {
+        std::string name;
+        read_string(object, "io", path, name);
+        if (name.empty()) {
+            return;
+        }
+        if (name == "mmap") {
+            out = IOTYPE_MMAP;
+        } else if (name == "read") {
+            out = IOTYPE_READWRITE;
+        } else {
+            fail(path + ".io", "expected \"mmap\" or \"read\"");
+        }
+    }
+
+private:
+    std::string& _error;
+};
+
+constexpr double int_max = 2147483647.0;
+
+void read_cameras(config_reader& reader, const json_value& root, capture_config& config)
+{
+    const json_value* cameras = root.find("cameras");
+    if (!cameras || cameras->kind != json_value::array || cameras->items.empty()) {
+        reader.fail("cameras", "expected a non-empty array");
+        return;
+    }
+    std::set<int> ids;
+    for (size_t i = 0; i < cameras->items.size() && reader.ok(); ++i) {
+        const json_value& item = cameras->items[i];
+        std::string path = "cameras[" + std::to_string(i) + "]";
+        if (!reader.expect_object(item, path, {"id", "device", "width", "height", "format", "fps", "io",
+                                               "driver_buffers", "pool_size", "preview_pyramid"})) {
+            return;
+        }
+        camera_config camera;
+        camera.id = static_cast<int>(i);
+        reader.read_number(item, "id", path, camera.id, 0, int_max);
+        reader.read_string(item, "device", path, camera.device);
+        reader.read_number(item, "width", path, camera.width, 1, 65535);
+        reader.read_number(item, "height", path, camera.height, 1, 65535);
+        reader.read_format(item, "format", path, camera.format);
+        reader.read_number(item, "fps", path, camera.fps, 1, 1000);
+        reader.read_io(item, path, camera.io_type);
+        reader.read_number(item, "driver_buffers", path, camera.driver_buffers, 0, 64);
+        reader.read_number(item, "pool_size", path, camera.pool_size, 1, 1024);
+        reader.read_bool(item, "preview_pyramid", path, camera.preview_pyramid);
+        if (camera.device.empty()) {
+            reader.fail(path + ".device", "missing");
+        } else if (!ids.insert(camera.id).second) {
+            reader.fail(path + ".id", "duplicate camera id " + std::to_string(camera.id));
+        }
+        config.cameras.push_back(camera);
+    }
+    if (config.cameras.size() > frame_group::max_cameras) {
+        reader.fail("cameras", "more than " + std::to_string(frame_group::max_cameras) + " cameras");
+    }
+}
+
+void read_sync(config_reader& reader, const json_value& root, sync_config& sync)
+{
+    const json_value* value = root.find("sync");
+    if (!value) {
+        return;
+    }
+    const std::string path = "sync";
+    if (!reader.expect_object(*value, path, {"strategy", "tolerance_us", "hybrid", "trigger", "phase_alignment"})) {
+        return;
+    }
+
+    std::string strategy;
+    reader.read_string(*value, "strategy", path, strategy);
+    if (strategy == "timestamp") {
+        sync.strategy = sync_strategy::timestamp;
+    } else if (strategy == "hybrid") {
+        sync.strategy = sync_strategy::hybrid;
+    } else if (strategy == "trigger") {
+        sync.strategy = sync_strategy::trigger;
+    } else if (!strategy.empty()) {
+        reader.fail(path + ".strategy", "expected \"timestamp\", \"hybrid\" or \"trigger\"");
+    }
+    reader.read_number(*value, "tolerance_us", path, sync.tolerance_us, 0, 1e9);
+
+    if (const json_value* hybrid = value->find("hybrid")) {
+        const std::string sub = path + ".hybrid";
+        if (reader.expect_object(*hybrid, sub, {"barrier_groups", "barrier_window_us", "target_percentile",
+                                                "headroom", "min_tolerance_us", "max_tolerance_us",
+                                                "window_groups", "max_mismatch_ratio"})) {
+            reader.read_number(*hybrid, "barrier_groups", sub, sync.hybrid.barrier_groups, 1, 100000);
+            reader.read_number(*hybrid, "barrier_window_us", sub, sync.hybrid.barrier_window_us, 0, 1e9);
+            reader.read_number(*hybrid, "target_percentile", sub, sync.hybrid.target_percentile, 0, 1);
+            reader.read_number(*hybrid, "headroom", sub, sync.hybrid.headroom, 1, 100);
+            reader.read_number(*hybrid, "min_tolerance_us", sub, sync.hybrid.min_tolerance_us, 0, 1e9);
+            reader.read_number(*hybrid, "max_tolerance_us", sub, sync.hybrid.max_tolerance_us, 0, 1e9);
+            reader.read_number(*hybrid, "window_groups", sub, sync.hybrid.window_groups, 1, 100000);
+            reader.read_number(*hybrid, "max_mismatch_ratio", sub, sync.hybrid.max_mismatch_ratio, 0, 1);
+        }
+    }
+
+    if (const json_value* trigger = value->find("trigger")) {
+        const std::string sub = path + ".trigger";
+        if (reader.expect_object(*trigger, sub, {"fps", "spin_us", "control_id", "hardware_cameras"})) {
+            reader.read_number(*trigger, "fps", sub, sync.trigger.fps, 1, 1000);
+            reader.read_number(*trigger, "spin_us", sub, sync.trigger.spin_us, 0, 100000);
+            reader.read_number(*trigger, "control_id", sub, sync.trigger.control_id, 0, 4294967295.0);
+            reader.read_int_list(*trigger, "hardware_cameras", sub, sync.trigger.hardware_cameras, 0, int_max);
+        }
+    }
+
+    if (const json_value* phase = value->find("phase_alignment")) {
+        const std::string sub = path + ".phase_alignment";
+        if (reader.expect_object(*phase, sub, {"enabled", "reference_camera_id", "tolerance_us", "samples",
+                                               "max_attempts", "check_interval_ms"})) {
+            sync.phase_alignment = true;
+            reader.read_bool(*phase, "enabled", sub, sync.phase_alignment);
+            reader.read_number(*phase, "reference_camera_id", sub, sync.phase.reference_camera_id, -1, int_max);
+            reader.read_number(*phase, "tolerance_us", sub, sync.phase.tolerance_us, 0, 1e9);
+            reader.read_number(*phase, "samples", sub, sync.phase.samples, 1, 10000);
+            reader.read_number(*phase, "max_attempts", sub, sync.phase.max_attempts, 0, 1000);
+            reader.read_number(*phase, "check_interval_ms", sub, sync.phase.check_interval_ms, 1, 600000);
+        }
+    }
+}
+
+void read_threads(config_reader& reader, const json_value& root, capture_config& config)
+{
+    const json_value* value = root.find("threads");
+    if (!value) {
+        return;
+    }
+    if (value->kind != json_value::object) {
+        reader.fail("threads", "expected an object");
+        return;
+    }
+    for (const auto& member : value->members) {
+        const std::string path = "threads." + member.first;
+        int role = 0;
+        while (role < static_cast<int>(thread_role::count) &&
+               member.first != thread_policy_set::role_name(static_cast<thread_role>(role))) {
+            ++role;
+        }
+        if (role == static_cast<int>(thread_role::count)) {
+            reader.fail(path, "unknown thread role");
+            return;
+        }
+        if (!reader.expect_object(member.second, path, {"cpus", "spread", "realtime", "priority", "numa_node"})) {
+            return;
+        }
+        thread_policy policy;
+        reader.read_int_list(member.second, "cpus", path, policy.cpus, 0, CPU_SETSIZE - 1);
+        reader.read_bool(member.second, "spread", path, policy.spread);
+        reader.read_bool(member.second, "realtime", path, policy.realtime);
+        reader.read_number(member.second, "priority", path, policy.priority, 0, 99);
+        reader.read_number(member.second, "numa_node", path, policy.numa_node, -1, 1023);
+        config.threads.emplace_back(static_cast<thread_role>(role), policy);
+    }
+}
+
+void read_mosaic(config_reader& reader, const json_value& root, mosaic_config& mosaic)
+{
+    const json_value* value = root.find("mosaic");
+    if (!value) {
+        return;
+    }
+    const std::string path = "mosaic";
+    if (!reader.expect_object(*value, path, {"width", "height", "columns", "tiles", "threads", "pool_size",
+                                             "overlay", "glyph_scale"})) {
+        return;
+    }
+    reader.read_number(*value, "width", path, mosaic.width, 16, 16384);
+    reader.read_number(*value, "height", path, mosaic.height, 16, 16384);
+    reader.read_number(*value, "columns", path, mosaic.columns, 0, 64);
+    reader.read_number(*value, "tiles", path, mosaic.tiles, 0, 1024);
+    reader.read_number(*value, "threads", path, mosaic.threads, 1, 256);
+    reader.read_number(*value, "pool_size", path, mosaic.pool_size, 1, 64);
+    reader.read_bool(*value, "overlay", path, mosaic.overlay);
+    reader.read_number(*value, "glyph_scale", path, mosaic.glyph_scale, 1, 16);
+}
+
+void read_consumers(config_reader& reader, const json_value& root, capture_config& config)
+{
+    const json_value* value = root.find("consumers");
+    if (!value) {
+        return;
+    }
+    if (value->kind != json_value::array) {
+        reader.fail("consumers", "expected an array");
+        return;
+    }
+    std::set<std::string> names;
+    std::set<std::string> devices;
+    for (size_t i = 0; i < value->items.size() && reader.ok(); ++i) {
+        const json_value& item = value->items[i];
+        std::string path = "consumers[" + std::to_string(i) + "]";
+        if (!reader.expect_object(item, path, {"name", "device", "camera", "format", "io"})) {
+            return;
+        }
+        consumer_config consumer;
+        reader.read_string(item, "name", path, consumer.name);
+        reader.read_string(item, "device", path, consumer.target.device);
+        reader.read_format(item, "format", path, consumer.target.format);
+        reader.read_io(item, path, consumer.target.io_type);
+
+        const json_value* camera = item.find("camera");
+        if (camera && camera->kind == json_value::string && camera->text == "mosaic") {
+            consumer.target.camera_id = stream_republisher::mosaic_source;
+        } else {
+            reader.read_number(item, "camera", path, consumer.target.camera_id, 0, int_max);
+        }
+
+        if (consumer.name.empty()) {
+            consumer.name = consumer.target.device;
+        }
+        if (consumer.target.device.empty()) {
+            reader.fail(path + ".device", "missing");
+        } else if (!names.insert(consumer.name).second) {
+            reader.fail(path + ".name", "duplicate consumer \"" + consumer.name + "\"");
+        } else if (!devices.insert(consumer.target.device).second) {
+            reader.fail(path + ".device", "device used by another consumer");
+        }
+        config.consumers.push_back(consumer);
+    }
+}
+
+} // namespace
+
+/**
+ * @brief 解析JSON格式的配置
+ */
+bool parse_capture_config(const std::string& text, capture_config& config, std::string& error)
+{
+    error.clear();
+    json_value root;
+    json_parser parser(text);
+    if (!parser.parse(root, error)) {
+        return false;
+    }
+
+    capture_config parsed;
+    config_reader reader(error);
+    if (!reader.expect_object(root, "config", {"cameras", "sync", "threads", "mosaic", "consumers"})) {
+        return false;
+    }
+    read_cameras(reader, root, parsed);
+    read_sync(reader, root, parsed.sync);
+    read_threads(reader, root, parsed);
+    read_mosaic(reader, root, parsed.mosaic);
+    read_consumers(reader, root, parsed);
+    if (!reader.ok()) {
+        return false;
+    }
+
+    config = std::move(parsed);
+    return true;
+}
+
+/**
+ * @brief 读取并解析配置文件
+ */
+bool load_capture_config(const std::string& path, capture_config& config, std::string& error)
+{
+    std::ifstream file(path);
+    if (!file) {
+        error = "cannot open " + path + ": " + std::strerror(errno);
+        return false;
+    }
+    std::stringstream text;
+    text << file.rdbuf();
+    if (!parse_capture_config(text.str(), config, error)) {
+        error = path + ": " + error;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "mosaic_compositor.hpp"
+#include "stream_republisher.hpp"
+#include "sync_capture_manager.hpp"
+
+/**
+ * @brief 单个摄像头的配置
+ */
+struct camera_config {
+    int id = 0;                              // 摄像头ID，配置中唯一
+    std::string device;                      // 设备路径
+    uint32_t width = 640;                    // 图像宽度
+    uint32_t height = 480;                   // 图像高度
+    uint32_t format = V4L2_PIX_FMT_YUYV;     // 像素格式
+    int fps = 30;                            // 帧率
+    V4l2IoType io_type = IOTYPE_MMAP;        // IO方式
+    unsigned int driver_buffers = 0;         // MMAP方式向驱动申请的缓冲区数量，0表示默认数量
+    size_t pool_size = 8;                    // 帧缓冲池容量
+    bool preview_pyramid = false;            // 是否附加预览金字塔
+};
+
+/**
+ * @brief 组帧策略
+ */
+enum class sync_strategy {
+    timestamp = 0,    // 固定容差的时间戳匹配
+    hybrid,           // 屏障与时间戳混合组帧
+    trigger           // 软件触发，按触发编号配对
+};
+
+/**
+ * @brief 组帧配置
+ */
+struct sync_config {
+    sync_strategy strategy = sync_strategy::timestamp;   // 组帧策略
+    int64_t tolerance_us = 1000;                         // 时间戳容差，hybrid策略下为初始容差
+    hybrid_sync_config hybrid;                           // hybrid策略的参数
+    trigger_config trigger;                              // trigger策略的参数
+    bool phase_alignment = false;                        // 是否对齐自由运行摄像头的采集相位
+    phase_alignment_config phase;                        // 相位对齐参数
+};
+
+/**
+ * @brief 帧组的使用者，当前为转发到V4L2输出设备
+ */
+struct consumer_config {
+    std::string name;                // 名称，热加载时按名称比较
+    republish_target target;         // 转发目标，camera_id为stream_republisher::mosaic_source时转发拼接画面
+};
+
+/**
+ * @brief 多摄像头采集的完整配置
+ *
+ * 从JSON文件读取，格式如下（除cameras外各节均可省略，省略的字段取结构体的默认值）：
+ *
+ *     {
+ *       "cameras": [
+ *         {"id": 0, "device": "/dev/video0", "width": 1280, "height": 720, "format": "YUYV",
+ *          "fps": 30, "io": "mmap", "driver_buffers": 4, "pool_size": 8, "preview_pyramid": false}
+ *       ],
+ *       "sync": {"strategy": "hybrid", "tolerance_us": 2000,
+ *                "hybrid": {"target_percentile": 0.95, "max_tolerance_us": 10000},
+ *                "trigger": {"fps": 30, "hardware_cameras": [1]},
+ *                "phase_alignment": {"enabled": true, "tolerance_us": 500}},
+ *       "threads": {"capture": {"cpus": [2, 3], "realtime": true, "priority": 50},
+ *                   "sync": {"cpus": [4]}},
+ *       "mosaic": {"width": 1920, "height": 1080, "columns": 2},
+ *       "consumers": [
+ *         {"name": "cam0", "device": "/dev/video10", "camera": 0},
+ *         {"name": "wall", "device": "/dev/video11", "camera": "mosaic", "format": "BGR24", "io": "read"}
+ *       ]
+ *     }
+ *
+ * 像素格式写作V4L2的四字符码或MJPEG、RGB24、BGR24、NV12M等常用名；io为mmap或read；
+ * threads的键为thread_role的名称（capture、sync、decode、storage、trigger）。
+ * 未知的键视为错误，避免拼写错误的配置被静默忽略
+ */
+struct capture_config {
+    std::vector<camera_config> cameras;                              // 摄像头
+    sync_config sync;                                                // 组帧
+    std::vector<std::pair<thread_role, thread_policy>> threads;      // 配置了策略的线程角色
+    mosaic_config mosaic;                                            // 转发拼接画面时的合成参数
+    std::vector<consumer_config> consumers;                          // 帧组的使用者
+};
+
+/**
+ * @brief 解析JSON格式的配置
+ *
+ * @param text JSON文本
+ * @param config 输出解析结果
+ * @param error 失败时输出原因，包括位置或出错的键
+ * @return true 解析成功
+ */
+bool parse_capture_config(const std::string& text, capture_config& config, std::string& error);
+
+/**
+ * @brief 读取并解析配置文件
+ *
+ * @param path 文件路径
+ * @param config 输出解析结果
+ * @param error 失败时输出原因
+ * @return true 读取并解析成功
+ */
+bool load_capture_config(const std::string& path, capture_config& config, std::string& error);
@@ -0,0 +1,215 @@
+#include "frame_group.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+
+/**
+ * @brief 构造函数
+ */
+frame_group::frame_group()
+    : _count(0),
+      _sealed(false),
+      _group_timestamp(0),
+      _spread_us(0),
+      _group_id(0)
+{
+}
+
+/**
+ * @brief 添加一路摄像头的帧
+ */
+bool frame_group::add_frame(int camera_id, std::shared_ptr<buffer> frame)
+{
+    if (!frame || _sealed || _count >= max_cameras || index_of(camera_id) >= 0) {
+        return false;
+    }
+
+    _meta.camera_id[_count] = camera_id;
+    _meta.timestamp[_count] = frame->timestamp();
+    _meta.sequence[_count] = frame->sequence();
+    _meta.size[_count] = static_cast<uint32_t>(frame->size());
+    _meta.data[_count] = static_cast<const uint8_t*>(frame->data());
+    _frames[_count] = std::move(frame);
+    ++_count;
+    return true;
+}
+
+/**
+ * @brief 封装帧组，计算组时间戳和时间戳跨度
+ */
+void frame_group::seal(uint64_t group_id)
+{
+    int64_t min_ts = std::numeric_limits<int64_t>::max();
+    int64_t max_ts = std::numeric_limits<int64_t>::min();
+
+    // 时间戳连续存放，循环可被编译器向量化
+    for (size_t i = 0; i < _count; ++i) {
+        min_ts = std::min(min_ts, _meta.timestamp[i]);
+        max_ts = std::max(max_ts, _meta.timestamp[i]);
+    }
+
+    _group_id = group_id;
+    _group_timestamp = (_count > 0) ? min_ts : 0;
+    _spread_us = (_count > 0) ? (max_ts - min_ts) : 0;
+    _sealed = true;
+}
+
+/**
+ * @brief 清空帧组
+ */
+void frame_group::reset()
+{
+    for (size_t i = 0; i < _count; ++i) {
+        _frames[i].reset();
+    }
+    _count = 0;
+    _sealed = false;
+    _group_timestamp = 0;
+    _spread_us = 0;
+    _group_id = 0;
+}
+
+/**
+ * @brief 查找摄像头在帧组中的下标
+ */
+int frame_group::index_of(int camera_id) const
+{
+    for (size_t i = 0; i < _count; ++i) {
+        if (_meta.camera_id[i] == camera_id) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief 帧组池的内部存储
+ */
+struct frame_group_pool::storage {
+    /**
+     * @brief shared_ptr控制块的内存块
+     */
+    struct alignas(alignof(std::max_align_t)) block {
+        unsigned char bytes[128];
+    };
+
+    std::mutex mutex;                                      // 互斥锁
+    std::vector<std::unique_ptr<frame_group>> groups;      // 全部帧组
+    std::vector<frame_group*> free_groups;                 // 空闲帧组
+    std::unique_ptr<block[]> blocks;                       // 控制块内存
+    std::vector<block*> free_blocks;                       // 空闲控制块内存
+};
+
+/**
+ * @brief 帧组释放器，最后一个持有者释放时清空帧组并放回池中
+ */
+struct frame_group_pool::group_deleter {
+    std::shared_ptr<storage> pool;
+
+    void operator()(frame_group* group) const
+    {
+        group->reset();
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        pool->free_groups.push_back(group);
+    }
+};
+
+/**
+ * @brief 从池内预分配内存块中分配shared_ptr控制块的分配器
+ */
+template <typename T>
+struct frame_group_pool::block_allocator {
+    using value_type = T;
+
+    std::shared_ptr<storage> pool;
+
+    explicit block_allocator(std::shared_ptr<storage> pool) : pool(std::move(pool)) {}
+
+    template <typename U>
+    block_allocator(const block_allocator<U>& other) : pool(other.pool) {}
+
+    T* allocate(size_t n)
+    {
+        static_assert(sizeof(T) <= sizeof(storage::block), "control block too large");
+        if (n == 1) {
+            std::lock_guard<std::mutex> lock(pool->mutex);
+            if (!pool->free_blocks.empty()) {
+                storage::block* b = pool->free_blocks.back();
+                pool->free_blocks.pop_back();
+                return reinterpret_cast<T*>(b);
+            }
+        }
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, size_t n)
+    {
+        auto* b = reinterpret_cast<storage::block*>(p);
+        if (n == 1 && b >= pool->blocks.get() && b < pool->blocks.get() + 2 * pool->groups.size()) {
+            std::lock_guard<std::mutex> lock(pool->mutex);
+            pool->free_blocks.push_back(b);
+            return;
+        }
+        ::operator delete(p);
+    }
+
+    template <typename U>
+    bool operator==(const block_allocator<U>& other) const { return pool == other.pool; }
+
+    template <typename U>
+    bool operator!=(const block_allocator<U>& other) const { return pool != other.pool; }
+};
+
+/**
+ * @brief 构造函数，预分配全部帧组
+ */
+frame_group_pool::frame_group_pool(size_t capacity)
+    : _capacity(capacity),
+      _storage(std::make_shared<storage>())
+{
+    // 控制块在帧组放回池中之后才释放，预留两倍数量避免短暂不足
+    size_t block_count = 2 * capacity;
+
+    _storage->groups.reserve(capacity);
+    _storage->free_groups.reserve(capacity);
+    for (size_t i = 0; i < capacity; ++i) {
+        _storage->groups.emplace_back(new frame_group());
+        _storage->free_groups.push_back(_storage->groups.back().get());
+    }
+
+    _storage->blocks.reset(new storage::block[block_count]);
+    _storage->free_blocks.reserve(block_count);
+    for (size_t i = 0; i < block_count; ++i) {
+        _storage->free_blocks.push_back(&_storage->blocks[i]);
+    }
+}
+
+/**
+ * @brief 获取一个空闲帧组
+ */
+std::shared_ptr<frame_group> frame_group_pool::acquire()
+{
+    frame_group* group = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(_storage->mutex);
+        if (_storage->free_groups.empty()) {
+            return nullptr;
+        }
+        group = _storage->free_groups.back();
+        _storage->free_groups.pop_back();
+    }
+
+    return std::shared_ptr<frame_group>(group,
+                                        group_deleter{_storage},
+                                        block_allocator<frame_group>(_storage));
+}
+
+/**
+ * @brief 当前空闲帧组数量
+ */
+size_t frame_group_pool::available() const
+{
+    std::lock_guard<std::mutex> lock(_storage->mutex);
+    return _storage->free_groups.size();
+}
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "buffer.hpp"
+
+/**
+ * @brief 同步帧组
+ *
+ * 保存同一时刻各摄像头采集到的帧。每路帧的元数据（摄像头ID、时间戳、序列号、
+ * 大小、数据指针）按结构数组(SoA)方式连续存放在对象内部，容量在编译期固定，
+ * 组帧过程不触发堆分配。
+ *
+ * 帧的生命周期由帧组统一持有：帧以移动方式放入帧组，消费者之间只传递
+ * std::shared_ptr<frame_group> 这一个句柄，而不是逐帧复制 shared_ptr<buffer>。
+ */
+class frame_group {
+public:
+    /**
+     * @brief 单个帧组支持的最大摄像头数量
+     */
+    static constexpr size_t max_cameras = 16;
+
+    frame_group();
+
+    // 帧组由帧组池统一管理，禁止拷贝
+    frame_group(const frame_group&) = delete;
+    frame_group& operator=(const frame_group&) = delete;
+
+    /**
+     * @brief 添加一路摄像头的帧
+     *
+     * @param camera_id 摄像头ID
+     * @param frame 帧数据，以移动方式转交给帧组
+     * @return true 添加成功
+     * @return false 帧为空、帧组已满、帧组已封装或该摄像头已存在
+     */
+    bool add_frame(int camera_id, std::shared_ptr<buffer> frame);
+
+    /**
+     * @brief 封装帧组
+     *
+     * 计算组时间戳（最早帧的时间戳）和组内时间戳跨度，封装后不能再添加帧
+     *
+     * @param group_id 帧组ID
+     */
+    void seal(uint64_t group_id);
+
+    /**
+     * @brief 清空帧组并释放所持有的帧，以便复用
+     */
+    void reset();
+
+    /**
+     * @brief 帧组中的帧数量
+     */
+    size_t size() const { return _count; }
+
+    /**
+     * @brief 帧组是否为空
+     */
+    bool empty() const { return _count == 0; }
+
+    /**
+     * @brief 帧组是否已封装
+     */
+    bool is_sealed() const { return _sealed; }
+
+    /**
+     * @brief 判断帧组是否包含全部摄像头的帧
+     *
+     * @param camera_count 期望的摄像头数量
+     */
+    bool is_complete(size_t camera_count) const { return _count >= camera_count; }
+
+    /**
+     * @brief 判断组内时间戳跨度是否在容差范围内
+     *
+     * 跨度在封装时计算一次，此处仅做比较
+     *
+     * @param tolerance_us 容差（微秒）
+     */
+    bool is_well_synced(int64_t tolerance_us) const
+    {
+        return _sealed && _count > 0 && _spread_us <= tolerance_us;
+    }
+
+    /**
+     * @brief 查找摄像头在帧组中的下标
+     *
+     * @param camera_id 摄像头ID
+     * @return int 下标，不存在时返回-1
+     */
+    int index_of(int camera_id) const;
+
+    // 按下标访问单帧元数据
+    int camera_id(size_t index) const { return _meta.camera_id[index]; }
+    int64_t timestamp(size_t index) const { return _meta.timestamp[index]; }
+    uint64_t sequence(size_t index) const { return _meta.sequence[index]; }
+    size_t frame_size(size_t index) const { return _meta.size[index]; }
+    const uint8_t* data(size_t index) const { return _meta.data[index]; }
+
+    /**
+     * @brief 获取下标对应的帧对象
+     *
+     * 仅在需要把单帧交给其他模块长期持有时使用，会增加该帧的引用计数
+     */
+    const std::shared_ptr<buffer>& frame(size_t index) const { return _frames[index]; }
+
+    // 连续的元数据数组，便于批量处理
+    const int32_t* camera_ids() const { return _meta.camera_id; }
+    const int64_t* timestamps() const { return _meta.timestamp; }
+    const uint64_t* sequences() const { return _meta.sequence; }
+
+    /**
+     * @brief 组时间戳（微秒），取组内最早帧的时间戳
+     */
+    int64_t group_timestamp() const { return _group_timestamp; }
+
+    /**
+     * @brief 组内最晚帧与最早帧的时间差（微秒）
+     */
+    int64_t spread_us() const { return _spread_us; }
+
+    /**
+     * @brief 帧组ID
+     */
+    uint64_t group_id() const { return _group_id; }
+
+private:
+    /**
+     * @brief 按结构数组方式存放的逐帧元数据
+     */
+    struct alignas(64) metadata {
+        int64_t timestamp[max_cameras];       // 时间戳（微秒）
+        uint64_t sequence[max_cameras];       // 序列号
+        const uint8_t* data[max_cameras];     // 数据指针
+        uint32_t size[max_cameras];           // 数据大小（字节）
+        int32_t camera_id[max_cameras];       // 摄像头ID
+    };
+
+    metadata _meta;                                              // 逐帧元数据
+    size_t _count;                                               // 帧数量
+    bool _sealed;                                                // 是否已封装
+    int64_t _group_timestamp;                                    // 组时间戳
+    int64_t _spread_us;                                          // 时间戳跨度
+    uint64_t _group_id;                                          // 帧组ID
+    std::array<std::shared_ptr<buffer>, max_cameras> _frames;    // 帧的所有权
+};
+
+/**
+ * @brief 帧组池
+ *
+ * 预先分配固定数量的帧组并循环复用。获取到的帧组在最后一个持有者释放时
+ * 自动清空（随即释放所持有的帧）并回到池中；shared_ptr的控制块也从池内
+ * 预分配的内存块中分配，获取帧组时不会触发堆分配。
+ *
+ * 池的内部存储由已发出的帧组共同持有，帧组可以比池对象本身存活更久。
+ */
+class frame_group_pool {
+public:
+    /**
+     * @brief 构造函数
+     *
+     * @param capacity 预分配的帧组数量
+     */
+    explicit frame_group_pool(size_t capacity);
+
+    // 禁止拷贝
+    frame_group_pool(const frame_group_pool&) = delete;
+    frame_group_pool& operator=(const frame_group_pool&) = delete;
+
+    /**
+     * @brief 获取一个空闲帧组
+     *
+     * @return std::shared_ptr<frame_group> 已清空的帧组，池耗尽时返回nullptr
+     */
+    std::shared_ptr<frame_group> acquire();
+
+    /**
+     * @brief 池容量
+     */
+    size_t capacity() const { return _capacity; }
+
+    /**
+     * @brief 当前空闲帧组数量
+     */
+    size_t available() const;
+
+private:
+    struct storage;
+    struct group_deleter;
+    template <typename T> struct block_allocator;
+
+    size_t _capacity;                      // 池容量
+    std::shared_ptr<storage> _storage;     // 帧组和控制块的预分配存储
+};
@@ -0,0 +1,186 @@
+#include "group_history.hpp"
+
+#include <algorithm>
+
+/**
+ * @brief 构造函数
+ */
+group_history::group_history(const history_config& config)
+    : _config(config),
+      _bytes(0),
+      _paused(false)
+{
+}
+
+/**
+ * @brief 加入一个帧组
+ */
+void group_history::push(std::shared_ptr<frame_group> group)
+{
+    if (!group || !group->is_sealed()) {
+        return;
+    }
+
+    entry item;
+    item.timestamp = group->group_timestamp();
+    item.bytes = 0;
+    for (size_t i = 0; i < group->size(); ++i) {
+        item.bytes += group->frame_size(i);
+    }
+    item.group = std::move(group);
+
+    // 淘汰的帧组在锁外释放，归还帧缓冲池时不阻塞查询
+    std::vector<std::shared_ptr<frame_group>> evicted;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_paused) {
+            ++_stats.paused;
+            return;
+        }
+
+        // 帧组基本按时间顺序到达，乱序时插入到对应位置
+        auto position = _entries.end();
+        if (!_entries.empty() && item.timestamp < _entries.back().timestamp) {
+            position = std::upper_bound(_entries.begin(), _entries.end(), item.timestamp,
+                                        [](int64_t ts, const entry& e) { return ts < e.timestamp; });
+        }
+        _bytes += item.bytes;
+        _entries.insert(position, std::move(item));
+        ++_stats.pushed;
+
+        int64_t newest = _entries.back().timestamp;
+        while (_entries.size() > 1 &&
+               (_bytes > _config.byte_budget ||
+                _entries.size() > _config.max_groups ||
+                newest - _entries.front().timestamp > _config.max_age_us)) {
+            _bytes -= _entries.front().bytes;
+            evicted.push_back(std::move(_entries.front().group));
+            _entries.pop_front();
+            ++_stats.evicted;
+        }
+    }
+}
+
+/**
+ * @brief 获取全部保留的帧组
+ */
+std::vector<std::shared_ptr<frame_group>> group_history::snapshot() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return collect(_entries.begin(), _entries.end());
+}
+
+/**
+ * @brief 按组时间戳查询帧组
+ */
+std::vector<std::shared_ptr<frame_group>> group_history::query(int64_t begin_us, int64_t end_us) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto first = std::lower_bound(_entries.begin(), _entries.end(), begin_us,
+                                  [](const entry& e, int64_t ts) { return e.timestamp < ts; });
+    auto last = std::upper_bound(first, _entries.end(), end_us,
+                                 [](int64_t ts, const entry& e) { return ts < e.timestamp; });
+    return collect(first, last);
+}
+
+/**
+ * @brief 获取最新帧组之前一段时间内的帧组
+ */
+std::vector<std::shared_ptr<frame_group>> group_history::recent(int64_t duration_us) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (_entries.empty()) {
+        ++_stats.snapshots;
+        return {};
+    }
+    int64_t begin_us = _entries.back().timestamp - duration_us;
+    auto first = std::lower_bound(_entries.begin(), _entries.end(), begin_us,
+                                  [](const entry& e, int64_t ts) { return e.timestamp < ts; });
+    return collect(first, _entries.end());
+}
+
+/**
+ * @brief 淘汰最早的帧组直到不超过字节上限
+ */
+size_t group_history::trim(size_t max_bytes)
+{
+    std::vector<std::shared_ptr<frame_group>> evicted;
+    size_t released = 0;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        while (!_entries.empty() && _bytes > max_bytes) {
+            released += _entries.front().bytes;
+            _bytes -= _entries.front().bytes;
+            evicted.push_back(std::move(_entries.front().group));
+            _entries.pop_front();
+            ++_stats.shed;
+        }
+    }
+    return released;
+}
+
+/**
+ * @brief 清空历史
+ */
+void group_history::clear()
+{
+    entry_list entries;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        entries.swap(_entries);
+        _bytes = 0;
+    }
+}
+
+/**
+ * @brief 获取统计信息
+ */
+history_stats group_history::stats() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    history_stats stats = _stats;
+    stats.groups = _entries.size();
+    stats.bytes = _bytes;
+    if (!_entries.empty()) {
+        stats.oldest_us = _entries.front().timestamp;
+        stats.newest_us = _entries.back().timestamp;
+    }
+    return stats;
+}
+
+/**
+ * @brief 暂停或恢复保留新的帧组
+ */
+void group_history::set_paused(bool paused)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _paused = paused;
+}
+
+/**
+ * @brief 是否暂停保留
+ */
+bool group_history::paused() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _paused;
+}
+
+/**
+ * @brief 复制一段帧组的引用，调用者需持有_mutex
+ */
+std::vector<std::shared_ptr<frame_group>> group_history::collect(entry_list::const_iterator first,
+                                                                 entry_list::const_iterator last) const
+{
+    ++_stats.snapshots;
+
+    std::vector<std::shared_ptr<frame_group>> groups;
+    groups.reserve(static_cast<size_t>(std::distance(first, last)));
+    for (auto it = first; it != last; ++it) {
+        groups.push_back(it->group);
+    }
+    return groups;
+}
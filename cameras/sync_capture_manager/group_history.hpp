@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "frame_group.hpp"
+
+/**
+ * @brief 帧组历史配置
+ */
+struct history_config {
+    size_t byte_budget = 64u * 1024u * 1024u;  // 保留帧数据的字节上限
+    int64_t max_age_us = 3000000;               // 相对最新帧组的最长保留时长（微秒）
+    size_t max_groups = 120;                    // 最多保留的帧组数
+};
+
+/**
+ * @brief 帧组历史统计
+ */
+struct history_stats {
+    size_t groups = 0;               // 当前保留的帧组数
+    size_t bytes = 0;                // 当前保留的帧数据字节数
+    int64_t oldest_us = 0;           // 最早帧组的时间戳（微秒）
+    int64_t newest_us = 0;           // 最新帧组的时间戳（微秒）
+    uint64_t pushed = 0;             // 加入的帧组数
+    uint64_t evicted = 0;            // 因超出字节、时长或数量上限而淘汰的帧组数
+    uint64_t shed = 0;               // 因内存压力而提前淘汰的帧组数
+    uint64_t paused = 0;             // 暂停保留期间未加入的帧组数
+    uint64_t snapshots = 0;          // 快照和查询次数
+};
+
+/**
+ * @brief 最近帧组的时间索引环形历史
+ *
+ * 按组时间戳顺序保留最近的帧组，在字节、时长和数量三个上限内淘汰最早的帧组。
+ * 保留的只是帧组的引用：被保留的帧组及其中的帧暂不回到帧组池和各摄像头的帧缓冲池，
+ * 淘汰后随最后一个持有者释放自然回收。快照和按时间范围的查询同样只复制引用，
+ * 外部触发时可把事件前的若干秒交给录制模块而不复制帧数据。
+ *
+ * 线程安全
+ */
+class group_history {
+public:
+    /**
+     * @brief 构造函数
+     *
+     * @param config 历史配置
+     */
+    explicit group_history(const history_config& config = history_config());
+
+    // 禁止拷贝
+    group_history(const group_history&) = delete;
+    group_history& operator=(const group_history&) = delete;
+
+    /**
+     * @brief 加入一个已封装的帧组并淘汰超出上限的最早帧组
+     *
+     * @param group 帧组
+     */
+    void push(std::shared_ptr<frame_group> group);
+
+    /**
+     * @brief 获取全部保留的帧组，按时间顺序
+     */
+    std::vector<std::shared_ptr<frame_group>> snapshot() const;
+
+    /**
+     * @brief 按组时间戳查询帧组，按时间顺序
+     *
+     * @param begin_us 起始时间戳（含，微秒）
+     * @param end_us 结束时间戳（含，微秒）
+     */
+    std::vector<std::shared_ptr<frame_group>> query(int64_t begin_us, int64_t end_us) const;
+
+    /**
+     * @brief 获取最新帧组之前duration_us内的帧组，按时间顺序
+     *
+     * @param duration_us 时长（微秒）
+     */
+    std::vector<std::shared_ptr<frame_group>> recent(int64_t duration_us) const;
+
+    /**
+     * @brief 淘汰最早的帧组直到保留的字节数不超过max_bytes，用于内存压力下削减
+     *
+     * @param max_bytes 保留的字节上限
+     * @return size_t 淘汰的字节数
+     */
+    size_t trim(size_t max_bytes);
+
+    /**
+     * @brief 清空历史
+     */
+    void clear();
+
+    /**
+     * @brief 暂停或恢复保留新的帧组，用于内存预算执行pause_recorders时
+     *
+     * @param paused true表示之后加入的帧组直接丢弃
+     */
+    void set_paused(bool paused);
+
+    /**
+     * @brief 是否暂停保留
+     */
+    bool paused() const;
+
+    /**
+     * @brief 获取统计信息
+     */
+    history_stats stats() const;
+
+    /**
+     * @brief 获取配置
+     */
+    const history_config& config() const { return _config; }
+
+private:
+    /**
+     * @brief 一个保留的帧组
+     */
+    struct entry {
+        int64_t timestamp;                     // 组时间戳
+        size_t bytes;                          // 帧数据字节数
+        std::shared_ptr<frame_group> group;    // 帧组
+    };
+
+    using entry_list = std::deque<entry>;
+
+    std::vector<std::shared_ptr<frame_group>> collect(entry_list::const_iterator first,
+                                                      entry_list::const_iterator last) const;
+
+    history_config _config;          // 历史配置
+    mutable std::mutex _mutex;       // 保护历史和统计
+    entry_list _entries;             // 按时间顺序的帧组
+    size_t _bytes;                   // 保留的字节数
+    bool _paused;                    // 是否暂停保留新的帧组
+    mutable history_stats _stats;    // 统计信息
+};
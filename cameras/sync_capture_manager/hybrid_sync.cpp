@@ -0,0 +1,141 @@
+#include "hybrid_sync.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+/**
+ * @brief 构造函数
+ */
+hybrid_sync::hybrid_sync(const hybrid_sync_config& config, int64_t initial_tolerance_us)
+    : _config(config),
+      _tolerance_us(std::min(std::max(initial_tolerance_us, config.min_tolerance_us), config.max_tolerance_us)),
+      _frame_interval_us(0),
+      _window_mismatches(0)
+{
+    _config.barrier_groups = std::max<size_t>(_config.barrier_groups, 1);
+    _config.window_groups = std::max<size_t>(_config.window_groups, 1);
+    _samples.reserve(std::max(_config.barrier_groups, _config.window_groups));
+    _scratch.reserve(_samples.capacity());
+
+    enter_barrier(sync_decision::initial_barrier);
+}
+
+/**
+ * @brief 记录一个组成的帧组
+ */
+bool hybrid_sync::on_group(int64_t spread_us)
+{
+    ++_metrics.groups;
+    _metrics.last_spread_us = spread_us;
+    _samples.push_back(spread_us);
+
+    if (_metrics.mode == sync_mode::barrier) {
+        if (_samples.size() < _config.barrier_groups) {
+            return false;
+        }
+        // 屏障模式下的跨度未被容差截断，直接作为时间戳模式的初始容差
+        int64_t tolerance = spread_percentile();
+        if (_metrics.spread_percentile_us * _config.headroom > _config.max_tolerance_us) {
+            // 各摄像头相位相差过大，时间戳模式只会不断失配
+            _metrics.last_decision = sync_decision::spread_too_wide;
+            reset_window();
+            return false;
+        }
+        _tolerance_us = tolerance;
+        _metrics.mode = sync_mode::timestamp;
+        _metrics.last_decision = sync_decision::aligned;
+        ++_metrics.timestamp_entries;
+        reset_window();
+        return true;
+    }
+
+    if (_samples.size() < _config.window_groups) {
+        return false;
+    }
+
+    _metrics.window_mismatch_ratio = static_cast<double>(_window_mismatches) / _samples.size();
+    if (_metrics.window_mismatch_ratio > _config.max_mismatch_ratio) {
+        enter_barrier(sync_decision::spread_degraded);
+        return true;
+    }
+
+    // 时间戳模式下超出容差的跨度不会出现在样本中，分位数加余量后仍可能放宽容差
+    int64_t tolerance = spread_percentile();
+    if (tolerance != _tolerance_us) {
+        _metrics.last_decision = (tolerance < _tolerance_us) ? sync_decision::tightened
+                                                             : sync_decision::loosened;
+        _tolerance_us = tolerance;
+        ++_metrics.tolerance_updates;
+    }
+    reset_window();
+    return false;
+}
+
+/**
+ * @brief 记录一次失配丢帧
+ */
+bool hybrid_sync::on_mismatch()
+{
+    ++_metrics.mismatches;
+    if (_metrics.mode == sync_mode::barrier) {
+        return false;
+    }
+
+    // 容差过紧时可能长时间组不成帧组，不等窗口结束
+    ++_window_mismatches;
+    if (_window_mismatches > _config.max_mismatch_ratio * _config.window_groups) {
+        _metrics.window_mismatch_ratio = static_cast<double>(_window_mismatches) /
+                                         std::max<size_t>(_samples.size(), 1);
+        enter_barrier(sync_decision::spread_degraded);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief 重新进入屏障模式
+ */
+void hybrid_sync::enter_barrier(sync_decision reason)
+{
+    _metrics.mode = sync_mode::barrier;
+    _metrics.last_decision = reason;
+    ++_metrics.barrier_entries;
+    reset_window();
+}
+
+/**
+ * @brief 屏障窗口
+ *
+ * 队首已对齐到最新一轮时，同一轮的帧都在基准前后半个帧间隔内，相位任意分布时跨度可接近一个帧间隔
+ */
+int64_t hybrid_sync::barrier_window_us() const
+{
+    if (_config.barrier_window_us > 0) {
+        return _config.barrier_window_us;
+    }
+    return (_frame_interval_us > 0) ? _frame_interval_us : _config.max_tolerance_us;
+}
+
+/**
+ * @brief 按目标分位数和余量计算容差
+ */
+int64_t hybrid_sync::spread_percentile()
+{
+    _scratch.assign(_samples.begin(), _samples.end());
+    double rank = std::min(std::max(_config.target_percentile, 0.0), 1.0) * (_scratch.size() - 1);
+    auto nth = _scratch.begin() + static_cast<size_t>(std::ceil(rank));
+    std::nth_element(_scratch.begin(), nth, _scratch.end());
+    _metrics.spread_percentile_us = *nth;
+
+    int64_t tolerance = static_cast<int64_t>(*nth * _config.headroom);
+    return std::min(std::max(tolerance, _config.min_tolerance_us), _config.max_tolerance_us);
+}
+
+/**
+ * @brief 开始新的统计窗口
+ */
+void hybrid_sync::reset_window()
+{
+    _samples.clear();
+    _window_mismatches = 0;
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief 组帧模式
+ */
+enum class sync_mode {
+    barrier = 0,    // 屏障：等齐所有摄像头，各摄像头取最接近最新队首的帧，重新对齐配对相位
+    timestamp       // 时间戳：按自适应容差匹配队首帧
+};
+
+/**
+ * @brief 最近一次模式或容差调整的原因
+ */
+enum class sync_decision {
+    initial_barrier = 0,    // 启动时进入屏障模式
+    aligned,                // 屏障模式采集到足够的跨度样本，切换到时间戳模式
+    spread_too_wide,        // 屏障模式下的跨度超出容差上限，继续屏障模式
+    tightened,              // 跨度分布变窄，收紧容差
+    loosened,               // 跨度分布变宽，放宽容差
+    spread_degraded,        // 失配丢帧过多，重新进入屏障模式
+    membership_changed      // 摄像头重新参与组帧，重新进入屏障模式
+};
+
+/**
+ * @brief 混合组帧配置
+ */
+struct hybrid_sync_config {
+    size_t barrier_groups = 30;          // 屏障模式下收集多少个帧组的跨度后切换到时间戳模式
+    int64_t barrier_window_us = 0;       // 屏障模式下同一轮帧的最大跨度（微秒），为0时取一个帧间隔
+    double target_percentile = 0.95;     // 容差取跨度分布的该分位数
+    double headroom = 1.25;              // 分位数之上的余量倍数
+    int64_t min_tolerance_us = 100;      // 容差下限（微秒）
+    int64_t max_tolerance_us = 10000;    // 容差上限（微秒）
+    size_t window_groups = 100;          // 时间戳模式下每多少个帧组重新计算一次容差
+    double max_mismatch_ratio = 0.2;     // 窗口内失配丢帧数与帧组数之比超过该值时重新进入屏障模式
+};
+
+/**
+ * @brief 混合组帧的决策和容差统计
+ */
+struct sync_metrics {
+    sync_mode mode = sync_mode::timestamp;                       // 当前模式
+    sync_decision last_decision = sync_decision::initial_barrier; // 最近一次决策
+    int64_t tolerance_us = 0;            // 当前生效的容差（屏障模式下为屏障窗口）
+    int64_t spread_percentile_us = 0;    // 最近一次计算的跨度分位数
+    int64_t last_spread_us = 0;          // 最近一个帧组的跨度
+    uint64_t groups = 0;                 // 组成的帧组数
+    uint64_t mismatches = 0;             // 因跨度超出容差而丢弃的队首帧数
+    uint64_t barrier_entries = 0;        // 进入屏障模式的次数
+    uint64_t timestamp_entries = 0;      // 进入时间戳模式的次数
+    uint64_t tolerance_updates = 0;      // 容差调整次数
+    double window_mismatch_ratio = 0;    // 最近一个完整窗口的失配丢帧比例
+};
+
+/**
+ * @brief 屏障与时间戳混合组帧的自适应控制
+ *
+ * 从屏障模式开始：等齐所有摄像头后按最新队首对齐配对，记录每个帧组的跨度；
+ * 样本足够后按目标分位数加余量得到容差并切换到时间戳模式。时间戳模式下每个窗口按
+ * 最近的跨度分布收紧或放宽容差，窗口内失配丢帧过多时说明跨度已经劣化，重新进入屏障模式
+ * 采集未被容差截断的跨度分布。
+ *
+ * 不加锁，由sync_capture_manager在持有其_mutex时调用
+ */
+class hybrid_sync {
+public:
+    /**
+     * @brief 构造函数，从屏障模式开始
+     *
+     * @param config 配置
+     * @param initial_tolerance_us 切换到时间戳模式前使用的初始容差
+     */
+    hybrid_sync(const hybrid_sync_config& config, int64_t initial_tolerance_us);
+
+    /**
+     * @brief 当前模式
+     */
+    sync_mode mode() const { return _metrics.mode; }
+
+    /**
+     * @brief 当前生效的容差，屏障模式下为屏障窗口
+     */
+    int64_t tolerance_us() const
+    {
+        return (_metrics.mode == sync_mode::barrier) ? barrier_window_us() : _tolerance_us;
+    }
+
+    /**
+     * @brief 更新观测到的最大帧间隔，用于默认的屏障窗口
+     *
+     * @param interval_us 各摄像头帧间隔中的最大值（微秒）
+     */
+    void set_frame_interval(int64_t interval_us) { _frame_interval_us = interval_us; }
+
+    /**
+     * @brief 记录一个组成的帧组
+     *
+     * @param spread_us 帧组内时间戳跨度
+     * @return true 模式发生了切换
+     */
+    bool on_group(int64_t spread_us);
+
+    /**
+     * @brief 记录一次因跨度超出容差而丢弃的队首帧
+     *
+     * @return true 模式发生了切换
+     */
+    bool on_mismatch();
+
+    /**
+     * @brief 重新进入屏障模式
+     *
+     * @param reason 原因
+     */
+    void enter_barrier(sync_decision reason);
+
+    /**
+     * @brief 获取统计
+     */
+    sync_metrics metrics() const
+    {
+        sync_metrics metrics = _metrics;
+        metrics.tolerance_us = tolerance_us();
+        return metrics;
+    }
+
+private:
+    int64_t barrier_window_us() const;
+    int64_t spread_percentile();
+    void reset_window();
+
+    hybrid_sync_config _config;          // 配置
+    int64_t _tolerance_us;               // 时间戳模式的容差
+    int64_t _frame_interval_us;          // 观测到的最大帧间隔
+    std::vector<int64_t> _samples;       // 当前窗口的跨度样本
+    std::vector<int64_t> _scratch;       // 计算分位数用的副本
+    size_t _window_mismatches;           // 当前窗口的失配丢帧数
+    sync_metrics _metrics;               // 统计
+};
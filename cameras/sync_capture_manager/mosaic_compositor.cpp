@@ -0,0 +1,399 @@
+#include "mosaic_compositor.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <linux/videodev2.h>
+
+#include "pixel_pipeline.hpp"
+#include "preview_pyramid.hpp"
+
+namespace {
+
+constexpr int glyph_columns = 5;     // 基础字形宽度
+constexpr int glyph_rows = 7;        // 基础字形高度
+
+/**
+ * @brief 5x7点阵字形，每行低5位从左到右
+ */
+struct glyph_bitmap {
+    char code;
+    uint8_t rows[glyph_rows];
+};
+
+constexpr glyph_bitmap font[] = {
+    {' ', {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}},
+    {'0', {0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E}},
+    {'1', {0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E}},
+    {'2', {0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F}},
+    {'3', {0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E}},
+    {'4', {0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02}},
+    {'5', {0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E}},
+    {'6', {0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E}},
+    {'7', {0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08}},
+    {'8', {0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E}},
+    {'9', {0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C}},
+    {':', {0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00}},
+    {'.', {0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C}},
+    {'#', {0x0A, 0x0A, 0x1F, 0x0A, 0x1F, 0x0A, 0x0A}},
+    {'-', {0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00}},
+    {'A', {0x0E, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11}},
+    {'C', {0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E}},
+    {'G', {0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F}},
+    {'I', {0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E}},
+    {'L', {0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F}},
+    {'M', {0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11}},
+    {'N', {0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11}},
+    {'O', {0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E}},
+    {'S', {0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E}},
+};
+
+// ---------------------------------------------------------------------------
+// 按行取样，xmap为每个输出像素对应的源图列号
+// ---------------------------------------------------------------------------
+
+template <int Y0, int U, int V>
+struct packed_yuv422_sampler {
+    static void row(const uint8_t* const* planes, const size_t* strides, size_t y,
+                    const uint32_t* xmap, size_t width, uint8_t* dst)
+    {
+        const uint8_t* s = planes[0] + y * strides[0];
+        for (size_t x = 0; x < width; ++x, dst += 3) {
+            uint32_t sx = xmap[x];
+            const uint8_t* p = s + (sx & ~1u) * 2;
+            pixel::bgr24::store_yuv(dst, p[Y0 + (sx & 1) * 2], p[U], p[V]);
+        }
+    }
+};
+
+struct nv12_sampler {
+    static void row(const uint8_t* const* planes, const size_t* strides, size_t y,
+                    const uint32_t* xmap, size_t width, uint8_t* dst)
+    {
+        const uint8_t* luma = planes[0] + y * strides[0];
+        const uint8_t* chroma = planes[1] + (y / 2) * strides[1];
+        for (size_t x = 0; x < width; ++x, dst += 3) {
+            uint32_t sx = xmap[x];
+            const uint8_t* c = chroma + (sx & ~1u);
+            pixel::bgr24::store_yuv(dst, luma[sx], c[0], c[1]);
+        }
+    }
+};
+
+struct grey_sampler {
+    static void row(const uint8_t* const* planes, const size_t* strides, size_t y,
+                    const uint32_t* xmap, size_t width, uint8_t* dst)
+    {
+        const uint8_t* s = planes[0] + y * strides[0];
+        for (size_t x = 0; x < width; ++x, dst += 3) {
+            dst[0] = dst[1] = dst[2] = s[xmap[x]];
+        }
+    }
+};
+
+template <int R, int B>
+struct rgb24_sampler {
+    static void row(const uint8_t* const* planes, const size_t* strides, size_t y,
+                    const uint32_t* xmap, size_t width, uint8_t* dst)
+    {
+        const uint8_t* s = planes[0] + y * strides[0];
+        for (size_t x = 0; x < width; ++x, dst += 3) {
+            const uint8_t* p = s + xmap[x] * 3;
+            pixel::bgr24::store_rgb(dst, p[R], p[1], p[B]);
+        }
+    }
+};
+
+/**
+ * @brief 按最近邻把一帧缩放到格子
+ */
+template <uint32_t FourCC, typename Sampler>
+bool scale_into(const buffer& frame, uint8_t* dst, size_t stride, size_t width, size_t height)
+{
+    const uint8_t* planes[2] = {nullptr, nullptr};
+    size_t strides[2] = {0, 0};
+    size_t src_width = frame.width();
+    size_t src_height = frame.height();
+    if (!pixel::locate_planes<pixel::format_traits<FourCC>>(frame, src_width, src_height, planes, strides)) {
+        return false;
+    }
+
+    // 每个线程复用列映射表，取输出像素中心对应的源像素
+    thread_local std::vector<uint32_t> xmap;
+    xmap.resize(width);
+    for (size_t x = 0; x < width; ++x) {
+        xmap[x] = static_cast<uint32_t>(((2 * x + 1) * src_width) / (2 * width));
+    }
+
+    for (size_t y = 0; y < height; ++y) {
+        size_t sy = ((2 * y + 1) * src_height) / (2 * height);
+        Sampler::row(planes, strides, sy, xmap.data(), width, dst + y * stride);
+    }
+    return true;
+}
+
+/**
+ * @brief 把一帧缩放到格子，优先使用已生成的预览金字塔
+ *
+ * @return false 格式不支持或数据不完整
+ */
+bool scale_frame(const buffer& frame, uint8_t* dst, size_t stride, size_t width, size_t height)
+{
+    const buffer* source = &frame;
+    std::shared_ptr<buffer> level;
+    const std::shared_ptr<preview_pyramid>& pyramid = frame.pyramid();
+    if (pyramid && pyramid->computed()) {
+        // 从最小的一级开始找不小于格子的图像
+        for (size_t k = preview_pyramid::max_levels; k >= 1; --k) {
+            level = pyramid->level(k);
+            if (level && level->width() >= width && level->height() >= height) {
+                source = level.get();
+                break;
+            }
+            level.reset();
+        }
+        // 内存压力下金字塔只保留最小的一级，预览降低分辨率，直接从该级放大
+        if (!level && pyramid->reduced()) {
+            level = pyramid->level(1);
+            if (level) {
+                source = level.get();
+            }
+        }
+    }
+    if (source->width() == 0 || source->height() == 0) {
+        return false;
+    }
+
+    switch (source->fourcc()) {
+    case V4L2_PIX_FMT_YUYV:
+        return scale_into<V4L2_PIX_FMT_YUYV, packed_yuv422_sampler<0, 1, 3>>(*source, dst, stride, width, height);
+    case V4L2_PIX_FMT_UYVY:
+        return scale_into<V4L2_PIX_FMT_UYVY, packed_yuv422_sampler<1, 0, 2>>(*source, dst, stride, width, height);
+    case V4L2_PIX_FMT_NV12:
+        return scale_into<V4L2_PIX_FMT_NV12, nv12_sampler>(*source, dst, stride, width, height);
+    case V4L2_PIX_FMT_NV12M:
+        return scale_into<V4L2_PIX_FMT_NV12M, nv12_sampler>(*source, dst, stride, width, height);
+    case V4L2_PIX_FMT_GREY:
+        return scale_into<V4L2_PIX_FMT_GREY, grey_sampler>(*source, dst, stride, width, height);
+    case V4L2_PIX_FMT_RGB24:
+        return scale_into<V4L2_PIX_FMT_RGB24, rgb24_sampler<0, 2>>(*source, dst, stride, width, height);
+    case V4L2_PIX_FMT_BGR24:
+        return scale_into<V4L2_PIX_FMT_BGR24, rgb24_sampler<2, 0>>(*source, dst, stride, width, height);
+    default:
+        return false;
+    }
+}
+
+} // namespace
+
+/**
+ * @brief 预先光栅化的字形图集
+ *
+ * 每个字形按放大倍数展开为一个格子大小的掩码，绘制时逐字节查表，
+ * 格子四周留出一个放大像素的边距作为文字背景
+ */
+struct mosaic_compositor::glyph_atlas {
+    size_t cell_width;              // 格子宽度
+    size_t cell_height;             // 格子高度
+    std::vector<uint8_t> masks;     // 各字形的掩码，非0为前景
+    int lookup[128];                // 字符到字形下标，-1表示不支持
+
+    explicit glyph_atlas(int scale)
+    {
+        if (scale < 1) {
+            scale = 1;
+        }
+        cell_width = static_cast<size_t>(glyph_columns + 1) * scale;
+        cell_height = static_cast<size_t>(glyph_rows + 2) * scale;
+
+        size_t count = sizeof(font) / sizeof(font[0]);
+        masks.assign(count * cell_width * cell_height, 0);
+        for (int& index : lookup) {
+            index = -1;
+        }
+
+        for (size_t g = 0; g < count; ++g) {
+            lookup[static_cast<unsigned char>(font[g].code)] = static_cast<int>(g);
+            uint8_t* mask = &masks[g * cell_width * cell_height];
+            for (size_t y = 0; y < cell_height; ++y) {
+                int row = static_cast<int>(y) / scale - 1;
+                if (row < 0 || row >= glyph_rows) {
+                    continue;
+                }
+                for (size_t x = 0; x < cell_width; ++x) {
+                    int column = static_cast<int>(x) / scale;
+                    if (column < glyph_columns && (font[g].rows[row] >> (glyph_columns - 1 - column)) & 1) {
+                        mask[y * cell_width + x] = 0xFF;
+                    }
+                }
+            }
+        }
+    }
+
+    const uint8_t* glyph(char code) const
+    {
+        int index = lookup[static_cast<unsigned char>(code) & 0x7F];
+        if (index < 0) {
+            index = lookup[static_cast<unsigned char>(' ')];
+        }
+        return &masks[static_cast<size_t>(index) * cell_width * cell_height];
+    }
+};
+
+/**
+ * @brief 构造函数
+ */
+mosaic_compositor::mosaic_compositor(const mosaic_config& config, std::shared_ptr<memory_budget> budget)
+    : _config(config),
+      _atlas(new glyph_atlas(config.glyph_scale)),
+      _workers(config.threads),
+      _last_compose_us(0)
+{
+    size_t frame_size = static_cast<size_t>(_config.width) * _config.height * 3;
+    _pool.reset(new frame_pool(frame_size, _config.pool_size, std::move(budget)));
+}
+
+/**
+ * @brief 析构函数
+ */
+mosaic_compositor::~mosaic_compositor() = default;
+
+/**
+ * @brief 设置格子与摄像头的对应关系
+ */
+void mosaic_compositor::set_layout(const std::vector<int>& camera_ids)
+{
+    std::lock_guard<std::mutex> lock(_compose_mutex);
+    _layout = camera_ids;
+}
+
+/**
+ * @brief 合成一帧拼接画面
+ */
+std::shared_ptr<buffer> mosaic_compositor::compose(const frame_group& group)
+{
+    std::lock_guard<std::mutex> compose_lock(_compose_mutex);
+    auto start = std::chrono::steady_clock::now();
+
+    std::shared_ptr<buffer> output = _pool->acquire();
+    if (!output) {
+        return nullptr;
+    }
+
+    size_t stride = static_cast<size_t>(_config.width) * 3;
+    buffer::plane layout;
+    layout.offset = 0;
+    layout.size = output->size();
+    layout.bytesperline = static_cast<uint32_t>(stride);
+    output->set_planes(&layout, 1);
+    output->set_format(_config.width, _config.height, V4L2_PIX_FMT_BGR24);
+    output->set_timestamp(group.group_timestamp());
+    output->set_sequence(group.group_id());
+    if (!group.empty()) {
+        output->set_clock(group.frame(0)->clock());
+    }
+
+    // 网格布局
+    size_t tiles = _config.tiles;
+    if (tiles == 0) {
+        tiles = _layout.empty() ? group.size() : _layout.size();
+    }
+    tiles = std::max<size_t>(tiles, 1);
+    size_t columns = _config.columns;
+    if (columns == 0) {
+        columns = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(tiles))));
+    }
+    size_t rows = (tiles + columns - 1) / columns;
+
+    _job.group = &group;
+    _job.output = static_cast<uint8_t*>(output->data());
+    _job.stride = stride;
+    _job.columns = columns;
+    _job.rows = rows;
+
+    _workers.run(columns * rows, [this](size_t tile) { render_tile(tile); });
+    _job = job();
+
+    _last_compose_us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    return output;
+}
+
+/**
+ * @brief 处理一个格子
+ */
+void mosaic_compositor::render_tile(size_t tile)
+{
+    const frame_group& group = *_job.group;
+    size_t column = tile % _job.columns;
+    size_t row = tile / _job.columns;
+    size_t x0 = column * _config.width / _job.columns;
+    size_t x1 = (column + 1) * _config.width / _job.columns;
+    size_t y0 = row * _config.height / _job.rows;
+    size_t y1 = (row + 1) * _config.height / _job.rows;
+    size_t width = x1 - x0;
+    size_t height = y1 - y0;
+    uint8_t* dst = _job.output + y0 * _job.stride + x0 * 3;
+
+    // 找到格子对应的帧
+    int index = -1;
+    int camera_id = -1;
+    if (!_layout.empty()) {
+        if (tile < _layout.size()) {
+            camera_id = _layout[tile];
+            index = group.index_of(camera_id);
+        }
+    } else if (tile < group.size()) {
+        index = static_cast<int>(tile);
+        camera_id = group.camera_id(tile);
+    }
+
+    bool drawn = (index >= 0) && scale_frame(*group.frame(index), dst, _job.stride, width, height);
+    if (!drawn) {
+        for (size_t y = 0; y < height; ++y) {
+            memset(dst + y * _job.stride, 0, width * 3);
+        }
+    }
+
+    if (!_config.overlay || camera_id < 0) {
+        return;
+    }
+
+    char text[64];
+    if (drawn) {
+        // 时间戳按一天内的时刻显示
+        int64_t ms = group.timestamp(index) / 1000;
+        int64_t day_ms = ((ms % 86400000) + 86400000) % 86400000;
+        snprintf(text, sizeof(text), "CAM %d #%llu %02d:%02d:%02d.%03d",
+                 camera_id, static_cast<unsigned long long>(group.sequence(index)),
+                 static_cast<int>(day_ms / 3600000), static_cast<int>(day_ms / 60000 % 60),
+                 static_cast<int>(day_ms / 1000 % 60), static_cast<int>(day_ms % 1000));
+    } else {
+        snprintf(text, sizeof(text), "CAM %d NO SIGNAL", camera_id);
+    }
+    draw_text(text, dst, _job.stride, width, height);
+}
+
+/**
+ * @brief 在格子左上角绘制一行文字，背景压暗一半，超出格子的部分截断
+ */
+void mosaic_compositor::draw_text(const char* text, uint8_t* dst, size_t stride,
+                                  size_t max_width, size_t max_height) const
+{
+    const glyph_atlas& atlas = *_atlas;
+    size_t height = std::min(atlas.cell_height, max_height);
+
+    size_t x = 0;
+    for (const char* c = text; *c && x + atlas.cell_width <= max_width; ++c, x += atlas.cell_width) {
+        const uint8_t* mask = atlas.glyph(*c);
+        for (size_t y = 0; y < height; ++y) {
+            const uint8_t* m = mask + y * atlas.cell_width;
+            uint8_t* d = dst + y * stride + x * 3;
+            for (size_t i = 0; i < atlas.cell_width * 3; ++i) {
+                d[i] = m[i / 3] ? 0xFF : static_cast<uint8_t>(d[i] >> 1);
+            }
+        }
+    }
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "buffer.hpp"
+#include "frame_group.hpp"
+#include "frame_pool.hpp"
+#include "memory_budget.hpp"
+#include "worker_pool.hpp"
+
+/**
+ * @brief 拼接画面配置
+ */
+struct mosaic_config {
+    uint32_t width = 1920;           // 输出宽度
+    uint32_t height = 1080;          // 输出高度
+    size_t columns = 0;              // 列数，为0时按画面数取不小于其平方根的整数
+    size_t tiles = 0;                // 画面数，为0时按布局或帧组大小
+    size_t threads = 4;              // 并行线程数，包括调用compose的线程
+    size_t pool_size = 3;            // 输出缓冲池容量
+    bool overlay = true;             // 是否叠加摄像头ID、序列号和时间戳
+    int glyph_scale = 2;             // 字符放大倍数，基础字形为5x7像素
+};
+
+/**
+ * @brief 同步帧组的拼接画面合成器
+ *
+ * 把帧组中每个摄像头的帧缩放到网格中的一个格子，写入输出缓冲池中的一个BGR24
+ * buffer。各格子由线程池并行处理；帧已附加并生成预览金字塔时从不小于格子尺寸的
+ * 最小一级取样，否则直接按最近邻从原图取样，只读取输出需要的像素。
+ * 文字叠加使用构造时预先光栅化的字形图集，不依赖OpenCV。
+ *
+ * 输入支持YUYV、UYVY、NV12、NV12M、GREY、RGB24和BGR24，其余格式的格子显示为黑色
+ */
+class mosaic_compositor {
+public:
+    /**
+     * @brief 构造函数，创建线程池和字形图集
+     *
+     * @param config 配置
+     * @param budget 共享的内存预算，为空时不限制
+     */
+    explicit mosaic_compositor(const mosaic_config& config = mosaic_config(),
+                               std::shared_ptr<memory_budget> budget = nullptr);
+
+    /**
+     * @brief 析构函数，停止线程池
+     */
+    ~mosaic_compositor();
+
+    // 禁止拷贝
+    mosaic_compositor(const mosaic_compositor&) = delete;
+    mosaic_compositor& operator=(const mosaic_compositor&) = delete;
+
+    /**
+     * @brief 设置格子与摄像头的对应关系
+     *
+     * @param camera_ids 第i个格子显示的摄像头ID，为空时按帧组中的顺序
+     */
+    void set_layout(const std::vector<int>& camera_ids);
+
+    /**
+     * @brief 合成一帧拼接画面
+     *
+     * 帧组中缺少的摄像头显示为黑色并标注NO SIGNAL。不可重入，多个线程同时调用时依次执行
+     *
+     * @param group 已封装的帧组
+     * @return std::shared_ptr<buffer> BGR24图像，输出缓冲池耗尽时返回nullptr
+     */
+    std::shared_ptr<buffer> compose(const frame_group& group);
+
+    /**
+     * @brief 获取配置
+     */
+    const mosaic_config& config() const { return _config; }
+
+    /**
+     * @brief 获取最近一次合成的耗时（微秒）
+     */
+    int64_t get_last_compose_us() const { return _last_compose_us; }
+
+private:
+    struct glyph_atlas;
+
+    /**
+     * @brief 一次合成任务
+     */
+    struct job {
+        const frame_group* group = nullptr;    // 输入帧组
+        uint8_t* output = nullptr;             // 输出图像
+        size_t stride = 0;                     // 输出行跨度
+        size_t columns = 1;                    // 列数
+        size_t rows = 1;                       // 行数
+    };
+
+    void render_tile(size_t tile);
+    void draw_text(const char* text, uint8_t* dst, size_t stride, size_t max_width, size_t max_height) const;
+
+    mosaic_config _config;                         // 配置
+    std::unique_ptr<frame_pool> _pool;             // 输出缓冲池
+    std::unique_ptr<glyph_atlas> _atlas;           // 字形图集
+    std::vector<int> _layout;                      // 格子对应的摄像头ID
+
+    std::mutex _compose_mutex;                     // 保证compose串行执行
+    worker_pool _workers;                          // 并行处理格子的线程池
+    job _job;                                      // 当前任务
+    std::atomic<int64_t> _last_compose_us;         // 最近一次合成的耗时
+};
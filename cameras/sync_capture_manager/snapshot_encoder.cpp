@@ -0,0 +1,525 @@
+#include "snapshot_encoder.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <csetjmp>
+#include <cstdio>
+#include <linux/videodev2.h>
+
+#include <jpeglib.h>
+#include <png.h>
+
+#include "pixel_pipeline.hpp"
+
+namespace {
+
+/**
+ * @brief YUV源图的访问方式，覆盖打包4:2:2和半平面4:2:0
+ */
+struct yuv_source {
+    const uint8_t* luma;        // 亮度起始地址（已加上Y分量偏移）
+    size_t luma_stride;         // 亮度行跨度
+    size_t luma_step;           // 相邻亮度样本的字节间距
+    const uint8_t* chroma;      // 色度起始地址
+    size_t chroma_stride;       // 色度行跨度
+    size_t chroma_step;         // 相邻色度样本对的字节间距
+    size_t u_offset;            // U在样本对中的偏移
+    size_t v_offset;            // V在样本对中的偏移
+    bool chroma_subsampled;     // 色度是否只有一半的行（4:2:0）
+    size_t width;               // 宽度
+    size_t height;              // 高度
+
+    const uint8_t* chroma_row(size_t row) const
+    {
+        return chroma + (chroma_subsampled ? row / 2 : row) * chroma_stride;
+    }
+};
+
+/**
+ * @brief 有限范围（16~235/240）到JFIF全范围的查找表，以及不做转换时用的恒等表
+ */
+struct range_tables {
+    uint8_t luma[256];
+    uint8_t chroma[256];
+    uint8_t identity[256];
+
+    range_tables()
+    {
+        for (int i = 0; i < 256; ++i) {
+            identity[i] = static_cast<uint8_t>(i);
+            luma[i] = pixel::clamp_u8(((i - 16) * 255 + 109) / 219);
+            chroma[i] = pixel::clamp_u8(((i - 128) * 255 + (i >= 128 ? 112 : -112)) / 224 + 128);
+        }
+    }
+
+    static const range_tables& instance()
+    {
+        static const range_tables tables;
+        return tables;
+    }
+};
+
+template <uint32_t FourCC>
+bool locate(const buffer& frame, const uint8_t** planes, size_t* strides)
+{
+    return pixel::locate_planes<pixel::format_traits<FourCC>>(frame, frame.width(), frame.height(), planes, strides);
+}
+
+/**
+ * @brief 按帧格式建立YUV源图的访问方式
+ *
+ * @return false 格式不支持或数据不完整
+ */
+bool make_yuv_source(const buffer& frame, yuv_source& src)
+{
+    const uint8_t* planes[2] = {nullptr, nullptr};
+    size_t strides[2] = {0, 0};
+    src.width = frame.width();
+    src.height = frame.height();
+
+    switch (frame.fourcc()) {
+    case V4L2_PIX_FMT_YUYV:
+    case V4L2_PIX_FMT_UYVY: {
+        bool yuyv = (frame.fourcc() == V4L2_PIX_FMT_YUYV);
+        if (!(yuyv ? locate<V4L2_PIX_FMT_YUYV>(frame, planes, strides)
+                   : locate<V4L2_PIX_FMT_UYVY>(frame, planes, strides))) {
+            return false;
+        }
+        src.luma = planes[0] + (yuyv ? 0 : 1);
+        src.luma_stride = strides[0];
+        src.luma_step = 2;
+        src.chroma = planes[0];
+        src.chroma_stride = strides[0];
+        src.chroma_step = 4;
+        src.u_offset = yuyv ? 1 : 0;
+        src.v_offset = yuyv ? 3 : 2;
+        src.chroma_subsampled = false;
+        return true;
+    }
+    case V4L2_PIX_FMT_NV12:
+    case V4L2_PIX_FMT_NV12M:
+        if (!(frame.fourcc() == V4L2_PIX_FMT_NV12 ? locate<V4L2_PIX_FMT_NV12>(frame, planes, strides)
+                                                  : locate<V4L2_PIX_FMT_NV12M>(frame, planes, strides))) {
+            return false;
+        }
+        src.luma = planes[0];
+        src.luma_stride = strides[0];
+        src.luma_step = 1;
+        src.chroma = planes[1];
+        src.chroma_stride = strides[1];
+        src.chroma_step = 2;
+        src.u_offset = 0;
+        src.v_offset = 1;
+        src.chroma_subsampled = true;
+        return true;
+    default:
+        return false;
+    }
+}
+
+/**
+ * @brief 复制一行样本并把行尾补齐到DCT块宽度
+ */
+inline void fill_row(const uint8_t* src, size_t step, const uint8_t* table,
+                     size_t width, size_t padded, uint8_t* dst)
+{
+    for (size_t x = 0; x < width; ++x) {
+        dst[x] = table[src[x * step]];
+    }
+    std::fill(dst + width, dst + padded, dst[width - 1]);
+}
+
+} // namespace
+
+/**
+ * @brief 可复用的编码器上下文
+ */
+struct snapshot_encoder::context {
+    struct error_manager {
+        jpeg_error_mgr pub;
+        jmp_buf jump;
+        char message[JMSG_LENGTH_MAX];
+    };
+
+    struct destination {
+        jpeg_destination_mgr pub;
+        std::vector<uint8_t>* output;
+    };
+
+    jpeg_compress_struct cinfo;         // JPEG编码器
+    error_manager error;                // 错误处理
+    destination dest;                   // 输出到output
+    std::vector<uint8_t> output;        // 输出缓冲区，容量随最大的一帧增长
+    std::vector<uint8_t> rows;          // 一个iMCU行的Y、Cb、Cr样本
+    std::vector<uint8_t> bgr;           // PNG编码的BGR中间图像
+
+    context()
+    {
+        cinfo.err = jpeg_std_error(&error.pub);
+        error.pub.error_exit = &context::on_error;
+        error.message[0] = '\0';
+        jpeg_create_compress(&cinfo);
+
+        dest.output = &output;
+        dest.pub.init_destination = &context::init_destination;
+        dest.pub.empty_output_buffer = &context::empty_output_buffer;
+        dest.pub.term_destination = &context::term_destination;
+        cinfo.dest = &dest.pub;
+        output.resize(256 * 1024);
+    }
+
+    ~context()
+    {
+        jpeg_destroy_compress(&cinfo);
+    }
+
+    static void on_error(j_common_ptr cinfo)
+    {
+        error_manager* error = reinterpret_cast<error_manager*>(cinfo->err);
+        (*cinfo->err->format_message)(cinfo, error->message);
+        longjmp(error->jump, 1);
+    }
+
+    static void init_destination(j_compress_ptr cinfo)
+    {
+        destination* dest = reinterpret_cast<destination*>(cinfo->dest);
+        dest->output->resize(dest->output->capacity());
+        dest->pub.next_output_byte = dest->output->data();
+        dest->pub.free_in_buffer = dest->output->size();
+    }
+
+    static boolean empty_output_buffer(j_compress_ptr cinfo)
+    {
+        destination* dest = reinterpret_cast<destination*>(cinfo->dest);
+        size_t used = dest->output->size();
+        dest->output->resize(used * 2);
+        dest->pub.next_output_byte = dest->output->data() + used;
+        dest->pub.free_in_buffer = dest->output->size() - used;
+        return TRUE;
+    }
+
+    static void term_destination(j_compress_ptr cinfo)
+    {
+        destination* dest = reinterpret_cast<destination*>(cinfo->dest);
+        dest->output->resize(dest->output->size() - dest->pub.free_in_buffer);
+    }
+
+    static void png_write(png_structp png, png_bytep data, png_size_t length)
+    {
+        std::vector<uint8_t>* out = static_cast<std::vector<uint8_t>*>(png_get_io_ptr(png));
+        out->insert(out->end(), data, data + length);
+    }
+
+    static void png_flush(png_structp)
+    {
+    }
+
+    bool encode_jpeg(const yuv_source& src, const snapshot_config& config, std::string& message);
+    void write_raw_rows(const yuv_source& src, bool full_range, size_t luma_rows);
+    bool encode_png(const buffer& frame, const snapshot_config& config, std::string& message);
+};
+
+/**
+ * @brief 以YCbCr原始数据编码JPEG
+ */
+bool snapshot_encoder::context::encode_jpeg(const yuv_source& src, const snapshot_config& config,
+                                            std::string& message)
+{
+    int h_factor = (config.subsampling == chroma_subsampling::yuv444) ? 1 : 2;
+    int v_factor = (config.subsampling == chroma_subsampling::yuv420) ? 2 : 1;
+    size_t luma_rows = static_cast<size_t>(v_factor) * DCTSIZE;
+    size_t luma_padded = (src.width + h_factor * DCTSIZE - 1) / (h_factor * DCTSIZE) * (h_factor * DCTSIZE);
+    size_t chroma_padded = luma_padded / h_factor;
+    rows.resize(luma_rows * luma_padded + 2 * DCTSIZE * chroma_padded);
+
+    if (setjmp(error.jump)) {
+        jpeg_abort_compress(&cinfo);
+        message = error.message;
+        return false;
+    }
+
+    cinfo.image_width = static_cast<JDIMENSION>(src.width);
+    cinfo.image_height = static_cast<JDIMENSION>(src.height);
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_YCbCr;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_colorspace(&cinfo, JCS_YCbCr);
+    jpeg_set_quality(&cinfo, std::min(std::max(config.quality, 1), 100), TRUE);
+    cinfo.raw_data_in = TRUE;
+    cinfo.comp_info[0].h_samp_factor = h_factor;
+    cinfo.comp_info[0].v_samp_factor = v_factor;
+    cinfo.comp_info[1].h_samp_factor = 1;
+    cinfo.comp_info[1].v_samp_factor = 1;
+    cinfo.comp_info[2].h_samp_factor = 1;
+    cinfo.comp_info[2].v_samp_factor = 1;
+
+    jpeg_start_compress(&cinfo, TRUE);
+    while (cinfo.next_scanline < cinfo.image_height) {
+        write_raw_rows(src, config.full_range, luma_rows);
+    }
+    jpeg_finish_compress(&cinfo);
+    return true;
+}
+
+/**
+ * @brief 准备并写入一个iMCU行，超出图像的行重复最后一行
+ */
+void snapshot_encoder::context::write_raw_rows(const yuv_source& src, bool full_range, size_t luma_rows)
+{
+    const range_tables& tables = range_tables::instance();
+    const uint8_t* luma_table = full_range ? tables.luma : tables.identity;
+    const uint8_t* chroma_table = full_range ? tables.chroma : tables.identity;
+
+    bool full_chroma = (cinfo.comp_info[0].h_samp_factor == 1);
+    size_t v_factor = static_cast<size_t>(cinfo.comp_info[0].v_samp_factor);
+    size_t luma_padded = cinfo.comp_info[0].width_in_blocks * DCTSIZE;
+    size_t chroma_padded = cinfo.comp_info[1].width_in_blocks * DCTSIZE;
+    size_t chroma_width = full_chroma ? src.width : (src.width + 1) / 2;
+    size_t first = cinfo.next_scanline;
+
+    JSAMPROW y_rows[2 * DCTSIZE];
+    JSAMPROW cb_rows[DCTSIZE];
+    JSAMPROW cr_rows[DCTSIZE];
+    JSAMPARRAY planes[3] = {y_rows, cb_rows, cr_rows};
+
+    uint8_t* y_base = rows.data();
+    uint8_t* cb_base = y_base + luma_rows * luma_padded;
+    uint8_t* cr_base = cb_base + DCTSIZE * chroma_padded;
+
+    for (size_t i = 0; i < luma_rows; ++i) {
+        size_t row = std::min(first + i, src.height - 1);
+        y_rows[i] = y_base + i * luma_padded;
+        fill_row(src.luma + row * src.luma_stride, src.luma_step, luma_table, src.width, luma_padded, y_rows[i]);
+    }
+
+    for (size_t j = 0; j < DCTSIZE; ++j) {
+        // 色度行覆盖的亮度行，4:2:0时为两行
+        size_t row0 = std::min(first + j * v_factor, src.height - 1);
+        size_t row1 = std::min(first + j * v_factor + v_factor - 1, src.height - 1);
+        const uint8_t* r0 = src.chroma_row(row0);
+        const uint8_t* r1 = src.chroma_row(row1);
+        uint8_t* cb = cb_base + j * chroma_padded;
+        uint8_t* cr = cr_base + j * chroma_padded;
+        cb_rows[j] = cb;
+        cr_rows[j] = cr;
+
+        for (size_t x = 0; x < chroma_width; ++x) {
+            // 源色度总是水平减半，4:4:4输出时每个样本重复两次
+            size_t sx = (full_chroma ? x / 2 : x) * src.chroma_step;
+            int u = r0[sx + src.u_offset];
+            int v = r0[sx + src.v_offset];
+            if (r0 != r1) {
+                u = (u + r1[sx + src.u_offset] + 1) >> 1;
+                v = (v + r1[sx + src.v_offset] + 1) >> 1;
+            }
+            cb[x] = chroma_table[u];
+            cr[x] = chroma_table[v];
+        }
+        std::fill(cb + chroma_width, cb + chroma_padded, cb[chroma_width - 1]);
+        std::fill(cr + chroma_width, cr + chroma_padded, cr[chroma_width - 1]);
+    }
+
+    jpeg_write_raw_data(&cinfo, planes, static_cast<JDIMENSION>(luma_rows));
+}
+
+/**
+ * @brief 转换为BGR后编码PNG
+ */
+bool snapshot_encoder::context::encode_png(const buffer& frame, const snapshot_config& config,
+                                           std::string& message)
+{
+    pixel::convert_fn convert = pixel::dispatcher<pixel::bgr24>::select(frame.fourcc());
+    if (!convert) {
+        message = "unsupported pixel format";
+        return false;
+    }
+    size_t width = frame.width();
+    size_t height = frame.height();
+    size_t stride = width * 3;
+    bgr.resize(stride * height);
+    if (!convert(frame, frame.width(), frame.height(), bgr.data(), stride)) {
+        message = "incomplete frame";
+        return false;
+    }
+
+    png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+    png_infop info = png ? png_create_info_struct(png) : nullptr;
+    if (!png || !info) {
+        png_destroy_write_struct(&png, nullptr);
+        message = "cannot create PNG writer";
+        return false;
+    }
+    if (setjmp(png_jmpbuf(png))) {
+        png_destroy_write_struct(&png, &info);
+        message = "PNG encoding failed";
+        return false;
+    }
+
+    output.clear();
+    png_set_write_fn(png, &output, &context::png_write, &context::png_flush);
+    png_set_IHDR(png, info, static_cast<png_uint_32>(width), static_cast<png_uint_32>(height), 8,
+                 PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+    png_set_compression_level(png, std::min(std::max(config.png_compression, 0), 9));
+    if (config.png_compression <= 3) {
+        // 低压缩级别时只用SUB滤波，减少逐行试探的开销
+        png_set_filter(png, PNG_FILTER_TYPE_BASE, PNG_FILTER_SUB);
+    }
+    png_write_info(png, info);
+    png_set_bgr(png);
+    for (size_t y = 0; y < height; ++y) {
+        png_write_row(png, bgr.data() + y * stride);
+    }
+    png_write_end(png, info);
+    png_destroy_write_struct(&png, &info);
+    return true;
+}
+
+/**
+ * @brief 构造函数
+ */
+snapshot_encoder::snapshot_encoder(const snapshot_config& config)
+    : _config(config),
+      _workers(config.threads)
+{
+}
+
+/**
+ * @brief 析构函数
+ */
+snapshot_encoder::~snapshot_encoder() = default;
+
+/**
+ * @brief 在调用线程上编码一帧
+ */
+bool snapshot_encoder::encode(const buffer& frame, snapshot_image& image)
+{
+    return encode_frame(frame, frame.camera_id(), image);
+}
+
+/**
+ * @brief 并行编码帧组中的全部帧
+ */
+std::vector<snapshot_image> snapshot_encoder::encode_group(const frame_group& group)
+{
+    std::vector<snapshot_image> images(group.size());
+    _workers.run(group.size(), [&](size_t index) {
+        if (group.frame(index)) {
+            encode_frame(*group.frame(index), group.camera_id(index), images[index]);
+        }
+    });
+    return images;
+}
+
+/**
+ * @brief 获取各摄像头的编码统计
+ */
+std::vector<snapshot_stats> snapshot_encoder::get_stats() const
+{
+    std::lock_guard<std::mutex> lock(_stats_mutex);
+
+    std::vector<snapshot_stats> stats;
+    for (const auto& entry : _stats) {
+        stats.push_back(entry.second);
+    }
+    return stats;
+}
+
+/**
+ * @brief 编码一帧并记录统计
+ */
+bool snapshot_encoder::encode_frame(const buffer& frame, int camera_id, snapshot_image& image)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    image.camera_id = camera_id;
+    image.sequence = frame.sequence();
+    image.timestamp = frame.timestamp();
+    image.data.clear();
+    image.error.clear();
+    image.ok = false;
+
+    uint32_t fourcc = frame.fourcc();
+    if (frame.width() == 0 || frame.height() == 0) {
+        image.error = "frame has no format";
+    } else if (_config.format == snapshot_format::jpeg &&
+               (fourcc == V4L2_PIX_FMT_MJPEG || fourcc == V4L2_PIX_FMT_JPEG)) {
+        // 已经是JPEG，原样输出
+        const uint8_t* data = static_cast<const uint8_t*>(frame.data());
+        image.data.assign(data, data + frame.size());
+        image.ok = true;
+    } else {
+        std::unique_ptr<context> ctx = acquire_context();
+        if (_config.format == snapshot_format::png) {
+            image.ok = ctx->encode_png(frame, _config, image.error);
+        } else {
+            yuv_source src;
+            if (!make_yuv_source(frame, src)) {
+                image.error = "unsupported pixel format or incomplete frame";
+            } else {
+                image.ok = ctx->encode_jpeg(src, _config, image.error);
+            }
+        }
+        if (image.ok) {
+            // 复制而不是交换，保留上下文中输出缓冲区的容量
+            image.data.assign(ctx->output.begin(), ctx->output.end());
+        }
+        release_context(std::move(ctx));
+    }
+
+    image.encode_us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    record(image, frame.size());
+    return image.ok;
+}
+
+/**
+ * @brief 取用一个空闲的编码器上下文，没有时新建
+ */
+std::unique_ptr<snapshot_encoder::context> snapshot_encoder::acquire_context()
+{
+    {
+        std::lock_guard<std::mutex> lock(_context_mutex);
+        if (!_contexts.empty()) {
+            std::unique_ptr<context> ctx = std::move(_contexts.back());
+            _contexts.pop_back();
+            return ctx;
+        }
+    }
+    return std::unique_ptr<context>(new context());
+}
+
+/**
+ * @brief 归还编码器上下文
+ */
+void snapshot_encoder::release_context(std::unique_ptr<context> ctx)
+{
+    std::lock_guard<std::mutex> lock(_context_mutex);
+    _contexts.push_back(std::move(ctx));
+}
+
+/**
+ * @brief 记录编码统计
+ */
+void snapshot_encoder::record(const snapshot_image& image, size_t input_bytes)
+{
+    int64_t now_us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+
+    std::lock_guard<std::mutex> lock(_stats_mutex);
+    snapshot_stats& stats = _stats[image.camera_id];
+    stats.camera_id = image.camera_id;
+    if (!image.ok) {
+        ++stats.failures;
+        return;
+    }
+    if (stats.frames == 0) {
+        stats.first_time_us = now_us;
+    }
+    ++stats.frames;
+    stats.input_bytes += input_bytes;
+    stats.output_bytes += image.data.size();
+    stats.total_us += image.encode_us;
+    stats.max_us = std::max(stats.max_us, image.encode_us);
+    stats.last_us = image.encode_us;
+    stats.last_time_us = now_us;
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "buffer.hpp"
+#include "frame_group.hpp"
+#include "worker_pool.hpp"
+
+/**
+ * @brief 快照格式
+ */
+enum class snapshot_format {
+    jpeg = 0,       // JPEG
+    png             // PNG
+};
+
+/**
+ * @brief JPEG色度抽样方式
+ */
+enum class chroma_subsampling {
+    yuv420 = 0,     // 4:2:0
+    yuv422,         // 4:2:2
+    yuv444          // 4:4:4
+};
+
+/**
+ * @brief 快照编码配置
+ */
+struct snapshot_config {
+    snapshot_format format = snapshot_format::jpeg;                 // 输出格式
+    int quality = 85;                                               // JPEG质量（1~100）
+    chroma_subsampling subsampling = chroma_subsampling::yuv420;    // JPEG色度抽样
+    bool full_range = true;                                         // 把有限范围的YUV扩展为JFIF要求的全范围
+    int png_compression = 1;                                        // PNG压缩级别（0~9）
+    size_t threads = 4;                                             // 批量编码的并行线程数
+};
+
+/**
+ * @brief 一帧的编码结果
+ */
+struct snapshot_image {
+    int camera_id = -1;              // 摄像头ID
+    uint64_t sequence = 0;           // 序列号
+    int64_t timestamp = 0;           // 时间戳（微秒）
+    bool ok = false;                 // 是否编码成功
+    std::string error;               // 失败原因
+    std::vector<uint8_t> data;       // 编码后的文件内容
+    int64_t encode_us = 0;           // 编码耗时（微秒）
+};
+
+/**
+ * @brief 单个摄像头的编码统计
+ */
+struct snapshot_stats {
+    int camera_id = -1;              // 摄像头ID
+    uint64_t frames = 0;             // 编码成功的帧数
+    uint64_t failures = 0;           // 编码失败的帧数
+    uint64_t input_bytes = 0;        // 输入字节数
+    uint64_t output_bytes = 0;       // 输出字节数
+    int64_t total_us = 0;            // 累计编码耗时（微秒）
+    int64_t max_us = 0;              // 最大编码耗时（微秒）
+    int64_t last_us = 0;             // 最近一次编码耗时（微秒）
+    int64_t first_time_us = 0;       // 第一帧完成时刻（steady_clock，微秒）
+    int64_t last_time_us = 0;        // 最近一帧完成时刻（steady_clock，微秒）
+
+    /**
+     * @brief 平均编码延迟（微秒）
+     */
+    double mean_us() const { return frames ? static_cast<double>(total_us) / frames : 0.0; }
+
+    /**
+     * @brief 按墙上时间计算的编码吞吐量（帧/秒）
+     */
+    double throughput_fps() const
+    {
+        int64_t span = last_time_us - first_time_us;
+        return (frames > 1 && span > 0) ? (frames - 1) * 1e6 / span : 0.0;
+    }
+};
+
+/**
+ * @brief 快照编码服务
+ *
+ * JPEG编码器上下文（jpeg_compress_struct、行缓冲区和输出缓冲区）在编码之间复用，
+ * 每个编码线程从空闲列表中取用一个，不在每次调用时重新创建。YUYV、UYVY、NV12和NV12M
+ * 直接以YCbCr原始数据送入libjpeg，不经过BGR转换；MJPEG帧原样输出。
+ * PNG没有YUV格式，先按像素转换管线转为BGR再压缩。
+ *
+ * encode可在任意线程调用；encode_group在内部线程池上并行编码帧组中的全部帧，
+ * 不占用采集线程
+ */
+class snapshot_encoder {
+public:
+    /**
+     * @brief 构造函数
+     *
+     * @param config 编码配置
+     */
+    explicit snapshot_encoder(const snapshot_config& config = snapshot_config());
+
+    /**
+     * @brief 析构函数
+     */
+    ~snapshot_encoder();
+
+    // 禁止拷贝
+    snapshot_encoder(const snapshot_encoder&) = delete;
+    snapshot_encoder& operator=(const snapshot_encoder&) = delete;
+
+    /**
+     * @brief 在调用线程上编码一帧
+     *
+     * @param frame 帧，需已设置格式元数据
+     * @param image 输出编码结果
+     * @return true 编码成功
+     */
+    bool encode(const buffer& frame, snapshot_image& image);
+
+    /**
+     * @brief 并行编码帧组中的全部帧
+     *
+     * @param group 帧组
+     * @return std::vector<snapshot_image> 按帧组下标排列的编码结果
+     */
+    std::vector<snapshot_image> encode_group(const frame_group& group);
+
+    /**
+     * @brief 获取各摄像头的编码统计
+     */
+    std::vector<snapshot_stats> get_stats() const;
+
+    /**
+     * @brief 获取配置
+     */
+    const snapshot_config& config() const { return _config; }
+
+    /**
+     * @brief 文件扩展名（含点）
+     */
+    const char* extension() const { return _config.format == snapshot_format::png ? ".png" : ".jpg"; }
+
+private:
+    struct context;
+
+    bool encode_frame(const buffer& frame, int camera_id, snapshot_image& image);
+    std::unique_ptr<context> acquire_context();
+    void release_context(std::unique_ptr<context> ctx);
+    void record(const snapshot_image& image, size_t input_bytes);
+
+    snapshot_config _config;                                // 编码配置
+    worker_pool _workers;                                   // 批量编码线程池
+
+    std::mutex _context_mutex;                              // 保护空闲上下文列表
+    std::vector<std::unique_ptr<context>> _contexts;        // 空闲的编码器上下文
+
+    mutable std::mutex _stats_mutex;                        // 保护统计
+    std::map<int, snapshot_stats> _stats;                   // 各摄像头的统计
+};
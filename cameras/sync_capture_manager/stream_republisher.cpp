@@ -0,0 +1,293 @@
+#include "stream_republisher.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+/**
+ * @brief 构造函数
+ */
+stream_republisher::stream_republisher(std::shared_ptr<mosaic_compositor> compositor)
+    : _compositor(std::move(compositor))
+{
+}
+
+/**
+ * @brief 析构函数
+ */
+stream_republisher::~stream_republisher() = default;
+
+/**
+ * @brief 添加转发目标
+ */
+bool stream_republisher::add_target(const republish_target& target)
+{
+    if (target.format != 0 && target.format != V4L2_PIX_FMT_BGR24 && target.format != V4L2_PIX_FMT_GREY) {
+        std::cerr << "Republish target " << target.device << ": only BGR24 and GREY conversions are supported"
+                  << std::endl;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (target.camera_id == mosaic_source && !_compositor) {
+        std::cerr << "Republish target " << target.device << ": mosaic source without a compositor" << std::endl;
+        return false;
+    }
+
+    std::unique_ptr<output_slot> slot(new output_slot());
+    slot->target = target;
+    slot->stats.camera_id = target.camera_id;
+    slot->stats.device = target.device;
+    _slots.push_back(std::move(slot));
+    return true;
+}
+
+/**
+ * @brief 移除转发目标
+ */
+bool stream_republisher::remove_target(const std::string& device)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = std::find_if(_slots.begin(), _slots.end(),
+                           [&device](const std::unique_ptr<output_slot>& slot) { return slot->target.device == device; });
+    if (it == _slots.end()) {
+        return false;
+    }
+    _slots.erase(it);
+    return true;
+}
+
+/**
+ * @brief 更换拼接画面合成器
+ */
+void stream_republisher::set_compositor(std::shared_ptr<mosaic_compositor> compositor)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _compositor = std::move(compositor);
+}
+
+/**
+ * @brief 转发一个帧组
+ */
+size_t stream_republisher::publish(const frame_group& group)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // 拼接画面每个帧组只合成一次，由所有以其为源的目标共用
+    std::shared_ptr<buffer> mosaic;
+    bool mosaic_done = false;
+
+    size_t written = 0;
+    for (auto& slot : _slots) {
+        const buffer* frame = nullptr;
+        if (slot->target.camera_id == mosaic_source) {
+            if (!mosaic_done && _compositor) {
+                mosaic = _compositor->compose(group);
+                mosaic_done = true;
+            }
+            frame = mosaic.get();
+        } else {
+            int index = group.index_of(slot->target.camera_id);
+            if (index >= 0) {
+                frame = group.frame(index).get();
+            }
+        }
+        if (!frame) {
+            ++slot->stats.missing;
+            continue;
+        }
+
+        if (!slot->output && !open_output(*slot, *frame)) {
+            ++slot->stats.failed;
+            continue;
+        }
+        if (write_frame(*slot, *frame)) {
+            ++written;
+        }
+    }
+    return written;
+}
+
+/**
+ * @brief 获取各目标的统计
+ */
+std::vector<republish_stats> stream_republisher::get_stats() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    std::vector<republish_stats> stats;
+    stats.reserve(_slots.size());
+    for (const auto& slot : _slots) {
+        stats.push_back(slot->stats);
+    }
+    return stats;
+}
+
+/**
+ * @brief 按源帧的尺寸和格式打开输出设备
+ */
+bool stream_republisher::open_output(output_slot& slot, const buffer& frame)
+{
+    uint32_t format = slot.target.format ? slot.target.format : frame.fourcc();
+    // 输出设备为单平面，NV12M的两个平面依次写入即为NV12
+    if (format == V4L2_PIX_FMT_NV12M) {
+        format = V4L2_PIX_FMT_NV12;
+    }
+
+    slot.convert = nullptr;
+    if (slot.target.format != 0 && slot.target.format != frame.fourcc()) {
+        slot.convert = (slot.target.format == V4L2_PIX_FMT_BGR24)
+                           ? pixel::dispatcher<pixel::bgr24>::select(frame.fourcc())
+                           : pixel::dispatcher<pixel::gray8>::select(frame.fourcc());
+        if (!slot.convert) {
+            std::cerr << "Republish target " << slot.target.device << ": cannot convert "
+                      << V4l2Device::fourcc(frame.fourcc()) << " to " << V4l2Device::fourcc(slot.target.format)
+                      << std::endl;
+            return false;
+        }
+    }
+
+    V4L2DeviceParameters params(slot.target.device.c_str(), format, frame.width(), frame.height(), 0,
+                                slot.target.io_type);
+    params.m_syscalls = slot.target.syscalls;
+    slot.output.reset(V4l2Output::create(params));
+    if (!slot.output) {
+        std::cerr << "Failed to open republish target " << slot.target.device << std::endl;
+        return false;
+    }
+    if (slot.output->getFormat() != format || slot.output->getWidth() != frame.width() ||
+        slot.output->getHeight() != frame.height()) {
+        std::cerr << "Republish target " << slot.target.device << " did not accept "
+                  << V4l2Device::fourcc(format) << " " << frame.width() << "x" << frame.height() << std::endl;
+        slot.output.reset();
+        return false;
+    }
+
+    if (slot.convert) {
+        size_t min_stride = (format == V4L2_PIX_FMT_BGR24) ? pixel::bgr24::min_stride(frame.width())
+                                                           : pixel::gray8::min_stride(frame.width());
+        slot.out_stride = std::max<size_t>(slot.output->getBytesPerLine(), min_stride);
+    }
+    slot.source_format = frame.fourcc();
+    slot.stats.opened = true;
+    std::cout << "Republishing " << ((slot.target.camera_id == mosaic_source) ? std::string("mosaic")
+                                         : "camera " + std::to_string(slot.target.camera_id))
+              << " to " << slot.target.device << " as " << V4l2Device::fourcc(format) << std::endl;
+    return true;
+}
+
+/**
+ * @brief 写出一帧
+ */
+bool stream_republisher::write_frame(output_slot& slot, const buffer& frame)
+{
+    if (frame.fourcc() != slot.source_format || frame.width() != slot.output->getWidth() ||
+        frame.height() != slot.output->getHeight()) {
+        // 源格式或尺寸在运行中改变，输出设备按新格式重新打开
+        slot.output.reset();
+        slot.stats.opened = false;
+        if (!open_output(slot, frame)) {
+            ++slot.stats.failed;
+            return false;
+        }
+    }
+
+    // 读写方式的设备不支持部分写入，由write一次写入
+    if (slot.target.io_type != IOTYPE_MMAP) {
+        return write_whole(slot, frame);
+    }
+    if (!slot.output->startPartialWrite()) {
+        if (slot.output->getLastError() == EAGAIN) {
+            ++slot.stats.busy;
+        } else {
+            ++slot.stats.failed;
+        }
+        return false;
+    }
+    return write_partial(slot, frame);
+}
+
+/**
+ * @brief 通过部分写入直接填充已出队的设备缓冲区
+ */
+bool stream_republisher::write_partial(output_slot& slot, const buffer& frame)
+{
+    size_t bytes = 0;
+    bool ok = true;
+
+    if (slot.convert) {
+        size_t size = slot.out_stride * frame.height();
+        char* dst = slot.output->reservePartialWrite(size);
+        ok = dst && slot.convert(frame, frame.width(), frame.height(), reinterpret_cast<uint8_t*>(dst),
+                                 slot.out_stride);
+        bytes = size;
+    } else if (frame.plane_count() == 0) {
+        bytes = slot.output->writePartial(const_cast<char*>(static_cast<const char*>(frame.data())), frame.size());
+        ok = (bytes == frame.size());
+    } else {
+        // 行跨度相同时整个平面一次写入，否则逐行写入设备的行跨度
+        size_t out_stride = slot.output->getBytesPerLine();
+        for (size_t p = 0; ok && p < frame.plane_count(); ++p) {
+            const buffer::plane& plane = frame.plane_info(p);
+            char* src = const_cast<char*>(reinterpret_cast<const char*>(frame.plane_data(p)));
+            if (out_stride == 0 || plane.bytesperline == 0 || plane.bytesperline == out_stride) {
+                size_t chunk = slot.output->writePartial(src, plane.size);
+                ok = (chunk == plane.size);
+                bytes += chunk;
+                continue;
+            }
+            size_t rows = plane.size / plane.bytesperline;
+            size_t copy = std::min<size_t>(plane.bytesperline, out_stride);
+            for (size_t row = 0; ok && row < rows; ++row) {
+                char* dst = slot.output->reservePartialWrite(out_stride);
+                if (dst) {
+                    memcpy(dst, src + row * plane.bytesperline, copy);
+                    bytes += out_stride;
+                }
+                ok = (dst != nullptr);
+            }
+        }
+    }
+
+    // 出错时仍需把缓冲区还给设备
+    ok = slot.output->endPartialWrite() && ok;
+    if (!ok) {
+        ++slot.stats.failed;
+        return false;
+    }
+    ++slot.stats.written;
+    slot.stats.bytes += bytes;
+    return true;
+}
+
+/**
+ * @brief 一次写入整帧，用于读写方式的设备
+ */
+bool stream_republisher::write_whole(output_slot& slot, const buffer& frame)
+{
+    char* data = const_cast<char*>(static_cast<const char*>(frame.data()));
+    size_t size = frame.size();
+    if (slot.convert) {
+        slot.scratch.resize(slot.out_stride * frame.height());
+        if (!slot.convert(frame, frame.width(), frame.height(), slot.scratch.data(), slot.out_stride)) {
+            ++slot.stats.failed;
+            return false;
+        }
+        data = reinterpret_cast<char*>(slot.scratch.data());
+        size = slot.scratch.size();
+    }
+
+    size_t ret = slot.output->write(data, size);
+    if (ret == static_cast<size_t>(-1) || ret == 0) {
+        if (slot.output->getLastError() == EAGAIN) {
+            ++slot.stats.busy;
+        } else {
+            ++slot.stats.failed;
+        }
+        return false;
+    }
+    ++slot.stats.written;
+    slot.stats.bytes += ret;
+    return true;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "frame_group.hpp"
+#include "mosaic_compositor.hpp"
+#include "pixel_pipeline.hpp"
+#include "libv4l2cpp/inc/V4l2Output.h"
+
+/**
+ * @brief 转发目标
+ */
+struct republish_target {
+    std::string device;                  // 输出设备路径，如v4l2loopback的/dev/videoN
+    int camera_id = 0;                   // 源摄像头ID，mosaic_source表示拼接画面
+    uint32_t format = 0;                 // 输出像素格式，为0时与源帧相同，可选BGR24或GREY做转换
+    V4l2IoType io_type = IOTYPE_MMAP;    // 输出设备的IO方式
+    V4l2Syscalls* syscalls = nullptr;    // 系统调用接口，为空时使用系统调用，测试时可注入V4l2Emulator
+};
+
+/**
+ * @brief 转发目标的统计
+ */
+struct republish_stats {
+    int camera_id = 0;           // 源摄像头ID
+    std::string device;          // 输出设备路径
+    bool opened = false;         // 输出设备是否已打开
+    uint64_t written = 0;        // 写出的帧数
+    uint64_t busy = 0;           // 输出设备没有空闲缓冲区而跳过的帧数
+    uint64_t missing = 0;        // 帧组中缺少源帧的次数
+    uint64_t failed = 0;         // 打开、转换或写入失败的次数
+    uint64_t bytes = 0;          // 写出的字节数
+};
+
+/**
+ * @brief 把同步帧组中的各路画面转发到V4L2输出设备
+ *
+ * 每个目标对应一个输出设备（通常为v4l2loopback），写入某个摄像头的帧或拼接画面，
+ * 使只能打开普通摄像头的旧工具也能读取同步后的画面。输出设备在第一次收到源帧时按
+ * 源帧的尺寸打开。
+ *
+ * 单平面MMAP输出使用部分写入：原样转发时各平面直接从帧缓冲池的buffer写入已出队的
+ * 设备缓冲区，需要转换格式时转换结果直接写入设备缓冲区，都不经过中间缓冲区。
+ * 输出设备以非阻塞方式打开，消费方跟不上时跳过该帧而不阻塞组帧。
+ *
+ * 线程安全，publish在调用线程中同步完成
+ */
+class stream_republisher {
+public:
+    static constexpr int mosaic_source = -1;    // 拼接画面作为源时的摄像头ID
+
+    /**
+     * @brief 构造函数
+     *
+     * @param compositor 拼接画面合成器，有以mosaic_source为源的目标时需要
+     */
+    explicit stream_republisher(std::shared_ptr<mosaic_compositor> compositor = nullptr);
+
+    /**
+     * @brief 析构函数，关闭输出设备
+     */
+    ~stream_republisher();
+
+    // 禁止拷贝
+    stream_republisher(const stream_republisher&) = delete;
+    stream_republisher& operator=(const stream_republisher&) = delete;
+
+    /**
+     * @brief 添加转发目标
+     *
+     * @param target 转发目标
+     * @return true 添加成功
+     * @return false 输出格式不支持，或以拼接画面为源但没有合成器
+     */
+    bool add_target(const republish_target& target);
+
+    /**
+     * @brief 移除转发目标并关闭其输出设备
+     *
+     * @param device 输出设备路径
+     * @return true 找到并移除了目标
+     */
+    bool remove_target(const std::string& device);
+
+    /**
+     * @brief 更换拼接画面合成器，之后的帧组使用新的合成器
+     */
+    void set_compositor(std::shared_ptr<mosaic_compositor> compositor);
+
+    /**
+     * @brief 转发一个帧组
+     *
+     * @param group 已封装的帧组
+     * @return size_t 写出的帧数
+     */
+    size_t publish(const frame_group& group);
+
+    /**
+     * @brief 获取各目标的统计
+     */
+    std::vector<republish_stats> get_stats() const;
+
+private:
+    /**
+     * @brief 一个转发目标的运行状态
+     */
+    struct output_slot {
+        republish_target target;                 // 目标配置
+        std::unique_ptr<V4l2Output> output;      // 输出设备，第一次收到源帧时打开
+        uint32_t source_format = 0;              // 打开时的源帧格式
+        pixel::convert_fn convert = nullptr;     // 格式转换函数，原样转发时为空
+        size_t out_stride = 0;                   // 转换输出的行跨度
+        std::vector<uint8_t> scratch;            // 设备不支持部分写入时的转换结果
+        republish_stats stats;                   // 统计
+    };
+
+    bool open_output(output_slot& slot, const buffer& frame);
+    bool write_frame(output_slot& slot, const buffer& frame);
+    bool write_partial(output_slot& slot, const buffer& frame);
+    bool write_whole(output_slot& slot, const buffer& frame);
+
+    std::shared_ptr<mosaic_compositor> _compositor;  // 拼接画面合成器
+    std::vector<std::unique_ptr<output_slot>> _slots; // 转发目标
+    mutable std::mutex _mutex;                       // 保护_slots
+};
@@ -0,0 +1,1492 @@
+#include "sync_capture_manager.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "capture_config.hpp"
+#include "v4l2_camera_device.hpp"
+
+namespace {
+
+/**
+ * @brief 把时间差折算为相位差，范围为[-interval/2, interval/2)
+ */
+int64_t wrap_phase(int64_t offset, int64_t interval)
+{
+    int64_t phase = offset % interval;
+    if (phase >= interval / 2) {
+        phase -= interval;
+    } else if (phase < -interval / 2) {
+        phase += interval;
+    }
+    return phase;
+}
+
+/**
+ * @brief 当前时间，与帧时间戳同一时钟（微秒）
+ */
+int64_t now_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+bool same_policy(const thread_policy& a, const thread_policy& b)
+{
+    return a.cpus == b.cpus && a.spread == b.spread && a.realtime == b.realtime && a.priority == b.priority &&
+           a.numa_node == b.numa_node;
+}
+
+bool same_hybrid(const hybrid_sync_config& a, const hybrid_sync_config& b)
+{
+    return a.barrier_groups == b.barrier_groups && a.barrier_window_us == b.barrier_window_us &&
+           a.target_percentile == b.target_percentile && a.headroom == b.headroom &&
+           a.min_tolerance_us == b.min_tolerance_us && a.max_tolerance_us == b.max_tolerance_us &&
+           a.window_groups == b.window_groups && a.max_mismatch_ratio == b.max_mismatch_ratio;
+}
+
+bool same_trigger(const trigger_config& a, const trigger_config& b)
+{
+    return a.fps == b.fps && a.spin_us == b.spin_us && a.control_id == b.control_id &&
+           a.hardware_cameras == b.hardware_cameras;
+}
+
+bool same_phase(const phase_alignment_config& a, const phase_alignment_config& b)
+{
+    return a.reference_camera_id == b.reference_camera_id && a.tolerance_us == b.tolerance_us &&
+           a.samples == b.samples && a.max_attempts == b.max_attempts && a.check_interval_ms == b.check_interval_ms;
+}
+
+bool same_mosaic(const mosaic_config& a, const mosaic_config& b)
+{
+    return a.width == b.width && a.height == b.height && a.columns == b.columns && a.tiles == b.tiles &&
+           a.threads == b.threads && a.pool_size == b.pool_size && a.overlay == b.overlay &&
+           a.glyph_scale == b.glyph_scale;
+}
+
+bool same_target(const republish_target& a, const republish_target& b)
+{
+    return a.device == b.device && a.camera_id == b.camera_id && a.format == b.format && a.io_type == b.io_type;
+}
+
+bool uses_mosaic(const capture_config& config)
+{
+    return std::any_of(config.consumers.begin(), config.consumers.end(), [](const consumer_config& consumer) {
+        return consumer.target.camera_id == stream_republisher::mosaic_source;
+    });
+}
+
+} // namespace
+
+/**
+ * @brief 构造函数
+ */
+sync_capture_manager::sync_capture_manager(int64_t tolerance_us,
+                                           std::shared_ptr<memory_budget> budget)
+    : _tolerance_us(tolerance_us),
+      _budget(std::move(budget)),
+      _reserved_bytes(0),
+      _shed_handler_id(-1),
+      _pause_handler_id(-1),
+      _group_pool(new frame_group_pool(group_pool_size)),
+      _phase_reference(0),
+      _config_syscalls(nullptr),
+      _watch_stop(false),
+      _initialized(false),
+      _running(false),
+      _next_group_id(0),
+      _dropped_frames(0),
+      _dropped_groups(0),
+      _startup_time_us(0),
+      _group_event_fd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+{
+    _ready_groups.reserve(max_ready_groups);
+
+    if (_budget) {
+        reserve_group_pool(group_pool_size);
+        _shed_handler_id = _budget->add_shed_handler(
+            shed_action::drop_oldest_incomplete_groups,
+            [this](shed_action, bool) {
+                drop_oldest_pending();
+                if (_history) {
+                    _history->trim(_history->stats().bytes / 2);
+                }
+            });
+        // 暂停录制时历史不再保留新的帧组，并释放已保留的帧组
+        _pause_handler_id = _budget->add_shed_handler(
+            shed_action::pause_recorders,
+            [this](shed_action, bool engaged) {
+                if (_history) {
+                    _history->set_paused(engaged);
+                    if (engaged) {
+                        _history->trim(0);
+                    }
+                }
+            });
+    }
+}
+
+/**
+ * @brief 析构函数
+ */
+sync_capture_manager::~sync_capture_manager()
+{
+    stop_config_watch();
+    stop_capture();
+    if (_group_event_fd >= 0) {
+        close(_group_event_fd);
+    }
+
+    if (_budget) {
+        _budget->remove_shed_handler(_shed_handler_id);
+        _budget->remove_shed_handler(_pause_handler_id);
+        if (_reserved_bytes > 0) {
+            _budget->release(_reserved_bytes, memory_consumer::sync_queue);
+        }
+    }
+}
+
+/**
+ * @brief 添加摄像头
+ */
+bool sync_capture_manager::add_camera(std::unique_ptr<icamera_device> camera)
+{
+    if (!camera || _initialized || _cameras.size() >= frame_group::max_cameras) {
+        return false;
+    }
+
+    std::unique_ptr<camera_slot> slot(new camera_slot());
+    slot->camera = std::move(camera);
+    slot->pending.reserve(max_pending_frames);
+    _cameras.push_back(std::move(slot));
+    return true;
+}
+
+/**
+ * @brief 并行初始化所有摄像头
+ */
+bool sync_capture_manager::initialize()
+{
+    if (_initialized) {
+        return true;
+    }
+
+    _startup_report.assign(_cameras.size(), camera_startup_report());
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    threads.reserve(_cameras.size());
+    for (size_t i = 0; i < _cameras.size(); ++i) {
+        threads.emplace_back([this, i]() {
+            camera_slot& slot = *_cameras[i];
+            camera_startup_report& report = _startup_report[i];
+
+            auto* v4l2_camera = dynamic_cast<v4l2_camera_device*>(slot.camera.get());
+            if (v4l2_camera && _budget) {
+                v4l2_camera->set_memory_budget(_budget, v4l2_camera->get_pool_size());
+            }
+
+            auto camera_start = std::chrono::steady_clock::now();
+            report.camera_id = slot.camera->get_camera_id();
+            report.success = slot.camera->initialize();
+            report.total_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - camera_start).count();
+            if (v4l2_camera) {
+                report.phases = v4l2_camera->get_startup_timing();
+            }
+            slot.active = report.success;
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    _startup_time_us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+
+    bool all_success = true;
+    for (const auto& report : _startup_report) {
+        all_success = all_success && report.success;
+        std::cout << "Camera " << report.camera_id
+                  << (report.success ? " initialized in " : " failed after ")
+                  << report.total_us << " us"
+                  << " [open " << report.phases.m_open
+                  << ", querycap " << report.phases.m_querycap
+                  << ", format " << report.phases.m_format
+                  << (report.phases.m_formatCacheHit ? " (cached)" : "")
+                  << ", param " << report.phases.m_param
+                  << ", reqbufs " << report.phases.m_reqbufs
+                  << ", mmap " << report.phases.m_mmap
+                  << ", qbuf " << report.phases.m_qbuf
+                  << ", streamon " << report.phases.m_streamon << "]" << std::endl;
+    }
+    std::cout << _cameras.size() << " cameras initialized in " << _startup_time_us << " us" << std::endl;
+
+    _initialized = true;
+    return all_success;
+}
+
+/**
+ * @brief 按配置创建摄像头和转发目标
+ */
+bool sync_capture_manager::load_config(const capture_config& config, V4l2Syscalls* syscalls)
+{
+    std::lock_guard<std::mutex> config_lock(_config_mutex);
+
+    if (_initialized || _running) {
+        std::cerr << "Cannot load config after initialize" << std::endl;
+        return false;
+    }
+    if (_cameras.size() + config.cameras.size() > frame_group::max_cameras) {
+        std::cerr << "Config has more cameras than a frame group can hold" << std::endl;
+        return false;
+    }
+
+    for (const auto& camera_config : config.cameras) {
+        std::unique_ptr<v4l2_camera_device> camera(new v4l2_camera_device(
+            camera_config.device, camera_config.width, camera_config.height, camera_config.format,
+            camera_config.id));
+        camera->set_io_mode(camera_config.io_type, camera_config.driver_buffers);
+        camera->set_fps(camera_config.fps);
+        camera->set_memory_budget(_budget, camera_config.pool_size);
+        camera->enable_preview_pyramid(camera_config.preview_pyramid);
+        if (syscalls) {
+            camera->set_syscalls(syscalls);
+        }
+        add_camera(std::move(camera));
+    }
+
+    _tolerance_us = config.sync.tolerance_us;
+    switch (config.sync.strategy) {
+    case sync_strategy::hybrid:
+        enable_hybrid_sync(config.sync.hybrid);
+        break;
+    case sync_strategy::trigger:
+        enable_trigger(config.sync.trigger);
+        break;
+    case sync_strategy::timestamp:
+        break;
+    }
+    if (config.sync.phase_alignment) {
+        enable_phase_alignment(config.sync.phase);
+    }
+
+    // 策略集合在这里一次创建，热加载只调用set，采集线程读取的指针不再改变
+    if (!_policies) {
+        set_thread_policies(std::make_shared<thread_policy_set>());
+    }
+    for (const auto& entry : config.threads) {
+        _policies->set(entry.first, entry.second);
+    }
+
+    // 转发器始终创建，之后热加载增加的目标不必替换正在取帧组时使用的指针
+    _republisher = std::make_shared<stream_republisher>(
+        uses_mosaic(config) ? std::make_shared<mosaic_compositor>(config.mosaic, _budget) : nullptr);
+    _config_syscalls = syscalls;
+    for (const auto& consumer : config.consumers) {
+        republish_target target = consumer.target;
+        target.syscalls = syscalls;
+        if (!_republisher->add_target(target)) {
+            std::cerr << "Consumer " << consumer.name << " not added" << std::endl;
+        }
+    }
+
+    _config.reset(new capture_config(config));
+    return true;
+}
+
+/**
+ * @brief 热加载配置
+ */
+config_reload_report sync_capture_manager::apply_config(const capture_config& config)
+{
+    std::lock_guard<std::mutex> config_lock(_config_mutex);
+
+    config_reload_report report;
+    if (!_config) {
+        report.failed.push_back("no configuration loaded");
+        return report;
+    }
+    // 生效的配置只记录已应用的改动，需要重启的改动在下次比较时仍会列出
+    capture_config& current = *_config;
+
+    for (const auto& wanted : config.cameras) {
+        std::string name = "camera " + std::to_string(wanted.id);
+        auto it = std::find_if(current.cameras.begin(), current.cameras.end(),
+                               [&wanted](const camera_config& camera) { return camera.id == wanted.id; });
+        if (it == current.cameras.end()) {
+            report.requires_restart.push_back(name + ": added");
+            continue;
+        }
+        camera_config& old = *it;
+        if (wanted.device != old.device || wanted.io_type != old.io_type ||
+            wanted.driver_buffers != old.driver_buffers || wanted.pool_size != old.pool_size ||
+            wanted.preview_pyramid != old.preview_pyramid) {
+            report.requires_restart.push_back(name + ": device, io, buffers or preview pyramid");
+        }
+
+        v4l2_camera_device* camera = nullptr;
+        for (auto& slot : _cameras) {
+            if (slot->camera->get_camera_id() == wanted.id) {
+                camera = dynamic_cast<v4l2_camera_device*>(slot->camera.get());
+            }
+        }
+        if (!camera) {
+            continue;
+        }
+
+        if (wanted.format != old.format || wanted.width != old.width || wanted.height != old.height) {
+            if (camera->set_format(wanted.format, wanted.width, wanted.height)) {
+                old.format = wanted.format;
+                old.width = wanted.width;
+                old.height = wanted.height;
+                report.applied.push_back(name + ": format " + V4l2Device::fourcc(wanted.format) + " " +
+                                         std::to_string(wanted.width) + "x" + std::to_string(wanted.height));
+            } else {
+                report.failed.push_back(name + ": format change rejected");
+            }
+        }
+        if (wanted.fps != old.fps) {
+            if (camera->set_fps(wanted.fps)) {
+                old.fps = wanted.fps;
+                int actual = camera->get_fps();
+                if (actual != wanted.fps) {
+                    report.adjusted.push_back(name + ": fps " + std::to_string(wanted.fps) + " adjusted to " +
+                                              std::to_string(actual) + " by the driver");
+                } else {
+                    report.applied.push_back(name + ": fps " + std::to_string(wanted.fps));
+                }
+            } else {
+                report.failed.push_back(name + ": fps change rejected");
+            }
+        }
+    }
+    for (const auto& old : current.cameras) {
+        if (std::none_of(config.cameras.begin(), config.cameras.end(),
+                         [&old](const camera_config& camera) { return camera.id == old.id; })) {
+            report.requires_restart.push_back("camera " + std::to_string(old.id) + ": removed");
+        }
+    }
+
+    if (config.sync.strategy != current.sync.strategy || !same_hybrid(config.sync.hybrid, current.sync.hybrid) ||
+        !same_trigger(config.sync.trigger, current.sync.trigger) ||
+        config.sync.phase_alignment != current.sync.phase_alignment ||
+        !same_phase(config.sync.phase, current.sync.phase)) {
+        report.requires_restart.push_back("sync strategy");
+    }
+    if (config.sync.tolerance_us != current.sync.tolerance_us) {
+        if (current.sync.strategy == sync_strategy::timestamp) {
+            // 固定容差在每次配对时读取，直接替换即可
+            std::lock_guard<std::mutex> lock(_mutex);
+            _tolerance_us = config.sync.tolerance_us;
+            current.sync.tolerance_us = config.sync.tolerance_us;
+            report.applied.push_back("sync tolerance " + std::to_string(config.sync.tolerance_us) + " us");
+        } else {
+            report.requires_restart.push_back("sync tolerance");
+        }
+    }
+
+    // 只记录已应用的角色，失败的角色保留原策略，下次重新加载时再次尝试
+    std::vector<std::pair<thread_role, thread_policy>> applied_threads;
+    for (int i = 0; i < static_cast<int>(thread_role::count); ++i) {
+        thread_role role = static_cast<thread_role>(i);
+        auto find_entry = [role](const capture_config& c) -> const std::pair<thread_role, thread_policy>* {
+            for (const auto& entry : c.threads) {
+                if (entry.first == role) {
+                    return &entry;
+                }
+            }
+            return nullptr;
+        };
+        const auto* wanted_entry = find_entry(config);
+        const auto* current_entry = find_entry(current);
+        thread_policy wanted = wanted_entry ? wanted_entry->second : thread_policy();
+        thread_policy previous = current_entry ? current_entry->second : thread_policy();
+        const auto* recorded = wanted_entry;
+        if (!same_policy(wanted, previous)) {
+            if (_policies) {
+                _policies->set(role, wanted);
+                report.applied.push_back(std::string("threads.") + thread_policy_set::role_name(role) +
+                                         " (threads started later)");
+            } else {
+                report.failed.push_back(std::string("threads.") + thread_policy_set::role_name(role));
+                recorded = current_entry;
+            }
+        }
+        if (recorded) {
+            applied_threads.push_back(*recorded);
+        }
+    }
+    current.threads = applied_threads;
+
+    if (!same_mosaic(config.mosaic, current.mosaic) || (uses_mosaic(config) && !uses_mosaic(current))) {
+        _republisher->set_compositor(
+            uses_mosaic(config) ? std::make_shared<mosaic_compositor>(config.mosaic, _budget) : nullptr);
+        current.mosaic = config.mosaic;
+        report.applied.push_back("mosaic");
+    }
+
+    // 先移除消失或改变的目标，释放其输出设备后再添加
+    std::vector<consumer_config> consumers;
+    for (const auto& old : current.consumers) {
+        auto it = std::find_if(config.consumers.begin(), config.consumers.end(),
+                               [&old](const consumer_config& consumer) { return consumer.name == old.name; });
+        if (it != config.consumers.end() && same_target(it->target, old.target)) {
+            consumers.push_back(old);
+            continue;
+        }
+        _republisher->remove_target(old.target.device);
+        report.applied.push_back("consumer " + old.name + (it == config.consumers.end() ? ": removed" : ": changed"));
+    }
+    for (const auto& wanted : config.consumers) {
+        if (std::any_of(consumers.begin(), consumers.end(),
+                        [&wanted](const consumer_config& consumer) { return consumer.name == wanted.name; })) {
+            continue;
+        }
+        republish_target target = wanted.target;
+        target.syscalls = _config_syscalls;
+        if (!_republisher->add_target(target)) {
+            report.failed.push_back("consumer " + wanted.name);
+            continue;
+        }
+        consumers.push_back(wanted);
+        if (std::none_of(current.consumers.begin(), current.consumers.end(),
+                         [&wanted](const consumer_config& consumer) { return consumer.name == wanted.name; })) {
+            report.applied.push_back("consumer " + wanted.name + ": added");
+        }
+    }
+    current.consumers = consumers;
+
+    for (const auto& entry : report.applied) {
+        std::cout << "Config applied: " << entry << std::endl;
+    }
+    for (const auto& entry : report.adjusted) {
+        std::cout << "Config adjusted: " << entry << std::endl;
+    }
+    for (const auto& entry : report.requires_restart) {
+        std::cout << "Config change needs restart: " << entry << std::endl;
+    }
+    for (const auto& entry : report.failed) {
+        std::cerr << "Config change failed: " << entry << std::endl;
+    }
+    return report;
+}
+
+/**
+ * @brief 监视配置文件
+ */
+bool sync_capture_manager::watch_config(const std::string& path, int interval_ms)
+{
+    {
+        std::lock_guard<std::mutex> config_lock(_config_mutex);
+        if (!_config) {
+            std::cerr << "Cannot watch config before load_config" << std::endl;
+            return false;
+        }
+    }
+    if (_watch_thread.joinable()) {
+        return false;
+    }
+
+    _watch_stop = false;
+    _watch_thread = std::thread(&sync_capture_manager::config_watch_thread, this, path, std::max(interval_ms, 10));
+    return true;
+}
+
+/**
+ * @brief 停止监视配置文件
+ */
+void sync_capture_manager::stop_config_watch()
+{
+    if (!_watch_thread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(_watch_mutex);
+        _watch_stop = true;
+    }
+    _watch_cv.notify_all();
+    _watch_thread.join();
+}
+
+/**
+ * @brief 启动采集线程
+ */
+bool sync_capture_manager::start_capture()
+{
+    if (!_initialized) {
+        std::cerr << "Cannot start capture: manager not initialized" << std::endl;
+        return false;
+    }
+    if (_running.exchange(true)) {
+        return true;
+    }
+
+    if (_policies) {
+        std::vector<std::string> errors;
+        if (!_policies->validate(errors)) {
+            for (const auto& error : errors) {
+                std::cerr << "Thread policy: " << error << std::endl;
+            }
+        }
+    }
+
+    if (_trigger) {
+        // 触发模式需在启动视频流之前设置，模拟触发时STREAMON不再预先入队缓冲区
+        const trigger_config& config = _trigger->config();
+        for (auto& slot : _cameras) {
+            auto* v4l2_camera = dynamic_cast<v4l2_camera_device*>(slot->camera.get());
+            if (!slot->active || !v4l2_camera) {
+                continue;
+            }
+            int id = v4l2_camera->get_camera_id();
+            bool hardware = std::find(config.hardware_cameras.begin(), config.hardware_cameras.end(), id) !=
+                            config.hardware_cameras.end();
+            if (v4l2_camera->set_trigger_mode(hardware ? camera_trigger::hardware : camera_trigger::emulated,
+                                              config.control_id)) {
+                _trigger->add_camera(v4l2_camera);
+            } else {
+                std::cerr << "Camera " << id << " does not accept trigger mode, running free" << std::endl;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < _cameras.size(); ++i) {
+        camera_slot& slot = *_cameras[i];
+        if (!slot.active) {
+            continue;
+        }
+        if (!slot.camera->start_capture()) {
+            std::cerr << "Failed to start camera " << slot.camera->get_camera_id() << std::endl;
+            slot.active = false;
+            continue;
+        }
+
+        // 设备支持推送时在设备的采集线程中直接处理帧，不再为每个摄像头单独开取帧线程
+        frame_sink_options options;
+        options.max_batch = max_pending_frames;
+        slot.pushed = slot.camera->set_frame_sink(
+            [this, i](std::vector<std::shared_ptr<buffer>>& frames) { deliver_frames(i, frames); },
+            options);
+        if (!slot.pushed) {
+            slot.thread = std::thread(&sync_capture_manager::capture_thread, this, i);
+        }
+    }
+
+    if (_trigger && !_trigger->start(_policies)) {
+        std::cerr << "Failed to start trigger scheduler" << std::endl;
+    }
+
+    if (_phase_config) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _phase_reference = _cameras.size();
+        for (size_t i = 0; i < _cameras.size(); ++i) {
+            camera_slot& slot = *_cameras[i];
+            slot.phase_samples.reserve(_phase_config->samples);
+            if (slot.active && _phase_reference == _cameras.size() &&
+                (_phase_config->reference_camera_id < 0 ||
+                 slot.camera->get_camera_id() == _phase_config->reference_camera_id)) {
+                _phase_reference = i;
+            }
+        }
+        if (_phase_reference < _cameras.size()) {
+            _phase_thread = std::thread(&sync_capture_manager::phase_thread, this);
+        } else {
+            std::cerr << "Phase alignment disabled: reference camera not active" << std::endl;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 停止采集
+ */
+bool sync_capture_manager::stop_capture()
+{
+    if (!_running.exchange(false)) {
+        return true;
+    }
+
+    if (_trigger) {
+        _trigger->stop();
+    }
+
+    if (_phase_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+        }
+        _phase_cv.notify_all();
+        _phase_thread.join();
+    }
+
+    for (auto& slot : _cameras) {
+        if (slot->pushed) {
+            slot->camera->clear_frame_sink();
+            slot->pushed = false;
+        }
+        if (slot->thread.joinable()) {
+            slot->thread.join();
+        }
+        slot->policy_applied = false;
+        if (slot->active) {
+            slot->camera->stop_capture();
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto& slot : _cameras) {
+        slot->pending.clear();
+    }
+    _cv.notify_all();
+    return true;
+}
+
+/**
+ * @brief 设置线程策略
+ */
+void sync_capture_manager::set_thread_policies(std::shared_ptr<thread_policy_set> policies)
+{
+    if (_running) {
+        std::cerr << "Cannot change thread policies while capturing" << std::endl;
+        return;
+    }
+    _policies = std::move(policies);
+}
+
+/**
+ * @brief 获取采集线程的策略状态
+ */
+std::vector<thread_policy_status> sync_capture_manager::get_thread_policy_report() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    std::vector<thread_policy_status> report;
+    for (const auto& slot : _cameras) {
+        if (slot->active) {
+            report.push_back(slot->policy_status);
+        }
+    }
+    return report;
+}
+
+/**
+ * @brief 启用重复帧和画面冻结检测
+ */
+void sync_capture_manager::enable_freeze_detection(const freeze_config& config)
+{
+    if (_running) {
+        std::cerr << "Cannot enable freeze detection while capturing" << std::endl;
+        return;
+    }
+
+    for (auto& slot : _cameras) {
+        slot->freeze.reset(new freeze_detector(config));
+    }
+}
+
+/**
+ * @brief 获取重复帧检测报告
+ */
+std::vector<camera_freeze_report> sync_capture_manager::get_freeze_report() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    std::vector<camera_freeze_report> report;
+    for (const auto& slot : _cameras) {
+        if (!slot->freeze) {
+            continue;
+        }
+        camera_freeze_report entry;
+        entry.camera_id = slot->camera->get_camera_id();
+        entry.stalled = slot->stalled;
+        entry.stats = slot->freeze_totals;
+        report.push_back(entry);
+    }
+    return report;
+}
+
+/**
+ * @brief 获取画面冻结的摄像头
+ */
+std::vector<int> sync_capture_manager::get_stalled_cameras() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    std::vector<int> ids;
+    for (const auto& slot : _cameras) {
+        if (slot->active && slot->stalled) {
+            ids.push_back(slot->camera->get_camera_id());
+        }
+    }
+    return ids;
+}
+
+/**
+ * @brief 启用帧组历史
+ */
+void sync_capture_manager::enable_history(const history_config& config)
+{
+    if (_running) {
+        std::cerr << "Cannot enable frame group history while capturing" << std::endl;
+        return;
+    }
+
+    // 历史保留的帧组不回到池中，池需同时容纳历史和输出队列
+    size_t capacity = group_pool_size + config.max_groups;
+    _group_pool.reset(new frame_group_pool(capacity));
+    if (_budget) {
+        reserve_group_pool(capacity);
+    }
+    _history = std::make_shared<group_history>(config);
+    if (_budget && _budget->is_engaged(shed_action::pause_recorders)) {
+        _history->set_paused(true);
+    }
+}
+
+/**
+ * @brief 启用混合组帧
+ */
+void sync_capture_manager::enable_hybrid_sync(const hybrid_sync_config& config)
+{
+    if (_running) {
+        std::cerr << "Cannot enable hybrid sync while capturing" << std::endl;
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _hybrid.reset(new hybrid_sync(config, _tolerance_us));
+}
+
+/**
+ * @brief 获取组帧统计
+ */
+sync_metrics sync_capture_manager::get_sync_metrics() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (_hybrid) {
+        return _hybrid->metrics();
+    }
+    sync_metrics metrics;
+    metrics.tolerance_us = _tolerance_us;
+    return metrics;
+}
+
+/**
+ * @brief 启用采集相位对齐
+ */
+void sync_capture_manager::enable_phase_alignment(const phase_alignment_config& config)
+{
+    if (_running) {
+        std::cerr << "Cannot enable phase alignment while capturing" << std::endl;
+        return;
+    }
+
+    _phase_config.reset(new phase_alignment_config(config));
+    _phase_config->samples = std::max<size_t>(_phase_config->samples, 1);
+}
+
+/**
+ * @brief 获取相位对齐报告
+ */
+std::vector<camera_phase_report> sync_capture_manager::get_phase_report() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    std::vector<camera_phase_report> report;
+    if (!_phase_config) {
+        return report;
+    }
+    for (size_t i = 0; i < _cameras.size(); ++i) {
+        const camera_slot& slot = *_cameras[i];
+        if (!slot.active) {
+            continue;
+        }
+        camera_phase_report entry;
+        entry.camera_id = slot.camera->get_camera_id();
+        entry.reference = (i == _phase_reference);
+        entry.aligned = entry.reference || slot.phase_aligned;
+        entry.phase_error_us = entry.reference ? 0 : slot.phase_error_us;
+        entry.stream_latency_us = slot.stream_latency_us;
+        entry.adjustments = slot.phase_adjustments;
+        report.push_back(entry);
+    }
+    return report;
+}
+
+/**
+ * @brief 启用软件触发
+ */
+void sync_capture_manager::enable_trigger(const trigger_config& config)
+{
+    if (_running) {
+        std::cerr << "Cannot enable trigger while capturing" << std::endl;
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _trigger.reset(new trigger_scheduler(config));
+}
+
+/**
+ * @brief 获取软件触发统计
+ */
+trigger_stats sync_capture_manager::get_trigger_stats() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _trigger ? _trigger->get_stats() : trigger_stats();
+}
+
+/**
+ * @brief 获取同步帧组
+ */
+std::shared_ptr<frame_group> sync_capture_manager::get_sync_frame_group(int timeout_ms)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _cv.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+                 [this]() { return !_ready_groups.empty() || !_running; });
+
+    if (_ready_groups.empty()) {
+        return nullptr;
+    }
+
+    auto group = std::move(_ready_groups.front());
+    _ready_groups.erase(_ready_groups.begin());
+    if (_ready_groups.empty()) {
+        // 输出队列取空后清除可读状态
+        uint64_t value;
+        ssize_t ret = read(_group_event_fd, &value, sizeof(value));
+        (void)ret;
+    }
+    lock.unlock();
+
+    // 转发在取帧组的线程中完成，不占用组帧的锁
+    if (_republisher) {
+        _republisher->publish(*group);
+    }
+    return group;
+}
+
+/**
+ * @brief 获取丢弃的帧数
+ */
+uint64_t sync_capture_manager::get_dropped_frames() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _dropped_frames;
+}
+
+/**
+ * @brief 获取丢弃的帧组数
+ */
+uint64_t sync_capture_manager::get_dropped_groups() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _dropped_groups;
+}
+
+/**
+ * @brief 获取处于降级状态的摄像头
+ */
+std::vector<int> sync_capture_manager::get_degraded_cameras() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    std::vector<int> ids;
+    for (const auto& slot : _cameras) {
+        if (slot->active && slot->degraded) {
+            ids.push_back(slot->camera->get_camera_id());
+        }
+    }
+    return ids;
+}
+
+/**
+ * @brief 摄像头采集线程，用于只支持拉取的设备
+ *
+ * @param index 摄像头下标
+ */
+void sync_capture_manager::capture_thread(size_t index)
+{
+    camera_slot& slot = *_cameras[index];
+
+    std::vector<std::shared_ptr<buffer>> frames;
+    frames.reserve(1);
+    while (_running) {
+        frames.clear();
+        auto frame = slot.camera->get_frame();
+        if (frame) {
+            frames.push_back(std::move(frame));
+        }
+        if (!deliver_frames(index, frames)) {
+            // 降级的摄像头在后台恢复，降低轮询频率
+            std::this_thread::sleep_for(std::chrono::milliseconds(slot.degraded ? 100 : 5));
+        }
+    }
+}
+
+/**
+ * @brief 处理一批新帧
+ *
+ * 在采集线程或设备的回调线程中执行，同一摄像头不会并发调用。空批次只更新降级状态
+ *
+ * @param index 摄像头下标
+ * @param frames 按时间顺序的新帧
+ * @return true 至少有一帧进入配对
+ */
+bool sync_capture_manager::deliver_frames(size_t index, std::vector<std::shared_ptr<buffer>>& frames)
+{
+    camera_slot& slot = *_cameras[index];
+
+    // 先绑定CPU和内存节点，之后帧缓冲池按需分配的buffer落在本线程所在的节点
+    if (_policies && !slot.policy_applied) {
+        slot.policy_applied = true;
+        thread_policy_status status = _policies->apply(thread_role::capture, static_cast<int>(index));
+        if (!status.ok) {
+            std::cerr << "Camera " << slot.camera->get_camera_id()
+                      << " capture thread policy not applied: " << status.error << std::endl;
+        }
+        std::lock_guard<std::mutex> lock(_mutex);
+        slot.policy_status = status;
+    }
+
+    bool degraded = (slot.camera->get_health() == camera_health::degraded);
+    if (degraded != slot.degraded) {
+        set_degraded(index, degraded);
+    }
+
+    size_t kept = 0;
+    for (auto& frame : frames) {
+        if (!frame || (slot.freeze && !check_freeze(index, *frame))) {
+            continue;
+        }
+        if (frame->sequence() == 0) {
+            frame->set_sequence(slot.sequence);
+        }
+        ++slot.sequence;
+        frames[kept++] = std::move(frame);
+    }
+    frames.resize(kept);
+    if (kept == 0) {
+        return false;
+    }
+
+    on_frames(index, frames);
+    return true;
+}
+
+/**
+ * @brief 处理新到达的帧，一批帧只加一次锁
+ */
+void sync_capture_manager::on_frames(size_t index, std::vector<std::shared_ptr<buffer>>& frames)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    camera_slot& slot = *_cameras[index];
+    auto& pending = slot.pending;
+    update_frame_interval(slot, frames);
+    if (_phase_config && _phase_reference < _cameras.size() && index != _phase_reference) {
+        sample_phase(index, frames);
+    }
+    for (auto& frame : frames) {
+        if (pending.size() >= max_pending_frames) {
+            pending.erase(pending.begin());
+            ++_dropped_frames;
+        }
+        pending.push_back(std::move(frame));
+
+        match_frames();
+    }
+}
+
+/**
+ * @brief 更新摄像头的帧间隔，作为屏障窗口和相位测量的依据。调用者需持有_mutex
+ */
+void sync_capture_manager::update_frame_interval(camera_slot& slot,
+                                                 const std::vector<std::shared_ptr<buffer>>& frames)
+{
+    for (const auto& frame : frames) {
+        int64_t interval = frame->timestamp() - slot.last_timestamp;
+        if (slot.last_timestamp > 0 && interval > 0) {
+            // 丢帧或重启造成的间隔按两倍帧间隔计入，避免平滑值被一次空档拉偏
+            slot.frame_interval_us = (slot.frame_interval_us > 0)
+                ? slot.frame_interval_us +
+                  (std::min(interval, 2 * slot.frame_interval_us) - slot.frame_interval_us) / 8
+                : interval;
+        }
+        slot.last_timestamp = frame->timestamp();
+    }
+
+    if (!_hybrid) {
+        return;
+    }
+    int64_t max_interval = 0;
+    for (const auto& other : _cameras) {
+        if (other->active && !other->degraded && !other->stalled) {
+            max_interval = std::max(max_interval, other->frame_interval_us);
+        }
+    }
+    _hybrid->set_frame_interval(max_interval);
+}
+
+/**
+ * @brief 记录摄像头相对参考摄像头最近一帧的相位误差。调用者需持有_mutex
+ */
+void sync_capture_manager::sample_phase(size_t index, const std::vector<std::shared_ptr<buffer>>& frames)
+{
+    camera_slot& slot = *_cameras[index];
+    const camera_slot& reference = *_cameras[_phase_reference];
+    if (slot.restart_scheduled || reference.last_timestamp == 0 || reference.frame_interval_us <= 0) {
+        return;
+    }
+
+    for (const auto& frame : frames) {
+        int64_t error = wrap_phase(frame->timestamp() - reference.last_timestamp, reference.frame_interval_us);
+        if (slot.phase_samples.size() < _phase_config->samples) {
+            slot.phase_samples.push_back(error);
+        } else {
+            slot.phase_samples[slot.phase_next] = error;
+        }
+        slot.phase_next = (slot.phase_next + 1) % _phase_config->samples;
+    }
+}
+
+/**
+ * @brief 相位对齐线程，定期检查各摄像头的相位误差
+ */
+void sync_capture_manager::phase_thread()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (_running) {
+        _phase_cv.wait_for(lock, std::chrono::milliseconds(_phase_config->check_interval_ms),
+                           [this]() { return !_running; });
+        int64_t now = now_us();
+        for (size_t i = 0; _running && i < _cameras.size(); ++i) {
+            if (i != _phase_reference) {
+                adjust_phase(i, now);
+            }
+        }
+    }
+}
+
+/**
+ * @brief 检查一个摄像头的相位误差，超出容差时安排重启视频流
+ *
+ * STREAMON到出帧的延迟对帧间隔取模后基本不变：由上一次重启时STREAMON相对参考相位的
+ * 偏移和重启后测得的误差估算该延迟，再把下一次STREAMON安排在参考相位减去延迟的时刻。
+ * 调用者需持有_mutex
+ *
+ * @param index 摄像头下标
+ * @param now 当前时间，与帧时间戳同一时钟（微秒）
+ */
+void sync_capture_manager::adjust_phase(size_t index, int64_t now)
+{
+    camera_slot& slot = *_cameras[index];
+    const camera_slot& reference = *_cameras[_phase_reference];
+    auto* camera = dynamic_cast<v4l2_camera_device*>(slot.camera.get());
+    int64_t interval = reference.frame_interval_us;
+    if (!camera || !slot.active || slot.degraded || slot.stalled ||
+        interval <= 0 || reference.last_timestamp == 0) {
+        return;
+    }
+
+    if (slot.restart_scheduled) {
+        int64_t stream_on = camera->get_last_stream_on_us();
+        if (stream_on == slot.stream_on_us) {
+            return;
+        }
+        // 重启前的帧与新相位无关，重新采集样本
+        slot.stream_on_us = stream_on;
+        slot.restart_offset_us = wrap_phase(stream_on - reference.last_timestamp, interval);
+        slot.restart_offset_valid = true;
+        slot.restart_scheduled = false;
+        slot.phase_samples.clear();
+        slot.phase_next = 0;
+        return;
+    }
+
+    if (slot.phase_samples.size() < _phase_config->samples) {
+        return;
+    }
+    std::vector<int64_t> samples(slot.phase_samples);
+    auto middle = samples.begin() + samples.size() / 2;
+    std::nth_element(samples.begin(), middle, samples.end());
+    slot.phase_error_us = *middle;
+    if (slot.restart_offset_valid) {
+        slot.stream_latency_us = wrap_phase(slot.phase_error_us - slot.restart_offset_us, interval);
+        slot.restart_offset_valid = false;
+    }
+
+    if (std::llabs(slot.phase_error_us) <= _phase_config->tolerance_us) {
+        if (!slot.phase_aligned) {
+            slot.phase_aligned = true;
+            std::cout << "Camera " << slot.camera->get_camera_id() << " phase aligned to camera "
+                      << reference.camera->get_camera_id() << " within " << slot.phase_error_us
+                      << " us after " << slot.phase_attempts << " stream restarts" << std::endl;
+        }
+        slot.phase_attempts = 0;
+        return;
+    }
+    slot.phase_aligned = false;
+    if (slot.phase_attempts >= _phase_config->max_attempts) {
+        return;
+    }
+
+    int64_t target = reference.last_timestamp + wrap_phase(-slot.stream_latency_us, interval);
+    int64_t earliest = now + restart_margin_us;
+    if (target < earliest) {
+        target += ((earliest - target) / interval + 1) * interval;
+    }
+    camera->schedule_restart(target);
+    slot.restart_scheduled = true;
+    ++slot.phase_attempts;
+    ++slot.phase_adjustments;
+}
+
+/**
+ * @brief 按时间戳窗口配对各摄像头的帧
+ *
+ * 所有活动摄像头都有待配对帧时，若各队首帧的时间戳跨度在容差内则组成帧组，
+ * 否则丢弃最早的队首帧后继续尝试。启用混合组帧时容差由_hybrid给出，屏障模式下
+ * 先把各队首对齐到最新的一轮。启用软件触发且队首都带触发编号时按编号配对，不看时间戳。
+ * 调用者需持有_mutex
+ */
+void sync_capture_manager::match_frames()
+{
+    while (true) {
+        bool barrier = !_trigger && _hybrid && (_hybrid->mode() == sync_mode::barrier);
+        if (barrier) {
+            align_pending_heads();
+        }
+
+        int64_t min_ts = std::numeric_limits<int64_t>::max();
+        int64_t max_ts = std::numeric_limits<int64_t>::min();
+        camera_slot* oldest = nullptr;
+        size_t active_count = 0;
+        uint64_t min_trigger = std::numeric_limits<uint64_t>::max();
+        uint64_t max_trigger = 0;
+
+        for (auto& slot : _cameras) {
+            if (!slot->active || slot->degraded || slot->stalled) {
+                continue;
+            }
+            if (slot->pending.empty()) {
+                return;
+            }
+            int64_t ts = slot->pending.front()->timestamp();
+            if (ts < min_ts) {
+                min_ts = ts;
+                oldest = slot.get();
+            }
+            max_ts = std::max(max_ts, ts);
+            uint64_t trigger_id = slot->pending.front()->trigger_id();
+            min_trigger = std::min(min_trigger, trigger_id);
+            max_trigger = std::max(max_trigger, trigger_id);
+            ++active_count;
+        }
+
+        if (active_count == 0) {
+            return;
+        }
+
+        if (_trigger && min_trigger != 0) {
+            // 所有队首都来自触发时按编号精确配对：编号较小的帧对应的触发在其他摄像头上已丢失
+            if (min_trigger != max_trigger) {
+                for (auto& slot : _cameras) {
+                    if (!slot->active || slot->degraded || slot->stalled) {
+                        continue;
+                    }
+                    if (slot->pending.front()->trigger_id() < max_trigger) {
+                        slot->pending.erase(slot->pending.begin());
+                        ++_dropped_frames;
+                    }
+                }
+                continue;
+            }
+        } else {
+            int64_t tolerance = _hybrid ? _hybrid->tolerance_us() : _tolerance_us;
+            if (max_ts - min_ts > tolerance) {
+                // 最早的帧已无法与其他摄像头配对
+                oldest->pending.erase(oldest->pending.begin());
+                ++_dropped_frames;
+                if (_hybrid && _hybrid->on_mismatch()) {
+                    log_sync_mode();
+                }
+                continue;
+            }
+            if (_hybrid && _hybrid->on_group(max_ts - min_ts)) {
+                log_sync_mode();
+            }
+        }
+
+        auto group = _group_pool->acquire();
+        for (auto& slot : _cameras) {
+            if (!slot->active || slot->degraded || slot->stalled) {
+                continue;
+            }
+            if (group) {
+                group->add_frame(slot->camera->get_camera_id(), std::move(slot->pending.front()));
+            }
+            slot->pending.erase(slot->pending.begin());
+        }
+
+        if (!group) {
+            ++_dropped_groups;
+            continue;
+        }
+        group->seal(_next_group_id++);
+        if (_history) {
+            _history->push(group);
+        }
+
+        if (_ready_groups.size() >= max_ready_groups) {
+            _ready_groups.erase(_ready_groups.begin());
+            ++_dropped_groups;
+        }
+        if (_ready_groups.empty()) {
+            uint64_t one = 1;
+            ssize_t ret = write(_group_event_fd, &one, sizeof(one));
+            (void)ret;
+        }
+        _ready_groups.push_back(std::move(group));
+        _cv.notify_one();
+    }
+}
+
+/**
+ * @brief 屏障模式下把各摄像头的队首对齐到最新的一轮
+ *
+ * 等齐所有摄像头后以最晚的队首时间戳为基准，每个摄像头丢弃比后一帧离基准更远的
+ * 队首帧，使配对从同一轮帧重新开始。调用者需持有_mutex
+ */
+void sync_capture_manager::align_pending_heads()
+{
+    int64_t reference = std::numeric_limits<int64_t>::min();
+    for (auto& slot : _cameras) {
+        if (!slot->active || slot->degraded || slot->stalled) {
+            continue;
+        }
+        if (slot->pending.empty()) {
+            return;
+        }
+        reference = std::max(reference, slot->pending.front()->timestamp());
+    }
+
+    for (auto& slot : _cameras) {
+        if (!slot->active || slot->degraded || slot->stalled) {
+            continue;
+        }
+        auto& pending = slot->pending;
+        while (pending.size() > 1 &&
+               std::llabs(pending[1]->timestamp() - reference) <=
+               std::llabs(pending[0]->timestamp() - reference)) {
+            pending.erase(pending.begin());
+            ++_dropped_frames;
+        }
+    }
+}
+
+/**
+ * @brief 输出组帧模式的切换，调用者需持有_mutex
+ */
+void sync_capture_manager::log_sync_mode()
+{
+    sync_metrics metrics = _hybrid->metrics();
+    if (metrics.mode == sync_mode::barrier) {
+        std::cout << "Sync spread degraded (" << metrics.window_mismatch_ratio
+                  << " mismatches per group), re-entering barrier mode" << std::endl;
+    } else {
+        std::cout << "Sync aligned, switching to timestamp mode with tolerance "
+                  << metrics.tolerance_us << " us (spread percentile " << metrics.spread_percentile_us << " us)"
+                  << std::endl;
+    }
+}
+
+/**
+ * @brief 切换摄像头的降级状态
+ *
+ * 降级的摄像头不再参与组帧，其余摄像头继续输出帧组；恢复后重新参与组帧
+ */
+void sync_capture_manager::set_degraded(size_t index, bool degraded)
+{
+    camera_slot& slot = *_cameras[index];
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        slot.degraded = degraded;
+        _dropped_frames += slot.pending.size();
+        slot.pending.clear();
+        slot.last_timestamp = 0;
+        slot.restart_scheduled = false;
+        slot.restart_offset_valid = false;
+        slot.phase_aligned = false;
+        slot.phase_samples.clear();
+        slot.phase_next = 0;
+        if (degraded) {
+            // 其他摄像头可能正在等待该摄像头的帧
+            match_frames();
+        } else if (_hybrid) {
+            // 重新打开的设备相位未知
+            _hybrid->enter_barrier(sync_decision::membership_changed);
+        }
+    }
+
+    if (degraded) {
+        std::cerr << "Camera " << slot.camera->get_camera_id()
+                  << " degraded, continuing with remaining cameras" << std::endl;
+        return;
+    }
+
+    // 重新打开的设备与之前的帧没有可比性
+    if (slot.freeze) {
+        slot.freeze->reset();
+    }
+
+    std::cout << "Camera " << slot.camera->get_camera_id() << " rejoined";
+    if (auto* v4l2_camera = dynamic_cast<v4l2_camera_device*>(slot.camera.get())) {
+        camera_recovery_stats stats = v4l2_camera->get_recovery_stats();
+        std::cout << " after " << stats.last_recovery_us << " us, "
+                  << stats.missed_frames << " frames missed in total";
+    }
+    std::cout << std::endl;
+}
+
+/**
+ * @brief 检测新到达的帧是否重复
+ *
+ * @return true 该帧参与组帧
+ * @return false 该帧是重复帧，应丢弃
+ */
+bool sync_capture_manager::check_freeze(size_t index, const buffer& frame)
+{
+    camera_slot& slot = *_cameras[index];
+
+    frame_verdict verdict = slot.freeze->check(frame);
+    bool stalled = slot.freeze->frozen();
+    if (stalled != slot.stalled) {
+        set_stalled(index, stalled);
+    }
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        slot.freeze_totals = slot.freeze->stats();
+    }
+
+    switch (verdict) {
+    case frame_verdict::unique:    return true;
+    case frame_verdict::duplicate: return !slot.freeze->config().drop_duplicates;
+    default:                       return false;
+    }
+}
+
+/**
+ * @brief 切换摄像头的画面冻结状态
+ *
+ * 画面冻结的摄像头仍在出帧但内容不变，与降级一样暂不参与组帧，避免其他摄像头
+ * 的新画面与旧画面配成帧组
+ */
+void sync_capture_manager::set_stalled(size_t index, bool stalled)
+{
+    camera_slot& slot = *_cameras[index];
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        slot.stalled = stalled;
+        _dropped_frames += slot.pending.size();
+        slot.pending.clear();
+        if (stalled) {
+            match_frames();
+        } else if (_hybrid) {
+            _hybrid->enter_barrier(sync_decision::membership_changed);
+        }
+    }
+
+    if (stalled) {
+        std::cerr << "Camera " << slot.camera->get_camera_id() << " stalled after "
+                  << slot.freeze->repeat_count() << " repeated frames, continuing with remaining cameras"
+                  << std::endl;
+    } else {
+        std::cout << "Camera " << slot.camera->get_camera_id() << " delivering new frames again" << std::endl;
+    }
+}
+
+/**
+ * @brief 丢弃每个摄像头最早的待配对帧
+ *
+ * 作为内存预算的削减动作，使这些帧占用的缓冲区可以被复用
+ */
+void sync_capture_manager::drop_oldest_pending()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    for (auto& slot : _cameras) {
+        if (!slot->pending.empty()) {
+            slot->pending.erase(slot->pending.begin());
+            ++_dropped_frames;
+        }
+    }
+}
+
+/**
+ * @brief 按帧组池容量向预算申请同步队列的固定开销
+ */
+void sync_capture_manager::reserve_group_pool(size_t capacity)
+{
+    if (_reserved_bytes > 0) {
+        _budget->release(_reserved_bytes, memory_consumer::sync_queue);
+    }
+    _reserved_bytes = capacity * sizeof(frame_group);
+    if (!_budget->try_reserve(_reserved_bytes, memory_consumer::sync_queue)) {
+        _reserved_bytes = 0;
+    }
+}
+
+/**
+ * @brief 配置文件监视线程
+ *
+ * 修改时间或大小变化时重新解析，编辑器分多次写入时解析失败的中间状态会被跳过
+ */
+void sync_capture_manager::config_watch_thread(std::string path, int interval_ms)
+{
+    auto file_version = [&path](struct timespec& mtime, off_t& size) {
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0) {
+            return false;
+        }
+        mtime = st.st_mtim;
+        size = st.st_size;
+        return true;
+    };
+
+    struct timespec mtime = {0, 0};
+    off_t size = 0;
+    file_version(mtime, size);
+
+    std::unique_lock<std::mutex> lock(_watch_mutex);
+    while (!_watch_cv.wait_for(lock, std::chrono::milliseconds(interval_ms), [this]() { return _watch_stop; })) {
+        struct timespec current_mtime;
+        off_t current_size;
+        if (!file_version(current_mtime, current_size) ||
+            (current_mtime.tv_sec == mtime.tv_sec && current_mtime.tv_nsec == mtime.tv_nsec && current_size == size)) {
+            continue;
+        }
+        mtime = current_mtime;
+        size = current_size;
+
+        lock.unlock();
+        capture_config config;
+        std::string error;
+        if (load_capture_config(path, config, error)) {
+            std::cout << "Reloading config " << path << std::endl;
+            apply_config(config);
+        } else {
+            std::cerr << "Config not reloaded: " << error << std::endl;
+        }
+        lock.lock();
+    }
+}
@@ -0,0 +1,422 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "camera_device.hpp"
+#include "frame_group.hpp"
+#include "frame_hash.hpp"
+#include "group_history.hpp"
+#include "hybrid_sync.hpp"
+#include "memory_budget.hpp"
+#include "stream_republisher.hpp"
+#include "thread_policy.hpp"
+#include "trigger_scheduler.hpp"
+#include "libv4l2cpp/inc/V4l2Device.h"
+
+/**
+ * @brief 单个摄像头的启动报告
+ */
+struct camera_startup_report {
+    int camera_id = -1;              // 摄像头ID
+    bool success = false;            // 是否初始化成功
+    int64_t total_us = 0;            // initialize总耗时（微秒）
+    V4l2StartupTiming phases;        // 各阶段耗时，仅V4L2摄像头有效
+};
+
+/**
+ * @brief 单个摄像头的重复帧检测报告
+ */
+struct camera_freeze_report {
+    int camera_id = -1;              // 摄像头ID
+    bool stalled = false;            // 是否处于画面冻结状态
+    freeze_stats stats;              // 检测统计
+};
+
+/**
+ * @brief 采集相位对齐配置
+ */
+struct phase_alignment_config {
+    int reference_camera_id = -1;        // 参考摄像头ID，为-1时取第一个活动摄像头
+    int64_t tolerance_us = 1000;         // 相位误差不超过该值时视为已对齐（微秒）
+    size_t samples = 15;                 // 取中位数的相位样本数，重启后重新采集
+    uint32_t max_attempts = 6;           // 连续未对齐时最多重启视频流的次数
+    int check_interval_ms = 200;         // 检查相位的间隔（毫秒）
+};
+
+/**
+ * @brief 单个摄像头的相位对齐报告
+ */
+struct camera_phase_report {
+    int camera_id = -1;                  // 摄像头ID
+    bool reference = false;              // 是否是参考摄像头
+    bool aligned = false;                // 相位误差是否在容差内
+    int64_t phase_error_us = 0;          // 相对参考摄像头的相位误差中位数（微秒），范围为正负半个帧间隔
+    int64_t stream_latency_us = 0;       // 估算的STREAMON到出帧的延迟对帧间隔取模（微秒）
+    uint32_t adjustments = 0;            // 为对齐相位重启视频流的总次数
+};
+
+/**
+ * @brief 热加载配置的结果
+ */
+struct config_reload_report {
+    std::vector<std::string> applied;            // 已在运行中生效的改动
+    std::vector<std::string> requires_restart;   // 需要重新创建管理器才能生效、本次未应用的改动
+    std::vector<std::string> adjusted;           // 已生效但设备调整了取值的改动，如驱动支持的帧率
+    std::vector<std::string> failed;             // 应用时出错的改动
+};
+
+struct capture_config;
+
+/**
+ * @brief 多摄像头同步采集管理器
+ *
+ * 负责并行初始化所有摄像头、为每个摄像头运行采集线程，并按时间戳窗口
+ * 把各摄像头的帧配对为帧组
+ */
+class sync_capture_manager {
+public:
+    /**
+     * @brief 构造函数
+     *
+     * @param tolerance_us 组帧的时间戳容差（微秒）
+     * @param budget 共享的内存预算，为空时不限制
+     */
+    explicit sync_capture_manager(int64_t tolerance_us = 1000,
+                                  std::shared_ptr<memory_budget> budget = nullptr);
+
+    /**
+     * @brief 析构函数，停止采集并释放预算
+     */
+    ~sync_capture_manager();
+
+    // 禁止拷贝
+    sync_capture_manager(const sync_capture_manager&) = delete;
+    sync_capture_manager& operator=(const sync_capture_manager&) = delete;
+
+    /**
+     * @brief 添加摄像头，需在initialize之前调用
+     *
+     * @param camera 尚未初始化的摄像头
+     * @return true 添加成功
+     * @return false 已初始化或超出帧组容量
+     */
+    bool add_camera(std::unique_ptr<icamera_device> camera);
+
+    /**
+     * @brief 并行初始化所有摄像头
+     *
+     * 每个摄像头在独立线程中完成初始化，总耗时约等于最慢的单个摄像头。
+     * 初始化失败的摄像头不参与后续采集
+     *
+     * @return true 全部摄像头初始化成功
+     * @return false 至少一个摄像头初始化失败
+     */
+    bool initialize();
+
+    /**
+     * @brief 设置线程策略，需在start_capture之前调用，load_config之后不要再替换
+     *
+     * 采集线程按capture角色绑定CPU和调度策略，第i个摄像头使用下标i
+     *
+     * @param policies 线程策略，为空时不做设置
+     */
+    void set_thread_policies(std::shared_ptr<thread_policy_set> policies);
+
+    /**
+     * @brief 获取采集线程应用策略后的实际状态
+     */
+    std::vector<thread_policy_status> get_thread_policy_report() const;
+
+    /**
+     * @brief 启用重复帧和画面冻结检测，需在start_capture之前调用
+     *
+     * 采集线程对每帧计算采样哈希并与上一帧比较。画面冻结的摄像头视为停滞，
+     * 与降级的摄像头一样暂不参与组帧，收到新画面后重新参与
+     *
+     * @param config 检测配置
+     */
+    void enable_freeze_detection(const freeze_config& config = freeze_config());
+
+    /**
+     * @brief 获取各摄像头的重复帧检测报告，未启用检测时为空
+     */
+    std::vector<camera_freeze_report> get_freeze_report() const;
+
+    /**
+     * @brief 获取当前画面冻结、暂不参与组帧的摄像头ID
+     */
+    std::vector<int> get_stalled_cameras() const;
+
+    /**
+     * @brief 启用帧组历史，需在start_capture之前调用
+     *
+     * 每个完成的帧组在进入输出队列的同时加入历史，外部触发时可从历史中取出事件前
+     * 若干秒的帧组交给录制模块。帧组池按历史的帧组数上限扩容；被保留的帧仍占用各摄像头
+     * 的帧缓冲池，摄像头的池容量需能覆盖历史时长内的帧数。内存预算越过高水位时
+     * 历史淘汰一半的帧数据
+     *
+     * @param config 历史配置
+     */
+    void enable_history(const history_config& config = history_config());
+
+    /**
+     * @brief 获取帧组历史，未启用时返回nullptr
+     */
+    std::shared_ptr<group_history> get_history() const { return _history; }
+
+    /**
+     * @brief 启用屏障与时间戳混合组帧，需在start_capture之前调用
+     *
+     * 先以屏障模式对齐各摄像头的配对相位，再切换到按跨度分布自适应容差的时间戳匹配，
+     * 跨度劣化或摄像头重新参与组帧时回到屏障模式。构造时的容差作为初始容差
+     *
+     * @param config 混合组帧配置
+     */
+    void enable_hybrid_sync(const hybrid_sync_config& config = hybrid_sync_config());
+
+    /**
+     * @brief 获取组帧模式、当前容差和决策统计
+     *
+     * 未启用混合组帧时只有固定容差和时间戳模式
+     */
+    sync_metrics get_sync_metrics() const;
+
+    /**
+     * @brief 启用采集相位对齐，需在start_capture之前调用
+     *
+     * 帧率相同但自由运行的摄像头彼此相位随机，帧组内的时间偏差可达半个帧间隔以上。
+     * 管理器持续测量各摄像头相对参考摄像头的相位，误差超出容差时在算好的时刻
+     * 重启该摄像头的视频流（STREAMOFF/STREAMON），使其之后的帧落在参考摄像头的相位上；
+     * 首次重启用于估算STREAMON到出帧的延迟，通常第二次即可对齐。只对V4L2摄像头生效
+     *
+     * @param config 相位对齐配置
+     */
+    void enable_phase_alignment(const phase_alignment_config& config = phase_alignment_config());
+
+    /**
+     * @brief 获取各摄像头的相位对齐报告，未启用时为空
+     */
+    std::vector<camera_phase_report> get_phase_report() const;
+
+    /**
+     * @brief 启用软件触发，需在start_capture之前调用
+     *
+     * 管理器在启动采集时把V4L2摄像头切换到触发模式并由一个调度线程按固定周期发出编号触发：
+     * hardware_cameras中的摄像头通过按钮控制项触发曝光，其余摄像头以定时QBUF模拟触发。
+     * 帧组按触发编号精确配对，不再依赖时间戳容差和混合组帧
+     *
+     * @param config 触发配置
+     */
+    void enable_trigger(const trigger_config& config = trigger_config());
+
+    /**
+     * @brief 获取软件触发统计，未启用时全为0
+     */
+    trigger_stats get_trigger_stats() const;
+
+    /**
+     * @brief 按配置创建摄像头并设置组帧、线程策略和转发目标，需在initialize之前调用
+     *
+     * 配置中的每个摄像头创建为v4l2_camera_device并按add_camera加入；组帧策略对应
+     * enable_hybrid_sync、enable_trigger和enable_phase_alignment；consumers中的目标
+     * 由管理器在get_sync_frame_group取出帧组时转发
+     *
+     * @param config 配置，见capture_config
+     * @param syscalls 摄像头和输出设备使用的系统调用接口，为空时使用系统调用，测试时可注入V4l2Emulator
+     * @return true 配置已应用
+     * @return false 已初始化，或摄像头数量超出帧组容量
+     */
+    bool load_config(const capture_config& config, V4l2Syscalls* syscalls = nullptr);
+
+    /**
+     * @brief 把新配置与当前配置比较，在运行中应用可以热更新的改动
+     *
+     * 只影响改动涉及的部分：摄像头的帧率和格式逐个修改，只重启该摄像头的视频流；
+     * timestamp策略下的容差直接生效；consumers按名称增删转发目标；拼接参数更换合成器；
+     * 线程策略对之后启动的线程生效。增删摄像头、更换设备、IO方式、缓冲区数量以及
+     * 组帧策略需要重新创建管理器，只在报告中列出
+     *
+     * @param config 新配置
+     * @return config_reload_report 各项改动的处理结果
+     */
+    config_reload_report apply_config(const capture_config& config);
+
+    /**
+     * @brief 监视配置文件，修改后自动解析并调用apply_config
+     *
+     * 后台线程按间隔检查文件的修改时间，解析失败时保留当前配置并输出错误
+     *
+     * @param path 配置文件路径，通常与load_config使用的文件相同
+     * @param interval_ms 检查间隔（毫秒）
+     * @return true 已开始监视
+     * @return false 尚未load_config或已在监视
+     */
+    bool watch_config(const std::string& path, int interval_ms = 1000);
+
+    /**
+     * @brief 停止监视配置文件
+     */
+    void stop_config_watch();
+
+    /**
+     * @brief 获取转发器，未load_config时返回nullptr
+     */
+    std::shared_ptr<stream_republisher> get_republisher() const { return _republisher; }
+
+    /**
+     * @brief 启动所有已初始化摄像头的采集线程
+     */
+    bool start_capture();
+
+    /**
+     * @brief 停止采集线程和摄像头
+     */
+    bool stop_capture();
+
+    /**
+     * @brief 获取同步帧组
+     *
+     * @param timeout_ms 等待超时（毫秒）
+     * @return std::shared_ptr<frame_group> 帧组，超时返回nullptr
+     */
+    std::shared_ptr<frame_group> get_sync_frame_group(int timeout_ms);
+
+    /**
+     * @brief 获取帧组事件的文件描述符
+     *
+     * 输出队列非空时可读，取空后恢复为不可读，用于select/poll/epoll或协程等待帧组；
+     * 可读后用get_sync_frame_group(0)取帧组，不要直接读取该描述符
+     *
+     * @return 文件描述符（eventfd），由管理器持有
+     */
+    int get_group_fd() const { return _group_event_fd; }
+
+    /**
+     * @brief 获取各摄像头的启动报告
+     */
+    const std::vector<camera_startup_report>& get_startup_report() const { return _startup_report; }
+
+    /**
+     * @brief 获取并行初始化的总耗时（微秒）
+     */
+    int64_t get_startup_time_us() const { return _startup_time_us; }
+
+    /**
+     * @brief 获取摄像头数量
+     */
+    size_t get_camera_count() const { return _cameras.size(); }
+
+    /**
+     * @brief 获取因无法配对或削减而丢弃的帧数
+     */
+    uint64_t get_dropped_frames() const;
+
+    /**
+     * @brief 获取因帧组池耗尽或输出队列已满而丢弃的帧组数
+     */
+    uint64_t get_dropped_groups() const;
+
+    /**
+     * @brief 获取当前处于降级状态、暂不参与组帧的摄像头ID
+     */
+    std::vector<int> get_degraded_cameras() const;
+
+private:
+    /**
+     * @brief 单个摄像头的采集状态
+     */
+    struct camera_slot {
+        std::unique_ptr<icamera_device> camera;            // 摄像头
+        std::vector<std::shared_ptr<buffer>> pending;      // 等待配对的帧，按时间顺序
+        uint64_t sequence = 0;                             // 本地序列号
+        int64_t last_timestamp = 0;                        // 最近一帧的时间戳，受_mutex保护
+        int64_t frame_interval_us = 0;                     // 平滑后的帧间隔，受_mutex保护
+        std::vector<int64_t> phase_samples;                // 相对参考摄像头的相位误差样本，受_mutex保护
+        size_t phase_next = 0;                             // 下一个相位样本的位置
+        int64_t phase_error_us = 0;                        // 最近测得的相位误差中位数
+        int64_t restart_offset_us = 0;                     // 最近一次重启时STREAMON相对参考相位的偏移
+        int64_t stream_on_us = 0;                          // 最近一次计划重启的STREAMON时间
+        int64_t stream_latency_us = 0;                     // 估算的STREAMON到出帧的延迟对帧间隔取模
+        bool restart_scheduled = false;                    // 是否已安排重启、尚未完成
+        bool restart_offset_valid = false;                 // 重启后的相位尚未用于估算延迟
+        bool phase_aligned = false;                        // 相位误差是否在容差内
+        uint32_t phase_attempts = 0;                       // 本轮对齐已重启的次数
+        uint32_t phase_adjustments = 0;                    // 为对齐相位重启的总次数
+        bool active = false;                               // 是否参与采集
+        bool degraded = false;                             // 是否降级，降级期间不参与组帧
+        bool stalled = false;                              // 是否画面冻结，冻结期间不参与组帧
+        std::unique_ptr<freeze_detector> freeze;           // 重复帧检测，仅在采集线程中使用
+        freeze_stats freeze_totals;                        // 重复帧检测统计的副本，受_mutex保护
+        std::thread thread;                                // 采集线程，帧由设备推送时不使用
+        bool pushed = false;                               // 帧是否由设备回调推送
+        bool policy_applied = false;                       // 是否已在采集线程或回调线程中应用线程策略
+        thread_policy_status policy_status;                // 采集线程策略的实际状态
+    };
+
+    void capture_thread(size_t index);
+    bool deliver_frames(size_t index, std::vector<std::shared_ptr<buffer>>& frames);
+    void on_frames(size_t index, std::vector<std::shared_ptr<buffer>>& frames);
+    void update_frame_interval(camera_slot& slot, const std::vector<std::shared_ptr<buffer>>& frames);
+    void sample_phase(size_t index, const std::vector<std::shared_ptr<buffer>>& frames);
+    void phase_thread();
+    void adjust_phase(size_t index, int64_t now);
+    void match_frames();
+    void align_pending_heads();
+    void log_sync_mode();
+    void set_degraded(size_t index, bool degraded);
+    bool check_freeze(size_t index, const buffer& frame);
+    void set_stalled(size_t index, bool stalled);
+    void drop_oldest_pending();
+    void reserve_group_pool(size_t capacity);
+    void config_watch_thread(std::string path, int interval_ms);
+
+    static constexpr size_t max_pending_frames = 4;       // 每个摄像头最多等待配对的帧数
+    static constexpr size_t max_ready_groups = 8;         // 输出队列长度
+    static constexpr size_t group_pool_size = 16;         // 帧组池容量
+    static constexpr int64_t restart_margin_us = 2000;    // 计划重启时间至少晚于当前的时长
+
+    std::vector<std::unique_ptr<camera_slot>> _cameras;   // 摄像头
+    int64_t _tolerance_us;                                // 组帧容差
+    std::shared_ptr<memory_budget> _budget;               // 内存预算
+    size_t _reserved_bytes;                               // 向预算申请的字节数
+    int _shed_handler_id;                                 // 削减动作回调ID
+    int _pause_handler_id;                                // 暂停录制回调ID
+    std::unique_ptr<frame_group_pool> _group_pool;        // 帧组池
+    std::shared_ptr<group_history> _history;              // 帧组历史
+    std::unique_ptr<hybrid_sync> _hybrid;                 // 混合组帧控制，受_mutex保护
+    std::unique_ptr<phase_alignment_config> _phase_config; // 相位对齐配置，为空时不对齐
+    size_t _phase_reference;                              // 参考摄像头下标
+    std::thread _phase_thread;                            // 相位对齐线程
+    std::condition_variable _phase_cv;                    // 通知相位对齐线程退出
+    std::unique_ptr<trigger_scheduler> _trigger;          // 软件触发调度器，为空时摄像头自由运行
+    std::shared_ptr<thread_policy_set> _policies;         // 线程策略
+    std::unique_ptr<capture_config> _config;              // 当前生效的配置，未load_config时为空
+    V4l2Syscalls* _config_syscalls;                       // 按配置创建设备时注入的系统调用接口
+    std::shared_ptr<stream_republisher> _republisher;     // 帧组转发器，load_config后创建
+    std::mutex _config_mutex;                             // 保护_config，串行化配置的加载和应用
+    std::thread _watch_thread;                            // 配置文件监视线程
+    std::mutex _watch_mutex;                              // 配合_watch_cv
+    std::condition_variable _watch_cv;                    // 通知监视线程退出
+    bool _watch_stop;                                     // 监视线程是否应退出，受_watch_mutex保护
+
+    bool _initialized;                                    // 是否已初始化
+    std::atomic<bool> _running;                           // 是否正在采集
+
+    mutable std::mutex _mutex;                            // 保护配对状态和输出队列
+    std::condition_variable _cv;                          // 输出队列条件变量
+    std::vector<std::shared_ptr<frame_group>> _ready_groups;  // 已完成的帧组
+    uint64_t _next_group_id;                              // 下一个帧组ID
+    uint64_t _dropped_frames;                             // 丢弃的帧数
+    uint64_t _dropped_groups;                             // 丢弃的帧组数
+
+    std::vector<camera_startup_report> _startup_report;   // 启动报告
+    int64_t _startup_time_us;                             // 并行初始化总耗时
+    int _group_event_fd;                                  // 输出队列非空时可读的eventfd
+};
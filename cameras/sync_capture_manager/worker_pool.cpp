@@ -0,0 +1,92 @@
+#include "worker_pool.hpp"
+
+/**
+ * @brief 构造函数
+ */
+worker_pool::worker_pool(size_t threads)
+    : _task(nullptr),
+      _count(0),
+      _generation(0),
+      _busy_workers(0),
+      _stop(false),
+      _next(0)
+{
+    for (size_t i = 1; i < threads; ++i) {
+        _workers.emplace_back(&worker_pool::worker_loop, this);
+    }
+}
+
+/**
+ * @brief 析构函数
+ */
+worker_pool::~worker_pool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _start_cv.notify_all();
+    for (auto& worker : _workers) {
+        worker.join();
+    }
+}
+
+/**
+ * @brief 并行执行任务
+ */
+void worker_pool::run(size_t count, const std::function<void(size_t)>& task)
+{
+    std::lock_guard<std::mutex> run_lock(_run_mutex);
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _task = &task;
+        _count = count;
+        _next = 0;
+        _busy_workers = _workers.size();
+        ++_generation;
+    }
+    _start_cv.notify_all();
+
+    drain();
+
+    // 等待工作线程处理完已领取的任务，之后调用者才能释放任务引用的数据
+    std::unique_lock<std::mutex> lock(_mutex);
+    _done_cv.wait(lock, [this]() { return _busy_workers == 0; });
+    _task = nullptr;
+    _count = 0;
+}
+
+/**
+ * @brief 工作线程
+ */
+void worker_pool::worker_loop()
+{
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+        _start_cv.wait(lock, [&]() { return _stop || _generation != seen; });
+        if (_stop) {
+            return;
+        }
+        seen = _generation;
+
+        lock.unlock();
+        drain();
+        lock.lock();
+
+        if (--_busy_workers == 0) {
+            _done_cv.notify_all();
+        }
+    }
+}
+
+/**
+ * @brief 领取并执行任务直到全部领取完
+ */
+void worker_pool::drain()
+{
+    for (size_t index = _next++; index < _count; index = _next++) {
+        (*_task)(index);
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief 固定大小的并行任务线程池
+ *
+ * 用于把一个帧组内彼此独立的工作（拼接画面的格子、各摄像头的编码等）分给多个线程。
+ * 工作线程常驻，run调用时领取下标执行任务，调用run的线程也参与执行
+ */
+class worker_pool {
+public:
+    /**
+     * @brief 构造函数
+     *
+     * @param threads 并行线程数，包括调用run的线程
+     */
+    explicit worker_pool(size_t threads);
+
+    /**
+     * @brief 析构函数，停止工作线程
+     */
+    ~worker_pool();
+
+    // 禁止拷贝
+    worker_pool(const worker_pool&) = delete;
+    worker_pool& operator=(const worker_pool&) = delete;
+
+    /**
+     * @brief 并行执行task(0)到task(count-1)，全部完成后返回
+     *
+     * 多个线程同时调用时依次执行
+     *
+     * @param count 任务数量
+     * @param task 任务函数，参数为任务下标
+     */
+    void run(size_t count, const std::function<void(size_t)>& task);
+
+    /**
+     * @brief 并行线程数，包括调用run的线程
+     */
+    size_t threads() const { return _workers.size() + 1; }
+
+private:
+    void worker_loop();
+    void drain();
+
+    std::mutex _run_mutex;                          // 保证run串行执行
+    std::mutex _mutex;                              // 保护任务状态
+    std::condition_variable _start_cv;              // 通知工作线程开始
+    std::condition_variable _done_cv;               // 通知调用线程完成
+    std::vector<std::thread> _workers;              // 工作线程
+    const std::function<void(size_t)>* _task;       // 当前任务
+    size_t _count;                                  // 当前任务数量
+    uint64_t _generation;                           // 任务编号
+    size_t _busy_workers;                           // 尚未完成当前任务的工作线程数
+    bool _stop;                                     // 通知工作线程退出
+    std::atomic<size_t> _next;                      // 下一个待领取的下标
+};